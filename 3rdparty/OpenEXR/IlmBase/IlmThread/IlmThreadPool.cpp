@@ -92,7 +92,8 @@ struct TaskGroup::Data
     
     Semaphore	isEmpty;        // used to signal that the taskgroup is empty
     int         numPending;     // number of pending tasks to still execute
-    Mutex       dtorMutex;      // used to work around the glibc bug:
+    Mutex       dtorMutex;      // guards numPending, also used to work
+                                // around the glibc bug:
                                 // http://sources.redhat.com/bugzilla/show_bug.cgi?id=12674
 };
 
@@ -119,6 +120,9 @@ struct ThreadPool::Data
     
     bool stopping;                  // flag indicating whether to stop threads
     Mutex stopMutex;                // mutual exclusion for stopping flag
+
+    ThreadPoolProvider *provider;   // replaces the threads unless null,
+                                    //   guarded by threadMutex
 };
 
 
@@ -161,16 +165,13 @@ WorkerThread::run ()
             if (_data->numTasks > 0)
             {
                 Task* task = _data->tasks.front();
-		TaskGroup* taskGroup = task->group();
                 _data->tasks.pop_front();
                 _data->numTasks--;
 
                 taskLock.release();
                 task->execute();
-                taskLock.acquire();
-
                 delete task;
-                taskGroup->_data->removeTask();
+                taskLock.acquire();
             }
             else if (_data->stopped())
 	    {
@@ -219,11 +220,14 @@ void
 TaskGroup::Data::addTask () 
 {
     //
-    // Any access to the taskgroup is protected by a mutex that is
-    // held by the threadpool.  Therefore it is safe to access
-    // numPending before we wait on the semaphore.
+    // Tasks register themselves upon construction, possibly while
+    // others complete from different threads, hence the mutex.
+    // Since numPending is zero only when the semaphore is
+    // available, waiting on it never blocks while locked.
     //
 
+    Lock lock (dtorMutex);
+
     if (numPending++ == 0)
 	isEmpty.wait ();
 }
@@ -242,11 +246,10 @@ TaskGroup::Data::removeTask ()
     // access to the memory location can be invalid.
     // http://sources.redhat.com/bugzilla/show_bug.cgi?id=12674
 
+    Lock lock (dtorMutex);
+
     if (--numPending == 0)
-    {
-        Lock lock (dtorMutex);
         isEmpty.post ();
-    }
 }
     
 
@@ -254,7 +257,8 @@ TaskGroup::Data::removeTask ()
 // struct ThreadPool::Data
 //
 
-ThreadPool::Data::Data (): numTasks (0), numThreads (0), stopping (false)
+ThreadPool::Data::Data ():
+    numTasks (0), numThreads (0), stopping (false), provider (0)
 {
     // empty
 }
@@ -263,6 +267,13 @@ ThreadPool::Data::Data (): numTasks (0), numThreads (0), stopping (false)
 ThreadPool::Data::~Data()
 {
     Lock lock (threadMutex);
+
+    if (provider)
+    {
+        provider->finish ();
+        delete provider;
+    }
+
     finish ();
 }
 
@@ -327,19 +338,42 @@ ThreadPool::Data::stop ()
 }
 
 
+//
+// class ThreadPoolProvider
+//
+
+ThreadPoolProvider::ThreadPoolProvider ()
+{
+    // empty
+}
+
+
+ThreadPoolProvider::~ThreadPoolProvider ()
+{
+    // empty
+}
+
+
 //
 // class Task
 //
 
 Task::Task (TaskGroup* g): _group(g)
 {
-    // empty
+    //
+    // The group keeps track of its tasks from their construction
+    // until their destruction, regardless of who executes them.
+    //
+
+    if (_group)
+        _group->_data->addTask ();
 }
 
 
 Task::~Task()
 {
-    // empty
+    if (_group)
+        _group->_data->removeTask ();
 }
 
 
@@ -384,6 +418,10 @@ int
 ThreadPool::numThreads () const
 {
     Lock lock (_data->threadMutex);
+
+    if (_data->provider)
+        return _data->provider->numThreads ();
+
     return _data->numThreads;
 }
 
@@ -401,7 +439,11 @@ ThreadPool::setNumThreads (int count)
 
     Lock lock (_data->threadMutex);
 
-    if ((size_t)count > _data->numThreads)
+    if (_data->provider)
+    {
+        _data->provider->setNumThreads (count);
+    }
+    else if ((size_t)count > _data->numThreads)
     {
 	//
         // Add more threads
@@ -444,7 +486,18 @@ ThreadPool::addTask (Task* task)
 
     Lock lock (_data->threadMutex);
 
-    if (_data->numThreads == 0)
+    if (_data->provider)
+    {
+	//
+	// The provider may execute the task right away, thus the
+	// other threads must be able to add tasks in the meantime
+	//
+
+        ThreadPoolProvider *provider = _data->provider;
+        lock.release ();
+        provider->addTask (task);
+    }
+    else if (_data->numThreads == 0)
     {
         task->execute ();
         delete task;
@@ -464,7 +517,6 @@ ThreadPool::addTask (Task* task)
 
             _data->tasks.push_back (task);
             _data->numTasks++;
-            task->group()->_data->addTask();
         }
         
 	//
@@ -476,6 +528,29 @@ ThreadPool::addTask (Task* task)
 }
 
 
+void
+ThreadPool::setThreadProvider (ThreadPoolProvider* provider)
+{
+    Lock lock (_data->threadMutex);
+
+    //
+    // Wait for the tasks of the current provider or threads
+    //
+
+    if (_data->provider)
+    {
+        _data->provider->finish ();
+        delete _data->provider;
+    }
+    else
+    {
+        _data->finish ();
+    }
+
+    _data->provider = provider;
+}
+
+
 #if !HAVE_SAFE_LOCAL_STATIC
 namespace
 {
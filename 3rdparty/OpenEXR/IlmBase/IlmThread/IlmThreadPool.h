@@ -53,6 +53,10 @@
 //	single TaskGroup.  The destructor of the TaskGroup waits for all
 //	tasks in the group to finish.
 //
+//	Class ThreadPoolProvider allows replacing the worker threads of
+//	a ThreadPool with some other mechanism, such as the task scheduler
+//	of the application.  This interface is backported from IlmBase 2.3.
+//
 //	Note: if you plan to use the ThreadPool interface in your own
 //	applications note that the implementation of the ThreadPool calls
 //	operator delete on tasks as they complete.  If you define a custom
@@ -70,6 +74,43 @@ class TaskGroup;
 class Task;
 
 
+//-------------------------------------------------------
+// ThreadPoolProvider -- the actual implementation of a
+// ThreadPool.  A provider must execute each task that it
+// is given and then delete it, just like the worker
+// threads of the default implementation.
+//-------------------------------------------------------
+
+class ILMTHREAD_EXPORT ThreadPoolProvider
+{
+  public:
+
+    ThreadPoolProvider ();
+    virtual ~ThreadPoolProvider ();
+
+    //----------------------------------------------------------
+    // As in ThreadPool.  The number of threads is a hint about
+    // the number of tasks worth having in flight at once.
+    //----------------------------------------------------------
+
+    virtual int		numThreads () const = 0;
+    virtual void	setNumThreads (int count) = 0;
+    virtual void	addTask (Task* task) = 0;
+
+    //----------------------------------------------------------
+    // Waits for all the tasks to complete, called right before
+    // the ThreadPool replaces or deletes the provider.
+    //----------------------------------------------------------
+
+    virtual void	finish () = 0;
+
+  private:
+
+    ThreadPoolProvider (const ThreadPoolProvider &);
+    ThreadPoolProvider & operator= (const ThreadPoolProvider &);
+};
+
+
 class ILMTHREAD_EXPORT ThreadPool  
 {
   public:
@@ -112,6 +153,19 @@ class ILMTHREAD_EXPORT ThreadPool
     void addTask (Task* task);
     
 
+    //------------------------------------------------------------
+    // Replace the worker threads with a provider, which becomes
+    // owned by the ThreadPool.  A null provider restores the
+    // default worker threads, without any thread running until
+    // setNumThreads is called.
+    //
+    // Warning: as with setNumThreads, never call this function
+    // while other threads may be adding tasks.
+    //------------------------------------------------------------
+
+    void setThreadProvider (ThreadPoolProvider* provider);
+
+
     //-------------------------------------------
     // Access functions for the global threadpool
     //-------------------------------------------
@@ -43,6 +43,14 @@
 #cmakedefine ILMBASE_USE_WINNT_VISTA_SYNC 1
 
 
+//
+// Defined as 1 since IlmThread::ThreadPool accepts custom providers
+// (IlmThread::ThreadPoolProvider) as a backport from IlmBase 2.3.
+//
+
+#define ILMBASE_HAS_THREAD_POOL_PROVIDER 1
+
+
 //
 // Current (internal) library namepace name and corresponding public
 // client namespaces.
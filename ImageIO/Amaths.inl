@@ -34,43 +34,50 @@ namespace am
 namespace
 {
 
-const pcg::Vec4f _ps_am_1(1.0f);
-const pcg::Vec4f _ps_am_0p5(0.5f);
-const pcg::Vec4f _ps_am_min_norm_pos(
-    _mm_castsi128_ps(pcg::Vec4i::constant<0x00800000>()));
-const pcg::Vec4f _ps_am_inv_mant_mask(
-    _mm_castsi128_ps(pcg::Vec4i::constant<~0x7f800000>()));
+// Plain unions instead of Vec4f so that they are constant-initialized: the
+// constructors run at load time, which in the AVX variants of the kernels
+// would execute VEX encoded instructions even on processors without AVX
+#define AM_PS_CONST(name, x) const pcg::Vec4fUnion name = {{x, x, x, x}}
+#define AM_EPI32_CONST(name, x) const pcg::Vec4iUnion name = {{x, x, x, x}}
 
-const pcg::Vec4i _epi32_1(pcg::Vec4i::constant<1>());
-const pcg::Vec4i _epi32_0x7f(pcg::Vec4i::constant<0x7f>());
+AM_PS_CONST(_ps_am_1, 1.0f);
+AM_PS_CONST(_ps_am_0p5, 0.5f);
+AM_EPI32_CONST(_ps_am_min_norm_pos, 0x00800000);
+AM_EPI32_CONST(_ps_am_inv_mant_mask, ~0x7f800000);
+
+AM_EPI32_CONST(_epi32_1, 1);
+AM_EPI32_CONST(_epi32_0x7f, 0x7f);
 
 /////////////////////////////////////////////////////////////////////////////
 // log functions
 
-const pcg::Vec4f _ps_log_p0( -7.89580278884799154124e-1f);
-const pcg::Vec4f _ps_log_p1(  1.63866645699558079767e1f);
-const pcg::Vec4f _ps_log_p2( -6.41409952958715622951e1f);
+AM_PS_CONST(_ps_log_p0, -7.89580278884799154124e-1f);
+AM_PS_CONST(_ps_log_p1, 1.63866645699558079767e1f);
+AM_PS_CONST(_ps_log_p2, -6.41409952958715622951e1f);
 
-const pcg::Vec4f _ps_log_q0( -3.56722798256324312549e1f);
-const pcg::Vec4f _ps_log_q1(  3.12093766372244180303e2f);
-const pcg::Vec4f _ps_log_q2( -7.69691943550460008604e2f);
+AM_PS_CONST(_ps_log_q0, -3.56722798256324312549e1f);
+AM_PS_CONST(_ps_log_q1, 3.12093766372244180303e2f);
+AM_PS_CONST(_ps_log_q2, -7.69691943550460008604e2f);
 
-const pcg::Vec4f _ps_log_c0(  0.693147180559945f);
+AM_PS_CONST(_ps_log_c0, 0.693147180559945f);
 
-const pcg::Vec4f _ps_log2_c0( 1.44269504088896340735992f);
+AM_PS_CONST(_ps_log2_c0, 1.44269504088896340735992f);
 
 /////////////////////////////////////////////////////////////////////////////
 // exp2 functions
 
-const pcg::Vec4f _ps_exp2_hi(  127.4999961853f);
-const pcg::Vec4f _ps_exp2_lo( -127.4999961853f);
+AM_PS_CONST(_ps_exp2_hi, 127.4999961853f);
+AM_PS_CONST(_ps_exp2_lo, -127.4999961853f);
+
+AM_PS_CONST(_ps_exp2_p0, 2.30933477057345225087e-2f);
+AM_PS_CONST(_ps_exp2_p1, 2.02020656693165307700e1f);
+AM_PS_CONST(_ps_exp2_p2, 1.51390680115615096133e3f);
 
-const pcg::Vec4f _ps_exp2_p0( 2.30933477057345225087e-2f);
-const pcg::Vec4f _ps_exp2_p1( 2.02020656693165307700e1f);
-const pcg::Vec4f _ps_exp2_p2( 1.51390680115615096133e3f);
+AM_PS_CONST(_ps_exp2_q0, 2.33184211722314911771e2f);
+AM_PS_CONST(_ps_exp2_q1, 4.36821166879210612817e3f);
 
-const pcg::Vec4f _ps_exp2_q0( 2.33184211722314911771e2f);
-const pcg::Vec4f _ps_exp2_q1( 4.36821166879210612817e3f);
+#undef AM_PS_CONST
+#undef AM_EPI32_CONST
 
 } // namespace
 } // namespace am
@@ -84,20 +91,20 @@ const pcg::Vec4f _ps_exp2_q1( 4.36821166879210612817e3f);
 inline __m128 am::log_eps(__m128 x)
 {
     // Constants
-    const __m128 am_1          = _ps_am_1;
-    const __m128 min_norm_pos  = _ps_am_min_norm_pos;
-    const __m128 inv_mant_mask = _ps_am_inv_mant_mask;
-    const __m128i epi32_0x7f   = _epi32_0x7f;
+    const __m128 am_1          = _ps_am_1.xmm;
+    const __m128 min_norm_pos  = _mm_castsi128_ps(_ps_am_min_norm_pos.xmm);
+    const __m128 inv_mant_mask = _mm_castsi128_ps(_ps_am_inv_mant_mask.xmm);
+    const __m128i epi32_0x7f   = _epi32_0x7f.xmm;
 
-    const __m128 log_p0 = _ps_log_p0;
-    const __m128 log_p1 = _ps_log_p1;
-    const __m128 log_p2 = _ps_log_p2;
+    const __m128 log_p0 = _ps_log_p0.xmm;
+    const __m128 log_p1 = _ps_log_p1.xmm;
+    const __m128 log_p2 = _ps_log_p2.xmm;
 
-    const __m128 log_q0 = _ps_log_q0;
-    const __m128 log_q1 = _ps_log_q1;
-    const __m128 log_q2 = _ps_log_q2;
+    const __m128 log_q0 = _ps_log_q0.xmm;
+    const __m128 log_q1 = _ps_log_q1.xmm;
+    const __m128 log_q2 = _ps_log_q2.xmm;
 
-    const __m128 log_c0 = _ps_log_c0;
+    const __m128 log_c0 = _ps_log_c0.xmm;
 
 
     // Use variables named like the registers to keep the code close
@@ -167,32 +174,32 @@ inline __m128 am::log_eps(__m128 x)
 inline __m128 am::pow_eps(__m128 x, __m128 y)
 {
     // Constants
-    const __m128 am_1          = _ps_am_1;
-    const __m128 am_0p5        = _ps_am_0p5;
-    const __m128 min_norm_pos  = _ps_am_min_norm_pos;
-    const __m128 inv_mant_mask = _ps_am_inv_mant_mask;
-    const __m128i epi32_1      = _epi32_1;
-    const __m128i epi32_0x7f   = _epi32_0x7f;
+    const __m128 am_1          = _ps_am_1.xmm;
+    const __m128 am_0p5        = _ps_am_0p5.xmm;
+    const __m128 min_norm_pos  = _mm_castsi128_ps(_ps_am_min_norm_pos.xmm);
+    const __m128 inv_mant_mask = _mm_castsi128_ps(_ps_am_inv_mant_mask.xmm);
+    const __m128i epi32_1      = _epi32_1.xmm;
+    const __m128i epi32_0x7f   = _epi32_0x7f.xmm;
 
-    const __m128 log_p0 = _ps_log_p0;
-    const __m128 log_p1 = _ps_log_p1;
-    const __m128 log_p2 = _ps_log_p2;
+    const __m128 log_p0 = _ps_log_p0.xmm;
+    const __m128 log_p1 = _ps_log_p1.xmm;
+    const __m128 log_p2 = _ps_log_p2.xmm;
 
-    const __m128 log_q0 = _ps_log_q0;
-    const __m128 log_q1 = _ps_log_q1;
-    const __m128 log_q2 = _ps_log_q2;
+    const __m128 log_q0 = _ps_log_q0.xmm;
+    const __m128 log_q1 = _ps_log_q1.xmm;
+    const __m128 log_q2 = _ps_log_q2.xmm;
 
-    const __m128 log2_c0 = _ps_log2_c0;
+    const __m128 log2_c0 = _ps_log2_c0.xmm;
 
-    const __m128 exp2_hi = _ps_exp2_hi;
-    const __m128 exp2_lo = _ps_exp2_lo;
+    const __m128 exp2_hi = _ps_exp2_hi.xmm;
+    const __m128 exp2_lo = _ps_exp2_lo.xmm;
 
-    const __m128 exp2_p0 = _ps_exp2_p0;
-    const __m128 exp2_p1 = _ps_exp2_p1;
-    const __m128 exp2_p2 = _ps_exp2_p2;
+    const __m128 exp2_p0 = _ps_exp2_p0.xmm;
+    const __m128 exp2_p1 = _ps_exp2_p1.xmm;
+    const __m128 exp2_p2 = _ps_exp2_p2.xmm;
 
-    const __m128 exp2_q0 = _ps_exp2_q0;
-    const __m128 exp2_q1 = _ps_exp2_q1;
+    const __m128 exp2_q0 = _ps_exp2_q0.xmm;
+    const __m128 exp2_q1 = _ps_exp2_q1.xmm;
 
     // Use variables named like the registers to keep the code close
     __m128 xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7, ecx_16;
@@ -329,33 +336,42 @@ typedef pcg::Vec8i v8i;
 typedef pcg::Vec8f v8f;
 
 
-const v8f inv_mantissa_mask(_mm256_castsi256_ps(v8i::constant<~0x7f800000>()));
-const v8f min_normal(_mm256_castsi256_ps(v8i::constant<0x00800000>()));
+// Constant-initialized for the same reason as the SSE constants
+#define AM_AVX_PS_CONST(name, x) \
+    const pcg::Vec8fUnion name = {{x, x, x, x, x, x, x, x}}
+#define AM_AVX_EPI32_CONST(name, x) \
+    const pcg::Vec8iUnion name = {{x, x, x, x, x, x, x, x}}
+
+AM_AVX_EPI32_CONST(inv_mantissa_mask, ~0x7f800000);
+AM_AVX_EPI32_CONST(min_normal, 0x00800000);
+
+AM_AVX_PS_CONST(const_1, 1.0f);
+AM_AVX_PS_CONST(const_127, 127.0f);
+AM_AVX_PS_CONST(const_0p5, 0.5f);
 
-const v8f const_1(1.0f);
-const v8f const_127(127.0f);
-const v8f const_0p5(0.5f);
+AM_AVX_PS_CONST(log_p0, -7.89580278884799154124e-1f);
+AM_AVX_PS_CONST(log_p1, 1.63866645699558079767e1f);
+AM_AVX_PS_CONST(log_p2, -6.41409952958715622951e1f);
 
-const v8f log_p0( -7.89580278884799154124e-1f);
-const v8f log_p1(  1.63866645699558079767e1f);
-const v8f log_p2( -6.41409952958715622951e1f);
+AM_AVX_PS_CONST(log_q0, -3.56722798256324312549e1f);
+AM_AVX_PS_CONST(log_q1, 3.12093766372244180303e2f);
+AM_AVX_PS_CONST(log_q2, -7.69691943550460008604e2f);
 
-const v8f log_q0( -3.56722798256324312549e1f);
-const v8f log_q1(  3.12093766372244180303e2f);
-const v8f log_q2( -7.69691943550460008604e2f);
+AM_AVX_PS_CONST(log_c0, 0.693147180559945f);
+AM_AVX_PS_CONST(log2_c0, 1.44269504088896340735992f);
 
-const v8f log_c0(  0.693147180559945f);
-const v8f log2_c0(1.44269504088896340735992f);
+AM_AVX_PS_CONST(exp2_hi, 127.4999961853f);
+AM_AVX_PS_CONST(exp2_lo, -127.4999961853f);
 
-const v8f exp2_hi( 127.4999961853f);
-const v8f exp2_lo(-127.4999961853f);
+AM_AVX_PS_CONST(exp2_p0, 2.30933477057345225087e-2f);
+AM_AVX_PS_CONST(exp2_p1, 2.02020656693165307700e1f);
+AM_AVX_PS_CONST(exp2_p2, 1.51390680115615096133e3f);
 
-const v8f exp2_p0(2.30933477057345225087e-2f);
-const v8f exp2_p1(2.02020656693165307700e1f);
-const v8f exp2_p2(1.51390680115615096133e3f);
+AM_AVX_PS_CONST(exp2_q0, 2.33184211722314911771e2f);
+AM_AVX_PS_CONST(exp2_q1, 4.36821166879210612817e3f);
 
-const v8f exp2_q0(2.33184211722314911771e2f);
-const v8f exp2_q1(4.36821166879210612817e3f);
+#undef AM_AVX_PS_CONST
+#undef AM_AVX_EPI32_CONST
 
 
 
@@ -425,8 +441,9 @@ inline __m256 am::log_avx(__m256 x)
     typedef pcg::Vec8f v8f;
 
     // Constants
-    const v8f min_normal(avx::min_normal);
-    const v8f inv_mantissa_mask(avx::inv_mantissa_mask);
+    const v8f min_normal(_mm256_castsi256_ps(avx::min_normal.ymm));
+    const v8f inv_mantissa_mask(
+        _mm256_castsi256_ps(avx::inv_mantissa_mask.ymm));
     const v8f const_1(avx::const_1);
     const v8f const_127(avx::const_127);
 
@@ -494,8 +511,9 @@ inline __m256 am::pow_avx(__m256 x, __m256 y)
     typedef pcg::Vec8bf v8bf;
 
     // Constants
-    const v8f min_normal(avx::min_normal);
-    const v8f inv_mantissa_mask(avx::inv_mantissa_mask);
+    const v8f min_normal(_mm256_castsi256_ps(avx::min_normal.ymm));
+    const v8f inv_mantissa_mask(
+        _mm256_castsi256_ps(avx::inv_mantissa_mask.ymm));
     const v8f const_1(avx::const_1);
     const v8f const_127(avx::const_127);
 
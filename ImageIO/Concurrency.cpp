@@ -0,0 +1,132 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "Concurrency.h"
+#include "ConcurrencyPrivate.h"
+#include "Exception.h"
+
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/spin_mutex.h>
+#include <tbb/task_scheduler_init.h>
+
+#include <cassert>
+#include <vector>
+
+using pcg::Concurrency;
+
+
+namespace
+{
+
+tbb::spin_mutex maxThreadsMutex;
+int maxThreads = tbb::task_scheduler_init::default_num_threads();
+
+// Arenas for the process-wide setting, the last one is the current one. The
+// previous ones are kept until the end since they may still be in use.
+std::vector<tbb::task_arena*> processArenas;
+int processArenaThreads = 0;
+
+// Innermost scope of each thread
+typedef tbb::enumerable_thread_specific<const Concurrency::Scope*> ScopeTLS;
+ScopeTLS currentScopes(static_cast<const Concurrency::Scope*>(NULL));
+
+} // namespace
+
+
+
+int Concurrency::MaxThreads()
+{
+    tbb::spin_mutex::scoped_lock lock(maxThreadsMutex);
+    return maxThreads;
+}
+
+
+
+void Concurrency::SetMaxThreads(int num)
+{
+    if (num < 1) {
+        throw IllegalArgumentException("The maximum number of threads "
+            "must be at least one");
+    }
+    tbb::spin_mutex::scoped_lock lock(maxThreadsMutex);
+    maxThreads = num;
+}
+
+
+
+const Concurrency::Scope* Concurrency::CurrentScope()
+{
+    return currentScopes.local();
+}
+
+
+
+Concurrency::Scope::Scope(tbb::task_arena &arena, int grainSize) :
+m_arena(&arena), m_ownArena(NULL), m_grainSize(grainSize), m_previous(NULL)
+{
+    push();
+}
+
+
+
+Concurrency::Scope::Scope(int maxThreads, int grainSize) :
+m_arena(NULL), m_ownArena(NULL), m_grainSize(grainSize), m_previous(NULL)
+{
+    if (maxThreads < 1) {
+        throw IllegalArgumentException("The maximum number of threads "
+            "must be at least one");
+    }
+    m_ownArena = new tbb::task_arena(maxThreads);
+    m_arena = m_ownArena;
+    push();
+}
+
+
+
+void Concurrency::Scope::push()
+{
+    if (m_grainSize < 0) {
+        delete m_ownArena;
+        throw IllegalArgumentException("The grain size cannot be negative");
+    }
+    const Scope *&current = currentScopes.local();
+    m_previous = current;
+    current = this;
+}
+
+
+
+Concurrency::Scope::~Scope()
+{
+    const Scope *&current = currentScopes.local();
+    assert(current == this);
+    current = m_previous;
+    delete m_ownArena;
+}
+
+
+
+tbb::task_arena* pcg::concurrency::processArena()
+{
+    tbb::spin_mutex::scoped_lock lock(maxThreadsMutex);
+    if (maxThreads >= tbb::task_scheduler_init::default_num_threads()) {
+        return NULL;
+    }
+    if (processArenaThreads != maxThreads) {
+        processArenas.push_back(new tbb::task_arena(maxThreads));
+        processArenaThreads = maxThreads;
+    }
+    return processArenas.back();
+}
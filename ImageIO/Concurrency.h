@@ -0,0 +1,88 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#pragma once
+#if !defined(PCG_CONCURRENCY_H)
+#define PCG_CONCURRENCY_H
+
+#include "ImageIO.h"
+
+#include <tbb/task_arena.h>
+
+namespace pcg
+{
+
+// Process-wide setting for the number of threads used by the library. The
+// parallel loops of the kernels and the codecs run within a TBB arena limited
+// to that many threads, unless the calling thread sets up a Scope of its own.
+// The OpenEXR codecs also take it as the number of threads of the IlmThread
+// pool, whose tasks run on the TBB scheduler: decoding a file from within a
+// parallel loop or pipeline of TBB does not start any other threads.
+class Concurrency
+{
+public:
+
+    // Maximum number of threads working at once. Initially this is the
+    // default number of threads of TBB.
+    static IMAGEIO_API int MaxThreads();
+
+    // Sets the maximum number of threads, which must be at least one,
+    // otherwise it throws IllegalArgumentException. Anything already in
+    // progress keeps the previous setting.
+    static IMAGEIO_API void SetMaxThreads(int num);
+
+    // Execution context of the library for the thread which creates it, for
+    // example to give each request of a server its own budget. While the
+    // scope exists, the parallel loops started from this thread run within
+    // the given arena, or within an arena of the scope limited to maxThreads
+    // threads, instead of the process-wide one. A non-zero grain size is the
+    // minimum number of pixels processed by each task. Scopes may be nested,
+    // the innermost one applies, and they must be destroyed in reverse order
+    // by the same thread.
+    class IMAGEIO_API Scope
+    {
+    public:
+        explicit Scope(tbb::task_arena &arena, int grainSize = 0);
+        explicit Scope(int maxThreads, int grainSize = 0);
+        ~Scope();
+
+        inline tbb::task_arena& Arena() const {
+            return *m_arena;
+        }
+
+        inline int GrainSize() const {
+            return m_grainSize;
+        }
+
+    private:
+        // Non-copyable
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+
+        void push();
+
+        tbb::task_arena *m_arena;
+        tbb::task_arena *m_ownArena;
+        int m_grainSize;
+        const Scope *m_previous;
+    };
+
+    // The innermost scope of the calling thread, NULL if there is none
+    static IMAGEIO_API const Scope* CurrentScope();
+};
+
+} // namespace pcg
+
+#endif /* PCG_CONCURRENCY_H */
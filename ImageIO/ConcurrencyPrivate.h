@@ -0,0 +1,268 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Internal replacements of the TBB algorithms which run them within the
+// execution context of the calling thread, as set up through Concurrency.
+// Every parallel loop of the library goes through them.
+
+#if !defined(PCG_CONCURRENCYPRIVATE_H)
+#define PCG_CONCURRENCYPRIVATE_H
+
+#include "Concurrency.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/task.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+
+#include <algorithm>
+#include <cstddef>
+
+// oneTBB tells the context of the task which a thread is running
+#if TBB_INTERFACE_VERSION >= 12000
+# define PCG_TBB_CURRENT_CONTEXT 1
+#else
+# define PCG_TBB_CURRENT_CONTEXT 0
+#endif
+
+namespace pcg
+{
+namespace concurrency
+{
+
+// Arena limited to the process-wide number of threads. It is NULL when that
+// is the default number of threads of TBB, so that the implicit arena of
+// each thread does just as well.
+tbb::task_arena* processArena();
+
+// Arena for the parallel work started by the calling thread, NULL for its
+// current one. TBB worker threads are already running some parallel work
+// within an arena, thus they stay there.
+inline tbb::task_arena* currentArena()
+{
+    if (tbb::this_task_arena::current_thread_index() > 0) {
+        return NULL;
+    }
+    const Concurrency::Scope *scope = Concurrency::CurrentScope();
+    return scope != NULL ? &scope->Arena() : processArena();
+}
+
+// Maximum number of threads for the parallel work started by the calling
+// thread: that of its innermost scope, otherwise the process-wide setting
+inline int currentMaxThreads()
+{
+    const Concurrency::Scope *scope = Concurrency::CurrentScope();
+    return scope != NULL ? scope->Arena().max_concurrency() :
+        Concurrency::MaxThreads();
+}
+
+// Context of the task which the calling thread is running, NULL when it is
+// not running any, or when the version of TBB does not tell.
+inline tbb::task_group_context* callerContext()
+{
+#if PCG_TBB_CURRENT_CONTEXT
+    return tbb::task::current_context();
+#else
+    return NULL;
+#endif
+}
+
+// Base of the tasks run by execute, with the context for their algorithm:
+// NULL for the default one, that of the task running the algorithm.
+class ContextTask
+{
+public:
+    ContextTask() : m_context(NULL) {}
+
+    void bindTo(tbb::task_group_context *context) {
+        m_context = context;
+    }
+
+protected:
+    tbb::task_group_context *m_context;
+};
+
+// Runs the task within the current arena. Within another arena the
+// algorithm would belong to the default context of that arena, thus it is
+// bound explicitly to the context of the caller, so that cancelling the
+// task group of the caller, or an exception in its algorithm, reaches it.
+// With versions of TBB older than oneTBB the algorithm does not get
+// cancelled along with the caller then.
+template <class Task>
+inline void execute(Task task)
+{
+    tbb::task_arena *arena = currentArena();
+    if (arena == NULL) {
+        task();
+    } else {
+        task.bindTo(callerContext());
+        arena->execute(task);
+    }
+}
+
+// Ranges other than blocked_range keep their own grain size
+template <class Range>
+inline Range withGrainSize(const Range &range, size_t)
+{
+    return range;
+}
+
+// Increases the grain size of the range, each of whose items is the given
+// number of pixels, up to the grain size of the current scope
+template <typename Value>
+inline tbb::blocked_range<Value> withGrainSize(
+    const tbb::blocked_range<Value> &range, size_t pixelsPerItem)
+{
+    const Concurrency::Scope *scope = Concurrency::CurrentScope();
+    if (scope == NULL || scope->GrainSize() == 0) {
+        return range;
+    }
+    const size_t grainPixels = static_cast<size_t>(scope->GrainSize());
+    const size_t grain = std::max(range.grainsize(),
+        (grainPixels + pixelsPerItem - 1) / pixelsPerItem);
+    return tbb::blocked_range<Value>(range.begin(), range.end(), grain);
+}
+
+template <class Range, class Body>
+class ParallelForTask : public ContextTask
+{
+public:
+    ParallelForTask(const Range &range, const Body &body) :
+    m_range(range), m_body(body) {}
+
+    void operator()() const {
+        if (m_context != NULL) {
+            tbb::parallel_for(m_range, m_body, tbb::auto_partitioner(),
+                *m_context);
+        } else {
+            tbb::parallel_for(m_range, m_body);
+        }
+    }
+
+private:
+    const Range m_range;
+    const Body &m_body;
+};
+
+template <class Range, class Body>
+class ParallelReduceTask : public ContextTask
+{
+public:
+    ParallelReduceTask(const Range &range, Body &body) :
+    m_range(range), m_body(body) {}
+
+    void operator()() const {
+        if (m_context != NULL) {
+            tbb::parallel_reduce(m_range, m_body, tbb::auto_partitioner(),
+                *m_context);
+        } else {
+            tbb::parallel_reduce(m_range, m_body);
+        }
+    }
+
+private:
+    const Range m_range;
+    Body &m_body;
+};
+
+template <class Func0, class Func1>
+class ParallelInvokeTask : public ContextTask
+{
+public:
+    ParallelInvokeTask(const Func0 &func0, const Func1 &func1) :
+    m_func0(func0), m_func1(func1) {}
+
+    void operator()() const {
+        if (m_context != NULL) {
+            tbb::parallel_invoke(m_func0, m_func1, *m_context);
+        } else {
+            tbb::parallel_invoke(m_func0, m_func1);
+        }
+    }
+
+private:
+    const Func0 &m_func0;
+    const Func1 &m_func1;
+};
+
+template <class Func0, class Func1>
+class CallerInvokeTask : public ContextTask
+{
+public:
+    CallerInvokeTask(const Func0 &func0, const Func1 &func1) :
+    m_func0(func0), m_func1(func1) {}
+
+    void operator()() const {
+#if PCG_TBB_CURRENT_CONTEXT
+        if (m_context != NULL) {
+            tbb::task_group group(*m_context);
+            run(group);
+            return;
+        }
+#endif
+        tbb::task_group group;
+        run(group);
+    }
+
+private:
+    void run(tbb::task_group &group) const {
+        group.run(m_func1);
+        m_func0();
+        group.wait();
+    }
+
+    const Func0 &m_func0;
+    const Func1 &m_func1;
+};
+
+// Same as tbb::parallel_for and tbb::parallel_reduce, where each item of the
+// range is the given number of pixels
+template <class Range, class Body>
+inline void parallel_for(const Range &range, const Body &body,
+    size_t pixelsPerItem = 1)
+{
+    execute(ParallelForTask<Range, Body>(
+        withGrainSize(range, pixelsPerItem), body));
+}
+
+template <class Range, class Body>
+inline void parallel_reduce(const Range &range, Body &body,
+    size_t pixelsPerItem = 1)
+{
+    execute(ParallelReduceTask<Range, Body>(
+        withGrainSize(range, pixelsPerItem), body));
+}
+
+template <class Func0, class Func1>
+inline void parallel_invoke(const Func0 &func0, const Func1 &func1)
+{
+    execute(ParallelInvokeTask<Func0, Func1>(func0, func1));
+}
+
+// Same as parallel_invoke, except that func0 always runs on the calling
+// thread while func1 may be taken by another thread of the arena
+template <class Func0, class Func1>
+inline void parallel_invoke_caller(const Func0 &func0, const Func1 &func1)
+{
+    execute(CallerInvokeTask<Func0, Func1>(func0, func1));
+}
+
+} // namespace concurrency
+} // namespace pcg
+
+#endif /* PCG_CONCURRENCYPRIVATE_H */
@@ -0,0 +1,176 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "CpuFeatures.h"
+#include "Exception.h"
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#else
+# include <cpuid.h>
+#endif
+
+using pcg::CpuFeatures;
+
+
+namespace
+{
+
+// Instruction set used to compile the regular sources
+#if PCG_USE_AVX2
+const CpuFeatures::InstructionSet BASELINE = CpuFeatures::AVX2;
+#elif PCG_USE_AVX
+const CpuFeatures::InstructionSet BASELINE = CpuFeatures::AVX;
+#else
+const CpuFeatures::InstructionSet BASELINE = CpuFeatures::SSE2;
+#endif
+
+inline void cpuid(unsigned int leaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), 0);
+    for (int i = 0; i < 4; ++i) {
+        regs[i] = static_cast<unsigned int>(r[i]);
+    }
+#else
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Lower 32 bits of the extended control register 0, which tell which
+// register states the operating system saves on context switches
+inline unsigned int xcr0()
+{
+#if defined(_MSC_VER)
+    return static_cast<unsigned int>(_xgetbv(0));
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    return eax;
+#endif
+}
+
+// Best instruction set supported by the processor and the operating system
+CpuFeatures::InstructionSet detectProcessor()
+{
+    unsigned int regs[4];
+    cpuid(0, regs);
+    const unsigned int maxLeaf = regs[0];
+    if (maxLeaf < 1) {
+        return CpuFeatures::SSE2;
+    }
+
+    cpuid(1, regs);
+    const unsigned int ecx = regs[2];
+    const bool hasFMA     = (ecx & (1u << 12)) != 0;
+    const bool hasOSXSAVE = (ecx & (1u << 27)) != 0;
+    const bool hasAVX     = (ecx & (1u << 28)) != 0;
+    const bool hasF16C    = (ecx & (1u << 29)) != 0;
+
+    // The operating system must preserve both the XMM and the YMM registers
+    if (!hasOSXSAVE || !hasAVX || (xcr0() & 0x6) != 0x6) {
+        return CpuFeatures::SSE2;
+    }
+    if (maxLeaf >= 7) {
+        cpuid(7, regs);
+        const bool hasAVX2 = (regs[1] & (1u << 5)) != 0;
+        if (hasAVX2 && hasFMA && hasF16C) {
+            return CpuFeatures::AVX2;
+        }
+    }
+    return CpuFeatures::AVX;
+}
+
+inline bool isBuilt(CpuFeatures::InstructionSet isa)
+{
+    switch (isa) {
+    case CpuFeatures::SSE2:
+        return BASELINE == CpuFeatures::SSE2;
+    case CpuFeatures::AVX:
+#if PCG_SIMD_HAS_AVX
+        return true;
+#else
+        return BASELINE == CpuFeatures::AVX;
+#endif
+    case CpuFeatures::AVX2:
+#if PCG_SIMD_HAS_AVX2
+        return true;
+#else
+        return BASELINE == CpuFeatures::AVX2;
+#endif
+    default:
+        return false;
+    }
+}
+
+const CpuFeatures::InstructionSet processorISA = detectProcessor();
+
+CpuFeatures::InstructionSet activeISA = CpuFeatures::Best();
+
+} // namespace
+
+
+
+bool CpuFeatures::IsAvailable(InstructionSet isa)
+{
+    return isa <= processorISA && isBuilt(isa);
+}
+
+
+
+CpuFeatures::InstructionSet CpuFeatures::Best()
+{
+    for (int isa = AVX2; isa > BASELINE; --isa) {
+        if (IsAvailable(static_cast<InstructionSet>(isa))) {
+            return static_cast<InstructionSet>(isa);
+        }
+    }
+    return BASELINE;
+}
+
+
+
+CpuFeatures::InstructionSet CpuFeatures::Active()
+{
+    return activeISA;
+}
+
+
+
+void CpuFeatures::SetActive(InstructionSet isa)
+{
+    if (!IsAvailable(isa)) {
+        throw IllegalArgumentException(std::string("Instruction set not "
+            "available: ") + Name(isa));
+    }
+    activeISA = isa;
+}
+
+
+
+const char* CpuFeatures::Name(InstructionSet isa)
+{
+    switch (isa) {
+    case SSE2:
+        return "SSE2";
+    case AVX:
+        return "AVX";
+    case AVX2:
+        return "AVX2";
+    default:
+        return "Unknown";
+    }
+}
@@ -0,0 +1,69 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#pragma once
+#if !defined(PCG_CPUFEATURES_H)
+#define PCG_CPUFEATURES_H
+
+#include "ImageIO.h"
+
+namespace pcg
+{
+
+// Selection of the instruction set used by the SIMD kernels of the library:
+// tone mapping of SoA images, the Reinhard02 parameter estimation, the RGBE
+// conversions of SoA images and the SoA image comparisons. Depending on the
+// build, those kernels are compiled for several instruction sets and the best
+// one supported by the processor and the operating system is chosen when the
+// library is loaded.
+class CpuFeatures
+{
+public:
+
+    // Instruction sets, in increasing order of capabilities
+    enum InstructionSet
+    {
+        // Baseline SSE2 (and SSE3 with gcc-like compilers)
+        SSE2 = 0,
+        // 256-bit floating point vectors
+        AVX  = 1,
+        // 256-bit integer vectors, along with FMA and F16C
+        AVX2 = 2
+    };
+
+    // Returns whether the kernels have been built for the instruction set
+    // and the current processor and operating system support it
+    static IMAGEIO_API bool IsAvailable(InstructionSet isa);
+
+    // The best available instruction set
+    static IMAGEIO_API InstructionSet Best();
+
+    // The instruction set currently used by the kernels. Initially this is
+    // the best available one.
+    static IMAGEIO_API InstructionSet Active();
+
+    // Selects the instruction set for the kernels, for example to compare
+    // the performance or the results of different code paths. It throws
+    // IllegalArgumentException if the instruction set is not available.
+    // This must not be called while other threads are running the kernels.
+    static IMAGEIO_API void SetActive(InstructionSet isa);
+
+    // Human readable name of an instruction set, such as "AVX2"
+    static IMAGEIO_API const char* Name(InstructionSet isa);
+};
+
+} // namespace pcg
+
+#endif /* PCG_CPUFEATURES_H */
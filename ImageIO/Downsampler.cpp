@@ -0,0 +1,343 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "Downsampler.h"
+#include "ConcurrencyPrivate.h"
+#include "Exception.h"
+#include "StdAfx.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+using namespace pcg;
+
+
+namespace
+{
+
+// Lanczos kernel with 3 lobes
+inline double lanczos3(double t)
+{
+    const double PI = 3.14159265358979323846;
+    t = fabs(t);
+    if (t < 1e-8) {
+        return 1.0;
+    } else if (t >= 3.0) {
+        return 0.0;
+    }
+    const double x = PI * t;
+    return 3.0 * sin(x) * sin(x / 3.0) / (x * x);
+}
+
+
+
+// Taps to resample along one dimension: the destination sample i is the sum
+// over t of weight(t,i) * source[index(t,i)]. All the samples use the same
+// number of taps, padding with zero weights, and the taps are stored by
+// tap number so that consecutive destination samples are contiguous.
+class FilterTaps
+{
+public:
+    FilterTaps(int srcSize, int dstSize, Downsampler::Filter filter) :
+    m_numTaps(0), m_dstSize(dstSize),
+    m_isHalfBox(filter == Downsampler::BOX && srcSize == 2*dstSize)
+    {
+        typedef std::vector<std::pair<int, double> > TapList;
+        std::vector<TapList> taps(dstSize);
+        const double scale = static_cast<double>(srcSize) / dstSize;
+
+        for (int i = 0; i < dstSize; ++i) {
+            TapList &list = taps[i];
+            if (filter == Downsampler::BOX) {
+                const double a = i * scale;
+                const double b = (i + 1) * scale;
+                const int jEnd = std::min(srcSize, static_cast<int>(ceil(b)));
+                for (int j = static_cast<int>(floor(a)); j < jEnd; ++j) {
+                    const double w = std::min(b, j + 1.0) - std::max(a, 1.0*j);
+                    if (w > 0.0) {
+                        list.push_back(std::make_pair(j, w));
+                    }
+                }
+            } else {
+                const double center = (i + 0.5) * scale;
+                const double radius = 3.0 * scale;
+                const int jBegin = static_cast<int>(floor(center - radius));
+                const int jEnd   = static_cast<int>(ceil(center + radius));
+                for (int j = jBegin; j <= jEnd; ++j) {
+                    const double w = lanczos3((j + 0.5 - center) / scale);
+                    if (w != 0.0) {
+                        const int idx = std::max(0, std::min(srcSize - 1, j));
+                        list.push_back(std::make_pair(idx, w));
+                    }
+                }
+            }
+
+            double sum = 0.0;
+            for (size_t t = 0; t < list.size(); ++t) {
+                sum += list[t].second;
+            }
+            for (size_t t = 0; t < list.size(); ++t) {
+                list[t].second /= sum;
+            }
+            m_numTaps = std::max(m_numTaps, static_cast<int>(list.size()));
+        }
+
+        m_indices.resize(static_cast<size_t>(m_numTaps) * dstSize);
+        m_weights.resize(static_cast<size_t>(m_numTaps) * dstSize);
+        for (int i = 0; i < dstSize; ++i) {
+            const TapList &list = taps[i];
+            for (int t = 0; t < m_numTaps; ++t) {
+                const bool valid = t < static_cast<int>(list.size());
+                m_indices[t*dstSize + i] = list[valid ? t : 0].first;
+                m_weights[t*dstSize + i] =
+                    valid ? static_cast<float>(list[t].second) : 0.0f;
+            }
+        }
+    }
+
+    inline int numTaps() const {
+        return m_numTaps;
+    }
+
+    // Whether this is a box filter which reduces the size exactly by half
+    inline bool isHalfBox() const {
+        return m_isHalfBox;
+    }
+
+    inline const int* indices(int t) const {
+        return &m_indices[static_cast<size_t>(t) * m_dstSize];
+    }
+
+    inline const float* weights(int t) const {
+        return &m_weights[static_cast<size_t>(t) * m_dstSize];
+    }
+
+private:
+    int m_numTaps;
+    int m_dstSize;
+    bool m_isHalfBox;
+    std::vector<int> m_indices;
+    std::vector<float> m_weights;
+};
+
+
+
+inline void getPlanes(const RGBAImageSoA &img, float *planes[4])
+{
+    planes[0] = img.GetDataPointer<RGBAImageSoA::R>();
+    planes[1] = img.GetDataPointer<RGBAImageSoA::G>();
+    planes[2] = img.GetDataPointer<RGBAImageSoA::B>();
+    planes[3] = img.GetDataPointer<RGBAImageSoA::A>();
+}
+
+
+
+// Filters a destination scanline as a weighted sum of source scanlines
+inline void filterVertical(float * PCG_RESTRICT dest, const float *src,
+    int width, const FilterTaps &taps, int y)
+{
+    const int numTaps = taps.numTaps();
+    const size_t stride = width;
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (int t = 0; t < numTaps; ++t) {
+            const float *row = src + taps.indices(t)[y] * stride;
+            const __m128 w = _mm_set1_ps(taps.weights(t)[y]);
+            acc = _mm_add_ps(acc, _mm_mul_ps(w, _mm_loadu_ps(row + x)));
+        }
+        _mm_storeu_ps(dest + x, acc);
+    }
+    for (; x < width; ++x) {
+        float acc = 0.0f;
+        for (int t = 0; t < numTaps; ++t) {
+            const float *row = src + taps.indices(t)[y] * stride;
+            acc += taps.weights(t)[y] * row[x];
+        }
+        dest[x] = acc;
+    }
+}
+
+
+
+// Filters a scanline horizontally. Each group of four destination samples
+// gathers its taps from the source.
+inline void filterHorizontal(float * PCG_RESTRICT dest,
+    const float * PCG_RESTRICT src, int dstWidth, const FilterTaps &taps)
+{
+    int x = 0;
+    if (taps.isHalfBox()) {
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (; x + 4 <= dstWidth; x += 4) {
+            const __m128 a = _mm_loadu_ps(src + 2*x);
+            const __m128 b = _mm_loadu_ps(src + 2*x + 4);
+            const __m128 even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+            const __m128 odd  = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+            _mm_storeu_ps(dest + x, _mm_mul_ps(half, _mm_add_ps(even, odd)));
+        }
+        for (; x < dstWidth; ++x) {
+            dest[x] = 0.5f * (src[2*x] + src[2*x + 1]);
+        }
+        return;
+    }
+
+    const int numTaps = taps.numTaps();
+    for (; x + 4 <= dstWidth; x += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (int t = 0; t < numTaps; ++t) {
+            const int *idx = taps.indices(t) + x;
+#if PCG_USE_AVX2
+            const __m128 v = _mm_i32gather_ps(src,
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(idx)), 4);
+#else
+            const __m128 v = _mm_setr_ps(src[idx[0]], src[idx[1]],
+                src[idx[2]], src[idx[3]]);
+#endif
+            acc = _mm_add_ps(acc,
+                _mm_mul_ps(_mm_loadu_ps(taps.weights(t) + x), v));
+        }
+        _mm_storeu_ps(dest + x, acc);
+    }
+    for (; x < dstWidth; ++x) {
+        float acc = 0.0f;
+        for (int t = 0; t < numTaps; ++t) {
+            acc += taps.weights(t)[x] * src[taps.indices(t)[x]];
+        }
+        dest[x] = acc;
+    }
+}
+
+
+
+// TBB functor for the vertical pass, over the destination scanlines
+class VerticalFunctor
+{
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    VerticalFunctor(const RGBAImageSoA &src, RGBAImageSoA &dest,
+        const FilterTaps &taps) : m_width(src.Width()), m_taps(taps)
+    {
+        getPlanes(src,  m_src);
+        getPlanes(dest, m_dest);
+    }
+
+    void operator() (const Range &range) const {
+        for (int y = range.begin(); y != range.end(); ++y) {
+            for (int c = 0; c < 4; ++c) {
+                float *dest = m_dest[c] + static_cast<size_t>(y) * m_width;
+                filterVertical(dest, m_src[c], m_width, m_taps, y);
+            }
+        }
+    }
+
+private:
+    float *m_src[4];
+    float *m_dest[4];
+    const int m_width;
+    const FilterTaps &m_taps;
+};
+
+
+
+// TBB functor for the horizontal pass, over the scanlines
+class HorizontalFunctor
+{
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    HorizontalFunctor(const RGBAImageSoA &src, RGBAImageSoA &dest,
+        const FilterTaps &taps) :
+    m_srcWidth(src.Width()), m_dstWidth(dest.Width()), m_taps(taps)
+    {
+        getPlanes(src,  m_src);
+        getPlanes(dest, m_dest);
+    }
+
+    void operator() (const Range &range) const {
+        for (int y = range.begin(); y != range.end(); ++y) {
+            for (int c = 0; c < 4; ++c) {
+                filterHorizontal(m_dest[c] + static_cast<size_t>(y)*m_dstWidth,
+                    m_src[c] + static_cast<size_t>(y)*m_srcWidth,
+                    m_dstWidth, m_taps);
+            }
+        }
+    }
+
+private:
+    float *m_src[4];
+    float *m_dest[4];
+    const int m_srcWidth;
+    const int m_dstWidth;
+    const FilterTaps &m_taps;
+};
+
+} // namespace
+
+
+
+void Downsampler::Downsample(const RGBAImageSoA &src, RGBAImageSoA &dest,
+                             Filter filter)
+{
+    if (src.Width() <= 0 || dest.Width() <= 0) {
+        throw IllegalArgumentException("The images must be allocated.");
+    }
+    if (dest.Width() > src.Width() || dest.Height() > src.Height()) {
+        throw IllegalArgumentException("The destination image cannot be "
+            "larger than the source.");
+    }
+
+    const bool resizeX = dest.Width()  != src.Width();
+    const bool resizeY = dest.Height() != src.Height();
+    if (!resizeX && !resizeY) {
+        float *srcPlanes[4], *destPlanes[4];
+        getPlanes(src, srcPlanes);
+        getPlanes(dest, destPlanes);
+        for (int c = 0; c < 4; ++c) {
+            memcpy(destPlanes[c], srcPlanes[c], src.Size() * sizeof(float));
+        }
+        return;
+    }
+
+    // The vertical pass goes first, so that the horizontal one, which has
+    // to gather its inputs, runs over fewer scanlines
+    RGBAImageSoA tmp;
+    const RGBAImageSoA *vertical = &src;
+    if (resizeY) {
+        RGBAImageSoA *target = &dest;
+        if (resizeX) {
+            tmp.Alloc(src.Width(), dest.Height());
+            target = &tmp;
+        }
+        FilterTaps taps(src.Height(), dest.Height(), filter);
+        VerticalFunctor functor(src, *target, taps);
+        concurrency::parallel_for(tbb::blocked_range<int>(0, dest.Height()),
+            functor, src.Width());
+        vertical = target;
+    }
+
+    if (resizeX) {
+        FilterTaps taps(src.Width(), dest.Width(), filter);
+        HorizontalFunctor functor(*vertical, dest, taps);
+        concurrency::parallel_for(tbb::blocked_range<int>(0, dest.Height()),
+            functor, dest.Width());
+    }
+}
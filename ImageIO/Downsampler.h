@@ -0,0 +1,51 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#pragma once
+#if !defined(PCG_DOWNSAMPLER_H)
+#define PCG_DOWNSAMPLER_H
+
+#include "ImageIO.h"
+#include "ImageSoA.h"
+
+namespace pcg
+{
+
+// Parallel, separable resampling of SoA images to lower resolutions, as used
+// to generate the levels of mipmaps and ripmaps.
+class Downsampler
+{
+public:
+
+    // Reconstruction filters
+    enum Filter
+    {
+        // Area average of the source pixels covered by each destination pixel
+        BOX,
+        // Windowed sinc with 3 lobes, scaled by the reduction factor
+        LANCZOS3
+    };
+
+    // Resamples all the channels of src into dest, which must be already
+    // allocated with the target dimensions. Neither the width nor the height
+    // of dest may be larger than those of src. Pixels outside the source are
+    // taken from the closest edge.
+    static void IMAGEIO_API Downsample(const RGBAImageSoA &src,
+        RGBAImageSoA &dest, Filter filter = BOX);
+};
+
+} // namespace pcg
+
+#endif /* PCG_DOWNSAMPLER_H */
@@ -0,0 +1,176 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+/*
+ * Bulk conversion between IEEE 754 half precision values, given as their raw
+ * 16-bit patterns (as in OpenEXR's half::bits()), and single precision floats.
+ * When the F16C instructions are available at compile time they are used
+ * directly, otherwise the conversions are emulated with SSE2.
+ *
+ * The results match OpenEXR's half class: half to float is exact and float to
+ * half rounds to the nearest value, ties to even, with overflows becoming
+ * infinity. Only the payload of NaNs might differ when using F16C.
+ */
+
+#pragma once
+#if !defined (PCG_HALFCONVERSION_H)
+#define PCG_HALFCONVERSION_H
+
+#include "StdAfx.h"
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(__F16C__) || (defined(_MSC_VER) && PCG_USE_AVX2)
+# include <immintrin.h>
+# define PCG_HALF_USE_F16C 1
+#endif
+
+namespace pcg
+{
+
+// Converts four halves, stored in the lower 16 bits of each element
+inline __m128 halfToFloat4(__m128i h)
+{
+#if PCG_HALF_USE_F16C
+    // F16C implies SSE4.1, which provides the unsigned saturation
+    return _mm_cvtph_ps(_mm_packus_epi32(h, _mm_setzero_si128()));
+#else
+    const __m128i expmant = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+    const __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, expmant), 16);
+
+    // Normalized values just need to adjust the exponent bias, 127 - 15
+    const __m128 normal = _mm_castsi128_ps(_mm_add_epi32(
+        _mm_slli_epi32(expmant, 13), _mm_set1_epi32(112 << 23)));
+
+    // Denormals and zero are exactly mantissa * 2^-24
+    const __m128 denormal = _mm_mul_ps(_mm_cvtepi32_ps(expmant),
+        _mm_set1_ps(5.9604644775390625e-8f));
+    const __m128 isDenormal = _mm_castsi128_ps(
+        _mm_cmplt_epi32(expmant, _mm_set1_epi32(0x0400)));
+
+    // Infinity and NaN keep the mantissa with the maximum exponent
+    const __m128i isInfNaN = _mm_cmpgt_epi32(expmant, _mm_set1_epi32(0x7bff));
+    const __m128i infNaNExp =
+        _mm_and_si128(isInfNaN, _mm_set1_epi32(0x7f800000));
+
+    const __m128 value = _mm_or_ps(_mm_and_ps(isDenormal, denormal),
+        _mm_andnot_ps(isDenormal, normal));
+    return _mm_or_ps(value, _mm_castsi128_ps(_mm_or_si128(sign, infNaNExp)));
+#endif
+}
+
+
+
+// Converts four floats into halves, stored in the lower 16 bits of each
+// element of the result
+inline __m128i floatToHalf4(__m128 f)
+{
+#if PCG_HALF_USE_F16C
+    return _mm_unpacklo_epi16(_mm_cvtps_ph(f, 0), _mm_setzero_si128());
+#else
+    // Based on the SSE2 round-to-nearest-even conversion by Fabian Giesen
+    const __m128i absMask = _mm_set1_epi32(0x7fffffff);
+    const __m128i fi = _mm_castps_si128(f);
+    const __m128i absf = _mm_and_si128(fi, absMask);
+    const __m128i sign = _mm_srli_epi32(_mm_andnot_si128(absMask, fi), 16);
+
+    // Values from 65520 upwards round to infinity, NaNs keep the upper bits
+    // of the mantissa, making sure they are still NaNs
+    const __m128i isRegular =
+        _mm_cmpgt_epi32(_mm_set1_epi32((127 + 16) << 23), absf);
+    const __m128i isNaN = _mm_cmpgt_epi32(absf, _mm_set1_epi32(0x7f800000));
+    __m128i nanMant = _mm_srli_epi32(
+        _mm_and_si128(absf, _mm_set1_epi32(0x007fffff)), 13);
+    nanMant = _mm_or_si128(nanMant, _mm_and_si128(_mm_set1_epi32(1),
+        _mm_cmpeq_epi32(nanMant, _mm_setzero_si128())));
+    const __m128i infNaN = _mm_or_si128(_mm_set1_epi32(0x7c00),
+        _mm_and_si128(isNaN, nanMant));
+
+    // Results which are half denormals: let the FPU align and round the
+    // mantissa by adding a magic number
+    const __m128i subnormMagic = _mm_set1_epi32(((127-15) + (23-10) + 1) << 23);
+    const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(
+        _mm_castsi128_ps(absf), _mm_castsi128_ps(subnormMagic))), subnormMagic);
+    const __m128i isSubnormal =
+        _mm_cmpgt_epi32(_mm_set1_epi32((127 - 14) << 23), absf);
+
+    // Normalized results: rebias the exponent and round to nearest even
+    const __m128i mantOdd = _mm_srai_epi32(_mm_slli_epi32(absf, 31 - 13), 31);
+    const __m128i rounded = _mm_sub_epi32(_mm_add_epi32(absf,
+        _mm_set1_epi32(0xfff - ((127 - 15) << 23))), mantOdd);
+    const __m128i normal = _mm_srli_epi32(rounded, 13);
+
+    const __m128i nonSpecial = _mm_or_si128(
+        _mm_and_si128(isSubnormal, subnormal),
+        _mm_andnot_si128(isSubnormal, normal));
+    const __m128i result = _mm_or_si128(_mm_and_si128(isRegular, nonSpecial),
+        _mm_andnot_si128(isRegular, infNaN));
+    return _mm_or_si128(result, sign);
+#endif
+}
+
+
+
+// Converts count halves into floats. The pointers do not need any alignment.
+inline void convertHalfToFloat(float *dest, const unsigned short *src,
+                               size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i h = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(src + i));
+        const __m128i zero = _mm_setzero_si128();
+        _mm_storeu_ps(dest + i,   halfToFloat4(_mm_unpacklo_epi16(h, zero)));
+        _mm_storeu_ps(dest + i+4, halfToFloat4(_mm_unpackhi_epi16(h, zero)));
+    }
+    for (; i < count; i += 4) {
+        const size_t n = (count - i) < 4 ? (count - i) : 4;
+        unsigned short hBuf[8] = {0};
+        float fBuf[4];
+        memcpy(hBuf, src + i, n * sizeof(unsigned short));
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<__m128i*>(hBuf));
+        _mm_storeu_ps(fBuf,
+            halfToFloat4(_mm_unpacklo_epi16(h, _mm_setzero_si128())));
+        memcpy(dest + i, fBuf, n * sizeof(float));
+    }
+}
+
+
+
+// Converts count floats into halves. The pointers do not need any alignment.
+inline void convertFloatToHalf(unsigned short *dest, const float *src,
+                               size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Bias the 16-bit values so that the signed saturation keeps them
+        const __m128i lo = floatToHalf4(_mm_loadu_ps(src + i));
+        const __m128i hi = floatToHalf4(_mm_loadu_ps(src + i + 4));
+        const __m128i bias = _mm_set1_epi32(0x8000);
+        const __m128i packed = _mm_xor_si128(_mm_packs_epi32(
+            _mm_sub_epi32(lo, bias), _mm_sub_epi32(hi, bias)),
+            _mm_set1_epi16(static_cast<short>(0x8000)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), packed);
+    }
+    for (; i < count; ++i) {
+        const __m128i h = floatToHalf4(_mm_set_ss(src[i]));
+        dest[i] = static_cast<unsigned short>(_mm_cvtsi128_si32(h));
+    }
+}
+
+} // namespace pcg
+
+#endif /* PCG_HALFCONVERSION_H */
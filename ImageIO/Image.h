@@ -32,8 +32,10 @@
 #endif
 
 #include "ImageIO.h"
+#include "ImageBufferPool.h"
 #include "Exception.h"
 
+#include <cstddef>
 #include <cstdlib>
 #include <cassert>
 
@@ -49,6 +51,8 @@ namespace pcg {
 		BottomUp
 	};
 
+	// Pixel indices and sizes are ptrdiff_t so that images may have more than
+	// 2^31 pixels; the width and the height are still int.
 	template< typename T, ScanLineMode S = TopDown >
 	class Image {
 
@@ -68,10 +72,10 @@ namespace pcg {
 			static T* GetScanline(int j, ScanLineMode mode, const Image *img) {
 				switch(mode) {
 					case TopDown:
-						return &(img->d[j * img->w]);
+						return &(img->d[static_cast<ptrdiff_t>(j) * img->w]);
 						break;
 					case BottomUp:
-						return &(img->d[(img->h - j - 1) * img->w]);
+						return &(img->d[static_cast<ptrdiff_t>(img->h - j - 1) * img->w]);
 						break;
 					default:
 						assert(0);
@@ -82,10 +86,10 @@ namespace pcg {
 			static T& ElementAt(int i, int j, ScanLineMode mode, const Image *img) {
 				switch(mode) {
 					case TopDown:
-						return img->d[img->w*j+i];
+						return img->d[static_cast<ptrdiff_t>(img->w)*j+i];
 						break;
 					case BottomUp:
-						return img->d[(img->h-j-1)*img->w+i];
+						return img->d[static_cast<ptrdiff_t>(img->h-j-1)*img->w+i];
 						break;
 					default:
 						assert(0);
@@ -101,10 +105,10 @@ namespace pcg {
 			static T* GetScanline(int j, ScanLineMode mode, const Image *img) {
 				switch(mode) {
 					case BottomUp:
-						return &(img->d[j * img->w]);
+						return &(img->d[static_cast<ptrdiff_t>(j) * img->w]);
 						break;
 					case TopDown:
-						return &(img->d[(img->h - j - 1) * img->w]);
+						return &(img->d[static_cast<ptrdiff_t>(img->h - j - 1) * img->w]);
 						break;
 					default:
 						assert(0);
@@ -115,10 +119,10 @@ namespace pcg {
 			static T& ElementAt(int i, int j, ScanLineMode mode, const Image *img) {
 				switch(mode) {
 					case BottomUp:
-						return img->d[img->w*j+i];
+						return img->d[static_cast<ptrdiff_t>(img->w)*j+i];
 						break;
 					case TopDown:
-						return img->d[(img->h-j-1)*img->w+i];
+						return img->d[static_cast<ptrdiff_t>(img->h-j-1)*img->w+i];
 						break;
 					default:
 						assert(0);
@@ -130,14 +134,20 @@ namespace pcg {
 
 #endif /* PCG_IMAGE_CRAZY_TEMPLATES */
 
-		// Helper function to allocate the memory. It allocates excess data so
-		// that the total memory is a multiple of 64. The memory is aligned to
-		// 64-bytes as well.
+		// Size in bytes of the buffer for an image of w x h pixels. It allocates
+		// excess data so that the number of pixels is a multiple of 64.
+		static size_t bufferSize(int w, int h) {
+			const size_t count = ((static_cast<size_t>(w)*h) + 63) & ~0x3F;
+			assert (count >= (static_cast<size_t>(w)*h));
+			assert (count % 64 == 0);
+			return count * sizeof(T);
+		}
+
+		// Helper function to allocate the memory from the image buffer pool.
+		// The memory is aligned to 64-bytes.
 		inline void alloc() {
-			const size_t totalBytes = ((static_cast<size_t>(w)*h) + 63) & ~0x3F;
-			assert (totalBytes >= (static_cast<size_t>(w)*h));
-			assert (totalBytes % 64 == 0);
-			this->d = alloc_align<T>(64, totalBytes);
+			this->d = static_cast<T*>(
+				ImageBufferPool::Acquire(bufferSize(w, h), ALIGNMENT));
             if (this->d == NULL) {
                 throw RuntimeException("Couldn't allocate the memory "
                     "for the image");
@@ -146,6 +156,8 @@ namespace pcg {
 
 	public:
 
+		// Alignment in bytes of the pixels
+		static const size_t ALIGNMENT = 64;
 
 		// Default constructor: creates an empty image. To do anything
 		// useful afterwards you need to use the Alloc(int,int) method.
@@ -155,20 +167,41 @@ namespace pcg {
 		// Creates a new image allocating the required space
 		Image(int w, int h) : d(NULL), mode(S) {
 			assert(w > 0 && h > 0);
-            assert(((long long)w)*h <= 0x7fffffff);
 			this->w = w;
 			this->h = h;
 			alloc();
 		}
 
-		// Destructor, it reclaims the space previously allocated
+#if PCG_HAS_RVALUE_REFS
+		// Takes the pixels of the other image, leaving it empty
+		Image(Image&& other) : d(NULL), w(0), h(0), mode(S) {
+			Swap(other);
+		}
+
+		// Releases the pixels of this image and takes those of the other one
+		Image& operator=(Image&& other) {
+			if (this != &other) {
+				Clear();
+				Swap(other);
+			}
+			return *this;
+		}
+#endif
+
+		// Destructor, it returns the space previously allocated to the pool
 		~Image() {
 			Clear();
 		}
 
-		// Allocates new space for the image data, deleting the previous one
+		// Allocates new space for the image data, deleting the previous one.
+		// If the new size needs the same memory the pixels are kept as is.
 		void Alloc(int w, int h) {
 			assert(w > 0 && h > 0);
+			if (d != NULL && bufferSize(w, h) == bufferSize(this->w, this->h)) {
+				this->w = w;
+				this->h = h;
+				return;
+			}
 			Clear();
 			this->w = w;
 			this->h = h;
@@ -178,46 +211,63 @@ namespace pcg {
 		// Deallocates the memory and resets the image dimensions to 0
 		void Clear() {
 			if(d != NULL) {
-				free_align(d);
+				ImageBufferPool::Release(d, bufferSize(w, h), ALIGNMENT);
 				d = NULL;
 			}
 			w = h = 0;
 		}
 
+		// Exchanges the pixels and the dimensions with those of another
+		// image, without copying any pixel
+		void Swap(Image &other) {
+			T* const tmpData = d;
+			const int tmpWidth = w, tmpHeight = h;
+			d = other.d;
+			w = other.w;
+			h = other.h;
+			other.d = tmpData;
+			other.w = tmpWidth;
+			other.h = tmpHeight;
+		}
+
 		// Returns a reference to the i-th pixel in the j-th scanline (indices are zero-based)
 		// according to the scanline order of the image.
 		T& ElementAt(int i, int j, ScanLineMode mode = S) const {
-			assert(w*j+i >=0 && w*j+i < w*h && j >= 0 && j < h && i >=0 && i < w);
+			assert(j >= 0 && j < h && i >=0 && i < w);
 #if PCG_IMAGE_CRAZY_TEMPLATES
 			return ScanLineGetter<S>::ElementAt(i, j, mode, this);
 #else
-            return (mode == S) ? d[w*j + i] : d[(h-j-1)*w + i];
+            return (mode == S) ? d[static_cast<ptrdiff_t>(w)*j + i] :
+                                 d[static_cast<ptrdiff_t>(h-j-1)*w + i];
 #endif
 		}
 
 		// Returns a reference to the idx-th pixel of the image, which are in scanline order
 		// according to the specified mode.
-		T& ElementAt(int idx) const {
-			assert(idx >=0 && idx < w*h);
+		T& ElementAt(ptrdiff_t idx) const {
+			assert(idx >=0 && idx < Size());
 			return d[idx];
 		}
 
 		// Writes in the i,j parameters the coordinates necessary to access the idx-pixel in the
 		// image using ElementAt(int,int), according to the scanline order of the image.
-		void GetIndices(int idx, int &i, int &j) const { 
-			i = idx % w; 
-			j = idx / w; 
+		void GetIndices(ptrdiff_t idx, int &i, int &j) const { 
+			i = static_cast<int>(idx % w); 
+			j = static_cast<int>(idx / w); 
 		}
 		
 		// Returns the index (zero based) of the i-th pixel at the j-th scanline using the
 		// scanline order of the image.
-		int GetIndex(int i, int j) const { return w*j+i; }
+		ptrdiff_t GetIndex(int i, int j) const {
+			return static_cast<ptrdiff_t>(w)*j+i;
+		}
 
 		// Returns the index (zero based) of the i-th pixel at the j-th scanline
 		// using the given scanline order.
-		int GetIndex(int i, int j, ScanLineMode mode) const {
-			return w*j+i;
-			return (mode == S) ? (w*j + i) : (((h-j-1)*w) + i);
+		ptrdiff_t GetIndex(int i, int j, ScanLineMode mode) const {
+			return static_cast<ptrdiff_t>(w)*j+i;
+			return (mode == S) ? (static_cast<ptrdiff_t>(w)*j + i) :
+				(static_cast<ptrdiff_t>(h-j-1)*w + i);
 		}
 
 		// Width of the image
@@ -227,20 +277,20 @@ namespace pcg {
 		int Height() const { return h; }
 
 		// Number of pixels in the image (Width*Height)
-		int Size()   const { return w*h; }
+		ptrdiff_t Size() const { return static_cast<ptrdiff_t>(w)*h; }
 
 		// Raw pointer to the pixels
 		T* GetDataPointer() const { return d; }
 
 		// Returns a reference to the idx-th pixel, as in ElementAt(int)
-		T& operator[](int idx) {
-			assert(idx >=0 && idx < w*h);
+		T& operator[](ptrdiff_t idx) {
+			assert(idx >=0 && idx < Size());
 			return d[idx];
 		}
 
 		// Returns a const reference to the idx-th pixel, as in ElementAt(int)
-		const T& operator[](int idx) const {
-			assert(idx >=0 && idx < w*h);
+		const T& operator[](ptrdiff_t idx) const {
+			assert(idx >=0 && idx < Size());
 			return d[idx];
 		}
 
@@ -258,7 +308,8 @@ namespace pcg {
 			return ScanLineGetter<S>::GetScanline(j, mode, this);
 #else
 			// We only have two modes, so this works nicely
-            return (mode == S) ? &(d[j * w]) : &(d[(h - j - 1) * w]);
+            return (mode == S) ? &(d[static_cast<ptrdiff_t>(j) * w]) :
+                                 &(d[static_cast<ptrdiff_t>(h - j - 1) * w]);
 #endif
 		}
 
@@ -275,6 +326,11 @@ namespace pcg {
 
 		// The scanline mode of this image
 		const ScanLineMode mode;
+
+	private:
+		// Non-copyable, the pixels would be released twice
+		Image(const Image&);
+		Image& operator=(const Image&);
 	};
 
 }
@@ -0,0 +1,166 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "ImageBufferPool.h"
+
+#include <tbb/spin_mutex.h>
+
+#include <cassert>
+#include <iterator>
+#include <list>
+
+using pcg::ImageBufferPool;
+
+
+namespace
+{
+
+struct Buffer
+{
+    void *ptr;
+    size_t bytes;
+    size_t alignment;
+
+    Buffer(void *p, size_t b, size_t a) : ptr(p), bytes(b), alignment(a) {}
+};
+
+// Free buffers, from the least to the most recently released. There are few
+// of them, so the linear searches are cheaper than keeping an index.
+typedef std::list<Buffer> BufferList;
+
+tbb::spin_mutex poolMutex;
+size_t maxBuffers = 0;
+BufferList *freeBuffers = NULL;
+
+// Moves the oldest buffers into evicted until there are at most num, so that
+// they may be freed once the lock is released. Requires the lock.
+void trim(size_t num, BufferList &evicted)
+{
+    if (freeBuffers == NULL || freeBuffers->size() <= num) {
+        return;
+    }
+    BufferList::iterator last = freeBuffers->begin();
+    std::advance(last, freeBuffers->size() - num);
+    evicted.splice(evicted.end(), *freeBuffers, freeBuffers->begin(), last);
+}
+
+// Frees the memory of the buffers, without holding the lock
+void freeAll(const BufferList &buffers)
+{
+    for (BufferList::const_iterator it = buffers.begin();
+         it != buffers.end(); ++it) {
+        pcg::free_align(it->ptr);
+    }
+}
+
+// Frees the cache at exit; images destroyed afterwards free their memory
+struct PoolCleanup
+{
+    ~PoolCleanup() {
+        BufferList *buffers = NULL;
+        {
+            tbb::spin_mutex::scoped_lock lock(poolMutex);
+            buffers = freeBuffers;
+            freeBuffers = NULL;
+            maxBuffers = 0;
+        }
+        if (buffers != NULL) {
+            freeAll(*buffers);
+            delete buffers;
+        }
+    }
+} poolCleanup;
+
+} // namespace
+
+
+
+size_t ImageBufferPool::MaxBuffers()
+{
+    tbb::spin_mutex::scoped_lock lock(poolMutex);
+    return maxBuffers;
+}
+
+
+
+void ImageBufferPool::SetMaxBuffers(size_t num)
+{
+    BufferList evicted;
+    {
+        tbb::spin_mutex::scoped_lock lock(poolMutex);
+        maxBuffers = num;
+        trim(num, evicted);
+    }
+    freeAll(evicted);
+}
+
+
+
+void ImageBufferPool::Purge()
+{
+    BufferList evicted;
+    {
+        tbb::spin_mutex::scoped_lock lock(poolMutex);
+        trim(0, evicted);
+    }
+    freeAll(evicted);
+}
+
+
+
+void* ImageBufferPool::Acquire(size_t bytes, size_t alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    {
+        tbb::spin_mutex::scoped_lock lock(poolMutex);
+        if (freeBuffers != NULL) {
+            for (BufferList::reverse_iterator it = freeBuffers->rbegin();
+                 it != freeBuffers->rend(); ++it) {
+                if (it->bytes == bytes && it->alignment == alignment) {
+                    void *ptr = it->ptr;
+                    freeBuffers->erase(--(it.base()));
+                    return ptr;
+                }
+            }
+        }
+    }
+    return alloc_align<char>(alignment, bytes);
+}
+
+
+
+void ImageBufferPool::Release(void *ptr, size_t bytes, size_t alignment)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    bool cached = false;
+    BufferList evicted;
+    {
+        tbb::spin_mutex::scoped_lock lock(poolMutex);
+        if (maxBuffers != 0) {
+            if (freeBuffers == NULL) {
+                freeBuffers = new BufferList;
+            }
+            freeBuffers->push_back(Buffer(ptr, bytes, alignment));
+            trim(maxBuffers, evicted);
+            cached = true;
+        }
+    }
+    freeAll(evicted);
+    if (!cached) {
+        free_align(ptr);
+    }
+}
@@ -0,0 +1,61 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#pragma once
+#if !defined(PCG_IMAGEBUFFERPOOL_H)
+#define PCG_IMAGEBUFFERPOOL_H
+
+#include "ImageIO.h"
+
+#include <cstddef>
+
+namespace pcg
+{
+
+// Process-wide cache of the pixel buffers of Image and of the SoA images.
+// The released buffers are kept, keyed by their size in bytes and their
+// alignment, and handed out again to the next image of the same size, so that
+// a sequence of images of the same size reuses memory which is already
+// mapped instead of going through the allocator each time. When the cache is
+// full the least recently released buffers are freed. Initially the cache
+// holds no buffers at all, thus each release frees the memory right away.
+class ImageBufferPool
+{
+public:
+
+    // Maximum number of free buffers kept in the cache
+    static IMAGEIO_API size_t MaxBuffers();
+
+    // Sets the maximum number of free buffers kept in the cache, freeing the
+    // least recently released ones if there are more than that. Zero disables
+    // the cache.
+    static IMAGEIO_API void SetMaxBuffers(size_t num);
+
+    // Frees all the buffers in the cache
+    static IMAGEIO_API void Purge();
+
+    // Returns a buffer of the given size in bytes whose address is a multiple
+    // of the alignment, which must be a power of two, or NULL if it cannot
+    // allocate the memory. The contents of the buffer are undefined.
+    static IMAGEIO_API void* Acquire(size_t bytes, size_t alignment);
+
+    // Returns to the cache a buffer from Acquire with the same size and
+    // alignment. Releasing NULL does nothing.
+    static IMAGEIO_API void Release(void *ptr, size_t bytes, size_t alignment);
+};
+
+} // namespace pcg
+
+#endif /* PCG_IMAGEBUFFERPOOL_H */
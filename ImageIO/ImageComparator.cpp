@@ -14,21 +14,21 @@
 ============================================================================*/
 
 #include "ImageComparator.h"
+#include "ImageComparatorPrivate.h"
+#include "ConcurrencyPrivate.h"
 #include "Exception.h"
 #include "ImageIterators.h"
-#if !PCG_USE_AVX
-# include "Vec4f.h"
-# include "Vec4i.h"
-#else
-# include "Vec8f.h"
-# include "Vec8i.h"
-#endif
+#include "ImageView.h"
+#include "SimdDispatch.h"
 
 
 // Intel Threading Buiding Blocks
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
 
+#include <algorithm>
+#include <cmath>
+
 using namespace pcg;
 using namespace tbb;
 
@@ -41,11 +41,6 @@ using namespace tbb;
 #endif // _MSC_VER
 
 
-// When enabled the SoA comparisons use approximation to the reciprocal and the
-// square root which provide about 18 bits of mantissa accuracy
-#define FAST_COMPARE 1
-
-
 
 namespace
 {
@@ -64,24 +59,24 @@ private:
     // The different kernels, one for each comparison type
 
     // Takes the absolute value of the difference of the pixels
-    inline void kernel_absoluteDiff(const int &i) const {
+    inline void kernel_absoluteDiff(const ptrdiff_t &i) const {
 
         dest[i] = Rgba32F::abs(src1[i] - src2[i]);
     }
 
     // Not actually a comparision but a combination: just adds both pixels
-    inline void kernel_addition(const int &i) const {
+    inline void kernel_addition(const ptrdiff_t &i) const {
         dest[i] = src1[i] + src2[i];
     }
 
     // Divides the first source by the second one
-    inline void kernel_division(const int &i) const {
+    inline void kernel_division(const ptrdiff_t &i) const {
         // TODO what if both are zero? what if src2[i] is almost zero?
         dest[i] = src1[i] / src2[i];
     }
 
     // Error relative to the adition of both images
-    inline void kernel_relError(const int &i) const {
+    inline void kernel_relError(const ptrdiff_t &i) const {
         dest[i] = Rgba32F(2.0f) * Rgba32F::abs(src1[i] - src2[i]) / (src1[i] + src2[i]);
     }
 
@@ -94,7 +89,7 @@ private:
 
 
     // Helper function for the 2-norm comparisons
-    FORCEINLINE_BEG void kernel_2norm(const Rgba32F &val, const int &i, 
+    FORCEINLINE_BEG void kernel_2norm(const Rgba32F &val, const ptrdiff_t &i, 
         const Rgba32F &alphaKillMask) const FORCEINLINE_END
     {	
         const Rgba32F v = val & alphaKillMask;
@@ -127,13 +122,13 @@ private:
     }
 
     // 2-norm of the rgb diference
-    inline void kernel_posNeg(const int &i, const Rgba32F &alphaKillMask) const {
+    inline void kernel_posNeg(const ptrdiff_t &i, const Rgba32F &alphaKillMask) const {
 
         const Rgba32F delta = (src1[i] - src2[i]);
         kernel_2norm(delta, i, alphaKillMask);
     }
 
-    inline void kernel_posNegRel(const int &i, const Rgba32F &alphaKillMask) const {
+    inline void kernel_posNegRel(const ptrdiff_t &i, const Rgba32F &alphaKillMask) const {
 
         const Rgba32F diff = Rgba32F(2.0f) * (src1[i] - src2[i]) / (src1[i] + src2[i]);
         kernel_2norm(diff, i, alphaKillMask);
@@ -145,44 +140,44 @@ public:
         src1(src1), src2(src2), dest(dest), type(type) {}
 
     // Linear-style operator (one pixel after the other)
-    void operator()(const blocked_range<int>& r) const {
+    void operator()(const blocked_range<ptrdiff_t>& r) const {
         const __m128i alphaKillInt = _mm_set_epi32(0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0x0);
         const Rgba32F alphaKill = _mm_castsi128_ps(alphaKillInt);
 
         // TODO Use templates to remove the conditional at compile-time
         switch (type) {
             case ImageComparator::AbsoluteDifference:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_absoluteDiff(i);
                 }
                 break;
 
             case ImageComparator::Addition:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_addition(i);
                 }
                 break;
 
             case ImageComparator::Division:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_division(i);
                 }
                 break;
 
             case ImageComparator::RelativeError:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_relError(i);
                 }
                 break;
 
             case ImageComparator::PositiveNegative:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_posNeg(i, alphaKill);
                 }
                 break;
 
             case ImageComparator::PositiveNegativeRelativeError:
-                for (int i = r.begin(); i != r.end(); ++i) {
+                for (ptrdiff_t i = r.begin(); i != r.end(); ++i) {
                     kernel_posNegRel(i, alphaKill);
                 }
                 break;
@@ -202,43 +197,8 @@ class ComparatorSoA
 {
 #if !PCG_USE_AVX
     typedef RGBA32FVec4ImageSoAIterator IteratorSoA;
-    typedef Vec4f vf;
-    typedef Vec4i vi;
-
-    static FORCEINLINE_BEG vf castAsFloat(const vi& a) FORCEINLINE_END {
-        return _mm_castsi128_ps(a);
-    }
-
-#if FAST_COMPARE
-    static FORCEINLINE_BEG vf simd_rsqrt(const vf& a) FORCEINLINE_END {
-        return _mm_rsqrt_ps(a);
-    }
-#else
-    static FORCEINLINE_BEG vf simd_sqrt(const vf& a) FORCEINLINE_END {
-        return _mm_sqrt_ps(a);
-    }
-#endif
-
 #else
     typedef RGBA32FVec8ImageSoAIterator IteratorSoA;
-    typedef Vec8f vf;
-    typedef Vec8i vi;
-
-    static FORCEINLINE_BEG vf castAsFloat(const vi& a) FORCEINLINE_END {
-        return _mm256_castsi256_ps(a);
-    }
-
-#if FAST_COMPARE
-    static FORCEINLINE_BEG vf simd_rsqrt(const vf& a) FORCEINLINE_END {
-        return _mm256_rsqrt_ps(a);
-    }
-#else
-    static FORCEINLINE_BEG vf simd_sqrt(const vf& a) FORCEINLINE_END {
-        return _mm256_sqrt_ps(a);
-    }
-
-#endif
-
 #endif
     typedef IteratorSoA::difference_type diff_t;
 
@@ -247,194 +207,202 @@ class ComparatorSoA
     const IteratorSoA src1Begin;
     const IteratorSoA src2Begin;
 
-    static FORCEINLINE_BEG vf absDiff(const vf& a, const vf& b) FORCEINLINE_END{
-        const vf mask(castAsFloat(vi::constant<0x7fffffff>()));
-        return mask & (a - b);
-    }
-
-    static FORCEINLINE_BEG vf
-    norm2(const vf& a, const vf& b, const vf& c) FORCEINLINE_END {
-        const vf n2 = a*a + b*b + c*c;
-
-#if FAST_COMPARE
-        // From Eigen 3.0 (MathFunctions.h)
-        // This is based on Quake3's fast inverse square root.
-        // For detail see here: http://www.beyond3d.com/content/articles/8/
-        const vf negHalf = n2 * vf(-0.5f);
-        
-        // Select only the inverse sqrt of non-zero inputs (using FLT_EPSILON)
-        const vf non_zero_mask(n2 > vf(1.192092896e-07f));
-        vf x = non_zero_mask & simd_rsqrt(n2);
-        
-        x = x * (vf(1.5f) + (negHalf * (x * x)));
-        // at this point x == 1/sqrt(n2)
-        x *= n2;
-        return x;
-#else
-        vf x = simd_sqrt(n2);
-        return x;
-#endif
-    }
-
-
-
-    void AbsoluteDifference(diff_t begin, diff_t end) const
+    // Applies one of the operations from ImageComparatorPrivate.h
+    template <class Op>
+    void apply(diff_t begin, diff_t end) const
     {
         IteratorSoA src1 = src1Begin + begin;
         IteratorSoA src2 = src2Begin + begin;
         IteratorSoA dest = destBegin + begin;
         for (diff_t i = begin; i != end; ++i, ++src1, ++src2, ++dest) {
-            dest->r() = absDiff(src1->r(), src2->r());
-            dest->g() = absDiff(src1->g(), src2->g());
-            dest->b() = absDiff(src1->b(), src2->b());
-            dest->a() = absDiff(src1->a(), src2->a());
+            Op::apply(*src1, *src2, *dest);
         }
     }
 
-    void Addition(diff_t begin, diff_t end) const
-    {
-        IteratorSoA src1 = src1Begin + begin;
-        IteratorSoA src2 = src2Begin + begin;
-        IteratorSoA dest = destBegin + begin;
-        for (diff_t i = begin; i != end; ++i, ++src1, ++src2, ++dest) {
-            dest->r() = vf(src1->r()) + vf(src2->r());
-            dest->g() = vf(src1->g()) + vf(src2->g());
-            dest->b() = vf(src1->b()) + vf(src2->b());
-            dest->a() = vf(src1->a()) + vf(src2->a());
+
+public:
+    ComparatorSoA(ImageComparator::Type cmpType, RGBAImageSoA& dest, 
+        const RGBAImageSoA& src1, const RGBAImageSoA& src2) :
+    type(cmpType), destBegin(IteratorSoA::begin(dest)),
+    src1Begin(IteratorSoA::begin(src1)), src2Begin(IteratorSoA::begin(src2))
+    {}
+
+    // Linear-style operator (one pixel after the other)
+    void operator()(const blocked_range<diff_t>& r) const {
+
+        switch (type) {
+            case ImageComparator::AbsoluteDifference:
+                apply<comparator::AbsoluteDifference>(r.begin(), r.end());
+                break;
+            case ImageComparator::Addition:
+                apply<comparator::Addition>(r.begin(), r.end());
+                break;
+            case ImageComparator::Division:
+                apply<comparator::Division>(r.begin(), r.end());
+                break;
+            case ImageComparator::RelativeError:
+                apply<comparator::RelativeError>(r.begin(), r.end());
+                break;
+            case ImageComparator::PositiveNegative:
+                apply<comparator::PositiveNegative>(r.begin(), r.end());
+                break;
+            case ImageComparator::PositiveNegativeRelativeError:
+                apply<comparator::PositiveNegativeRelativeError>(
+                    r.begin(), r.end());
+                break;
+
+            default:
+                assert(0);
+                break;
         }
     }
 
-    void Division(diff_t begin, diff_t end) const
-    {
-        IteratorSoA src1 = src1Begin + begin;
-        IteratorSoA src2 = src2Begin + begin;
-        IteratorSoA dest = destBegin + begin;
-        for (diff_t i = begin; i != end; ++i, ++src1, ++src2, ++dest) {
-#if FAST_COMPARE
-            dest->r() = vf(src1->r()) * rcp_nr(vf(src2->r()));
-            dest->g() = vf(src1->g()) * rcp_nr(vf(src2->g()));
-            dest->b() = vf(src1->b()) * rcp_nr(vf(src2->b()));
-            dest->a() = vf(src1->a()) * rcp_nr(vf(src2->a()));
+};
+
+
+
+// Comparator implementation for SoA views, one scanline after the other. The
+// groups of pixels of the scanlines whose values are aligned are compared in
+// place, the remaining pixels are copied through aligned buffers of the task.
+class ComparatorSoAView
+{
+#if !PCG_USE_AVX
+    typedef RGBA32FVec4ImageSoAIterator IteratorSoA;
+    static const int VEC_LEN = 4;
 #else
-            dest->r() = vf(src1->r()) / (vf(src2->r()));
-            dest->g() = vf(src1->g()) / (vf(src2->g()));
-            dest->b() = vf(src1->b()) / (vf(src2->b()));
-            dest->a() = vf(src1->a()) / (vf(src2->a()));
+    typedef RGBA32FVec8ImageSoAIterator IteratorSoA;
+    static const int VEC_LEN = 8;
 #endif
-        }
+    typedef RGBAImageSoA I;
+
+    // Pixels staged at once
+    static const int CHUNK = 512;
+
+    const ImageComparator::Type type;
+    const RGBAImageSoAView& dest;
+    const ConstRGBAImageSoAView& src1;
+    const ConstRGBAImageSoAView& src2;
+
+    static inline bool isAligned(const float* ptr) {
+        return reinterpret_cast<intptr_t>(ptr) % (VEC_LEN*sizeof(float)) == 0;
     }
-    
-    void RelativeError(diff_t begin, diff_t end) const
-    {
-        IteratorSoA src1 = src1Begin + begin;
-        IteratorSoA src2 = src2Begin + begin;
-        IteratorSoA dest = destBegin + begin;
 
-        const vf const_2(2.0f);
-        for (diff_t i = begin; i != end; ++i, ++src1, ++src2, ++dest) {
-#if FAST_COMPARE
-            dest->r() = const_2 * absDiff(src1->r(), src2->r()) *
-                rcp_nr(vf(src1->r()) + vf(src2->r()));
-            dest->g() = const_2 * absDiff(src1->g(), src2->g()) *
-                rcp_nr(vf(src1->g()) + vf(src2->g()));
-            dest->b() = const_2 * absDiff(src1->b(), src2->b()) *
-                rcp_nr(vf(src1->b()) + vf(src2->b()));
-            dest->a() = const_2 * absDiff(src1->a(), src2->a()) *
-                rcp_nr(vf(src1->a()) + vf(src2->a()));
-#else
-            dest->r() = const_2 * absDiff(src1->r(), src2->r()) /
-                (vf(src1->r()) + vf(src2->r()));
-            dest->g() = const_2 * absDiff(src1->g(), src2->g()) /
-                (vf(src1->g()) + vf(src2->g()));
-            dest->b() = const_2 * absDiff(src1->b(), src2->b()) /
-                (vf(src1->b()) + vf(src2->b()));
-            dest->a() = const_2 * absDiff(src1->a(), src2->a()) /
-                (vf(src1->a()) + vf(src2->a()));
-#endif
-        }
+    template <class View>
+    static inline bool isAligned(const View& view, int j) {
+        return isAligned(view.template GetScanlinePointer<I::R>(j)) &&
+            isAligned(view.template GetScanlinePointer<I::G>(j)) &&
+            isAligned(view.template GetScanlinePointer<I::B>(j)) &&
+            isAligned(view.template GetScanlinePointer<I::A>(j));
     }
 
-    void PositiveNegative(diff_t begin, diff_t end) const
-    {
-        IteratorSoA src1 = src1Begin + begin;
-        IteratorSoA src2 = src2Begin + begin;
-        IteratorSoA dest = destBegin + begin;
-        for (diff_t i = begin; i != end; ++i, ++src1, ++src2, ++dest) {
-            const vf dr = vf(src1->r()) - vf(src2->r());
-            const vf dg = vf(src1->g()) - vf(src2->g());
-            const vf db = vf(src1->b()) - vf(src2->b());
-            const vf norm = norm2(dr, dg, db);
-            const vf pn = dr + dg + db;
-
-            dest->r() = norm & vf(pn < vf::zero());
-            dest->g() = norm & vf(pn > vf::zero());
-            dest->b() = norm & vf(pn == vf::zero());
-            dest->a() = norm;
-        }
+    template <class View>
+    static inline IteratorSoA rowBegin(const View& view, int j) {
+        return IteratorSoA::begin(view.template GetScanlinePointer<I::R>(j),
+            view.template GetScanlinePointer<I::G>(j),
+            view.template GetScanlinePointer<I::B>(j),
+            view.template GetScanlinePointer<I::A>(j));
     }
 
-    void PositiveNegativeRelativeError(diff_t begin, diff_t end) const
+    // Copies count pixels of the j-th scanline, starting at i, between a view
+    // and the beginning of the staging image
+    static void stage(RGBAImageSoA& staged, const ConstRGBAImageSoAView& view,
+        int i, int j, int count)
     {
-        IteratorSoA src1 = src1Begin + begin;
-        IteratorSoA src2 = src2Begin + begin;
-        IteratorSoA dest = destBegin + begin;
+        const float *r = &view.ElementAt<I::R>(i, j);
+        const float *g = &view.ElementAt<I::G>(i, j);
+        const float *b = &view.ElementAt<I::B>(i, j);
+        const float *a = &view.ElementAt<I::A>(i, j);
+        std::copy(r, r + count, staged.GetDataPointer<I::R>());
+        std::copy(g, g + count, staged.GetDataPointer<I::G>());
+        std::copy(b, b + count, staged.GetDataPointer<I::B>());
+        std::copy(a, a + count, staged.GetDataPointer<I::A>());
+    }
 
-        const vf const_2(2.0f);
-        for (diff_t i = begin; i != end; ++i, ++src1, ++src2, ++dest) {
-#if FAST_COMPARE
-            const vf dr = const_2 * (vf(src1->r()) - vf(src2->r())) *
-                rcp_nr(vf(src1->r()) + vf(src2->r()));
-            const vf dg = const_2 * (vf(src1->g()) - vf(src2->g())) *
-                rcp_nr(vf(src1->g()) + vf(src2->g()));
-            const vf db = const_2 * (vf(src1->b()) - vf(src2->b())) *
-                rcp_nr(vf(src1->b()) + vf(src2->b()));
-#else
-            const vf dr = const_2 * (vf(src1->r()) - vf(src2->r())) /
-                (vf(src1->r()) + vf(src2->r()));
-            const vf dg = const_2 * (vf(src1->g()) - vf(src2->g())) /
-                (vf(src1->g()) + vf(src2->g()));
-            const vf db = const_2 * (vf(src1->b()) - vf(src2->b())) /
-                (vf(src1->b()) + vf(src2->b()));
-#endif
-            const vf norm = norm2(dr, dg, db);
-            const vf pn = dr + dg + db;
+    static void unstage(const RGBAImageSoAView& view, int i, int j,
+        const RGBAImageSoA& staged, int count)
+    {
+        const float *r = staged.GetDataPointer<I::R>();
+        const float *g = staged.GetDataPointer<I::G>();
+        const float *b = staged.GetDataPointer<I::B>();
+        const float *a = staged.GetDataPointer<I::A>();
+        std::copy(r, r + count, &view.ElementAt<I::R>(i, j));
+        std::copy(g, g + count, &view.ElementAt<I::G>(i, j));
+        std::copy(b, b + count, &view.ElementAt<I::B>(i, j));
+        std::copy(a, a + count, &view.ElementAt<I::A>(i, j));
+    }
 
-            dest->r() = norm & vf(pn < vf::zero());
-            dest->g() = norm & vf(pn > vf::zero());
-            dest->b() = norm & vf(pn == vf::zero());
-            dest->a() = norm;
+    template <class Op>
+    static void apply(IteratorSoA dest, IteratorSoA src1, IteratorSoA src2,
+        int groups)
+    {
+        for (int i = 0; i != groups; ++i, ++src1, ++src2, ++dest) {
+            Op::apply(*src1, *src2, *dest);
         }
     }
 
+    template <class Op>
+    void applyRows(int begin, int end) const
+    {
+        const int width = dest.Width();
+        RGBAImageSoA staged[3];
+
+        for (int j = begin; j != end; ++j) {
+            int i = 0;
+            if (isAligned(dest, j) && isAligned(src1, j) && isAligned(src2, j))
+            {
+                const int groups = width / VEC_LEN;
+                apply<Op>(rowBegin(dest, j), rowBegin(src1, j),
+                    rowBegin(src2, j), groups);
+                i = groups * VEC_LEN;
+            }
+
+            for (; i < width; i += CHUNK) {
+                if (staged[0].Size() == 0) {
+                    for (int k = 0; k != 3; ++k) {
+                        staged[k].Alloc(CHUNK, 1);
+                    }
+                }
+                const int count = std::min(width - i, int(CHUNK));
+                stage(staged[1], src1, i, j, count);
+                stage(staged[2], src2, i, j, count);
+                apply<Op>(IteratorSoA::begin(staged[0]),
+                    IteratorSoA::begin(staged[1]),
+                    IteratorSoA::begin(staged[2]),
+                    (count + VEC_LEN - 1) / VEC_LEN);
+                unstage(dest, i, j, staged[0], count);
+            }
+        }
+    }
 
 public:
-    ComparatorSoA(ImageComparator::Type cmpType, RGBAImageSoA& dest, 
-        const RGBAImageSoA& src1, const RGBAImageSoA& src2) :
-    type(cmpType), destBegin(IteratorSoA::begin(dest)),
-    src1Begin(IteratorSoA::begin(src1)), src2Begin(IteratorSoA::begin(src2))
+    ComparatorSoAView(ImageComparator::Type cmpType,
+        const RGBAImageSoAView& destView,
+        const ConstRGBAImageSoAView& src1View,
+        const ConstRGBAImageSoAView& src2View) :
+    type(cmpType), dest(destView), src1(src1View), src2(src2View)
     {}
 
-    // Linear-style operator (one pixel after the other)
-    void operator()(const blocked_range<diff_t>& r) const {
+    void operator()(const blocked_range<int>& r) const {
 
         switch (type) {
             case ImageComparator::AbsoluteDifference:
-                AbsoluteDifference(r.begin(), r.end());
+                applyRows<comparator::AbsoluteDifference>(r.begin(), r.end());
                 break;
             case ImageComparator::Addition:
-                Addition(r.begin(), r.end());
+                applyRows<comparator::Addition>(r.begin(), r.end());
                 break;
             case ImageComparator::Division:
-                Division(r.begin(), r.end());
+                applyRows<comparator::Division>(r.begin(), r.end());
                 break;
             case ImageComparator::RelativeError:
-                RelativeError(r.begin(), r.end());
+                applyRows<comparator::RelativeError>(r.begin(), r.end());
                 break;
             case ImageComparator::PositiveNegative:
-                PositiveNegative(r.begin(), r.end());
+                applyRows<comparator::PositiveNegative>(r.begin(), r.end());
                 break;
             case ImageComparator::PositiveNegativeRelativeError:
-                PositiveNegativeRelativeError(r.begin(), r.end());
+                applyRows<comparator::PositiveNegativeRelativeError>(
+                    r.begin(), r.end());
                 break;
 
             default:
@@ -442,13 +410,57 @@ public:
                 break;
         }
     }
-
 };
 
 } // namespace
 
 
 
+namespace pcg
+{
+PCG_SIMD_DECLARE_KERNEL(void, compareSoA, (ImageComparator::Type type,
+    RGBAImageSoA &dest, const RGBAImageSoA &src1, const RGBAImageSoA &src2))
+
+PCG_SIMD_DECLARE_KERNEL(void, compareSoAView, (ImageComparator::Type type,
+    const RGBAImageSoAView &dest, const ConstRGBAImageSoAView &src1,
+    const ConstRGBAImageSoAView &src2))
+} // namespace pcg
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::compareSoA(ImageComparator::Type type,
+    RGBAImageSoA &dest, const RGBAImageSoA &src1, const RGBAImageSoA &src2)
+{
+#if !PCG_USE_AVX
+    typedef RGBA32FVec4ImageSoAIterator IteratorSoA;
+    const size_t VEC_LEN = 4;
+#else
+    typedef RGBA32FVec8ImageSoAIterator IteratorSoA;
+    const size_t VEC_LEN = 8;
+#endif
+
+    typedef IteratorSoA::difference_type diff_t;
+    const diff_t count = IteratorSoA::end(src1) - IteratorSoA::begin(src1);
+    const blocked_range<diff_t> range(0, count, 4);
+    pcg::concurrency::parallel_for(range,
+        ComparatorSoA(type, dest, src1, src2), VEC_LEN);
+}
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::compareSoAView(ImageComparator::Type type,
+    const RGBAImageSoAView &dest, const ConstRGBAImageSoAView &src1,
+    const ConstRGBAImageSoAView &src2)
+{
+    pcg::concurrency::parallel_for(blocked_range<int>(0, dest.Height()),
+        ComparatorSoAView(type, dest, src1, src2), dest.Width());
+}
+
+
+
+// The entry points are only compiled once, for the baseline instruction set
+#if !PCG_SIMD_VARIANT
+
 template <ScanLineMode S>
 void ImageComparator::CompareHelper(Type type, Image<Rgba32F, S> &dest, 
             const Image<Rgba32F, S> &src1, const Image<Rgba32F, S> &src2)
@@ -462,8 +474,8 @@ void ImageComparator::CompareHelper(Type type, Image<Rgba32F, S> &dest,
     }
 
     // And launch the parallel for
-    const int numPixels = dest.Size();
-    parallel_for(blocked_range<int>(0, numPixels, 4),
+    const ptrdiff_t numPixels = dest.Size();
+    pcg::concurrency::parallel_for(blocked_range<ptrdiff_t>(0, numPixels, 4),
         Comparator<S>(type, dest, src1, src2));
 }
 
@@ -489,14 +501,74 @@ void ImageComparator::Compare(Type type, RGBAImageSoA &dest,
         throw IllegalArgumentException("Incompatible images size");
     }
 
-#if !PCG_USE_AVX
-    typedef RGBA32FVec4ImageSoAIterator IteratorSoA;
-#else
-    typedef RGBA32FVec8ImageSoAIterator IteratorSoA;
-#endif
+    PCG_SIMD_DISPATCH(compareSoA(type, dest, src1, src2));
+}
 
-    typedef IteratorSoA::difference_type diff_t;
-    const diff_t count = IteratorSoA::end(src1) - IteratorSoA::begin(src1);
-    const blocked_range<diff_t> range(0, count, 4);
-    parallel_for(range, ComparatorSoA(type, dest, src1, src2));
+
+void ImageComparator::Compare(Type type, const RGBAImageSoAView &dest,
+            const ConstRGBAImageSoAView &src1,
+            const ConstRGBAImageSoAView &src2)
+{
+    if (dest.Width() != src1.Width() || dest.Height() != src1.Height() ||
+        src1.Width() != src2.Width() || src1.Height() != src2.Height() )
+    {
+        throw IllegalArgumentException("Incompatible views size");
+    }
+    if (dest.Size() == 0) {
+        return;
+    }
+
+    PCG_SIMD_DISPATCH(compareSoAView(type, dest, src1, src2));
+}
+
+
+namespace
+{
+
+inline float relError(float a, float b) {
+    return 2.0f * std::abs(a - b) / (a + b);
+}
+
+inline float relDelta(float a, float b) {
+    return 2.0f * (a - b) / (a + b);
 }
+
+// Same layout as comparator::posNeg: the norm of the rgb difference goes to
+// the channel according to its sign, and always to the alpha
+inline Rgba32F posNeg(float dr, float dg, float db)
+{
+    const float norm = std::sqrt(dr*dr + dg*dg + db*db);
+    const float pn = dr + dg + db;
+    return Rgba32F(pn < 0.0f ? norm : 0.0f, pn > 0.0f ? norm : 0.0f,
+        pn == 0.0f ? norm : 0.0f, norm);
+}
+
+} // namespace
+
+
+Rgba32F ImageComparator::Compare(Type type,
+            const Rgba32F &src1, const Rgba32F &src2)
+{
+    switch (type) {
+    case AbsoluteDifference:
+        return Rgba32F::abs(src1 - src2);
+    case Addition:
+        return src1 + src2;
+    case Division:
+        return src1 / src2;
+    case RelativeError:
+        return Rgba32F(relError(src1.r(), src2.r()),
+            relError(src1.g(), src2.g()), relError(src1.b(), src2.b()),
+            relError(src1.a(), src2.a()));
+    case PositiveNegative:
+        return posNeg(src1.r() - src2.r(), src1.g() - src2.g(),
+            src1.b() - src2.b());
+    case PositiveNegativeRelativeError:
+        return posNeg(relDelta(src1.r(), src2.r()),
+            relDelta(src1.g(), src2.g()), relDelta(src1.b(), src2.b()));
+    default:
+        throw IllegalArgumentException("Unknown comparison type");
+    }
+}
+
+#endif // !PCG_SIMD_VARIANT
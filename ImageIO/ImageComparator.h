@@ -22,6 +22,7 @@
 #include "ImageIO.h"
 #include "Image.h"
 #include "ImageSoA.h"
+#include "ImageView.h"
 #include "Rgba32F.h"
 
 namespace pcg {
@@ -47,6 +48,17 @@ namespace pcg {
 
 		static IMAGEIO_API void Compare(Type type, RGBAImageSoA &dest,
 			const RGBAImageSoA &src1, const RGBAImageSoA &src2);
+
+		// Compares the pixels of views of the same size, otherwise it throws
+		// IllegalArgumentException. The destination may be the first source.
+		static IMAGEIO_API void Compare(Type type, const RGBAImageSoAView &dest,
+			const ConstRGBAImageSoAView &src1,
+			const ConstRGBAImageSoAView &src2);
+
+		// Compares a single pair of pixels, with the same methods as the SoA
+		// images but without their fast approximations
+		static IMAGEIO_API Rgba32F Compare(Type type,
+			const Rgba32F &src1, const Rgba32F &src2);
 		
 	private:
 		// Just for the sake of knowing what we have
@@ -0,0 +1,225 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Internal definitions of the SoA comparisons, shared by ImageComparator and
+// the fused comparisons of ToneMapperSoA. Those sources are compiled once per
+// instruction set, thus everything here has internal linkage.
+
+#if !defined(PCG_IMAGECOMPARATORPRIVATE_H)
+#define PCG_IMAGECOMPARATORPRIVATE_H
+
+#include "ImageComparator.h"
+#if !PCG_USE_AVX
+# include "Vec4f.h"
+# include "Vec4i.h"
+#else
+# include "Vec8f.h"
+# include "Vec8i.h"
+#endif
+
+
+// When enabled the SoA comparisons use approximation to the reciprocal and the
+// square root which provide about 18 bits of mantissa accuracy
+#define FAST_COMPARE 1
+
+
+
+namespace
+{
+namespace comparator
+{
+
+// Each operation compares a group of pixels in SoA form, using the widest
+// vector type of the instruction set. The sources and the destination are
+// anything with r(), g(), b() and a() accessors for those vectors. The
+// destination may be the first source, thus each channel is read before it
+// gets written.
+
+#if !PCG_USE_AVX
+typedef pcg::Vec4f vf;
+typedef pcg::Vec4i vi;
+
+inline vf castAsFloat(const vi& a) {
+    return _mm_castsi128_ps(a);
+}
+
+#if FAST_COMPARE
+inline vf simd_rsqrt(const vf& a) {
+    return _mm_rsqrt_ps(a);
+}
+#else
+inline vf simd_sqrt(const vf& a) {
+    return _mm_sqrt_ps(a);
+}
+#endif
+
+#else
+typedef pcg::Vec8f vf;
+typedef pcg::Vec8i vi;
+
+inline vf castAsFloat(const vi& a) {
+    return _mm256_castsi256_ps(a);
+}
+
+#if FAST_COMPARE
+inline vf simd_rsqrt(const vf& a) {
+    return _mm256_rsqrt_ps(a);
+}
+#else
+inline vf simd_sqrt(const vf& a) {
+    return _mm256_sqrt_ps(a);
+}
+#endif
+
+#endif
+
+inline vf absDiff(const vf& a, const vf& b) {
+    const vf mask(castAsFloat(vi::constant<0x7fffffff>()));
+    return mask & (a - b);
+}
+
+inline vf quotient(const vf& a, const vf& b) {
+#if FAST_COMPARE
+    return a * rcp_nr(b);
+#else
+    return a / b;
+#endif
+}
+
+inline vf norm2(const vf& a, const vf& b, const vf& c)
+{
+    const vf n2 = a*a + b*b + c*c;
+
+#if FAST_COMPARE
+    // From Eigen 3.0 (MathFunctions.h)
+    // This is based on Quake3's fast inverse square root.
+    // For detail see here: http://www.beyond3d.com/content/articles/8/
+    const vf negHalf = n2 * vf(-0.5f);
+
+    // Select only the inverse sqrt of non-zero inputs (using FLT_EPSILON)
+    const vf non_zero_mask(n2 > vf(1.192092896e-07f));
+    vf x = non_zero_mask & simd_rsqrt(n2);
+
+    x = x * (vf(1.5f) + (negHalf * (x * x)));
+    // at this point x == 1/sqrt(n2)
+    x *= n2;
+    return x;
+#else
+    vf x = simd_sqrt(n2);
+    return x;
+#endif
+}
+
+// Writes the norm of the rgb difference in the channel according to its sign:
+// red for negative, green for positive and blue for zero
+template <class D>
+inline void posNeg(const vf& dr, const vf& dg, const vf& db, D& dest)
+{
+    const vf norm = norm2(dr, dg, db);
+    const vf pn = dr + dg + db;
+
+    dest.r() = norm & vf(pn < vf::zero());
+    dest.g() = norm & vf(pn > vf::zero());
+    dest.b() = norm & vf(pn == vf::zero());
+    dest.a() = norm;
+}
+
+
+
+struct AbsoluteDifference
+{
+    template <class S1, class S2, class D>
+    static inline void apply(const S1& src1, const S2& src2, D& dest)
+    {
+        dest.r() = absDiff(src1.r(), src2.r());
+        dest.g() = absDiff(src1.g(), src2.g());
+        dest.b() = absDiff(src1.b(), src2.b());
+        dest.a() = absDiff(src1.a(), src2.a());
+    }
+};
+
+struct Addition
+{
+    template <class S1, class S2, class D>
+    static inline void apply(const S1& src1, const S2& src2, D& dest)
+    {
+        dest.r() = vf(src1.r()) + vf(src2.r());
+        dest.g() = vf(src1.g()) + vf(src2.g());
+        dest.b() = vf(src1.b()) + vf(src2.b());
+        dest.a() = vf(src1.a()) + vf(src2.a());
+    }
+};
+
+struct Division
+{
+    template <class S1, class S2, class D>
+    static inline void apply(const S1& src1, const S2& src2, D& dest)
+    {
+        dest.r() = quotient(src1.r(), src2.r());
+        dest.g() = quotient(src1.g(), src2.g());
+        dest.b() = quotient(src1.b(), src2.b());
+        dest.a() = quotient(src1.a(), src2.a());
+    }
+};
+
+struct RelativeError
+{
+    template <class S1, class S2, class D>
+    static inline void apply(const S1& src1, const S2& src2, D& dest)
+    {
+        const vf const_2(2.0f);
+        dest.r() = quotient(const_2 * absDiff(src1.r(), src2.r()),
+            vf(src1.r()) + vf(src2.r()));
+        dest.g() = quotient(const_2 * absDiff(src1.g(), src2.g()),
+            vf(src1.g()) + vf(src2.g()));
+        dest.b() = quotient(const_2 * absDiff(src1.b(), src2.b()),
+            vf(src1.b()) + vf(src2.b()));
+        dest.a() = quotient(const_2 * absDiff(src1.a(), src2.a()),
+            vf(src1.a()) + vf(src2.a()));
+    }
+};
+
+struct PositiveNegative
+{
+    template <class S1, class S2, class D>
+    static inline void apply(const S1& src1, const S2& src2, D& dest)
+    {
+        const vf dr = vf(src1.r()) - vf(src2.r());
+        const vf dg = vf(src1.g()) - vf(src2.g());
+        const vf db = vf(src1.b()) - vf(src2.b());
+        posNeg(dr, dg, db, dest);
+    }
+};
+
+struct PositiveNegativeRelativeError
+{
+    template <class S1, class S2, class D>
+    static inline void apply(const S1& src1, const S2& src2, D& dest)
+    {
+        const vf const_2(2.0f);
+        const vf dr = quotient(const_2 * (vf(src1.r()) - vf(src2.r())),
+            vf(src1.r()) + vf(src2.r()));
+        const vf dg = quotient(const_2 * (vf(src1.g()) - vf(src2.g())),
+            vf(src1.g()) + vf(src2.g()));
+        const vf db = quotient(const_2 * (vf(src1.b()) - vf(src2.b())),
+            vf(src1.b()) + vf(src2.b()));
+        posNeg(dr, dg, db, dest);
+    }
+};
+
+} // namespace comparator
+} // namespace
+
+#endif /* PCG_IMAGECOMPARATORPRIVATE_H */
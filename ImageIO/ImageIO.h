@@ -37,6 +37,15 @@
   #endif
 #endif /* WIN32 */
 
+// Whether the compiler supports rvalue references, for the move constructors
+#if !defined(PCG_HAS_RVALUE_REFS)
+  #if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+    #define PCG_HAS_RVALUE_REFS 1
+  #else
+    #define PCG_HAS_RVALUE_REFS 0
+  #endif
+#endif
+
 
 // For proper memory alignment
 #if defined(_MSC_VER)
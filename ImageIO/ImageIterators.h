@@ -594,6 +594,22 @@ public:
         return it;
     }
 
+    // Create an iterator at the given values of each channel, such as the
+    // beginning of a scanline of a view. The pointers must be aligned to the
+    // size of the groups of N pixels.
+    static RGBA32FVecImageSoAIterator begin(const float *r, const float *g,
+        const float *b, const float *a)
+    {
+        typedef typename RGBA32FVec_traits<N>::pointer_type vptr_t;
+        RGBA32FVecImageSoAIterator it;
+        it.m_r = reinterpret_cast<vptr_t>(const_cast<float*>(r));
+        it.m_g = reinterpret_cast<vptr_t>(const_cast<float*>(g));
+        it.m_b = reinterpret_cast<vptr_t>(const_cast<float*>(b));
+        it.m_a = reinterpret_cast<vptr_t>(const_cast<float*>(a));
+        it.m_offset = 0;
+        return it;
+    }
+
     // Create an iterator at the end of the image. Note that for this to work
     // the image must have a multiple of 4 number of pixels or have allocated
     // additional elements to avoid segfaults.
@@ -16,6 +16,7 @@
 #include "ImageSoA.h"
 #include "StdAfx.h"
 #include "Rgba32F.h"
+#include "ConcurrencyPrivate.h"
 
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
@@ -25,7 +26,7 @@ namespace
 {
 struct CopyFunctor
 {
-    typedef tbb::blocked_range<int> Range;
+    typedef tbb::blocked_range<ptrdiff_t> Range;
 
     struct Args
     {
@@ -53,7 +54,7 @@ struct CopyFunctor
 
     inline void
     copy4(float* r, float* g, float *b, float* a, const pcg::Rgba32F* src,
-          int off) const
+          ptrdiff_t off) const
     {
         __m128 p0 = src[off];
         __m128 p1 = src[off + 1];
@@ -75,11 +76,11 @@ struct CopyFunctor
         assert(range.begin() <= range.end());
 
         // The range might not be in appropriate multiples of four
-        const int beginSSE = (range.begin() + 3) & ~0x3;
-        const int endSSE   = range.end() & ~0x3;
+        const ptrdiff_t beginSSE = (range.begin() + 3) & ~ptrdiff_t(0x3);
+        const ptrdiff_t endSSE   = range.end() & ~ptrdiff_t(0x3);
         assert((endSSE - beginSSE) % 4 == 0);
         assert((beginSSE-range.begin())+(endSSE-beginSSE)+(range.end()-endSSE)\
-            == static_cast<int>(range.size()));
+            == static_cast<ptrdiff_t>(range.size()));
 
         float * r = m_args.dest.GetDataPointer<pcg::RGBAImageSoA::R>();
         float * g = m_args.dest.GetDataPointer<pcg::RGBAImageSoA::G>();
@@ -89,18 +90,18 @@ struct CopyFunctor
 
         // Copy individual items until the first multiple of 4, so that they
         // are aligned to 16 bytes (1 to 3 elements)
-        for (int i = range.begin(); i < beginSSE; ++i) {
+        for (ptrdiff_t i = range.begin(); i < beginSSE; ++i) {
             copy1(r[i], g[i], b[i], a[i], src[i]);
         }
 
         // Copy all the blocks of 4 pixels. This is the heaviest loop
-        for (int offset = beginSSE; offset < endSSE; offset += 4)
+        for (ptrdiff_t offset = beginSSE; offset < endSSE; offset += 4)
         {
             copy4(r, g, b, a, src, offset);
         }
 
         // Copy any remaining elements (1 to 3)
-        for (int i = endSSE; i < range.end(); ++i) {
+        for (ptrdiff_t i = endSSE; i < range.end(); ++i) {
             copy1(r[i], g[i], b[i], a[i], src[i]);
         }
     }
@@ -118,5 +119,5 @@ pcg::RGBAImageSoA::copyImage(const pcg::Image<pcg::Rgba32F, pcg::TopDown> &img)
 {
     CopyFunctor::Range range(0, img.Size(), 4);
     CopyFunctor functor(CopyFunctor::Args(img, *this));
-    tbb::parallel_for(range, functor);
+    pcg::concurrency::parallel_for(range, functor);
 }
@@ -18,12 +18,14 @@
 #define PCG_IMAGESOA_H
 
 #include "ImageIO.h"
+#include "ImageBufferPool.h"
 #include "Image.h"
 #include "Exception.h"
 #include "Rgba32F.h"
 
 #include <vector>
 #include <algorithm>
+#include <utility>
 #include <cassert>
 
 #if !defined(_MSC_VER) || _MSC_VER >= 1600
@@ -51,39 +53,64 @@ class ImageSoABase
 {
 protected:
     // Default constructor, clears the member variables
-    ImageSoABase() : m_width(0), m_height(0), m_data(0)
+    ImageSoABase() : m_width(0), m_height(0), m_data(0), m_bytes(0)
     {
     }
 
+#if PCG_HAS_RVALUE_REFS
+    // Takes the pixels of the other image, leaving it empty
+    ImageSoABase(ImageSoABase&& other) :
+    m_width(0), m_height(0), m_data(0), m_bytes(0),
+    m_offsets(other.m_offsets.size(), static_cast<size_t>(-1))
+    {
+        Swap(other);
+    }
 
-    // Allocates new space for the image data, deleting the previous one
+    // Releases the pixels of this image and takes those of the other one
+    ImageSoABase& operator=(ImageSoABase&& other) {
+        if (this != &other) {
+            Clear();
+            Swap(other);
+        }
+        return *this;
+    }
+#endif
+
+
+    // Allocates new space for the image data, deleting the previous one.
+    // If the new size needs the same memory the pixels are kept as is.
     template <size_t N>
     void Alloc(int w, int h, const size_t (&sizes)[N]) {
         assert(w > 0 && h > 0);
-        assert(((long long)w)*h <= 0x7fffffff);
-        Clear();
+
+        // Each channel is padded to 64 bytes and with 64-byte alignment
+        const size_t numel = static_cast<size_t>(w) * static_cast<size_t>(h);
+        size_t totalBytes = 0;
+        for (size_t i = 0; i != N; ++i) {
+            totalBytes += ((numel * sizes[i]) + 63) & ~0x3F;
+        }
+
+        if (m_data == NULL || totalBytes != m_bytes) {
+            Clear();
+            m_data = static_cast<int8_t*>(
+                ImageBufferPool::Acquire(totalBytes, ALIGNMENT));
+            if (m_data == NULL) {
+                throw RuntimeException("Couldn't allocate memory for the image.");
+            }
+            assert(reinterpret_cast<intptr_t>(m_data) % 64 == 0);
+            m_bytes = totalBytes;
+        }
         m_width  = w;
         m_height = h;
-        
-        // Allocate each channel, padding to 64 bytes and with 64-byte alignment
-        const size_t numel = static_cast<size_t>(w) * static_cast<size_t>(h);
 
         size_t offset = 0;
         assert(m_offsets.size() == N);
-        m_offsets[0] = offset;
         for (size_t i = 0; i != N; ++i) {
             m_offsets[i] = offset;
             offset += ((numel * sizes[i]) + 63) & ~0x3F;
             assert(offset % 64 == 0);
         }
-
-        // At this point offset contains the total requested memory
-        const size_t totalBytes = offset;
-        m_data = alloc_align<int8_t>(64, totalBytes);
-        assert(reinterpret_cast<intptr_t>(m_data) % 64 == 0);
-        if (m_data == NULL) {
-            throw RuntimeException("Couldn't allocate memory for the image.");
-        }
+        assert(offset == m_bytes);
     }
 
 public:
@@ -95,7 +122,7 @@ public:
     // Alignment in bytes
     static const int ALIGNMENT = 64;
 
-    // Destructor, it reclaims the space previously allocated
+    // Destructor, it returns the space previously allocated to the pool
     virtual ~ImageSoABase() {
         Clear();
     }
@@ -103,22 +130,34 @@ public:
     // Deallocates the memory and resets the image dimensions to 0
     void Clear() {
         if (m_data != 0) {
-            free_align(m_data);
+            ImageBufferPool::Release(m_data, m_bytes, ALIGNMENT);
             m_data = 0;
+            m_bytes = 0;
             std::fill(m_offsets.begin(), m_offsets.end(), -1);
         }
 
         m_width = m_height = 0;
     }
 
+    // Exchanges the pixels and the dimensions with those of another image
+    // with the same channels, without copying any pixel
+    void Swap(ImageSoABase &other) {
+        assert(m_offsets.size() == other.m_offsets.size());
+        std::swap(m_width,  other.m_width);
+        std::swap(m_height, other.m_height);
+        std::swap(m_data,   other.m_data);
+        std::swap(m_bytes,  other.m_bytes);
+        m_offsets.swap(other.m_offsets);
+    }
+
     // Width of the image
     int Width()  const { return m_width; }
 
     // Height of the image
     int Height() const { return m_height; }
 
-    // Number of pixels in the image (Width*Height)
-    int Size()   const { return m_width*m_height; }
+    // Number of pixels in the image (Width*Height), which may exceed 2^31
+    ptrdiff_t Size() const { return static_cast<ptrdiff_t>(m_width)*m_height; }
 
     // Provides access to the scanline mode of the image
     ScanLineMode GetMode() const { return TopDown; }
@@ -129,22 +168,21 @@ public:
     inline typename ChannelSpec::data_t & ElementAt(int i, int j,
         ScanLineMode mode = TopDown) const
     {
-        assert(m_width*j+i >=0 && m_width*j+i < m_width*m_height && 
-            j >= 0 && j < m_height && i >=0 && i < m_width);
+        assert(j >= 0 && j < m_height && i >=0 && i < m_width);
 
         typedef typename ChannelSpec::data_t data_t;
         data_t * d = reinterpret_cast<data_t*>(
             m_data + m_offsets[ChannelSpec::IDX]);
-        return (mode == TopDown) ? d[m_width*j + i] :
-                                   d[(m_height-j-1)*m_width + i];
+        return (mode == TopDown) ? d[static_cast<ptrdiff_t>(m_width)*j + i] :
+                                   d[static_cast<ptrdiff_t>(m_height-j-1)*m_width + i];
     }
 
     // Returns a reference to the idx-th pixel of the image, which are in
     // scanline order according to the specified mode.
     template <class ChannelSpec>
-    inline typename ChannelSpec::data_t & ElementAt(int idx) const
+    inline typename ChannelSpec::data_t & ElementAt(ptrdiff_t idx) const
     {
-        assert(idx >=0 && idx < m_width*m_height);
+        assert(idx >=0 && idx < Size());
         typedef typename ChannelSpec::data_t data_t;
         data_t * d = reinterpret_cast<data_t*>(
             m_data + m_offsets[ChannelSpec::IDX]);
@@ -164,26 +202,27 @@ public:
     // Writes in the i,j parameters the coordinates necessary to access the
     // idx-pixel in the image using ElementAt(int,int), according to the
     // scanline order of the image.
-    inline void GetIndices(int idx, int &i, int &j) const { 
-        assert(0 <= idx && idx < m_width*m_height);
-        i = idx % m_width; 
-        j = idx / m_width; 
+    inline void GetIndices(ptrdiff_t idx, int &i, int &j) const { 
+        assert(0 <= idx && idx < Size());
+        i = static_cast<int>(idx % m_width); 
+        j = static_cast<int>(idx / m_width); 
     }
 
     // Returns the index (zero based) of the i-th pixel at the j-th scanline
     // using the scanline order of the image.
-    inline int GetIndex(int i, int j) const {
+    inline ptrdiff_t GetIndex(int i, int j) const {
         assert(0 <= i && i < m_width);
         assert(0 <= j && j < m_height);
-        return m_width*j+i;
+        return static_cast<ptrdiff_t>(m_width)*j+i;
     }
 
     // Returns the index (zero based) of the i-th pixel at the j-th scanline
     // using the given scanline order.
-	inline int GetIndex(int i, int j, ScanLineMode mode) const {
+	inline ptrdiff_t GetIndex(int i, int j, ScanLineMode mode) const {
         assert(0 <= i && i < m_width);
         assert(0 <= j && j < m_height);
-        return mode == TopDown ? (m_width*j + i) : ((m_height-j-1)*m_width + i);
+        return mode == TopDown ? (static_cast<ptrdiff_t>(m_width)*j + i) :
+            (static_cast<ptrdiff_t>(m_height-j-1)*m_width + i);
     }
 
     // Gets a pointer to the beginning of the j-th scanline in the specified
@@ -201,8 +240,8 @@ public:
             m_data + m_offsets[ChannelSpec::IDX]);
 
         // There are only have two modes, so this works nicely
-        return (mode == TopDown) ? &(d[j * m_width]) :
-                                   &(d[(m_height - j - 1) * m_width]);
+        return (mode == TopDown) ? &(d[static_cast<ptrdiff_t>(j) * m_width]) :
+            &(d[static_cast<ptrdiff_t>(m_height - j - 1) * m_width]);
     }
 
 
@@ -213,8 +252,16 @@ protected:
     // Data for all each channels
     int8_t* m_data;
 
+    // Size in bytes of the data
+    size_t m_bytes;
+
     // Offsets for each channel
     std::vector<size_t> m_offsets;
+
+private:
+    // Non-copyable, the pixels would be released twice
+    ImageSoABase(const ImageSoABase&);
+    ImageSoABase& operator=(const ImageSoABase&);
 };
 
 
@@ -249,6 +296,15 @@ public:
         Alloc(w, h);
     }
 
+#if PCG_HAS_RVALUE_REFS
+    ImageSoA3(ImageSoA3&& other) : ImageSoABase(std::move(other)) {}
+
+    ImageSoA3& operator=(ImageSoA3&& other) {
+        ImageSoABase::operator=(std::move(other));
+        return *this;
+    }
+#endif
+
     // Allocates new space for the image data, deleting the previous one
     inline void Alloc(int w, int h) {
         const static size_t sizes[] = {
@@ -291,6 +347,15 @@ public:
         Alloc(w, h);
     }
 
+#if PCG_HAS_RVALUE_REFS
+    ImageSoA4(ImageSoA4&& other) : ImageSoABase(std::move(other)) {}
+
+    ImageSoA4& operator=(ImageSoA4&& other) {
+        ImageSoABase::operator=(std::move(other));
+        return *this;
+    }
+#endif
+
     // Allocates new space for the image data, deleting the previous one
     inline void Alloc(int w, int h) {
         const static size_t sizes[] = {
@@ -315,6 +380,16 @@ public:
 
     RGBAImageSoA(int w, int h) : ImageSoA4<float,float,float,float>(w, h) {}
 
+#if PCG_HAS_RVALUE_REFS
+    RGBAImageSoA(RGBAImageSoA&& other) :
+    ImageSoA4<float,float,float,float>(std::move(other)) {}
+
+    RGBAImageSoA& operator=(RGBAImageSoA&& other) {
+        ImageSoA4<float,float,float,float>::operator=(std::move(other));
+        return *this;
+    }
+#endif
+
     template <typename PixelRGB>
     RGBAImageSoA(const Image<PixelRGB, pcg::TopDown> &img) :
     ImageSoA4<float,float,float,float>(img.Width(), img.Height())
@@ -326,7 +401,8 @@ public:
 
         const PixelRGB * pixels = img.GetDataPointer();
 
-        for (int i = 0; i < img.Size(); ++i) {
+        const ptrdiff_t size = img.Size();
+        for (ptrdiff_t i = 0; i < size; ++i) {
             const PixelRGB &p = pixels[i];
             r[i] = p.r();
             g[i] = p.g();
@@ -358,7 +434,7 @@ public:
     }
 
     // Utility which generates a RGBA32F pixel on the fly
-    Rgba32F operator[] (int idx) const
+    Rgba32F operator[] (ptrdiff_t idx) const
     {
         const float& r = ElementAt<R>(idx);
         const float& g = ElementAt<G>(idx);
@@ -0,0 +1,259 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Non-owning views of pixels stored elsewhere: a region of an Image or of a
+// RGBAImageSoA, or memory from another library (a QImage, a Java direct
+// buffer, a Matlab array...) wrapped without copying it. A view is a top-down
+// rectangle of width x height pixels whose scanlines are a stride apart. The
+// stride is given in pixels and may be negative, which is how bottom-up
+// images are viewed. The view never allocates nor frees the pixels, which
+// must outlive it.
+//
+// Like Image, a const view still gives write access to its pixels; read-only
+// views use const pixels instead, e.g. ImageView<const Rgba32F>. Views with
+// writable pixels convert implicitly to read-only ones.
+
+#pragma once
+#if !defined(PCG_IMAGEVIEW_H)
+#define PCG_IMAGEVIEW_H
+
+#include "Image.h"
+#include "ImageSoA.h"
+#include "Exception.h"
+
+#include <cassert>
+#include <cstddef>
+
+namespace pcg
+{
+
+namespace imageview_internal
+{
+// Pixel type without the const qualifier
+template <typename T>
+struct mutable_type { typedef T type; };
+
+template <typename T>
+struct mutable_type<const T> { typedef T type; };
+
+// Throws IllegalArgumentException unless the region is within the view
+inline void checkRegion(int x, int y, int w, int h, int width, int height)
+{
+    if (x < 0 || y < 0 || w < 0 || h < 0 ||
+        w > width - x || h > height - y) {
+        throw IllegalArgumentException("The region is outside the view");
+    }
+}
+} // namespace imageview_internal
+
+
+
+// View of pixels stored in AoS form, such as those of Image
+template <typename T>
+class ImageView
+{
+public:
+    typedef T pixel_t;
+    typedef typename imageview_internal::mutable_type<T>::type mutable_t;
+
+    // Empty view
+    ImageView() : m_data(NULL), m_width(0), m_height(0), m_stride(0) {}
+
+    // View of the pixels whose top-left one is at data, with the given
+    // number of pixels between the beginning of consecutive scanlines
+    ImageView(T* data, int width, int height, ptrdiff_t stride) :
+    m_data(data), m_width(width), m_height(height), m_stride(stride)
+    {
+        assert(width >= 0 && height >= 0);
+        assert(data != NULL || width == 0 || height == 0);
+    }
+
+    // View of a whole image, in top-down order regardless of its own
+    template <ScanLineMode S>
+    ImageView(const Image<mutable_t, S>& img) :
+    m_data(img.GetScanlinePointer(0, TopDown)),
+    m_width(img.Width()), m_height(img.Height()),
+    m_stride(S == TopDown ? img.Width() : -img.Width())
+    {}
+
+    // Read-only view from a view of writable pixels
+    ImageView(const ImageView<mutable_t>& other) :
+    m_data(other.GetDataPointer()), m_width(other.Width()),
+    m_height(other.Height()), m_stride(other.Stride())
+    {}
+
+    // View of the region of width x height pixels whose top-left corner is
+    // the pixel (x,y). It throws IllegalArgumentException if the region is
+    // not within this view.
+    ImageView SubView(int x, int y, int width, int height) const
+    {
+        imageview_internal::checkRegion(x, y, width, height,
+            m_width, m_height);
+        if (width == 0 || height == 0) {
+            return ImageView();
+        }
+        return ImageView(&ElementAt(x, y), width, height, m_stride);
+    }
+
+    int Width()  const { return m_width; }
+
+    int Height() const { return m_height; }
+
+    // Number of pixels in the view (Width*Height)
+    ptrdiff_t Size() const { return static_cast<ptrdiff_t>(m_width)*m_height; }
+
+    // Pixels between the beginning of consecutive scanlines
+    ptrdiff_t Stride() const { return m_stride; }
+
+    // Whether the scanlines are consecutive in memory
+    bool IsContiguous() const { return m_stride == m_width || m_height < 2; }
+
+    // Pointer to the top-left pixel
+    T* GetDataPointer() const { return m_data; }
+
+    // Pointer to the beginning of the j-th scanline, from the top
+    T* GetScanlinePointer(int j) const {
+        assert(j >= 0 && j < m_height);
+        return m_data + j * m_stride;
+    }
+
+    // Reference to the i-th pixel in the j-th scanline, from the top
+    T& ElementAt(int i, int j) const {
+        assert(j >= 0 && j < m_height && i >= 0 && i < m_width);
+        return m_data[j * m_stride + i];
+    }
+
+private:
+    T* m_data;
+    int m_width;
+    int m_height;
+    ptrdiff_t m_stride;
+};
+
+
+
+// View of the R, G, B and A planes of floats of a SoA image, such as those of
+// RGBAImageSoA. The four planes have the same stride. F is either float or
+// const float.
+template <typename F>
+class ImageSoAView
+{
+public:
+    typedef F value_t;
+    typedef typename imageview_internal::mutable_type<F>::type mutable_t;
+
+    // Empty view
+    ImageSoAView() : m_width(0), m_height(0), m_stride(0) {
+        m_planes[0] = m_planes[1] = m_planes[2] = m_planes[3] = NULL;
+    }
+
+    // View of the planes whose top-left values are at r, g, b and a, with
+    // the given number of values between the beginning of consecutive
+    // scanlines of each plane
+    ImageSoAView(F* r, F* g, F* b, F* a, int width, int height,
+        ptrdiff_t stride) :
+    m_width(width), m_height(height), m_stride(stride)
+    {
+        assert(width >= 0 && height >= 0);
+        m_planes[0] = r;
+        m_planes[1] = g;
+        m_planes[2] = b;
+        m_planes[3] = a;
+    }
+
+    // View of a whole image
+    ImageSoAView(const RGBAImageSoA& img) :
+    m_width(img.Width()), m_height(img.Height()), m_stride(img.Width())
+    {
+        m_planes[0] = img.GetDataPointer<RGBAImageSoA::R>();
+        m_planes[1] = img.GetDataPointer<RGBAImageSoA::G>();
+        m_planes[2] = img.GetDataPointer<RGBAImageSoA::B>();
+        m_planes[3] = img.GetDataPointer<RGBAImageSoA::A>();
+    }
+
+    // Read-only view from a view of writable values
+    ImageSoAView(const ImageSoAView<mutable_t>& other) :
+    m_width(other.Width()), m_height(other.Height()),
+    m_stride(other.Stride())
+    {
+        m_planes[0] = other.template GetDataPointer<RGBAImageSoA::R>();
+        m_planes[1] = other.template GetDataPointer<RGBAImageSoA::G>();
+        m_planes[2] = other.template GetDataPointer<RGBAImageSoA::B>();
+        m_planes[3] = other.template GetDataPointer<RGBAImageSoA::A>();
+    }
+
+    // View of the region of width x height pixels whose top-left corner is
+    // the pixel (x,y). It throws IllegalArgumentException if the region is
+    // not within this view.
+    ImageSoAView SubView(int x, int y, int width, int height) const
+    {
+        imageview_internal::checkRegion(x, y, width, height,
+            m_width, m_height);
+        if (width == 0 || height == 0) {
+            return ImageSoAView();
+        }
+        const ptrdiff_t offset = y * m_stride + x;
+        return ImageSoAView(m_planes[0] + offset, m_planes[1] + offset,
+            m_planes[2] + offset, m_planes[3] + offset,
+            width, height, m_stride);
+    }
+
+    int Width()  const { return m_width; }
+
+    int Height() const { return m_height; }
+
+    // Number of pixels in the view (Width*Height)
+    ptrdiff_t Size() const { return static_cast<ptrdiff_t>(m_width)*m_height; }
+
+    // Values between the beginning of consecutive scanlines of each plane
+    ptrdiff_t Stride() const { return m_stride; }
+
+    // Whether the scanlines of each plane are consecutive in memory
+    bool IsContiguous() const { return m_stride == m_width || m_height < 2; }
+
+    // Pointer to the top-left value of the plane, using the channels of
+    // RGBAImageSoA, e.g. GetDataPointer<RGBAImageSoA::R>()
+    template <class ChannelSpec>
+    F* GetDataPointer() const {
+        return m_planes[ChannelSpec::IDX];
+    }
+
+    // Pointer to the beginning of the j-th scanline of the plane, from the top
+    template <class ChannelSpec>
+    F* GetScanlinePointer(int j) const {
+        assert(j >= 0 && j < m_height);
+        return m_planes[ChannelSpec::IDX] + j * m_stride;
+    }
+
+    // Reference to the value of the i-th pixel in the j-th scanline
+    template <class ChannelSpec>
+    F& ElementAt(int i, int j) const {
+        assert(j >= 0 && j < m_height && i >= 0 && i < m_width);
+        return m_planes[ChannelSpec::IDX][j * m_stride + i];
+    }
+
+private:
+    F* m_planes[4];
+    int m_width;
+    int m_height;
+    ptrdiff_t m_stride;
+};
+
+typedef ImageSoAView<float>       RGBAImageSoAView;
+typedef ImageSoAView<const float> ConstRGBAImageSoAView;
+
+} // namespace pcg
+
+#endif /* PCG_IMAGEVIEW_H */
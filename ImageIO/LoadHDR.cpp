@@ -19,6 +19,9 @@
 #include "OpenEXRIO.h"
 #include "RgbeIO.h"
 #include "PfmIO.h"
+#include "RgbeIOPrivate.h"
+#include "OpenEXRIOPrivate.h"
+#include "MappedFile.h"
 
 #include <fstream>
 #include <sstream>
@@ -45,8 +48,17 @@ inline int magic(const char (&m)[N]) {
     return (m[0] | (m[1] << 8));
 }
 
-template <class ImageCls>
-void LoadHDRImpl(ImageCls &img, std::istream &is)
+// Known types
+enum FileType {
+    OpenEXR,
+    RGBE,
+    PFM,
+    UNKNOWN
+};
+
+// Guesses the type of the file from its magic number, leaving the stream
+// at its original position
+FileType guessFileType(std::istream &is)
 {
     // Try to read the first 4 bytes to get the magic numbers
     const std::istream::pos_type origPosition = is.tellg();
@@ -64,14 +76,7 @@ void LoadHDRImpl(ImageCls &img, std::istream &is)
         throw IOException("Could not read the magic number.");
     }
 
-    // Known types
-    enum {
-        OpenEXR,
-        RGBE,
-        PFM,
-        UNKNOWN
-    };
-    int type = UNKNOWN;
+    FileType type = UNKNOWN;
 
     if (u.magic == 20000630) {
         // Assume OpenEXR
@@ -97,6 +102,32 @@ void LoadHDRImpl(ImageCls &img, std::istream &is)
     if (!is) {
         throw IOException("Could not reposition the stream.");
     }
+    return type;
+}
+
+// Loads the whole image when the window is null
+template <class ImageCls>
+void LoadHDRImpl(ImageCls &img, std::istream &is, const LoadWindow *window)
+{
+    const FileType type = guessFileType(is);
+
+    if (window != NULL) {
+        switch (type) {
+        case OpenEXR:
+            pcg::OpenEXRIO::Load(img, is, *window);
+            break;
+        case RGBE:
+            pcg::RgbeIO::Load(img, is, *window);
+            break;
+        case PFM:
+            pcg::PfmIO::Load(img, is, *window);
+            break;
+        case UNKNOWN:
+            assert(false);
+            break;
+        }
+        return;
+    }
 
     switch (type) {
     case OpenEXR:
@@ -108,6 +139,9 @@ void LoadHDRImpl(ImageCls &img, std::istream &is)
     case PFM:
         pcg::PfmIO::Load(img, is);
         break;
+    case UNKNOWN:
+        assert(false);
+        break;
     }
 }
 
@@ -145,22 +179,22 @@ inline std::string toPrintable(const wchar_t* str) {
 #endif
 
 template <class ImageCls, typename CharT>
-void LoadHDRImpl(ImageCls &img, const CharT *filename)
+void LoadHDRImpl(ImageCls &img, const CharT *filename,
+                 const LoadWindow *window)
 {
     if (filename == NULL) {
         throw IllegalArgumentException("The filename cannot be null.");
     }
 
-    std::ifstream is(filename, std::ios::binary);
-
-    if(!is) {
+    // The loaders decode the pixels directly from the file when it is mapped
+    FileInputStream is;
+    if (!is.open(filename)) {
         std::string msg("Could not open the file \"");
         msg += toPrintable(filename);
         msg += "\".";
         throw IOException(msg);
     }
-
-    LoadHDRImpl(img, is);
+    LoadHDRImpl(img, is, window);
 }
 
 } // namespace
@@ -168,23 +202,156 @@ void LoadHDRImpl(ImageCls &img, const CharT *filename)
 
 
 void pcg::LoadHDR(Image<Rgba32F,TopDown>  &img, std::istream &is) {
-    LoadHDRImpl(img, is);
+    LoadHDRImpl(img, is, NULL);
 }
 void pcg::LoadHDR(Image<Rgba32F,TopDown> &img, const char *filename) {
-    LoadHDRImpl(img, filename);
+    LoadHDRImpl(img, filename, NULL);
 }
 void pcg::LoadHDR(RGBAImageSoA &img, std::istream &is) {
-    LoadHDRImpl(img, is);
+    LoadHDRImpl(img, is, NULL);
 }
 void pcg::LoadHDR(RGBAImageSoA &img, const char *filename) {
-    LoadHDRImpl(img, filename);
+    LoadHDRImpl(img, filename, NULL);
+}
+
+void pcg::LoadHDR(Image<Rgba32F,TopDown> &img, std::istream &is,
+                  const LoadWindow &window) {
+    LoadHDRImpl(img, is, &window);
+}
+void pcg::LoadHDR(Image<Rgba32F,TopDown> &img, const char *filename,
+                  const LoadWindow &window) {
+    LoadHDRImpl(img, filename, &window);
+}
+void pcg::LoadHDR(RGBAImageSoA &img, std::istream &is,
+                  const LoadWindow &window) {
+    LoadHDRImpl(img, is, &window);
+}
+void pcg::LoadHDR(RGBAImageSoA &img, const char *filename,
+                  const LoadWindow &window) {
+    LoadHDRImpl(img, filename, &window);
+}
+
+
+
+struct ScanlineReader::Impl
+{
+    MappedFile file;
+    FileType type;
+    int width;
+    int height;
+    rgbeio_internal::BandDecoder *rgbeDecoder;
+    openexrio_internal::RegionReader *exrReader;
+
+    Impl() : type(UNKNOWN), width(0), height(0), rgbeDecoder(NULL),
+        exrReader(NULL) {}
+
+    ~Impl() {
+        delete rgbeDecoder;
+        delete exrReader;
+    }
+};
+
+
+ScanlineReader::ScanlineReader(const char *filename) : impl(new Impl)
+{
+    try {
+        if (filename == NULL) {
+            throw IllegalArgumentException("The filename cannot be null.");
+        }
+        if (!impl->file.open(filename)) {
+            std::string msg("Could not open the file \"");
+            msg += filename;
+            msg += "\".";
+            throw IOException(msg);
+        }
+
+        MemoryStreamBuf buffer(impl->file);
+        std::istream is(&buffer);
+        impl->type = guessFileType(is);
+        switch (impl->type) {
+        case OpenEXR:
+            // The file stays open to read all the bands
+            impl->exrReader = new openexrio_internal::RegionReader(filename);
+            impl->width  = impl->exrReader->width();
+            impl->height = impl->exrReader->height();
+            break;
+        case RGBE:
+            // The decoder keeps pointing to the mapped pixels
+            impl->rgbeDecoder = new rgbeio_internal::BandDecoder(is);
+            impl->width  = impl->rgbeDecoder->width();
+            impl->height = impl->rgbeDecoder->height();
+            break;
+        default:
+            PfmIO::GetSize(is, impl->width, impl->height);
+            break;
+        }
+    }
+    catch (...) {
+        delete impl;
+        throw;
+    }
 }
 
+
+ScanlineReader::~ScanlineReader()
+{
+    delete impl;
+}
+
+
+int ScanlineReader::Width() const
+{
+    return impl->width;
+}
+
+
+int ScanlineReader::Height() const
+{
+    return impl->height;
+}
+
+
+void ScanlineReader::Read(RGBAImageSoA &img, int y, int numRows)
+{
+    if (y < 0 || numRows <= 0 || numRows > impl->height - y) {
+        throw IllegalArgumentException("The scanlines are not within the "
+            "image.");
+    }
+
+    switch (impl->type) {
+    case OpenEXR:
+        impl->exrReader->read(img, 0, y, impl->width, numRows);
+        break;
+    case RGBE:
+        if (img.Width() != impl->width || img.Height() != numRows) {
+            img.Alloc(impl->width, numRows);
+        }
+        impl->rgbeDecoder->decode(img, y);
+        break;
+    default:
+        {
+            MemoryStreamBuf buffer(impl->file);
+            std::istream is(&buffer);
+            PfmIO::Load(img, is, LoadWindow(0, y, impl->width, numRows));
+        }
+        break;
+    }
+}
+
+
 #if defined(_WIN32)
 void pcg::LoadHDR(Image<Rgba32F,TopDown> &img, const wchar_t *filename) {
-    LoadHDRImpl(img, filename);
+    LoadHDRImpl(img, filename, NULL);
 }
 void pcg::LoadHDR(RGBAImageSoA &img, const wchar_t *filename) {
-    LoadHDRImpl(img, filename);
+    LoadHDRImpl(img, filename, NULL);
+}
+void pcg::LoadHDR(Image<Rgba32F,TopDown> &img, const wchar_t *filename,
+                  const LoadWindow &window) {
+    LoadHDRImpl(img, filename, &window);
+}
+void pcg::LoadHDR(RGBAImageSoA &img, const wchar_t *filename,
+                  const LoadWindow &window) {
+    LoadHDRImpl(img, filename, &window);
 }
 #endif
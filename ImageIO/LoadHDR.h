@@ -26,6 +26,7 @@
 #include "Image.h"
 #include "ImageSoA.h"
 #include "Rgba32F.h"
+#include "LoadWindow.h"
 
 #include <istream>
 #include <string>
@@ -52,6 +53,59 @@ namespace pcg
     inline static void LoadHDR(RGBAImageSoA &img, const std::string& filename) {
         LoadHDR(img, filename.c_str());
     }
+
+    // Load only a window of the image, subsampled by an integer step, as
+    // described in LoadWindow. Only the scanlines of the window are read or
+    // decoded, thus previewing a large image at 1/8 scale costs about 1/64
+    // of the full load for uncompressed formats. Throws an
+    // IllegalArgumentException if the window is not within the image.
+    IMAGEIO_API void LoadHDR(Image<Rgba32F,TopDown> &img, std::istream &is,
+        const LoadWindow &window);
+    IMAGEIO_API void LoadHDR(RGBAImageSoA &img, std::istream &is,
+        const LoadWindow &window);
+    IMAGEIO_API void LoadHDR(Image<Rgba32F,TopDown> &img, const char *filename,
+        const LoadWindow &window);
+    IMAGEIO_API void LoadHDR(RGBAImageSoA &img, const char *filename,
+        const LoadWindow &window);
+
+    inline static void LoadHDR(Image<Rgba32F,TopDown> &img,
+        const std::string& filename, const LoadWindow &window) {
+        LoadHDR(img, filename.c_str(), window);
+    }
+    inline static void LoadHDR(RGBAImageSoA &img, const std::string& filename,
+        const LoadWindow &window) {
+        LoadHDR(img, filename.c_str(), window);
+    }
+
+    // Reads an image file in bands of whole scanlines, so that images too
+    // large to fit in memory can be processed a few bands at a time. The
+    // file is memory mapped and its type guessed as in LoadHDR, both in the
+    // constructor, which throws an IOException if the file is not valid.
+    // RGBE files locate their scanlines once when opened, OpenEXR files
+    // stay open and read only the chunks which overlap each band.
+    class IMAGEIO_API ScanlineReader
+    {
+    public:
+        ScanlineReader(const char *filename);
+        ~ScanlineReader();
+
+        int Width() const;
+        int Height() const;
+
+        // Loads numRows scanlines starting at the scanline y, counted from
+        // the top, into img which gets Width() x numRows pixels. Bands may
+        // be read in any order. Throws IllegalArgumentException if the
+        // scanlines are not within the image.
+        void Read(RGBAImageSoA &img, int y, int numRows);
+
+    private:
+        ScanlineReader(const ScanlineReader&);
+        ScanlineReader& operator=(const ScanlineReader&);
+
+        struct Impl;
+        Impl *impl;
+    };
+
 #if defined(_WIN32)
     IMAGEIO_API void LoadHDR(Image<Rgba32F,TopDown> &img, const wchar_t *fname);
     IMAGEIO_API void LoadHDR(RGBAImageSoA &img, const wchar_t *filename);
@@ -63,6 +117,20 @@ namespace pcg
     inline static void LoadHDR(RGBAImageSoA &img, const std::wstring& filename){
         LoadHDR(img, filename.c_str());
     }
+
+    IMAGEIO_API void LoadHDR(Image<Rgba32F,TopDown> &img, const wchar_t *fname,
+        const LoadWindow &window);
+    IMAGEIO_API void LoadHDR(RGBAImageSoA &img, const wchar_t *filename,
+        const LoadWindow &window);
+
+    inline static void LoadHDR(Image<Rgba32F,TopDown> &img,
+        const std::wstring& filename, const LoadWindow &window) {
+        LoadHDR(img, filename.c_str(), window);
+    }
+    inline static void LoadHDR(RGBAImageSoA &img,
+        const std::wstring& filename, const LoadWindow &window) {
+        LoadHDR(img, filename.c_str(), window);
+    }
 #endif
 
 } // namespace pcg
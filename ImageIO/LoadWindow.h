@@ -0,0 +1,86 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#pragma once
+#if !defined(PCG_LOADWINDOW_H)
+#define PCG_LOADWINDOW_H
+
+#include "Exception.h"
+
+namespace pcg
+{
+
+// Window of pixels to load from an image file, with an integer subsampling
+// step. The coordinates have their origin at the top-left corner of the
+// image. The loaded image has ceil(width/step) x ceil(height/step) pixels,
+// where its pixel (i,j) is the pixel (x + i*step, y + j*step) of the file.
+// A width or height of zero extends the window up to the edge of the image.
+struct LoadWindow
+{
+    int x;
+    int y;
+    int width;
+    int height;
+    int step;
+
+    LoadWindow(int x_ = 0, int y_ = 0, int width_ = 0, int height_ = 0,
+        int step_ = 1) :
+    x(x_), y(y_), width(width_), height(height_), step(step_) {}
+
+    // Window with the whole image, keeping one of every step pixels
+    static LoadWindow subsampled(int step) {
+        return LoadWindow(0, 0, 0, 0, step);
+    }
+
+    // Returns the window with the actual dimensions for an image of the
+    // given size. Throws IllegalArgumentException if the window is not
+    // within the image or the step is not positive.
+    LoadWindow resolve(int imgWidth, int imgHeight) const
+    {
+        LoadWindow w(*this);
+        if (w.width  == 0) w.width  = imgWidth  - w.x;
+        if (w.height == 0) w.height = imgHeight - w.y;
+        if (w.step <= 0) {
+            throw IllegalArgumentException("The subsampling step must be "
+                "positive.");
+        }
+        if (w.x < 0 || w.y < 0 || w.width <= 0 || w.height <= 0 ||
+            w.width > imgWidth - w.x || w.height > imgHeight - w.y) {
+            throw IllegalArgumentException("The window is not within the "
+                "image.");
+        }
+        return w;
+    }
+
+    // Dimensions of the loaded image
+    inline int outputWidth() const {
+        return (width + step - 1) / step;
+    }
+    inline int outputHeight() const {
+        return (height + step - 1) / step;
+    }
+
+    // Coordinates in the file of the pixels of the loaded image
+    inline int sourceX(int i) const {
+        return x + i * step;
+    }
+    inline int sourceY(int j) const {
+        return y + j * step;
+    }
+};
+
+} // namespace pcg
+
+#endif /* PCG_LOADWINDOW_H */
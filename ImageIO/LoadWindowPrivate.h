@@ -0,0 +1,64 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Internal helpers shared by the loaders of windows of pixels
+
+#if !defined(PCG_LOADWINDOWPRIVATE_H)
+#define PCG_LOADWINDOWPRIVATE_H
+
+#include "Image.h"
+#include "ImageSoA.h"
+#include "Rgba32F.h"
+
+#include <cstddef>
+
+namespace pcg
+{
+
+// Stores the j-th scanline of a loaded window from four channels, whose
+// consecutive pixels are stride floats apart. A null alpha means one.
+inline void storeWindowScanline(Image<Rgba32F, TopDown> &img, int j,
+    const float *r, const float *g, const float *b, const float *a,
+    ptrdiff_t stride)
+{
+    Rgba32F *dest = img.GetScanlinePointer(j, TopDown);
+    const int width = img.Width();
+    for (int i = 0; i < width; ++i) {
+        const ptrdiff_t idx = i * stride;
+        dest[i].set(r[idx], g[idx], b[idx], a != NULL ? a[idx] : 1.0f);
+    }
+}
+
+inline void storeWindowScanline(RGBAImageSoA &img, int j,
+    const float *r, const float *g, const float *b, const float *a,
+    ptrdiff_t stride)
+{
+    float *destR = img.GetScanlinePointer<RGBAImageSoA::R>(j, TopDown);
+    float *destG = img.GetScanlinePointer<RGBAImageSoA::G>(j, TopDown);
+    float *destB = img.GetScanlinePointer<RGBAImageSoA::B>(j, TopDown);
+    float *destA = img.GetScanlinePointer<RGBAImageSoA::A>(j, TopDown);
+    const int width = img.Width();
+    for (int i = 0; i < width; ++i) {
+        const ptrdiff_t idx = i * stride;
+        destR[i] = r[idx];
+        destG[i] = g[idx];
+        destB[i] = b[idx];
+        destA[i] = a != NULL ? a[idx] : 1.0f;
+    }
+}
+
+} // namespace pcg
+
+#endif /* PCG_LOADWINDOWPRIVATE_H */
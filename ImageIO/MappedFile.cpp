@@ -0,0 +1,279 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "MappedFile.h"
+#include "Exception.h"
+
+#include <string>
+
+#if defined(_WIN32)
+# ifdef NOMINMAX
+#  undef NOMINMAX
+# endif
+# define NOMINMAX
+# define WIN32_LEAN_AND_MEAN
+# include <Windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+
+pcg::MappedFile::MappedFile() : m_data(NULL), m_size(0)
+{
+}
+
+pcg::MappedFile::MappedFile(const char *filename) : m_data(NULL), m_size(0)
+{
+    if (filename == NULL) {
+        throw IllegalArgumentException("The filename cannot be null.");
+    }
+    if (!open(filename)) {
+        throw IOException(std::string("Could not map the file \"") +
+            filename + "\".");
+    }
+}
+
+pcg::MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+
+#if defined(_WIN32)
+
+pcg::MappedFile::MappedFile(const wchar_t *filename) : m_data(NULL), m_size(0)
+{
+    if (filename == NULL) {
+        throw IllegalArgumentException("The filename cannot be null.");
+    }
+    if (!open(filename)) {
+        throw IOException("Could not map the file.");
+    }
+}
+
+bool pcg::MappedFile::open(const char *filename)
+{
+    close();
+    HANDLE hFile = ::CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    return hFile != INVALID_HANDLE_VALUE && map(hFile);
+}
+
+bool pcg::MappedFile::open(const wchar_t *filename)
+{
+    close();
+    HANDLE hFile = ::CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    return hFile != INVALID_HANDLE_VALUE && map(hFile);
+}
+
+bool pcg::MappedFile::map(void *hFile)
+{
+    LARGE_INTEGER fileSize;
+    if (!::GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0) {
+        ::CloseHandle(hFile);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file
+    HANDLE hMapping = ::CreateFileMappingW(hFile, NULL, PAGE_READONLY,
+        0, 0, NULL);
+    ::CloseHandle(hFile);
+    if (hMapping == NULL) {
+        return false;
+    }
+    const void *view = ::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    ::CloseHandle(hMapping);
+    if (view == NULL) {
+        return false;
+    }
+
+    m_data = static_cast<const char*>(view);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void pcg::MappedFile::close()
+{
+    if (m_data != NULL) {
+        ::UnmapViewOfFile(m_data);
+        m_data = NULL;
+        m_size = 0;
+    }
+}
+
+#else
+
+bool pcg::MappedFile::open(const char *filename)
+{
+    close();
+
+    // Opening a FIFO would block until there is a writer, only to find out
+    // that it cannot be mapped; leave it to the regular stream instead
+    struct stat st;
+    if (::stat(filename, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    const int fd = ::open(filename, O_RDONLY);
+    return fd != -1 && map(fd);
+}
+
+bool pcg::MappedFile::map(int fd)
+{
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file
+    const size_t size = static_cast<size_t>(st.st_size);
+    void *addr = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    // The pixels are decoded in parallel, so request the whole file early
+    ::posix_madvise(addr, size, POSIX_MADV_WILLNEED);
+
+    m_data = static_cast<const char*>(addr);
+    m_size = size;
+    return true;
+}
+
+void pcg::MappedFile::close()
+{
+    if (m_data != NULL) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+        m_data = NULL;
+        m_size = 0;
+    }
+}
+
+#endif
+
+
+
+pcg::MemoryStreamBuf::MemoryStreamBuf()
+{
+    reset(NULL, 0);
+}
+
+pcg::MemoryStreamBuf::MemoryStreamBuf(const char *data, size_t size)
+{
+    reset(data, size);
+}
+
+pcg::MemoryStreamBuf::MemoryStreamBuf(const MappedFile &file)
+{
+    reset(file.data(), file.size());
+}
+
+void pcg::MemoryStreamBuf::reset(const char *data, size_t size)
+{
+    // The get area is never written to
+    char *begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+}
+
+void pcg::MemoryStreamBuf::consume(size_t count)
+{
+    if (count > remaining()) {
+        count = remaining();
+    }
+    setg(eback(), gptr() + count, egptr());
+}
+
+pcg::MemoryStreamBuf::pos_type
+pcg::MemoryStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                              std::ios_base::openmode which)
+{
+    if ((which & std::ios_base::in) == 0) {
+        return pos_type(off_type(-1));
+    }
+
+    char *base;
+    switch (dir) {
+    case std::ios_base::beg:
+        base = eback();
+        break;
+    case std::ios_base::cur:
+        base = gptr();
+        break;
+    case std::ios_base::end:
+        base = egptr();
+        break;
+    default:
+        return pos_type(off_type(-1));
+    }
+
+    const off_type target = (base - eback()) + off;
+    if (target < 0 || target > egptr() - eback()) {
+        return pos_type(off_type(-1));
+    }
+    setg(eback(), eback() + target, egptr());
+    return pos_type(target);
+}
+
+pcg::MemoryStreamBuf::pos_type
+pcg::MemoryStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+
+pcg::FileInputStream::FileInputStream() : std::istream(NULL)
+{
+}
+
+template <typename CharT>
+bool pcg::FileInputStream::openImpl(const CharT *filename)
+{
+    m_file.close();
+    if (m_fileBuf.is_open()) {
+        m_fileBuf.close();
+    }
+
+    if (m_file.open(filename)) {
+        m_memBuf.reset(m_file.data(), m_file.size());
+        rdbuf(&m_memBuf);
+        return true;
+    }
+    if (m_fileBuf.open(filename, std::ios_base::in | std::ios_base::binary)) {
+        rdbuf(&m_fileBuf);
+        return true;
+    }
+
+    rdbuf(NULL);
+    return false;
+}
+
+bool pcg::FileInputStream::open(const char *filename)
+{
+    return openImpl(filename);
+}
+
+#if defined(_WIN32)
+bool pcg::FileInputStream::open(const wchar_t *filename)
+{
+    return openImpl(filename);
+}
+#endif
@@ -0,0 +1,164 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+/*
+ * Internal helpers to read files through memory mapped pages. The loaders
+ * parse the headers through a regular std::istream backed by a
+ * MemoryStreamBuf, then query the stream buffer to decode the pixels directly
+ * from the mapped memory instead of copying them through iostream buffers.
+ */
+
+#pragma once
+#if !defined (PCG_MAPPEDFILE_H)
+#define PCG_MAPPEDFILE_H
+
+#include <cstddef>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+
+namespace pcg
+{
+
+// Read-only memory mapping of a whole file. The constructors which receive
+// a filename throw an IOException if the file cannot be open or mapped.
+class MappedFile
+{
+public:
+    MappedFile();
+    explicit MappedFile(const char *filename);
+#if defined(_WIN32)
+    explicit MappedFile(const wchar_t *filename);
+#endif
+    ~MappedFile();
+
+    // Maps the file, releasing any previous mapping. Returns false if the
+    // file cannot be open or mapped.
+    bool open(const char *filename);
+#if defined(_WIN32)
+    bool open(const wchar_t *filename);
+#endif
+
+    // Releases the mapping
+    void close();
+
+    inline bool isOpen() const {
+        return m_data != NULL;
+    }
+
+    inline const char* data() const {
+        return m_data;
+    }
+
+    inline size_t size() const {
+        return m_size;
+    }
+
+private:
+    // Non-copyable
+    MappedFile(const MappedFile&);
+    MappedFile& operator= (const MappedFile&);
+
+#if defined(_WIN32)
+    bool map(void *hFile);
+#else
+    bool map(int fd);
+#endif
+
+    const char *m_data;
+    size_t m_size;
+};
+
+
+
+// Read-only stream buffer over a memory range, which is not copied. Loaders
+// which find this buffer behind an istream access the data directly.
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+    // Empty buffer
+    MemoryStreamBuf();
+
+    MemoryStreamBuf(const char *data, size_t size);
+
+    explicit MemoryStreamBuf(const MappedFile &file);
+
+    // Replaces the memory range, rewinding the buffer
+    void reset(const char *data, size_t size);
+
+    // Pointer to the next character to be read
+    inline const char* current() const {
+        return gptr();
+    }
+
+    // Number of characters until the end of the buffer
+    inline size_t remaining() const {
+        return static_cast<size_t>(egptr() - gptr());
+    }
+
+    // Advances the read position after the data has been accessed directly
+    void consume(size_t count);
+
+    // Returns the buffer behind the stream if it is a MemoryStreamBuf
+    static inline MemoryStreamBuf* fromStream(std::istream &is) {
+        return dynamic_cast<MemoryStreamBuf*>(is.rdbuf());
+    }
+
+protected:
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which = std::ios_base::in);
+
+    virtual pos_type seekpos(pos_type pos,
+        std::ios_base::openmode which = std::ios_base::in);
+
+};
+
+
+
+// Input stream over a whole file. It reads from the mapped pages whenever the
+// file can be mapped, otherwise through a regular file buffer, which is what
+// pipes, FIFOs and empty files get. The loaders only decode directly from
+// the file in the former case.
+class FileInputStream : public std::istream
+{
+public:
+    FileInputStream();
+
+    // Opens the file, returns false if it cannot be read at all
+    bool open(const char *filename);
+#if defined(_WIN32)
+    bool open(const wchar_t *filename);
+#endif
+
+    inline bool isMapped() const {
+        return m_file.isOpen();
+    }
+
+private:
+    // Non-copyable
+    FileInputStream(const FileInputStream&);
+    FileInputStream& operator= (const FileInputStream&);
+
+    template <typename CharT>
+    bool openImpl(const CharT *filename);
+
+    MappedFile m_file;
+    MemoryStreamBuf m_memBuf;
+    std::filebuf m_fileBuf;
+};
+
+} // namespace pcg
+
+#endif /* PCG_MAPPEDFILE_H */
@@ -16,26 +16,166 @@
 // Implementation file for loading the OpenEXR Images
 
 #include "OpenEXRIO.h"
+#include "OpenEXRIOPrivate.h"
+#include "Concurrency.h"
+#include "ConcurrencyPrivate.h"
 #include "Exception.h"
-#include "ImageIterators.h"
+#include "HalfConversion.h"
+#include "LoadWindowPrivate.h"
 
 // OpenEXR includes
 #include <half.h>
 #include <Iex.h>
 #include <ImathBox.h>
-#include <ImfArray.h>
 #include <ImfRgbaFile.h>
 #include <ImfInputFile.h>
+#include <ImfTiledInputFile.h>
+#include <ImfTiledRgbaFile.h>
+#include <ImfTestFile.h>
 #include <ImfChannelList.h>
 #include <ImfIO.h>
+#include <ImfStdIO.h>
+#include <IlmBaseConfig.h>
 #include <IlmThreadPool.h>
 
-#include <tbb/task_scheduler_init.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
+#include <tbb/spin_mutex.h>
+#include <tbb/task_arena.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <map>
+#include <string>
+#include <vector>
+
+// IlmBase 2.3 introduced the custom providers for the IlmThread pool, which
+// the internal copy of IlmBase has as well
+#if defined(ILMBASE_HAS_THREAD_POOL_PROVIDER) || \
+    (defined(ILMBASE_VERSION_HEX) && ILMBASE_VERSION_HEX >= 0x02030000)
+# define PCG_USE_THREAD_POOL_PROVIDER 1
+#else
+# define PCG_USE_THREAD_POOL_PROVIDER 0
+#endif
 
 namespace {
 
+#if PCG_USE_THREAD_POOL_PROVIDER
+
+// Executes an IlmThread task and deletes it, as the IlmThread pool does
+class RunTask
+{
+public:
+    RunTask(IlmThread::Task *t) : task(t) {}
+
+    void operator()() const {
+        try {
+            task->execute();
+        }
+        catch (...) {
+            // The tasks of IlmImf keep their own errors
+        }
+        delete task;
+    }
+
+private:
+    IlmThread::Task *task;
+};
+
+
+
+// Provider for the IlmThread pool which runs the tasks on the TBB scheduler,
+// with the concurrency of the calling thread: that of its Concurrency::Scope,
+// otherwise the process-wide one. A TBB worker thread executes the tasks it
+// adds right away: it is already doing parallel work, and it must not block
+// waiting for tasks which other workers, possibly blocked just as well, would
+// have to run. So does a thread limited to a single thread. Other threads
+// enqueue the tasks in an arena of the provider with that many threads,
+// while they wait for them in the destructor of their IlmThread::TaskGroup.
+// These arenas reserve no slots for application threads, which never enter
+// them: a waiting thread never holds the slot that its tasks need, as it
+// would if they were enqueued in the arena of the scope, where the thread
+// might be running a parallel loop.
+class TbbThreadPoolProvider : public IlmThread::ThreadPoolProvider
+{
+public:
+    virtual ~TbbThreadPoolProvider() {
+        for (ArenaMap::iterator it = arenas.begin(); it != arenas.end(); ++it) {
+            delete it->second;
+        }
+    }
+
+    // IlmImf sizes the buffers of each file after this
+    virtual int numThreads() const {
+        return pcg::concurrency::currentMaxThreads();
+    }
+
+    virtual void setNumThreads(int count) {
+        pcg::Concurrency::SetMaxThreads(std::max(1, count));
+    }
+
+    virtual void addTask(IlmThread::Task *task) {
+        const int maxThreads = pcg::concurrency::currentMaxThreads();
+        if (maxThreads == 1 ||
+            tbb::this_task_arena::current_thread_index() > 0) {
+            const RunTask run(task);
+            run();
+        } else {
+            arena(maxThreads).enqueue(RunTask(task));
+        }
+    }
+
+    virtual void finish() {
+        // Each file waits for its own tasks, nothing is left once they close
+    }
+
+private:
+    // Arena for the given number of threads. They are kept until the end
+    // since they may still be running tasks, there is one for each size.
+    tbb::task_arena& arena(int maxThreads) {
+        tbb::spin_mutex::scoped_lock lock(mutex);
+        tbb::task_arena *&a = arenas[maxThreads];
+        if (a == NULL) {
+            a = new tbb::task_arena(maxThreads, 0);
+        }
+        return *a;
+    }
+
+    typedef std::map<int, tbb::task_arena*> ArenaMap;
+
+    tbb::spin_mutex mutex;
+    ArenaMap arenas;
+};
+
+#endif // PCG_USE_THREAD_POOL_PROVIDER
+
+
+tbb::spin_mutex threadPoolMutex;
+bool hasThreadPool = false;
+
+// Sets up the global IlmThread pool, which IlmImf uses for all the files.
+// With a provider this happens only once, otherwise the pool gets resized
+// only when the ImageIO concurrency changes.
+void initThreadPool()
+{
+    tbb::spin_mutex::scoped_lock lock(threadPoolMutex);
+    IlmThread::ThreadPool &pool = IlmThread::ThreadPool::globalThreadPool();
+#if PCG_USE_THREAD_POOL_PROVIDER
+    if (!hasThreadPool) {
+        pool.setThreadProvider(new TbbThreadPoolProvider);
+        hasThreadPool = true;
+    }
+#else
+    const int maxThreads = pcg::Concurrency::MaxThreads();
+    if (!hasThreadPool || pool.numThreads() != maxThreads) {
+        pool.setNumThreads(maxThreads);
+        hasThreadPool = true;
+    }
+#endif
+}
+
+
 inline void clearError() {
     errno = 0;
 }
@@ -161,82 +301,254 @@ inline Imf::Slice newSlice(T* base, size_t xStride, size_t yStride,
 
 using namespace pcg;
 
-// Small function to actually copy the pixels from the already open file into the image
-void ReadImage(Image<Rgba32F, TopDown> &img, Imf::RgbaInputFile &file)
+// Number of scanlines stored together in each block of a scanline file
+inline int linesPerBlock(Imf::Compression compression)
 {
-    Imath::Box2i dw = file.dataWindow();
-    const int width  = dw.max.x - dw.min.x + 1;
-    const int height = dw.max.y - dw.min.y + 1;
+    switch (compression) {
+    case Imf::ZIP_COMPRESSION:
+    case Imf::PXR24_COMPRESSION:
+        return 16;
+    case Imf::PIZ_COMPRESSION:
+    case Imf::B44_COMPRESSION:
+    case Imf::B44A_COMPRESSION:
+        return 32;
+    default:
+        return 1;
+    }
+}
 
-    // Memory for reading the all pixels
-    Imf::Array2D<Imf::Rgba> halfPixels(width, height);
+// Number of blocks or tiles handed to OpenEXR at once, enough to keep busy
+// all the threads available to the current scope
+inline int blocksInFlight()
+{
+    return 4 * std::max(1, pcg::concurrency::currentMaxThreads());
+}
 
-    // Read all the pixels from the image
-    file.setFrameBuffer (&halfPixels[0][0], 1, width);
-    file.readPixels (dw.min.y, dw.max.y);	// Ossia, (0, height-1);
+// Height of the bands of scanlines converted at once from/to half. They are
+// large enough to keep all the OpenEXR threads busy while limiting the
+// half precision scratch buffer to a fraction of the image.
+inline int bandHeight(Imf::Compression compression, int height)
+{
+    const int rows =
+        std::max(64, blocksInFlight() * linesPerBlock(compression));
+    return std::min(rows, height);
+}
 
-    // OpenEXR files loaded this way are always organized TopDown according
-    // to our point of view
+// Number of rows of tiles read or written at once
+inline int tileRowsInFlight(int tilesPerRow)
+{
+    return std::max(1, (blocksInFlight() + tilesPerRow - 1) / tilesPerRow);
+}
+
+
+
+// Converts scanlines of halves into the destination image. The layout of the
+// scratch buffer used by each image type matches the layout of the image, so
+// that the conversion is a linear pass over each scanline.
+inline void convertHalfScanline(Image<Rgba32F, TopDown> &img, int y,
+    const unsigned short *src)
+{
+    float *dest = reinterpret_cast<float*>(img.GetScanlinePointer(y));
+    convertHalfToFloat(dest, src, 4 * img.Width());
+}
+
+inline void convertHalfScanline(const RGBAImageSoAView &img, int y,
+    const unsigned short *src)
+{
+    const size_t w = img.Width();
+    convertHalfToFloat(img.GetScanlinePointer<RGBAImageSoA::R>(y),
+        src,       w);
+    convertHalfToFloat(img.GetScanlinePointer<RGBAImageSoA::G>(y),
+        src + w,   w);
+    convertHalfToFloat(img.GetScanlinePointer<RGBAImageSoA::B>(y),
+        src + 2*w, w);
+    convertHalfToFloat(img.GetScanlinePointer<RGBAImageSoA::A>(y),
+        src + 3*w, w);
+}
+
+// Scratch layout for Rgba32F: interleaved as a, b, g, r. The pixel at
+// (xMin, yMin) is the first one of the scratch buffer.
+inline void insertHalfSlices(Imf::FrameBuffer &framebuffer,
+    const Image<Rgba32F, TopDown> &, unsigned short *scratch, int width,
+    int xMin, int yMin)
+{
+    unsigned short *base =
+        scratch - 4 * (xMin + static_cast<ptrdiff_t>(yMin) * width);
+    framebuffer.insert("R", newSlice(base+3, 4, 4*width, 0.0, Imf::HALF));
+    framebuffer.insert("G", newSlice(base+2, 4, 4*width, 0.0, Imf::HALF));
+    framebuffer.insert("B", newSlice(base+1, 4, 4*width, 0.0, Imf::HALF));
+    framebuffer.insert("A", newSlice(base,   4, 4*width, 1.0, Imf::HALF));
+}
+
+// Scratch layout for SoA: each scanline has the r, g, b and a runs
+inline void insertHalfSlices(Imf::FrameBuffer &framebuffer,
+    const RGBAImageSoAView &, unsigned short *scratch, int width,
+    int xMin, int yMin)
+{
+    unsigned short *base =
+        scratch - (xMin + 4 * static_cast<ptrdiff_t>(yMin) * width);
+    framebuffer.insert("R", newSlice(base,         1, 4*width, 0.0,Imf::HALF));
+    framebuffer.insert("G", newSlice(base+width,   1, 4*width, 0.0,Imf::HALF));
+    framebuffer.insert("B", newSlice(base+2*width, 1, 4*width, 0.0,Imf::HALF));
+    framebuffer.insert("A", newSlice(base+3*width, 1, 4*width, 1.0,Imf::HALF));
+}
+
+
+// Reverses in place the order of the four halves of each pixel, switching
+// between the r, g, b, a order of Imf::Rgba and the a, b, g, r of Rgba32F
+inline void reverseHalves(Imf::Rgba *pixels, int width)
+{
+    __m128i *ptr = reinterpret_cast<__m128i*>(pixels);
+    int i = 0;
+    for (; i + 2 <= width; i += 2) {
+        __m128i p = _mm_loadu_si128(ptr + i/2);
+        p = _mm_shufflelo_epi16(p, _MM_SHUFFLE(0,1,2,3));
+        p = _mm_shufflehi_epi16(p, _MM_SHUFFLE(0,1,2,3));
+        _mm_storeu_si128(ptr + i/2, p);
+    }
+    if (i < width) {
+        std::swap(pixels[i].r, pixels[i].a);
+        std::swap(pixels[i].g, pixels[i].b);
+    }
+}
+
+// Converts the scanlines from an Imf::Rgba buffer, as read by RgbaInputFile
+inline void convertRgbaScanline(Image<Rgba32F, TopDown> &img, int y,
+    Imf::Rgba *src, std::vector<float> &)
+{
+    reverseHalves(src, img.Width());
+    convertHalfScanline(img, y, reinterpret_cast<unsigned short*>(src));
+}
+
+inline void convertRgbaScanline(const RGBAImageSoAView &img, int y,
+    Imf::Rgba *src, std::vector<float> &buffer)
+{
+    const int width = img.Width();
+    buffer.resize(4 * width);
+    convertHalfToFloat(&buffer[0], reinterpret_cast<unsigned short*>(src),
+        4 * width);
+
+    float* r = img.GetScanlinePointer<RGBAImageSoA::R>(y);
+    float* g = img.GetScanlinePointer<RGBAImageSoA::G>(y);
+    float* b = img.GetScanlinePointer<RGBAImageSoA::B>(y);
+    float* a = img.GetScanlinePointer<RGBAImageSoA::A>(y);
+    for (int i = 0; i < width; ++i) {
+        r[i] = buffer[4*i];
+        g[i] = buffer[4*i + 1];
+        b[i] = buffer[4*i + 2];
+        a[i] = buffer[4*i + 3];
+    }
+}
+
+
+
+// TBB functors to convert a band of scanlines in parallel
+template <class ImageCls>
+class HalfBandFunctor
+{
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    HalfBandFunctor(ImageCls &img, int y0, const unsigned short *scratch) :
+    m_img(img), m_y0(y0), m_scratch(scratch) {}
+
+    void operator() (const Range &range) const {
+        const size_t stride = 4 * m_img.Width();
+        for (int j = range.begin(); j != range.end(); ++j) {
+            convertHalfScanline(m_img, m_y0 + j, m_scratch + j*stride);
+        }
+    }
+
+private:
+    ImageCls &m_img;
+    const int m_y0;
+    const unsigned short *m_scratch;
+};
+
+template <class ImageCls>
+class RgbaBandFunctor
+{
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    RgbaBandFunctor(ImageCls &img, int y0, Imf::Rgba *scratch) :
+    m_img(img), m_y0(y0), m_scratch(scratch) {}
+
+    void operator() (const Range &range) const {
+        std::vector<float> buffer;
+        const size_t stride = m_img.Width();
+        for (int j = range.begin(); j != range.end(); ++j) {
+            convertRgbaScanline(m_img, m_y0 + j, m_scratch + j*stride, buffer);
+        }
+    }
+
+private:
+    ImageCls &m_img;
+    const int m_y0;
+    Imf::Rgba *m_scratch;
+};
+
+
+
+// Allocates the image for the data window. Views are not allocated, they
+// must have the size of the data window instead.
+template <class ImageCls>
+inline void allocImage(ImageCls &img, int width, int height)
+{
     img.Alloc(width, height);
+}
 
-    // Convert everything to full floating point, storing in the top-down order
-    const Imf::Rgba *halfPixel = &halfPixels[0][0];
-    Rgba32F *pixel = img.GetDataPointer();
-    for(int i = 0; i < width*height; ++i) {
-        Rgba32F temp(halfPixel[i].r, halfPixel[i].g, halfPixel[i].b, halfPixel[i].a);
-        pixel[i] = temp;
+inline void allocImage(const RGBAImageSoAView &view, int width, int height)
+{
+    if (view.Width() != width || view.Height() != height) {
+        throw IllegalArgumentException("The size of the view does not match "
+            "the data window of the file");
     }
 }
 
 
 
-// Small function to actually copy the pixels from the already open file into
-// the SoA image
-void ReadImage(RGBAImageSoA &img, Imf::RgbaInputFile &file)
+// Copies the pixels from the already open file into the image. The halves are
+// read by bands into a scratch buffer and then converted in parallel.
+template <class ImageCls>
+void ReadImage(ImageCls &img, Imf::RgbaInputFile &file)
 {
     Imath::Box2i dw = file.dataWindow();
     const int width  = dw.max.x - dw.min.x + 1;
     const int height = dw.max.y - dw.min.y + 1;
 
-    // Memory for reading the all pixels
-    Imf::Array2D<Imf::Rgba> halfPixels(width, height);
-
-    // Read all the pixels from the image
-    file.setFrameBuffer (&halfPixels[0][0], 1, width);
-    file.readPixels (dw.min.y, dw.max.y);	// Ossia, (0, height-1);
-
     // OpenEXR files loaded this way are always organized TopDown according
     // to our point of view
-    img.Alloc(width, height);
+    allocImage(img, width, height);
 
-    // Convert everything to full floating point
-    const Imf::Rgba *halfPixel = &halfPixels[0][0];
-    float* r = img.GetDataPointer<RGBAImageSoA::R>();
-    float* g = img.GetDataPointer<RGBAImageSoA::G>();
-    float* b = img.GetDataPointer<RGBAImageSoA::B>();
-    float* a = img.GetDataPointer<RGBAImageSoA::A>();
-    for(int i = 0; i < width*height; ++i) {
-        r[i] = halfPixel[i].r;
-        g[i] = halfPixel[i].g;
-        b[i] = halfPixel[i].b;
-        a[i] = halfPixel[i].a;
+    const int rows = bandHeight(file.compression(), height);
+    std::vector<Imf::Rgba> scratch(static_cast<size_t>(width) * rows);
+
+    for (int y0 = 0; y0 < height; y0 += rows) {
+        const int bandRows = std::min(rows, height - y0);
+        const ptrdiff_t baseOffset =
+            -(dw.min.x + static_cast<ptrdiff_t>(dw.min.y + y0) * width);
+        file.setFrameBuffer(&scratch[0] + baseOffset, 1, width);
+        file.readPixels(dw.min.y + y0, dw.min.y + y0 + bandRows - 1);
+
+        RgbaBandFunctor<ImageCls> functor(img, y0, &scratch[0]);
+        pcg::concurrency::parallel_for(tbb::blocked_range<int>(0, bandRows),
+            functor, width);
     }
 }
 
 
 
 // Version using the general purpose interface, assumes RGBA channels
-void ReadImage(Image<Rgba32F, TopDown> &img, Imf::InputFile &file)
+void ReadImageFloat(Image<Rgba32F, TopDown> &img, Imf::InputFile &file)
 {
     Imath::Box2i dw = file.header().dataWindow();
     const int width  = dw.max.x - dw.min.x + 1;
-    const int height = dw.max.y - dw.min.y + 1;
 
     // We will read the RGBA data, requesting full floating point values
 
     // Build a framebuffer
     Imf::FrameBuffer framebuffer;
-    img.Alloc(width, height);
     float *pixels = reinterpret_cast<float *>(img.GetDataPointer());
 
     // The code assumes that sizeof(Rgba32F) == 4 * sizeof(float), and that the
@@ -248,7 +560,8 @@ void ReadImage(Image<Rgba32F, TopDown> &img, Imf::InputFile &file)
     //   ptr[1] == pixel.b()
     //   ptr[2] == pixel.g()
     //   ptr[3] == pixel.r()
-    const off_t baseOffset = - 4 * (dw.min.x + dw.min.y*width);
+    const ptrdiff_t baseOffset =
+        - 4 * (dw.min.x + static_cast<ptrdiff_t>(dw.min.y)*width);
     pixels += baseOffset;
 
     framebuffer.insert("R", newSlice(pixels+3, 4, 4*width));
@@ -263,33 +576,33 @@ void ReadImage(Image<Rgba32F, TopDown> &img, Imf::InputFile &file)
 
 
 
-// Version using the general purpose interface, assumes RGBA channels (SoA)
-void ReadImage(RGBAImageSoA &img, Imf::InputFile &file)
+// Version using the general purpose interface, assumes RGBA channels (SoA).
+// The values are read straight into the scanlines of the image or view.
+void ReadImageFloat(const RGBAImageSoAView &img, Imf::InputFile &file)
 {
     Imath::Box2i dw = file.header().dataWindow();
-    const int width  = dw.max.x - dw.min.x + 1;
-    const int height = dw.max.y - dw.min.y + 1;
+    const ptrdiff_t stride = img.Stride();
 
     // We will read the RGBA data, requesting full floating point values
 
     // Build a framebuffer
     Imf::FrameBuffer framebuffer;
-    img.Alloc(width, height);
     float* r = img.GetDataPointer<RGBAImageSoA::R>();
     float* g = img.GetDataPointer<RGBAImageSoA::G>();
     float* b = img.GetDataPointer<RGBAImageSoA::B>();
     float* a = img.GetDataPointer<RGBAImageSoA::A>();
 
-    const off_t baseOffset = - (dw.min.x + dw.min.y*width);
+    const ptrdiff_t baseOffset =
+        - (dw.min.x + static_cast<ptrdiff_t>(dw.min.y)*stride);
     r += baseOffset;
     g += baseOffset;
     b += baseOffset;
     a += baseOffset;
 
-    framebuffer.insert("R", newSlice(r, 1, width));
-    framebuffer.insert("G", newSlice(g, 1, width));
-    framebuffer.insert("B", newSlice(b, 1, width));
-    framebuffer.insert("A", newSlice(a, 1, width, 1.0));
+    framebuffer.insert("R", newSlice(r, 1, stride));
+    framebuffer.insert("G", newSlice(g, 1, stride));
+    framebuffer.insert("B", newSlice(b, 1, stride));
+    framebuffer.insert("A", newSlice(a, 1, stride, 1.0));
 
     // Read all the pixels from the image
     file.setFrameBuffer (framebuffer);
@@ -298,11 +611,60 @@ void ReadImage(RGBAImageSoA &img, Imf::InputFile &file)
 
 
 
+// Returns true if all the RGBA channels present in the file are halves
+inline bool isHalfRGBA(const Imf::ChannelList &channels)
+{
+    const char* names[] = {"R", "G", "B", "A"};
+    for (int i = 0; i < 4; ++i) {
+        const Imf::Channel *c = channels.findChannel(names[i]);
+        if (c != NULL && c->type != Imf::HALF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Version using the general purpose interface, assumes RGBA channels. Half
+// channels are read by bands and converted in parallel, while anything else
+// is converted by OpenEXR directly into the image.
 template <class ImageCls>
-void LoadImpl(ImageCls& img, std::istream &is, int nThreads = 0)
+void ReadImage(ImageCls &img, Imf::InputFile &file)
+{
+    const Imf::Header &header = file.header();
+    Imath::Box2i dw = header.dataWindow();
+    const int width  = dw.max.x - dw.min.x + 1;
+    const int height = dw.max.y - dw.min.y + 1;
+    allocImage(img, width, height);
+
+    if (!isHalfRGBA(header.channels())) {
+        ReadImageFloat(img, file);
+        return;
+    }
+
+    const int rows = bandHeight(header.compression(), height);
+    std::vector<unsigned short> scratch(4 * static_cast<size_t>(width) * rows);
+
+    for (int y0 = 0; y0 < height; y0 += rows) {
+        const int bandRows = std::min(rows, height - y0);
+        Imf::FrameBuffer framebuffer;
+        insertHalfSlices(framebuffer, img, &scratch[0], width,
+            dw.min.x, dw.min.y + y0);
+        file.setFrameBuffer(framebuffer);
+        file.readPixels(dw.min.y + y0, dw.min.y + y0 + bandRows - 1);
+
+        HalfBandFunctor<ImageCls> functor(img, y0, &scratch[0]);
+        pcg::concurrency::parallel_for(tbb::blocked_range<int>(0, bandRows),
+            functor, width);
+    }
+}
+
+
+
+template <class ImageCls>
+void LoadImpl(ImageCls& img, std::istream &is)
 {
     try {
-        IlmThread::ThreadPool::globalThreadPool().setNumThreads(nThreads);
+        initThreadPool();
         StdIStream stdis(is);
         Imf::InputFile file(stdis);
         const Imf::ChannelList & channels = file.header().channels();
@@ -323,10 +685,10 @@ void LoadImpl(ImageCls& img, std::istream &is, int nThreads = 0)
 }
 
 template <class ImageCls>
-void LoadImpl(ImageCls& img,  const char *filename, int nThreads = 0)
+void LoadImpl(ImageCls& img,  const char *filename)
 {
     try {
-        IlmThread::ThreadPool::globalThreadPool().setNumThreads(nThreads);
+        initThreadPool();
         Imf::InputFile file(filename);
         const Imf::ChannelList & channels = file.header().channels();
         const bool isYC = channels.findChannel("Y")  != NULL || 
@@ -412,27 +774,156 @@ inline Imf::RgbaChannels getImfRgbaChannels(OpenEXRIO::RgbaChannels channels)
 
 
 
+// Converts the y-th scanline of the image, in memory order, into halves
+template <ScanLineMode S>
+inline void convertToRgbaScanline(Imf::Rgba *dest,
+    const Image<Rgba32F, S> &img, int y, std::vector<float> &)
+{
+    const float *src = reinterpret_cast<const float*>(
+        img.GetDataPointer() + static_cast<size_t>(y) * img.Width());
+    convertFloatToHalf(reinterpret_cast<unsigned short*>(dest), src,
+        4 * img.Width());
+    reverseHalves(dest, img.Width());
+}
+
+// Converts the y-th scanline of the view, from the top
+inline void convertToRgbaScanline(Imf::Rgba *dest,
+    const ImageView<const Rgba32F> &img, int y, std::vector<float> &)
+{
+    const float *src =
+        reinterpret_cast<const float*>(img.GetScanlinePointer(y));
+    convertFloatToHalf(reinterpret_cast<unsigned short*>(dest), src,
+        4 * img.Width());
+    reverseHalves(dest, img.Width());
+}
+
+inline void convertToRgbaScanline(Imf::Rgba *dest,
+    const ConstRGBAImageSoAView &img, int y, std::vector<float> &buffer)
+{
+    const int width = img.Width();
+    const float *r = img.GetScanlinePointer<RGBAImageSoA::R>(y);
+    const float *g = img.GetScanlinePointer<RGBAImageSoA::G>(y);
+    const float *b = img.GetScanlinePointer<RGBAImageSoA::B>(y);
+    const float *a = img.GetScanlinePointer<RGBAImageSoA::A>(y);
+
+    // Interleave the channels as r, g, b, a then convert them all at once
+    buffer.resize(4 * width);
+    float *pixels = &buffer[0];
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        __m128 p0 = _mm_loadu_ps(r + i);
+        __m128 p1 = _mm_loadu_ps(g + i);
+        __m128 p2 = _mm_loadu_ps(b + i);
+        __m128 p3 = _mm_loadu_ps(a + i);
+        PCG_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        _mm_storeu_ps(pixels + 4*i,      p0);
+        _mm_storeu_ps(pixels + 4*i + 4,  p1);
+        _mm_storeu_ps(pixels + 4*i + 8,  p2);
+        _mm_storeu_ps(pixels + 4*i + 12, p3);
+    }
+    for (; i < width; ++i) {
+        pixels[4*i]     = r[i];
+        pixels[4*i + 1] = g[i];
+        pixels[4*i + 2] = b[i];
+        pixels[4*i + 3] = a[i];
+    }
+    convertFloatToHalf(reinterpret_cast<unsigned short*>(dest), pixels,
+        4 * width);
+}
+
+// TBB functor to convert the scanlines [y0, y0 + range) into halves
+template <class ImageCls>
+class ToHalfFunctor
+{
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    ToHalfFunctor(Imf::Rgba *dest, const ImageCls &img, int y0) :
+    m_dest(dest), m_img(img), m_y0(y0) {}
+
+    void operator() (const Range &range) const {
+        std::vector<float> buffer;
+        const size_t stride = m_img.Width();
+        for (int i = range.begin(); i != range.end(); ++i) {
+            convertToRgbaScanline(m_dest + i*stride, m_img, m_y0 + i, buffer);
+        }
+    }
+
+private:
+    Imf::Rgba *m_dest;
+    const ImageCls &m_img;
+    const int m_y0;
+};
+
+
+
+// Band of consecutive scanlines [y0, y0 + rows) converted into halves
+struct HalfBand
+{
+    std::vector<Imf::Rgba> pixels;
+    int y0;
+    int rows;
+};
+
+// Converts a whole band in parallel
+template <class ImageCls>
+class ConvertBandTask
+{
+public:
+    ConvertBandTask(HalfBand &band, const ImageCls &img) :
+    m_band(band), m_img(img) {}
+
+    void operator() () const {
+        ToHalfFunctor<ImageCls> functor(&m_band.pixels[0], m_img, m_band.y0);
+        pcg::concurrency::parallel_for(
+            tbb::blocked_range<int>(0, m_band.rows), functor, m_img.Width());
+    }
+
+private:
+    HalfBand &m_band;
+    const ImageCls &m_img;
+};
+
+// Submits a band to the output file, which compresses it with its own
+// threads. Errors are recorded instead of being thrown across TBB.
+class WriteBandTask
+{
+public:
+    WriteBandTask(Imf::RgbaOutputFile &file, const HalfBand &band, int width,
+        std::string &error) :
+    m_file(file), m_band(band), m_width(width), m_error(error) {}
+
+    void operator() () const {
+        try {
+            const Imf::Rgba *base = &m_band.pixels[0] -
+                static_cast<ptrdiff_t>(m_band.y0) * m_width;
+            m_file.setFrameBuffer(base, 1, m_width);
+            m_file.writePixels(m_band.rows);
+        }
+        catch (const Iex::BaseExc &e) {
+            m_error = e.what();
+        }
+    }
+
+private:
+    Imf::RgbaOutputFile &m_file;
+    const HalfBand &m_band;
+    const int m_width;
+    std::string &m_error;
+};
+
+
+
 // OStreamArgT should be either const char* or a subclass of Imf::Ostream
-template <typename ImgIterator, class OStreamArgT>
-void SaveImpl(const ImgIterator begin, OStreamArgT &ostreamArg,
-    int width, int height, pcg::ScanLineMode scanlineMode,
-    OpenEXRIO::Compression compression, OpenEXRIO::RgbaChannels rgbaChannels,
-    int nThreads)
+template <class ImageCls, class OStreamArgT>
+void SaveImpl(const ImageCls &img, OStreamArgT &ostreamArg,
+    pcg::ScanLineMode scanlineMode,
+    OpenEXRIO::Compression compression, OpenEXRIO::RgbaChannels rgbaChannels)
 {
+    const int width  = img.Width();
+    const int height = img.Height();
     try {
-        IlmThread::ThreadPool::globalThreadPool().setNumThreads(nThreads);
-
-        // Temporal buffer to convert from our floating point pixels into half
-        Imf::Array2D<Imf::Rgba> halfPixels(width, height);
-        
-        Imf::Rgba *halfPixel = &halfPixels[0][0];
-        ImgIterator pixel = begin;
-        for(int i = 0; i < width*height; ++i, ++pixel, ++halfPixel) {
-            halfPixel->r = pixel->r();
-            halfPixel->g = pixel->g();
-            halfPixel->b = pixel->b();
-            halfPixel->a = pixel->a();
-        }
+        initThreadPool();
 
         // Retrieve the compression type and the scanline order to use
         const Imf::Compression c   = getImfCompression(compression);
@@ -445,20 +936,651 @@ void SaveImpl(const ImgIterator begin, OStreamArgT &ostreamArg,
         // screen window center, screen window width, line order, compression
         Imf::Header hd (width, height, 1.0f, Imath::V2f(0.0f,0.0f), 1.0f, order, c);
         Imf::RgbaOutputFile file(ostreamArg, hd, cn);
-        file.setFrameBuffer(&halfPixels[0][0], 1, width);
-        file.writePixels(height);
+
+        // Instead of converting the whole image into halves, stream bands of
+        // scanlines in the file's line order using two buffers: while the
+        // file compresses and writes one band the next one is converted.
+        const int rows = bandHeight(c, height);
+        const int numBands = (height + rows - 1) / rows;
+        HalfBand bands[2];
+        for (int i = 0; i < 2 && i < numBands; ++i) {
+            bands[i].pixels.resize(static_cast<size_t>(width) * rows);
+        }
+        std::string error;
+
+        for (int i = 0; i < numBands; ++i) {
+            // Bands are numbered in the order in which they are written
+            for (int k = i; k <= i + 1 && k < numBands; ++k) {
+                HalfBand &band = bands[k % 2];
+                if (order == Imf::INCREASING_Y) {
+                    band.y0 = k * rows;
+                    band.rows = std::min(rows, height - band.y0);
+                } else {
+                    const int yEnd = height - k * rows;
+                    band.y0 = std::max(0, yEnd - rows);
+                    band.rows = yEnd - band.y0;
+                }
+            }
+
+            if (i == 0) {
+                ConvertBandTask<ImageCls>(bands[0], img)();
+            }
+            WriteBandTask writeTask(file, bands[i % 2], width, error);
+            if (i + 1 < numBands) {
+                // The file compresses in parallel only when its tasks are
+                // added from an application thread, never from a worker
+                ConvertBandTask<ImageCls> convertTask(bands[(i+1) % 2], img);
+                pcg::concurrency::parallel_invoke_caller(writeTask,
+                    convertTask);
+            } else {
+                writeTask();
+            }
+            if (!error.empty()) {
+                throw IOException(error);
+            }
+        }
     }
     catch (const Iex::BaseExc &e) {
         throw IOException(static_cast<const std::exception&>(e));
     }
 }
 
-} // namespace
 
 
+// Whether the file stores luminance and chroma instead of RGB
+inline bool isLuminanceChroma(const Imf::ChannelList &channels)
+{
+    return channels.findChannel("Y")  != NULL ||
+           channels.findChannel("RY") != NULL ||
+           channels.findChannel("BY") != NULL;
+}
+
+// Number of elements of the scratch buffers used for regions per pixel:
+// the RGBA channels of each scanline are stored as four consecutive runs
+// of halves or floats, while Imf::Rgba already holds the four channels.
+template <typename T>
+inline size_t scratchElements() {
+    return 4;
+}
+
+template <>
+inline size_t scratchElements<Imf::Rgba>() {
+    return 1;
+}
+
+// Sets up the frame buffer of a file so that the pixels in the box are read
+// into the scratch buffer
+template <class FileCls>
+inline void setScratchFrameBuffer(FileCls &file, unsigned short *scratch,
+    const Imath::Box2i &box)
+{
+    const ptrdiff_t width = box.max.x - box.min.x + 1;
+    unsigned short *base = scratch - (box.min.x + box.min.y * 4*width);
+    Imf::FrameBuffer fb;
+    fb.insert("R", newSlice(base,         1, 4*width, 0.0, Imf::HALF));
+    fb.insert("G", newSlice(base+width,   1, 4*width, 0.0, Imf::HALF));
+    fb.insert("B", newSlice(base+2*width, 1, 4*width, 0.0, Imf::HALF));
+    fb.insert("A", newSlice(base+3*width, 1, 4*width, 1.0, Imf::HALF));
+    file.setFrameBuffer(fb);
+}
+
+template <class FileCls>
+inline void setScratchFrameBuffer(FileCls &file, float *scratch,
+    const Imath::Box2i &box)
+{
+    const ptrdiff_t width = box.max.x - box.min.x + 1;
+    float *base = scratch - (box.min.x + box.min.y * 4*width);
+    Imf::FrameBuffer fb;
+    fb.insert("R", newSlice(base,         1, 4*width));
+    fb.insert("G", newSlice(base+width,   1, 4*width));
+    fb.insert("B", newSlice(base+2*width, 1, 4*width));
+    fb.insert("A", newSlice(base+3*width, 1, 4*width, 1.0));
+    file.setFrameBuffer(fb);
+}
+
+template <class FileCls>
+inline void setScratchFrameBuffer(FileCls &file, Imf::Rgba *scratch,
+    const Imath::Box2i &box)
+{
+    const ptrdiff_t width = box.max.x - box.min.x + 1;
+    file.setFrameBuffer(scratch - (box.min.x + box.min.y * width), 1, width);
+}
+
+// Copies into the y-th scanline of the image its pixels from the scratch
+// buffer, given the start of the scanline within the buffer, the number of
+// pixels in each scanline of the buffer and the horizontal offset of the
+// image within them.
+inline void copyRegionScanline(RGBAImageSoA &img, int y,
+    const unsigned short *src, size_t srcWidth, size_t x0, std::vector<float>&)
+{
+    const size_t w = img.Width();
+    src += x0;
+    convertHalfToFloat(img.GetScanlinePointer<RGBAImageSoA::R>(y),
+        src,              w);
+    convertHalfToFloat(img.GetScanlinePointer<RGBAImageSoA::G>(y),
+        src + srcWidth,   w);
+    convertHalfToFloat(img.GetScanlinePointer<RGBAImageSoA::B>(y),
+        src + 2*srcWidth, w);
+    convertHalfToFloat(img.GetScanlinePointer<RGBAImageSoA::A>(y),
+        src + 3*srcWidth, w);
+}
+
+inline void copyRegionScanline(RGBAImageSoA &img, int y,
+    const float *src, size_t srcWidth, size_t x0, std::vector<float>&)
+{
+    const size_t bytes = img.Width() * sizeof(float);
+    src += x0;
+    memcpy(img.GetScanlinePointer<RGBAImageSoA::R>(y), src,              bytes);
+    memcpy(img.GetScanlinePointer<RGBAImageSoA::G>(y), src + srcWidth,   bytes);
+    memcpy(img.GetScanlinePointer<RGBAImageSoA::B>(y), src + 2*srcWidth, bytes);
+    memcpy(img.GetScanlinePointer<RGBAImageSoA::A>(y), src + 3*srcWidth, bytes);
+}
+
+inline void copyRegionScanline(RGBAImageSoA &img, int y,
+    const Imf::Rgba *src, size_t, size_t x0, std::vector<float> &buffer)
+{
+    // The conversion into SoA does not modify the source
+    convertRgbaScanline(img, y, const_cast<Imf::Rgba*>(src + x0), buffer);
+}
+
+// TBB functor to copy the scanlines of the scratch buffer which overlap the
+// region, whose top-left corner is the origin of the image
+template <typename T>
+class RegionCopyFunctor
+{
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    RegionCopyFunctor(RGBAImageSoA &img, const T *scratch,
+        const Imath::Box2i &box, const Imath::Box2i &region) :
+    m_img(img), m_scratch(scratch), m_box(box), m_region(region) {}
+
+    void operator() (const Range &range) const {
+        std::vector<float> buffer;
+        const size_t width = m_box.max.x - m_box.min.x + 1;
+        const size_t x0 = m_region.min.x - m_box.min.x;
+        for (int y = range.begin(); y != range.end(); ++y) {
+            const T *src = m_scratch +
+                (y - m_box.min.y) * scratchElements<T>() * width;
+            copyRegionScanline(m_img, y - m_region.min.y, src, width, x0,
+                buffer);
+        }
+    }
+
+private:
+    RGBAImageSoA &m_img;
+    const T *m_scratch;
+    const Imath::Box2i m_box;
+    const Imath::Box2i m_region;
+};
+
+template <typename T>
+inline void copyRegion(RGBAImageSoA &img, const T *scratch,
+    const Imath::Box2i &box, const Imath::Box2i &region)
+{
+    const int y0 = std::max(box.min.y, region.min.y);
+    const int y1 = std::min(box.max.y, region.max.y);
+    RegionCopyFunctor<T> functor(img, scratch, box, region);
+    pcg::concurrency::parallel_for(tbb::blocked_range<int>(y0, y1 + 1),
+        functor, img.Width());
+}
+
+
+
+// Reads a region, in data window coordinates, of a scanline file. The file
+// writes whole scanlines, so they are read by bands into a scratch buffer.
+template <typename T, class FileCls>
+void ReadRegionScanlines(RGBAImageSoA &img, FileCls &file,
+    const Imath::Box2i &region)
+{
+    const Imath::Box2i &dw = file.header().dataWindow();
+    const size_t width = dw.max.x - dw.min.x + 1;
+    const int rows = bandHeight(file.header().compression(),
+        region.max.y - region.min.y + 1);
+    std::vector<T> scratch(scratchElements<T>() * width * rows);
+
+    for (int y0 = region.min.y; y0 <= region.max.y; y0 += rows) {
+        const Imath::Box2i box(Imath::V2i(dw.min.x, y0),
+            Imath::V2i(dw.max.x, std::min(y0 + rows - 1, region.max.y)));
+        setScratchFrameBuffer(file, &scratch[0], box);
+        file.readPixels(box.min.y, box.max.y);
+        copyRegion(img, &scratch[0], box, region);
+    }
+}
+
+// Reads a region, in data window coordinates of the level, of a tiled file.
+// Only the tiles which overlap the region are read, by rows of tiles.
+template <typename T, class FileCls>
+void ReadRegionTiles(RGBAImageSoA &img, FileCls &file,
+    const Imath::Box2i &region, int lx, int ly)
+{
+    const Imath::Box2i dw = file.dataWindowForLevel(lx, ly);
+    const int tileWidth  = file.tileXSize();
+    const int tileHeight = file.tileYSize();
+    const int tx0 = (region.min.x - dw.min.x) / tileWidth;
+    const int tx1 = (region.max.x - dw.min.x) / tileWidth;
+    const int ty0 = (region.min.y - dw.min.y) / tileHeight;
+    const int ty1 = (region.max.y - dw.min.y) / tileHeight;
+
+    // Read enough tiles at once to keep the OpenEXR threads busy
+    const int tilesPerRow = tx1 - tx0 + 1;
+    const int tileRows = tileRowsInFlight(tilesPerRow);
+    std::vector<T> scratch(scratchElements<T>() *
+        static_cast<size_t>(tilesPerRow) * tileWidth * tileRows * tileHeight);
+
+    for (int ty = ty0; ty <= ty1; ty += tileRows) {
+        const int tyEnd = std::min(ty + tileRows - 1, ty1);
+        const Imath::Box2i box(file.dataWindowForTile(tx0, ty, lx, ly).min,
+            file.dataWindowForTile(tx1, tyEnd, lx, ly).max);
+        setScratchFrameBuffer(file, &scratch[0], box);
+        file.readTiles(tx0, tx1, ty, tyEnd, lx, ly);
+        copyRegion(img, &scratch[0], box, region);
+    }
+}
+
+
+
+// Resolution levels of an OpenEXR file, scanline or tiled, which is opened
+// only once: the queries and the reads all go through the same file.
+class LevelFile
+{
+public:
+    explicit LevelFile(const char *filename) :
+    m_stream(checkFilename(filename)), m_isTiled(false), m_isYC(false),
+    m_tiled(NULL), m_tiledRgba(NULL), m_scanline(NULL), m_scanlineRgba(NULL)
+    {
+        try {
+            m_isTiled = Imf::isTiledOpenExrFile(m_stream);
+            if (m_isTiled) {
+                m_tiled = new Imf::TiledInputFile(m_stream);
+                m_isYC = isLuminanceChroma(m_tiled->header().channels());
+            } else {
+                m_scanline = new Imf::InputFile(m_stream);
+                m_isYC = isLuminanceChroma(m_scanline->header().channels());
+            }
+
+            // The luminance/chroma files are read through the RGBA interface,
+            // created anew over the same stream
+            if (m_isYC) {
+                delete m_tiled;
+                delete m_scanline;
+                m_tiled = NULL;
+                m_scanline = NULL;
+                m_stream.clear();
+                m_stream.seekg(0);
+                if (m_isTiled) {
+                    m_tiledRgba = new Imf::TiledRgbaInputFile(m_stream);
+                } else {
+                    m_scanlineRgba = new Imf::RgbaInputFile(m_stream);
+                }
+            }
+        }
+        catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    ~LevelFile() {
+        release();
+    }
+
+    int numXLevels() const {
+        return m_tiled != NULL ? m_tiled->numXLevels() :
+            (m_tiledRgba != NULL ? m_tiledRgba->numXLevels() : 1);
+    }
+
+    int numYLevels() const {
+        return m_tiled != NULL ? m_tiled->numYLevels() :
+            (m_tiledRgba != NULL ? m_tiledRgba->numYLevels() : 1);
+    }
+
+    // Data window of the level (lx,ly), it throws IllegalArgumentException
+    // if the file does not have such level
+    Imath::Box2i dataWindow(int lx, int ly) const
+    {
+        if (lx < 0 || ly < 0 || lx >= numXLevels() || ly >= numYLevels()) {
+            throw IllegalArgumentException("Invalid resolution level.");
+        }
+        Imath::Box2i dw;
+        if (m_tiled != NULL) {
+            if (m_tiled->isValidLevel(lx, ly)) {
+                dw = m_tiled->dataWindowForLevel(lx, ly);
+            }
+        } else if (m_tiledRgba != NULL) {
+            if (m_tiledRgba->isValidLevel(lx, ly)) {
+                dw = m_tiledRgba->dataWindowForLevel(lx, ly);
+            }
+        } else if (m_scanline != NULL) {
+            dw = m_scanline->header().dataWindow();
+        } else {
+            dw = m_scanlineRgba->dataWindow();
+        }
+        if (dw.isEmpty()) {
+            throw IllegalArgumentException("Invalid resolution level.");
+        }
+        return dw;
+    }
+
+    // Loads a region given relative to the top-left corner of the level
+    void readRegion(RGBAImageSoA &img, int x, int y, int width, int height,
+        int lx, int ly)
+    {
+        const Imath::Box2i dw = dataWindow(lx, ly);
+        if (width <= 0 || height <= 0 || x < 0 || y < 0 ||
+            x + width  > dw.max.x - dw.min.x + 1 ||
+            y + height > dw.max.y - dw.min.y + 1) {
+            throw IllegalArgumentException("The region is not within the "
+                "resolution level.");
+        }
+        const Imath::Box2i region(Imath::V2i(dw.min.x + x, dw.min.y + y),
+            Imath::V2i(dw.min.x + x + width - 1, dw.min.y + y + height - 1));
+        img.Alloc(width, height);
+
+        if (m_tiledRgba != NULL) {
+            ReadRegionTiles<Imf::Rgba>(img, *m_tiledRgba, region, lx, ly);
+        } else if (m_tiled != NULL) {
+            if (isHalfRGBA(m_tiled->header().channels())) {
+                ReadRegionTiles<unsigned short>(img, *m_tiled, region, lx, ly);
+            } else {
+                ReadRegionTiles<float>(img, *m_tiled, region, lx, ly);
+            }
+        } else if (m_scanlineRgba != NULL) {
+            ReadRegionScanlines<Imf::Rgba>(img, *m_scanlineRgba, region);
+        } else if (isHalfRGBA(m_scanline->header().channels())) {
+            ReadRegionScanlines<unsigned short>(img, *m_scanline, region);
+        } else {
+            ReadRegionScanlines<float>(img, *m_scanline, region);
+        }
+    }
+
+private:
+    // Non-copyable
+    LevelFile(const LevelFile&);
+    LevelFile& operator= (const LevelFile&);
+
+    static const char* checkFilename(const char *filename) {
+        if (filename == NULL) {
+            throw IllegalArgumentException("The filename cannot be null.");
+        }
+        return filename;
+    }
+
+    void release() {
+        delete m_tiled;
+        delete m_tiledRgba;
+        delete m_scanline;
+        delete m_scanlineRgba;
+        m_tiled = NULL;
+        m_tiledRgba = NULL;
+        m_scanline = NULL;
+        m_scanlineRgba = NULL;
+    }
+
+    Imf::StdIFStream m_stream;
+    bool m_isTiled;
+    bool m_isYC;
+    Imf::TiledInputFile *m_tiled;
+    Imf::TiledRgbaInputFile *m_tiledRgba;
+    Imf::InputFile *m_scanline;
+    Imf::RgbaInputFile *m_scanlineRgba;
+};
+
+void LoadRegionImpl(RGBAImageSoA &img, const char *filename,
+    int x, int y, int width, int height, int lx, int ly)
+{
+    try {
+        initThreadPool();
+        LevelFile file(filename);
+        file.readRegion(img, x, y, width, height, lx, ly);
+    }
+    catch (const Iex::BaseExc &e) {
+        throw IOException(static_cast<const std::exception&>(e));
+    }
+}
+
+
+
+// Copies the pixels of a window from a scanline of the scratch buffer into
+// the j-th scanline of the image, given the number of pixels in each
+// scanline of the buffer. Only the selected pixels are converted.
+template <class ImageCls>
+inline void copyWindowScanline(ImageCls &img, int j, const unsigned short *src,
+    size_t srcWidth, const LoadWindow &window,
+    std::vector<unsigned short> &halves, std::vector<float> &buffer)
+{
+    const size_t w = img.Width();
+    for (int c = 0; c < 4; ++c) {
+        const unsigned short *channel = src + c*srcWidth + window.x;
+        for (size_t i = 0; i < w; ++i) {
+            halves[c*w + i] = channel[i * window.step];
+        }
+    }
+    convertHalfToFloat(&buffer[0], &halves[0], 4 * w);
+    storeWindowScanline(img, j, &buffer[0], &buffer[w], &buffer[2*w],
+        &buffer[3*w], 1);
+}
+
+template <class ImageCls>
+inline void copyWindowScanline(ImageCls &img, int j, const float *src,
+    size_t srcWidth, const LoadWindow &window,
+    std::vector<unsigned short> &, std::vector<float> &)
+{
+    src += window.x;
+    storeWindowScanline(img, j, src, src + srcWidth, src + 2*srcWidth,
+        src + 3*srcWidth, window.step);
+}
+
+template <class ImageCls>
+inline void copyWindowScanline(ImageCls &img, int j, const Imf::Rgba *src,
+    size_t, const LoadWindow &window,
+    std::vector<unsigned short> &halves, std::vector<float> &buffer)
+{
+    const size_t w = img.Width();
+    src += window.x;
+    for (size_t i = 0; i < w; ++i) {
+        memcpy(&halves[4*i], src + i * window.step, sizeof(Imf::Rgba));
+    }
+    convertHalfToFloat(&buffer[0], &halves[0], 4 * w);
+    storeWindowScanline(img, j, &buffer[0], &buffer[1], &buffer[2],
+        &buffer[3], 4);
+}
+
+// TBB functor to copy the scanlines of a window from the scratch buffer,
+// whose first scanline is the scanline y0 of the window's coordinates
+template <typename T, class ImageCls>
+class WindowCopyFunctor
+{
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    WindowCopyFunctor(ImageCls &img, const T *scratch, size_t width,
+        const LoadWindow &window, int y0) :
+    m_img(img), m_scratch(scratch), m_width(width), m_window(window),
+    m_y0(y0) {}
+
+    void operator() (const Range &range) const {
+        std::vector<unsigned short> halves(4 * m_img.Width());
+        std::vector<float> buffer(4 * m_img.Width());
+        for (int j = range.begin(); j != range.end(); ++j) {
+            const T *src = m_scratch + (m_window.sourceY(j) - m_y0) *
+                scratchElements<T>() * m_width;
+            copyWindowScanline(m_img, j, src, m_width, m_window,
+                halves, buffer);
+        }
+    }
+
+private:
+    ImageCls &m_img;
+    const T *m_scratch;
+    const size_t m_width;
+    const LoadWindow &m_window;
+    const int m_y0;
+};
+
+// Reads a window, relative to the top-left corner of the data window. When
+// the step is smaller than the scanlines per block every block has to be
+// decompressed anyway, so the scanlines are read by bands; otherwise each
+// scanline of the window is read on its own, skipping the other blocks.
+template <typename T, class ImageCls, class FileCls>
+void ReadWindow(ImageCls &img, FileCls &file, const LoadWindow &window)
+{
+    const Imath::Box2i &dw = file.header().dataWindow();
+    const Imf::Compression compression = file.header().compression();
+    const size_t width = dw.max.x - dw.min.x + 1;
+    const int lastRow = window.sourceY(img.Height() - 1);
+    const int rows = window.step <= linesPerBlock(compression) ?
+        bandHeight(compression, lastRow - window.y + 1) : 1;
+    std::vector<T> scratch(scratchElements<T>() * width * rows);
+
+    for (int j = 0; j < img.Height(); ) {
+        const int y0 = window.sourceY(j);
+        const int y1 = std::min(y0 + rows - 1, lastRow);
+        const Imath::Box2i box(Imath::V2i(dw.min.x, dw.min.y + y0),
+            Imath::V2i(dw.max.x, dw.min.y + y1));
+        setScratchFrameBuffer(file, &scratch[0], box);
+        file.readPixels(box.min.y, box.max.y);
+
+        const int jEnd = (y1 - window.y) / window.step + 1;
+        WindowCopyFunctor<T, ImageCls> functor(img, &scratch[0], width,
+            window, y0);
+        pcg::concurrency::parallel_for(tbb::blocked_range<int>(j, jEnd),
+            functor, img.Width());
+        j = jEnd;
+    }
+}
+
+template <class ImageCls>
+void LoadWindowImpl(ImageCls &img, std::istream &is,
+    const LoadWindow &window)
+{
+    try {
+        initThreadPool();
+        StdIStream stdis(is);
+        Imf::InputFile file(stdis);
+        const Imath::Box2i &dw = file.header().dataWindow();
+        const LoadWindow w = window.resolve(dw.max.x - dw.min.x + 1,
+            dw.max.y - dw.min.y + 1);
+        img.Alloc(w.outputWidth(), w.outputHeight());
+
+        const Imf::ChannelList &channels = file.header().channels();
+        if (isLuminanceChroma(channels)) {
+            stdis.seekg(0);
+            Imf::RgbaInputFile ycFile(stdis);
+            ReadWindow<Imf::Rgba>(img, ycFile, w);
+        } else if (isHalfRGBA(channels)) {
+            ReadWindow<unsigned short>(img, file, w);
+        } else {
+            ReadWindow<float>(img, file, w);
+        }
+    }
+    catch (const Iex::BaseExc &e) {
+        throw IOException(static_cast<const std::exception&>(e));
+    }
+}
+
+
+
+// Converts a resolution level into halves and writes it by rows of tiles
+void WriteLevel(Imf::TiledRgbaOutputFile &file, const RGBAImageSoA &img,
+    int lx, int ly)
+{
+    const int width = img.Width();
+    const int tileHeight = file.tileYSize();
+    const int tilesPerRow = file.numXTiles(lx);
+    const int numTileRows = file.numYTiles(ly);
+    const int tileRows = tileRowsInFlight(tilesPerRow);
+    const int rows = std::min(tileRows * tileHeight, img.Height());
+
+    HalfBand band;
+    band.pixels.resize(static_cast<size_t>(width) * rows);
+    for (int ty = 0; ty < numTileRows; ty += tileRows) {
+        const int tyEnd = std::min(ty + tileRows, numTileRows) - 1;
+        band.y0 = ty * tileHeight;
+        band.rows = std::min(img.Height(), (tyEnd + 1) * tileHeight) - band.y0;
+        ConvertBandTask<RGBAImageSoA>(band, img)();
+
+        file.setFrameBuffer(&band.pixels[0] -
+            static_cast<ptrdiff_t>(band.y0) * width, 1, width);
+        file.writeTiles(0, tilesPerRow - 1, ty, tyEnd, lx, ly);
+    }
+}
+
+// Writes all the levels in the order expected by the file, generating each
+// level from the previous one
+template <class OStreamArgT>
+void SaveTiledImpl(const RGBAImageSoA &img, OStreamArgT &ostreamArg,
+    int tileWidth, int tileHeight, OpenEXRIO::LevelMode levelMode,
+    Downsampler::Filter filter, OpenEXRIO::Compression compression,
+    OpenEXRIO::RgbaChannels rgbaChannels)
+{
+    if (tileWidth <= 0 || tileHeight <= 0) {
+        throw IllegalArgumentException("Invalid tile size.");
+    }
+    if (rgbaChannels == OpenEXRIO::WRITE_YC ||
+        rgbaChannels == OpenEXRIO::WRITE_YCA) {
+        throw IllegalArgumentException("Tiled files do not support "
+            "subsampled chroma channels.");
+    }
+    try {
+        initThreadPool();
+
+        const Imf::Compression c   = getImfCompression(compression);
+        const Imf::RgbaChannels cn = getImfRgbaChannels(rgbaChannels);
+        const Imf::LevelMode mode = levelMode == OpenEXRIO::MIPMAP_LEVELS ?
+            Imf::MIPMAP_LEVELS : (levelMode == OpenEXRIO::RIPMAP_LEVELS ?
+            Imf::RIPMAP_LEVELS : Imf::ONE_LEVEL);
+
+        Imf::Header hd (img.Width(), img.Height(), 1.0f,
+            Imath::V2f(0.0f,0.0f), 1.0f, Imf::INCREASING_Y, c);
+        Imf::TiledRgbaOutputFile file(ostreamArg, hd, cn,
+            tileWidth, tileHeight, mode, Imf::ROUND_DOWN);
+
+        if (mode != Imf::RIPMAP_LEVELS) {
+            const RGBAImageSoA *level = &img;
+            RGBAImageSoA levels[2];
+            for (int l = 0; l < file.numLevels(); ++l) {
+                if (l > 0) {
+                    RGBAImageSoA &next = levels[l % 2];
+                    next.Alloc(file.levelWidth(l), file.levelHeight(l));
+                    Downsampler::Downsample(*level, next, filter);
+                    level = &next;
+                }
+                WriteLevel(file, *level, l, l);
+            }
+        } else {
+            // Each row of levels starts by reducing the height of the first
+            // level of the previous row, then reduces the width
+            const RGBAImageSoA *rowStart = &img;
+            RGBAImageSoA rowStarts[2], levels[2];
+            for (int ly = 0; ly < file.numYLevels(); ++ly) {
+                if (ly > 0) {
+                    RGBAImageSoA &next = rowStarts[ly % 2];
+                    next.Alloc(file.levelWidth(0), file.levelHeight(ly));
+                    Downsampler::Downsample(*rowStart, next, filter);
+                    rowStart = &next;
+                }
+                const RGBAImageSoA *level = rowStart;
+                for (int lx = 0; lx < file.numXLevels(); ++lx) {
+                    if (lx > 0) {
+                        RGBAImageSoA &next = levels[lx % 2];
+                        next.Alloc(file.levelWidth(lx), file.levelHeight(ly));
+                        Downsampler::Downsample(*level, next, filter);
+                        level = &next;
+                    }
+                    WriteLevel(file, *level, lx, ly);
+                }
+            }
+        }
+    }
+    catch (const Iex::BaseExc &e) {
+        throw IOException(static_cast<const std::exception&>(e));
+    }
+}
+
+} // namespace
 
 
-int OpenEXRIO::numThreads = tbb::task_scheduler_init::default_num_threads();
 
 
 void OpenEXRIO::setNumThreads(int num)
@@ -467,32 +1589,49 @@ void OpenEXRIO::setNumThreads(int num)
         throw IllegalArgumentException("The number of threads for OpenEXR IO "
             "cannot be negative.");
     }
-    numThreads = num;
+    Concurrency::SetMaxThreads(std::max(1, num));
 }
 
 
 void OpenEXRIO::LoadHelper(Image<Rgba32F, TopDown> &img,  const char *filename){
-    LoadImpl(img, filename, numThreads);
+    LoadImpl(img, filename);
 }
 
 void OpenEXRIO::LoadHelper(Image<Rgba32F, TopDown> &img,  std::istream &is) {
-    LoadImpl(img, is, numThreads);
+    LoadImpl(img, is);
 }
 
 void OpenEXRIO::Load(RGBAImageSoA& img, const char* filename) {
-    LoadImpl(img, filename, numThreads);
+    LoadImpl(img, filename);
+}
+
+void OpenEXRIO::Load(const RGBAImageSoAView& img, const char* filename) {
+    LoadImpl(img, filename);
+}
+
+void OpenEXRIO::Load(const RGBAImageSoAView& img, std::istream& is) {
+    LoadImpl(img, is);
 }
 
 void OpenEXRIO::Load(RGBAImageSoA& img, std::istream& is) {
-    LoadImpl(img, is, numThreads);
+    LoadImpl(img, is);
+}
+
+void OpenEXRIO::Load(Image<Rgba32F, TopDown> &img, std::istream &is,
+    const LoadWindow &window) {
+    LoadWindowImpl(img, is, window);
+}
+
+void OpenEXRIO::Load(RGBAImageSoA& img, std::istream& is,
+    const LoadWindow& window) {
+    LoadWindowImpl(img, is, window);
 }
 
 
 template<ScanLineMode S, class OStreamArgT>
 void OpenEXRIO::SaveHelper(const Image<Rgba32F, S> &img,  OStreamArgT &ostreamArg,
     Compression compression, RgbaChannels rgbaChannels) {
-    SaveImpl(img.GetDataPointer(), ostreamArg, img.Width(), img.Height(),
-        S, compression, rgbaChannels, numThreads);
+    SaveImpl(img, ostreamArg, S, compression, rgbaChannels);
 }
 
 
@@ -538,13 +1677,147 @@ void OpenEXRIO::Save(const Image<Rgba32F, BottomUp> &img, const char *filename,
 void OpenEXRIO::Save(const RGBAImageSoA& img, std::ofstream &os,
     RgbaChannels rgbaChannels, Compression compression) {
     StdOFStream stdos(os);
-    RGBA32FScalarImageSoAIterator it=RGBA32FScalarImageSoAIterator::begin(img);
-    SaveImpl(it, stdos, img.Width(), img.Height(), img.GetMode(),
-        compression, rgbaChannels, numThreads);
+    SaveImpl(img, stdos, img.GetMode(), compression, rgbaChannels);
 }
 void OpenEXRIO::Save(const RGBAImageSoA& img, const char* filename,
     RgbaChannels rgbaChannels, Compression compression) {
-    RGBA32FScalarImageSoAIterator it=RGBA32FScalarImageSoAIterator::begin(img);
-    SaveImpl(it, filename, img.Width(), img.Height(), img.GetMode(),
-        compression, rgbaChannels, numThreads);
+    SaveImpl(img, filename, img.GetMode(), compression, rgbaChannels);
+}
+
+void OpenEXRIO::Save(const ImageView<const Rgba32F>& img, std::ofstream &os,
+    RgbaChannels rgbaChannels, Compression compression) {
+    StdOFStream stdos(os);
+    SaveImpl(img, stdos, TopDown, compression, rgbaChannels);
+}
+void OpenEXRIO::Save(const ImageView<const Rgba32F>& img, const char* filename,
+    RgbaChannels rgbaChannels, Compression compression) {
+    SaveImpl(img, filename, TopDown, compression, rgbaChannels);
+}
+
+void OpenEXRIO::Save(const ConstRGBAImageSoAView& img, std::ofstream &os,
+    RgbaChannels rgbaChannels, Compression compression) {
+    StdOFStream stdos(os);
+    SaveImpl(img, stdos, TopDown, compression, rgbaChannels);
+}
+void OpenEXRIO::Save(const ConstRGBAImageSoAView& img, const char* filename,
+    RgbaChannels rgbaChannels, Compression compression) {
+    SaveImpl(img, filename, TopDown, compression, rgbaChannels);
+}
+
+
+
+void OpenEXRIO::SaveTiled(const RGBAImageSoA& img, std::ofstream &os,
+    int tileWidth, int tileHeight, LevelMode levelMode,
+    Downsampler::Filter filter, RgbaChannels rgbaChannels,
+    Compression compression) {
+    StdOFStream stdos(os);
+    SaveTiledImpl(img, stdos, tileWidth, tileHeight, levelMode, filter,
+        compression, rgbaChannels);
+}
+void OpenEXRIO::SaveTiled(const RGBAImageSoA& img, const char* filename,
+    int tileWidth, int tileHeight, LevelMode levelMode,
+    Downsampler::Filter filter, RgbaChannels rgbaChannels,
+    Compression compression) {
+    SaveTiledImpl(img, filename, tileWidth, tileHeight, levelMode, filter,
+        compression, rgbaChannels);
+}
+
+
+void OpenEXRIO::GetNumLevels(const char* filename,
+    int& numXLevels, int& numYLevels) {
+    try {
+        const LevelFile file(filename);
+        numXLevels = file.numXLevels();
+        numYLevels = file.numYLevels();
+    }
+    catch (const Iex::BaseExc &e) {
+        throw IOException(static_cast<const std::exception&>(e));
+    }
+}
+
+void OpenEXRIO::GetLevelSize(const char* filename, int lx, int ly,
+    int& width, int& height) {
+    try {
+        const LevelFile file(filename);
+        const Imath::Box2i dw = file.dataWindow(lx, ly);
+        width  = dw.max.x - dw.min.x + 1;
+        height = dw.max.y - dw.min.y + 1;
+    }
+    catch (const Iex::BaseExc &e) {
+        throw IOException(static_cast<const std::exception&>(e));
+    }
+}
+
+void OpenEXRIO::LoadLevel(RGBAImageSoA& img, const char* filename,
+    int lx, int ly) {
+    try {
+        initThreadPool();
+        LevelFile file(filename);
+        const Imath::Box2i dw = file.dataWindow(lx, ly);
+        file.readRegion(img, 0, 0, dw.max.x - dw.min.x + 1,
+            dw.max.y - dw.min.y + 1, lx, ly);
+    }
+    catch (const Iex::BaseExc &e) {
+        throw IOException(static_cast<const std::exception&>(e));
+    }
+}
+
+void OpenEXRIO::LoadRegion(RGBAImageSoA& img, const char* filename,
+    int x, int y, int width, int height, int lx, int ly) {
+    LoadRegionImpl(img, filename, x, y, width, height, lx, ly);
+}
+
+
+
+struct pcg::openexrio_internal::RegionReader::Impl
+{
+    LevelFile file;
+    int width;
+    int height;
+
+    explicit Impl(const char *filename) : file(filename), width(0), height(0)
+    {}
+};
+
+
+pcg::openexrio_internal::RegionReader::RegionReader(const char *filename) :
+m_impl(NULL)
+{
+    try {
+        m_impl = new Impl(filename);
+        const Imath::Box2i dw = m_impl->file.dataWindow(0, 0);
+        m_impl->width  = dw.max.x - dw.min.x + 1;
+        m_impl->height = dw.max.y - dw.min.y + 1;
+    }
+    catch (const Iex::BaseExc &e) {
+        delete m_impl;
+        throw IOException(static_cast<const std::exception&>(e));
+    }
+}
+
+pcg::openexrio_internal::RegionReader::~RegionReader()
+{
+    delete m_impl;
+}
+
+int pcg::openexrio_internal::RegionReader::width() const
+{
+    return m_impl->width;
+}
+
+int pcg::openexrio_internal::RegionReader::height() const
+{
+    return m_impl->height;
+}
+
+void pcg::openexrio_internal::RegionReader::read(RGBAImageSoA &img,
+    int x, int y, int width, int height)
+{
+    try {
+        initThreadPool();
+        m_impl->file.readRegion(img, x, y, width, height, 0, 0);
+    }
+    catch (const Iex::BaseExc &e) {
+        throw IOException(static_cast<const std::exception&>(e));
+    }
 }
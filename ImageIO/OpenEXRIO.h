@@ -24,6 +24,9 @@
 #include "Image.h"
 #include "Rgba32F.h"
 #include "ImageSoA.h"
+#include "ImageView.h"
+#include "Downsampler.h"
+#include "LoadWindow.h"
 
 #include <istream>
 
@@ -61,6 +64,14 @@ namespace pcg {
             WRITE_YA    // Luminance, alpha
         };
 
+        // Resolution levels stored in tiled files. The size of each level is
+        // half the size of the previous one, rounded down.
+        enum LevelMode {
+            ONE_LEVEL,
+            MIPMAP_LEVELS,  // Levels reduced in both dimensions at once
+            RIPMAP_LEVELS   // Levels reduced in each dimension independently
+        };
+
         static void Load(Image<Rgba32F, TopDown> &img, const char *filename) {
             LoadHelper(img, filename);
         }
@@ -91,6 +102,22 @@ namespace pcg {
 
         static void IMAGEIO_API Load(RGBAImageSoA& img, const char* filename);
 
+        // Loads the file into the pixels of a view, such as a region of a
+        // larger image. The view must have the size of the data window of the
+        // file, otherwise it throws IllegalArgumentException.
+        static void IMAGEIO_API Load(const RGBAImageSoAView& img,
+            std::istream& is);
+        static void IMAGEIO_API Load(const RGBAImageSoAView& img,
+            const char* filename);
+
+        // Loads a window of pixels of the data window, subsampled by an
+        // integer step. Only the scanlines of the window are read, and all
+        // of their blocks only when the step is smaller than the block.
+        static void IMAGEIO_API Load(Image<Rgba32F, TopDown> &img,
+            std::istream &is, const LoadWindow &window);
+        static void IMAGEIO_API Load(RGBAImageSoA& img, std::istream& is,
+            const LoadWindow& window);
+
         // To save the images with a different scanline order we only set a flag!
         static void IMAGEIO_API Save(const Image<Rgba32F, TopDown> &img, std::ofstream& os,
             Compression compression = ZIP);
@@ -125,7 +152,62 @@ namespace pcg {
             Save(img, filename, WRITE_RGB, ZIP);
         }
 
-        // Lazily set the number of threads to use for OpenEXR IO
+        // Save the pixels of views, in top-down order
+        static void IMAGEIO_API Save(const ImageView<const Rgba32F>& img,
+            std::ofstream& os, RgbaChannels rgbaChannels,
+            Compression compression = ZIP);
+        static void IMAGEIO_API Save(const ImageView<const Rgba32F>& img,
+            const char* filename, RgbaChannels rgbaChannels,
+            Compression compression = ZIP);
+        static void IMAGEIO_API Save(const ConstRGBAImageSoAView& img,
+            std::ofstream& os, RgbaChannels rgbaChannels,
+            Compression compression = ZIP);
+        static void IMAGEIO_API Save(const ConstRGBAImageSoAView& img,
+            const char* filename, RgbaChannels rgbaChannels,
+            Compression compression = ZIP);
+
+        // Save SoA images as tiled files, with tiles of the given size. The
+        // lower resolution levels of mipmaps and ripmaps are generated with
+        // the given filter. Tiled files do not support subsampled chroma,
+        // thus WRITE_YC and WRITE_YCA throw an IllegalArgumentException.
+        static void IMAGEIO_API SaveTiled(const RGBAImageSoA& img,
+            std::ofstream& os, int tileWidth, int tileHeight,
+            LevelMode levelMode = ONE_LEVEL,
+            Downsampler::Filter filter = Downsampler::BOX,
+            RgbaChannels rgbaChannels = WRITE_RGBA,
+            Compression compression = ZIP);
+        static void IMAGEIO_API SaveTiled(const RGBAImageSoA& img,
+            const char* filename, int tileWidth, int tileHeight,
+            LevelMode levelMode = ONE_LEVEL,
+            Downsampler::Filter filter = Downsampler::BOX,
+            RgbaChannels rgbaChannels = WRITE_RGBA,
+            Compression compression = ZIP);
+
+        // Number of resolution levels along each dimension. Scanline files
+        // and tiled files without levels only have the level (0,0), and the
+        // levels of mipmaps always have lx == ly.
+        static void IMAGEIO_API GetNumLevels(const char* filename,
+            int& numXLevels, int& numYLevels);
+
+        // Dimensions of the resolution level (lx,ly)
+        static void IMAGEIO_API GetLevelSize(const char* filename,
+            int lx, int ly, int& width, int& height);
+
+        // Loads the whole resolution level (lx,ly) of a file
+        static void IMAGEIO_API LoadLevel(RGBAImageSoA& img,
+            const char* filename, int lx, int ly);
+
+        // Loads the region of width x height pixels of the level (lx,ly)
+        // whose top-left corner is the pixel (x,y) of that level, with the
+        // origin at its top-left corner. Only the tiles or scanlines which
+        // overlap the region are read from the file.
+        static void IMAGEIO_API LoadRegion(RGBAImageSoA& img,
+            const char* filename, int x, int y, int width, int height,
+            int lx = 0, int ly = 0);
+
+        // Sets the number of threads, which is the same process-wide setting
+        // as Concurrency::SetMaxThreads. Zero, which used to decode the files
+        // serially, is the same as one.
         static void IMAGEIO_API setNumThreads(int num);
 
     private:
@@ -136,8 +218,6 @@ namespace pcg {
         template <ScanLineMode S, class OStreamArgT>
         static void SaveHelper(const Image<Rgba32F, S> &image, OStreamArgT &ostreamArg,
             Compression compression, RgbaChannels rgbaChannels);
-        
-        static int numThreads;
     };
 }
 
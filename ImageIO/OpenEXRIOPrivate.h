@@ -0,0 +1,55 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Internal definitions for OpenEXR files IO, which should not be known outside
+
+#if !defined(PCG_OPENEXRIOPRIVATE_H)
+#define PCG_OPENEXRIOPRIVATE_H
+
+#include "ImageSoA.h"
+
+namespace pcg
+{
+namespace openexrio_internal
+{
+
+// Reads regions of the level (0,0) of an OpenEXR file into SoA images. The
+// file is opened once by the constructor, which throws IOException if it is
+// not valid, and stays open until the reader is destroyed.
+class RegionReader
+{
+public:
+    explicit RegionReader(const char *filename);
+    ~RegionReader();
+
+    int width() const;
+    int height() const;
+
+    // Loads the region of width x height pixels whose top-left corner is
+    // the pixel (x,y), with the origin at the top-left corner of the image
+    void read(RGBAImageSoA &img, int x, int y, int width, int height);
+
+private:
+    RegionReader(const RegionReader&);
+    RegionReader& operator=(const RegionReader&);
+
+    struct Impl;
+    Impl *m_impl;
+};
+
+} // namespace openexrio_internal
+} // namespace pcg
+
+#endif /* PCG_OPENEXRIOPRIVATE_H */
@@ -14,13 +14,21 @@
 ============================================================================*/
 
 #include "PfmIO.h"
+#include "ConcurrencyPrivate.h"
+#include "MappedFile.h"
+#include "LoadWindowPrivate.h"
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <cstring>
 #include <sstream>
 #include <fstream>
 #include <iomanip>
 #include <ctype.h>
 #include <iostream>
 #include <memory>
+#include <vector>
 #if defined(_MSC_VER)
 #include <cstdlib>
 #endif
@@ -233,6 +241,73 @@ inline void swapByteOrder(unsigned int *ptr, int count)
 
 
 
+// Sets a full scanline from the raw PFM data
+template <class ImageIter>
+inline void Pfm_Set_scanline(ImageIter it, const float *data, int width,
+                             bool isColor)
+{
+    if (isColor) {
+        for (int i = 0; i < width; ++i) {
+            const int idx = i*3;
+            it[i].set(data[idx], data[idx+1], data[idx+2]);
+        }
+    } else {
+        for (int i = 0; i < width; ++i) {
+            const float &v = data[i];
+            it[i].set(v,v,v);
+        }
+    }
+}
+
+
+
+// Decodes a range of scanlines directly from the data in memory. The raw
+// floats are only copied if they need to be swapped or are misaligned.
+template <class ImageIter, class ImageType>
+class Pfm_Load_functor
+{
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    Pfm_Load_functor(ImageType &img, const char *data,
+                     bool swapBytes, bool isColor) :
+    m_img(img), m_data(data), m_swapBytes(swapBytes), m_isColor(isColor)
+    {}
+
+    void operator() (const Range &range) const
+    {
+        const int numFloats = m_img.Width() * (m_isColor ? 3 : 1);
+        const size_t scanline_len = numFloats * sizeof(float);
+        std::vector<float> buffer;
+
+        for (int h = range.begin(); h != range.end(); ++h) {
+            const char *src = m_data + h * scanline_len;
+            const float *scanline;
+            if (m_swapBytes || reinterpret_cast<uintptr_t>(src) % 4 != 0) {
+                buffer.resize(numFloats);
+                memcpy(&buffer[0], src, scanline_len);
+                if (m_swapBytes) {
+                    swapByteOrder((unsigned int *)&buffer[0], numFloats);
+                }
+                scanline = &buffer[0];
+            } else {
+                scanline = reinterpret_cast<const float*>(src);
+            }
+
+            ImageIter it = getScanlineIterator(m_img, h, BottomUp);
+            Pfm_Set_scanline(it, scanline, m_img.Width(), m_isColor);
+        }
+    }
+
+private:
+    ImageType &m_img;
+    const char *m_data;
+    const bool m_swapBytes;
+    const bool m_isColor;
+};
+
+
+
 // Load function just for the data, assumes the istream is right
 // at the beginning of the pixels and the image has been allocated
 template <class ImageIter, class ImageType>
@@ -240,39 +315,160 @@ void Pfm_Load_data(ImageType &img, std::istream &is,
                    bool swapBytes, bool isColor)
 {
     const int numChannels = isColor ? 3 : 1;
-
-    // Allocate one full scanline
     const size_t scanline_len = img.Width() * numChannels * sizeof(float);
-    float *buffer = new float[scanline_len];
-    if (buffer == NULL) {
-        throw PfmIOException("Couldn't allocate the temporary buffer.");
+
+    // Memory streams are decoded in place and in parallel
+    MemoryStreamBuf *memBuf = MemoryStreamBuf::fromStream(is);
+    if (memBuf != NULL) {
+        const size_t data_len = scanline_len * img.Height();
+        if (memBuf->remaining() < data_len) {
+            throw PfmIOException("Couldn't read all the scanline data.");
+        }
+        Pfm_Load_functor<ImageIter, ImageType> functor(img,
+            memBuf->current(), swapBytes, isColor);
+        concurrency::parallel_for(tbb::blocked_range<int>(0, img.Height()),
+            functor, img.Width());
+        memBuf->consume(data_len);
+        return;
     }
 
+    // Allocate one full scanline
+    std::vector<float> buffer(img.Width() * numChannels);
+
     for (int h = 0; h < img.Height(); ++h) {
-        is.read((char*)buffer, scanline_len);
+        is.read((char*)&buffer[0], scanline_len);
         if ( is.fail() ) {
-            delete [] buffer;
             throw PfmIOException("Couldn't read all the scanline data.");
         }
 
         if (swapBytes) {
-            swapByteOrder((unsigned int *)buffer, img.Width() * numChannels);
+            swapByteOrder((unsigned int *)&buffer[0], img.Width()*numChannels);
         }
 
         ImageIter it = getScanlineIterator(img, h, BottomUp);
-        if (isColor) {
-            for (int i = 0; i < img.Width(); ++i) {
-                const int idx = i*3;
-                it[i].set(buffer[idx], buffer[idx+1], buffer[idx+2]);
-            }
-        } else {
-            for (int i = 0; i < img.Width(); ++i) {
-                const float &v = buffer[i];
-                it[i].set(v,v,v);
-            }
+        Pfm_Set_scanline(it, &buffer[0], img.Width(), isColor);
+    }
+}
+
+
+
+// Gathers the pixels of a window from a raw scanline, starting at the first
+// pixel of the window, and stores them into the j-th scanline of the image
+template <class ImageType>
+inline void Pfm_Set_window_scanline(ImageType &img, int j, const char *src,
+                                    int step, std::vector<float> &buffer,
+                                    bool swapBytes, bool isColor)
+{
+    const int numChannels = isColor ? 3 : 1;
+    const size_t pixel_len = numChannels * sizeof(float);
+    const size_t src_stride = step * pixel_len;
+    for (int i = 0; i < img.Width(); ++i) {
+        memcpy(&buffer[i * numChannels], src + i * src_stride, pixel_len);
+    }
+    if (swapBytes) {
+        swapByteOrder((unsigned int *)&buffer[0], img.Width() * numChannels);
+    }
+
+    const float *p = &buffer[0];
+    if (isColor) {
+        storeWindowScanline(img, j, p, p + 1, p + 2, NULL, 3);
+    } else {
+        storeWindowScanline(img, j, p, p, p, NULL, 1);
+    }
+}
+
+
+
+// Decodes a range of scanlines of a window directly from the data in memory
+template <class ImageType>
+class Pfm_LoadWindow_functor
+{
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    Pfm_LoadWindow_functor(ImageType &img, const char *data, int height,
+                           size_t scanline_len, const LoadWindow &window,
+                           bool swapBytes, bool isColor) :
+    m_img(img), m_data(data), m_height(height), m_scanline_len(scanline_len),
+    m_window(window), m_swapBytes(swapBytes), m_isColor(isColor)
+    {}
+
+    void operator() (const Range &range) const
+    {
+        const size_t x_offset =
+            m_window.x * (m_isColor ? 3 : 1) * sizeof(float);
+        std::vector<float> buffer(m_img.Width() * (m_isColor ? 3 : 1));
+
+        for (int j = range.begin(); j != range.end(); ++j) {
+            const int h = m_height - 1 - m_window.sourceY(j);
+            const char *src = m_data + h * m_scanline_len + x_offset;
+            Pfm_Set_window_scanline(m_img, j, src, m_window.step, buffer,
+                m_swapBytes, m_isColor);
         }
     }
-    delete [] buffer;
+
+private:
+    ImageType &m_img;
+    const char *m_data;
+    const int m_height;
+    const size_t m_scanline_len;
+    const LoadWindow &m_window;
+    const bool m_swapBytes;
+    const bool m_isColor;
+};
+
+
+
+// Loads a window of an image of the given size, assuming the istream is
+// right at the beginning of the pixels and the image has been allocated.
+// Since the scanlines are stored bottom-up, the scanlines of the window in
+// a regular stream are read backwards, seeking to each one of them.
+template <class ImageType>
+void Pfm_Load_window(ImageType &img, std::istream &is, int width, int height,
+                     const LoadWindow &window, bool swapBytes, bool isColor)
+{
+    const int numChannels = isColor ? 3 : 1;
+    const size_t scanline_len = width * numChannels * sizeof(float);
+    const size_t data_len = scanline_len * height;
+
+    MemoryStreamBuf *memBuf = MemoryStreamBuf::fromStream(is);
+    if (memBuf != NULL) {
+        if (memBuf->remaining() < data_len) {
+            throw PfmIOException("Couldn't read all the scanline data.");
+        }
+        Pfm_LoadWindow_functor<ImageType> functor(img, memBuf->current(),
+            height, scanline_len, window, swapBytes, isColor);
+        concurrency::parallel_for(tbb::blocked_range<int>(0, img.Height()),
+            functor, img.Width());
+        memBuf->consume(data_len);
+        return;
+    }
+
+    const std::istream::pos_type start = is.tellg();
+    if (start == std::istream::pos_type(-1)) {
+        throw PfmIOException("Couldn't get the position of the pixels.");
+    }
+
+    const size_t pixel_len = numChannels * sizeof(float);
+    const size_t span_len =
+        (static_cast<size_t>(img.Width() - 1) * window.step + 1) * pixel_len;
+    std::vector<char> scanline(span_len);
+    std::vector<float> buffer(img.Width() * numChannels);
+
+    for (int j = img.Height() - 1; j >= 0; --j) {
+        const int h = height - 1 - window.sourceY(j);
+        is.seekg(start + static_cast<std::streamoff>(
+            h * scanline_len + window.x * pixel_len));
+        is.read(&scanline[0], span_len);
+        if ( is.fail() ) {
+            throw PfmIOException("Couldn't read all the scanline data.");
+        }
+        Pfm_Set_window_scanline(img, j, &scanline[0], window.step, buffer,
+            swapBytes, isColor);
+    }
+
+    // Leave the stream right after the pixels
+    is.seekg(start + static_cast<std::streamoff>(data_len));
 }
 
 
@@ -293,14 +489,11 @@ void PfmIO_Save_helper(const ImageCls &img, const char *filename)
 template <class ImageCls>
 void PfmIO_Load_helper(ImageCls &img, const char *filename) 
 {
-    std::ifstream pfmFile(filename, std::ios_base::binary);
-    if (! pfmFile.fail() ) {
-        PfmIO::Load(img, pfmFile);
-    }
-    else {
-        // Something terrible takes place here
+    FileInputStream pfmFile;
+    if (!pfmFile.open(filename)) {
         throw PfmIOException((std::string)"Couldn't open the file " + filename);
     }
+    PfmIO::Load(img, pfmFile);
 }
 
 } // namespace
@@ -364,6 +557,34 @@ void PfmIO::Load(RGBAImageSoA &img, std::istream &is)
     Pfm_Load_data<SoAHelper>(img, is, hdr.order!=getNativeOrder(), hdr.isColor);
 }
 
+void PfmIO::Load(Image<Rgba32F, TopDown> &img, std::istream &is,
+                 const LoadWindow &window)
+{
+    Header hdr(is);
+    const LoadWindow w = window.resolve(hdr.width, hdr.height);
+    img.Alloc(w.outputWidth(), w.outputHeight());
+    Pfm_Load_window(img, is, hdr.width, hdr.height, w,
+        hdr.order!=getNativeOrder(), hdr.isColor);
+}
+
+void PfmIO::Load(RGBAImageSoA &img, std::istream &is,
+                 const LoadWindow &window)
+{
+    Header hdr(is);
+    const LoadWindow w = window.resolve(hdr.width, hdr.height);
+    img.Alloc(w.outputWidth(), w.outputHeight());
+    Pfm_Load_window(img, is, hdr.width, hdr.height, w,
+        hdr.order!=getNativeOrder(), hdr.isColor);
+}
+
+void PfmIO::GetSize(std::istream &is, int &width, int &height)
+{
+    Header hdr(is);
+    width  = hdr.width;
+    height = hdr.height;
+}
+
+
 
 // Instanciate the templates
 void PfmIO::Save(const Image<Rgba32F, TopDown> &img, const char *filename) {
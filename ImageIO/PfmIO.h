@@ -27,6 +27,7 @@
 #include "ImageSoA.h"
 #include "Rgba32F.h"
 #include "Exception.h"
+#include "LoadWindow.h"
 
 #include <istream>
 #include <ostream>
@@ -68,6 +69,18 @@ namespace pcg {
         static void IMAGEIO_API Load(Image<Rgba32F, BottomUp> &img, std::istream &is);
         static void IMAGEIO_API Load(RGBAImageSoA &img, std::istream &is);
 
+        // Loads a window of pixels subsampled by an integer step, reading
+        // only the scanlines of the window
+        static void IMAGEIO_API Load(Image<Rgba32F, TopDown> &img,
+            std::istream &is, const LoadWindow &window);
+        static void IMAGEIO_API Load(RGBAImageSoA &img, std::istream &is,
+            const LoadWindow &window);
+
+        // Reads only the header to get the dimensions of the image. The
+        // stream is left right after the header.
+        static void IMAGEIO_API GetSize(std::istream &is,
+            int &width, int &height);
+
         static IMAGEIO_API void Save(const Image<Rgba32F, TopDown>  &img, std::ostream &os);
         static IMAGEIO_API void Save(const Image<Rgba32F, BottomUp> &img, std::ostream &os);
         static IMAGEIO_API void Save(const RGBAImageSoA &img, std::ostream &os);
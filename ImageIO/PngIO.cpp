@@ -17,201 +17,743 @@
 #include "LDRPixels.h"
 #include "Image.h"
 #include "Exception.h"
+#include "ConcurrencyPrivate.h"
 
-#include <iostream>
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
 #include <time.h>
 
 #include <png.h>
+#include <zlib.h>
+
+#include <tbb/spin_mutex.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#include <tbb/task_scheduler_init.h>
 
 
 #ifndef png_jmpbuf
 #   define png_jmpbuf(png_ptr)  ((png_ptr)->jmpbuf)
 #endif
 
-// PNG_TRANSFORM_STRIP_FILLER_AFTER was added in libpng 1.2.34
-#ifndef PNG_TRANSFORM_STRIP_FILLER_AFTER
-#define PNG_TRANSFORM_STRIP_FILLER_AFTER 0x1000
-#endif
+namespace
+{
 
-namespace pcg {
-namespace pngio_internal {
+// Approximate size of the raw data of each band. The bands are compressed
+// independently, without the data of the previous band as dictionary, which
+// costs a few hundred bytes per band.
+const size_t BAND_SIZE = 1 << 20;
 
-	// invGamma is as used in the tone mapper: stored_value = actual_value^invGamma
-	template <typename T, ScanLineMode S>
-	void Save(const Image<T, S> &img, const char *filename, 
-		const bool isSrgb, const float invGamma,
-		const int transformFlags = PNG_TRANSFORM_IDENTITY)
-	{
-		bool err;
-		FILE *fp = NULL;
-	#if defined(_MSC_VER) && _MSC_VER >= 1500
-		err = fopen_s(&fp, filename, "wb") != 0;
-	#else
-		fp = fopen(filename, "wb");
-		err = fp == 0;
-	#endif
-
-		if (err) {
-			throw IOException("Cannot open the file.");
-		}
-
-		// set up writing buffer 
-		png_structp pngPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-		if ( !pngPtr )
-		{
-			fclose(fp);
-			throw RuntimeException("Error: Fail to call png_create_write_struct.");
-		}
+// Bands being compressed per thread before WriteRows waits for them
+const int BANDS_PER_THREAD = 4;
 
-		// allocate memory for image information
-		png_infop infoPtr = png_create_info_struct(pngPtr);
-		if ( !infoPtr )
-		{
-			fclose(fp);
-			png_destroy_write_struct(&pngPtr, NULL);
-			throw RuntimeException("Error: Fail to call png_create_info_struct.");
-		}
 
-		// set up default error handling
-		if ( setjmp(png_jmpbuf(pngPtr)) )
-		{
-			fclose(fp);
-			png_destroy_write_struct(&pngPtr, &infoPtr);
-			throw RuntimeException("Error: Couldn't setup the error handler.");
+
+// Converts the pixels into the PNG RGB layout, with the 16-bit samples in
+// network byte order
+inline png_bytep packRow(const pcg::Rgba8 *src, int width, png_bytep dest)
+{
+	for (int i = 0; i < width; ++i, dest += 3) {
+		dest[0] = src[i].r;
+		dest[1] = src[i].g;
+		dest[2] = src[i].b;
+	}
+	return dest;
+}
+
+inline png_bytep packRow(const pcg::Bgra8 *src, int width, png_bytep dest)
+{
+	for (int i = 0; i < width; ++i, dest += 3) {
+		dest[0] = src[i].r;
+		dest[1] = src[i].g;
+		dest[2] = src[i].b;
+	}
+	return dest;
+}
+
+inline png_bytep packRow(const pcg::Rgba16 *src, int width, png_bytep dest)
+{
+	for (int i = 0; i < width; ++i, dest += 6) {
+		dest[0] = static_cast<png_byte>(src[i].r >> 8);
+		dest[1] = static_cast<png_byte>(src[i].r);
+		dest[2] = static_cast<png_byte>(src[i].g >> 8);
+		dest[3] = static_cast<png_byte>(src[i].g);
+		dest[4] = static_cast<png_byte>(src[i].b >> 8);
+		dest[5] = static_cast<png_byte>(src[i].b);
+	}
+	return dest;
+}
+
+
+
+inline int paethPredictor(int a, int b, int c)
+{
+	const int p  = a + b - c;
+	const int pa = abs(p - a);
+	const int pb = abs(p - b);
+	const int pc = abs(p - c);
+	if (pa <= pb && pa <= pc) {
+		return a;
+	} else if (pb <= pc) {
+		return b;
+	} else {
+		return c;
+	}
+}
+
+// Filters a scanline of n bytes with bpp bytes per pixel. The output is the
+// filter type byte followed by the n filtered bytes. The previous scanline
+// is all zeros for the first one.
+void filterRow(int type, png_const_bytep row, png_const_bytep prev,
+	size_t n, int bpp, png_bytep out)
+{
+	*out++ = static_cast<png_byte>(type);
+	switch (type) {
+	case PNG_FILTER_VALUE_NONE:
+		memcpy(out, row, n);
+		break;
+	case PNG_FILTER_VALUE_SUB:
+		for (size_t i = 0; i < n; ++i) {
+			const int a = i >= size_t(bpp) ? row[i - bpp] : 0;
+			out[i] = static_cast<png_byte>(row[i] - a);
 		}
+		break;
+	case PNG_FILTER_VALUE_UP:
+		for (size_t i = 0; i < n; ++i) {
+			out[i] = static_cast<png_byte>(row[i] - prev[i]);
+		}
+		break;
+	case PNG_FILTER_VALUE_AVG:
+		for (size_t i = 0; i < n; ++i) {
+			const int a = i >= size_t(bpp) ? row[i - bpp] : 0;
+			out[i] = static_cast<png_byte>(row[i] - ((a + prev[i]) >> 1));
+		}
+		break;
+	case PNG_FILTER_VALUE_PAETH:
+		for (size_t i = 0; i < n; ++i) {
+			const int a = i >= size_t(bpp) ? row[i - bpp]  : 0;
+			const int c = i >= size_t(bpp) ? prev[i - bpp] : 0;
+			out[i] = static_cast<png_byte>(row[i]-paethPredictor(a,prev[i],c));
+		}
+		break;
+	default:
+		assert(0);
+	}
+}
 
-		const int bitDepth = sizeof(typename T::pixel_t) * 8;
-		if (bitDepth != 8 && bitDepth != 16) {
-			fclose(fp);
-			png_destroy_write_struct(&pngPtr, &infoPtr);
-			throw RuntimeException("Error: Invalid bit depth (only 8 & 16 accepted).");
-		}
-
-		// set up the I/O function
-		png_init_io(pngPtr, fp);
-		png_set_IHDR(pngPtr, infoPtr, img.Width(), img.Height(), bitDepth, 
-			PNG_COLOR_TYPE_RGB, 
-			PNG_INTERLACE_NONE, 
-			PNG_COMPRESSION_TYPE_DEFAULT, 
-			PNG_FILTER_TYPE_DEFAULT);
-
-		// Add the info chunks
-		{
-			if (isSrgb) {
-				// From the png book, section 10.6:
-				// value 0 for perceptual, 1 for relative colorimetric, 
-				// 2 for saturation-preserving, and 3 for absolute colorimetric. 
-				png_set_sRGB_gAMA_and_cHRM(pngPtr, infoPtr, PNG_sRGB_INTENT_ABSOLUTE);
+// libpng's heuristic for the adaptive filter: the sum of the absolute values
+// of the filtered bytes taken as signed
+size_t filterCost(png_const_bytep filtered, size_t n)
+{
+	size_t sum = 0;
+	for (size_t i = 0; i < n; ++i) {
+		const int v = filtered[i];
+		sum += v < 128 ? v : 256 - v;
+	}
+	return sum;
+}
+
+
+
+// Group of consecutive scanlines which is filtered and compressed as a unit
+struct Band
+{
+	// Packed scanlines, preceded by the last scanline of the previous band
+	std::vector<png_byte> pixels;
+	int numRows;
+
+	// Whether this band ends the zlib stream
+	bool isLast;
+
+	// Deflated data, preceded by the zlib header in the first band. The
+	// adler32 checksum and the length refer to the filtered data.
+	std::vector<png_byte> output;
+	uLong adler;
+	uLong length;
+
+	// Set once the output is ready, guarded by the mutex
+	bool done;
+	tbb::spin_mutex mutex;
+
+	Band() : numRows(0), isLast(false), adler(0), length(0), done(false) {}
+
+	bool isDone() {
+		tbb::spin_mutex::scoped_lock lock(mutex);
+		return done;
+	}
+};
+
+
+
+// Function object which filters and deflates a band within a task group
+class CompressBand
+{
+public:
+	CompressBand(Band &b, size_t rowBytes, int bytesPerPixel, int level,
+		pcg::PngIO::Filter filterType) :
+	band(b), n(rowBytes), bpp(bytesPerPixel), compressionLevel(level),
+	filter(filterType) {}
+
+	void operator()() const
+	{
+		// Filter the scanlines
+		const size_t stride = n + 1;
+		std::vector<png_byte> filtered(band.numRows * stride);
+		std::vector<png_byte> trial(filter == pcg::PngIO::FILTER_ADAPTIVE ?
+			stride : 0);
+		for (int y = 0; y < band.numRows; ++y) {
+			png_const_bytep prev = &band.pixels[y * n];
+			png_const_bytep row  = prev + n;
+			png_bytep out = &filtered[y * stride];
+			if (filter != pcg::PngIO::FILTER_ADAPTIVE) {
+				filterRow(filterValue(), row, prev, n, bpp, out);
+				continue;
 			}
-			else {
-				png_set_gAMA(pngPtr, infoPtr, invGamma);
+
+			filterRow(PNG_FILTER_VALUE_NONE, row, prev, n, bpp, out);
+			size_t bestCost = filterCost(out + 1, n);
+			for (int type = PNG_FILTER_VALUE_SUB;
+				type <= PNG_FILTER_VALUE_PAETH; ++type) {
+				filterRow(type, row, prev, n, bpp, &trial[0]);
+				const size_t cost = filterCost(&trial[1], n);
+				if (cost < bestCost) {
+					bestCost = cost;
+					memcpy(out, &trial[0], stride);
+				}
 			}
+		}
+		band.pixels.clear();
+		band.length = static_cast<uLong>(filtered.size());
+		band.adler  = adler32(adler32(0L, Z_NULL, 0),
+			&filtered[0], band.length);
+
+		// Raw deflate, ending at a byte boundary so that the next band may
+		// be appended as is
+		z_stream strm;
+		memset(&strm, 0, sizeof(z_stream));
+		const int strategy = filter == pcg::PngIO::FILTER_NONE ?
+			Z_DEFAULT_STRATEGY : Z_FILTERED;
+		if (deflateInit2(&strm, compressionLevel, Z_DEFLATED, -MAX_WBITS,
+			8, strategy) != Z_OK) {
+			throw pcg::RuntimeException("Error: Couldn't initialize zlib.");
+		}
+		const size_t offset = band.output.size();
+		band.output.resize(offset + deflateBound(&strm, band.length) + 16);
+		strm.next_in   = &filtered[0];
+		strm.avail_in  = band.length;
+		strm.next_out  = &band.output[offset];
+		strm.avail_out = static_cast<uInt>(band.output.size() - offset);
+		const int flush = band.isLast ? Z_FINISH : Z_SYNC_FLUSH;
+		int ret;
+		while ((ret = deflate(&strm, flush)) == Z_OK && strm.avail_out == 0) {
+			const size_t used = band.output.size();
+			band.output.resize(2 * used);
+			strm.next_out  = &band.output[used];
+			strm.avail_out = static_cast<uInt>(used);
+		}
+		const size_t total = offset + strm.total_out;
+		deflateEnd(&strm);
+		if (ret != (band.isLast ? Z_STREAM_END : Z_OK)) {
+			throw pcg::RuntimeException("Error: Couldn't compress the data.");
+		}
+		band.output.resize(total);
 
-			time_t modtime = time(NULL);
-			png_time pngtime;
+		tbb::spin_mutex::scoped_lock lock(band.mutex);
+		band.done = true;
+	}
 
-			png_convert_from_time_t(&pngtime, modtime);
-			png_set_tIME(pngPtr, infoPtr, &pngtime);
+private:
+	int filterValue() const
+	{
+		switch (filter) {
+		case pcg::PngIO::FILTER_SUB:     return PNG_FILTER_VALUE_SUB;
+		case pcg::PngIO::FILTER_UP:      return PNG_FILTER_VALUE_UP;
+		case pcg::PngIO::FILTER_AVERAGE: return PNG_FILTER_VALUE_AVG;
+		case pcg::PngIO::FILTER_PAETH:   return PNG_FILTER_VALUE_PAETH;
+		default:                         return PNG_FILTER_VALUE_NONE;
 		}
+	}
 
-		// Setup the scanlines pointers
-		png_bytep * rowPtr = new png_bytep[img.Height()];
-		assert(rowPtr);
-		for(int i = 0; i < img.Height(); ++i) {
-			rowPtr[i] = reinterpret_cast<png_byte*>(img.GetScanlinePointer(i, TopDown));
-		}
-		
-		
-#if (PNG_LIBPNG_VER >= 10234)
+	Band &band;
+	const size_t n;
+	const int bpp;
+	const int compressionLevel;
+	const pcg::PngIO::Filter filter;
+};
+
+
+
+inline void putUInt32(png_bytep buf, png_uint_32 value)
+{
+	buf[0] = static_cast<png_byte>(value >> 24);
+	buf[1] = static_cast<png_byte>(value >> 16);
+	buf[2] = static_cast<png_byte>(value >> 8);
+	buf[3] = static_cast<png_byte>(value);
+}
+
+void writeChunk(FILE *fp, const char *type, png_const_bytep data, size_t len)
+{
+	png_byte buf[8];
+	putUInt32(buf, static_cast<png_uint_32>(len));
+	memcpy(buf + 4, type, 4);
+	uLong crc = crc32(0L, Z_NULL, 0);
+	crc = crc32(crc, buf + 4, 4);
+	if (len != 0) {
+		crc = crc32(crc, data, static_cast<uInt>(len));
+	}
+	png_byte crcBuf[4];
+	putUInt32(crcBuf, static_cast<png_uint_32>(crc));
+	if (fwrite(buf, 1, 8, fp) != 8 ||
+		(len != 0 && fwrite(data, 1, len, fp) != len) ||
+		fwrite(crcBuf, 1, 4, fp) != 4) {
+		throw pcg::IOException("Error: Couldn't write the file.");
+	}
+}
+
+// Writes the signature and the header chunks with libpng, up to the image
+// data. invGamma is as used in the tone mapper:
+// stored_value = actual_value^invGamma
+bool writeHeader(FILE *fp, int width, int height, int bitDepth,
+	bool isSrgb, float invGamma)
+{
+	png_structp pngPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+		NULL, NULL, NULL);
+	if (!pngPtr) {
+		return false;
+	}
+	png_infop infoPtr = png_create_info_struct(pngPtr);
+	if (!infoPtr) {
+		png_destroy_write_struct(&pngPtr, NULL);
+		return false;
+	}
+	if (setjmp(png_jmpbuf(pngPtr))) {
+		png_destroy_write_struct(&pngPtr, &infoPtr);
+		return false;
+	}
+
+	png_init_io(pngPtr, fp);
+	png_set_IHDR(pngPtr, infoPtr, width, height, bitDepth, 
+		PNG_COLOR_TYPE_RGB, 
+		PNG_INTERLACE_NONE, 
+		PNG_COMPRESSION_TYPE_DEFAULT, 
+		PNG_FILTER_TYPE_DEFAULT);
+
+	if (isSrgb) {
+		// From the png book, section 10.6:
+		// value 0 for perceptual, 1 for relative colorimetric, 
+		// 2 for saturation-preserving, and 3 for absolute colorimetric. 
+		png_set_sRGB_gAMA_and_cHRM(pngPtr, infoPtr, PNG_sRGB_INTENT_ABSOLUTE);
+	}
+	else {
+		png_set_gAMA(pngPtr, infoPtr, invGamma);
+	}
+
+	time_t modtime = time(NULL);
+	png_time pngtime;
+	png_convert_from_time_t(&pngtime, modtime);
+	png_set_tIME(pngPtr, infoPtr, &pngtime);
+
+	png_write_info(pngPtr, infoPtr);
+	png_destroy_write_struct(&pngPtr, &infoPtr);
+	return true;
+}
+
+// Adds a band to the task group, or waits for all of them, from within the
+// arena of the writer
+class RunBand
+{
+public:
+	RunBand(tbb::task_group &g, const CompressBand &t) : group(g), task(t) {}
+
+	void operator()() const
+	{
+		group.run(task);
+	}
+
+private:
+	tbb::task_group &group;
+	const CompressBand &task;
+};
+
+class WaitBands
+{
+public:
+	WaitBands(tbb::task_group &g) : group(g) {}
+
+	void operator()() const
+	{
+		group.wait();
+	}
 
-		// Write the whole data, we do the stripping because we always use RGB only
-		png_set_rows(pngPtr, infoPtr, rowPtr);
-		png_write_png(pngPtr, infoPtr, transformFlags, NULL);
+private:
+	tbb::task_group &group;
+};
 
-#else 
+} // namespace
 
-		// Write the information header
-		png_write_info(pngPtr, infoPtr);
 
-		// Ugly compatibility fixes
-		if (transformFlags & PNG_TRANSFORM_STRIP_FILLER_AFTER) {
-			png_set_filler(pngPtr, 0, PNG_FILLER_AFTER);
+
+struct pcg::PngWriter::Impl
+{
+	FILE *fp;
+	int width;
+	int height;
+	int bitDepth;
+	int compressionLevel;
+	PngIO::Filter filter;
+
+	size_t rowBytes;
+	int rowsPerBand;
+	int maxPending;
+
+	// Scanlines given so far and band being filled, if any
+	int rowsWritten;
+	Band *current;
+
+	// Copy of the last scanline of the previous band
+	std::vector<png_byte> lastRow;
+
+	// Bands being compressed or waiting to be written, in order. The tasks
+	// run within the arena of the thread which created the writer.
+	tbb::task_arena *arena;
+	tbb::task_group group;
+	std::deque<Band*> pending;
+
+	// Running checksum of the bands already written
+	uLong adler;
+
+	Impl() : fp(NULL), rowsWritten(0), current(NULL),
+		arena(pcg::concurrency::currentArena()),
+		adler(adler32(0L, Z_NULL, 0)) {}
+
+	~Impl()
+	{
+		try {
+			waitBands();
+		}
+		catch (...) {}
+		delete current;
+		for (size_t i = 0; i < pending.size(); ++i) {
+			delete pending[i];
 		}
-		if (transformFlags & PNG_TRANSFORM_SWAP_ENDIAN) {
-			png_set_swap(pngPtr);
+		if (fp != NULL) {
+			fclose(fp);
+		}
+	}
 
+	template <typename T>
+	void writeRows(const T *pixels, int numRows)
+	{
+		if (sizeof(typename T::pixel_t) * 8 != size_t(bitDepth)) {
+			throw IllegalArgumentException("The pixels do not match the "
+				"bit depth.");
 		}
-		if (transformFlags & PNG_TRANSFORM_BGR) {
-			png_set_bgr(pngPtr);
+		if (numRows < 0 || numRows > height - rowsWritten) {
+			throw IllegalArgumentException("Too many scanlines.");
 		}
-		
-		png_write_image(pngPtr, rowPtr);
-		png_write_end(pngPtr, NULL);
 
-#endif /* PNG_LIBPNG_VER >= 10234 */
-		
-		// clean up memory and structures
-		png_destroy_write_struct(&pngPtr, &infoPtr);
-		delete [] rowPtr;
+		for (int y = 0; y < numRows; ++y, pixels += width) {
+			if (current == NULL) {
+				beginBand();
+			}
+			packRow(pixels, width,
+				&current->pixels[(current->numRows + 1) * rowBytes]);
+			++current->numRows;
+			++rowsWritten;
+			if (current->numRows == rowsPerBand || rowsWritten == height) {
+				submitBand();
+			}
+		}
+	}
 
-		fclose(fp);
+	void beginBand()
+	{
+		assert(current == NULL);
+		Band *band = new Band;
+		band->pixels.resize((rowsPerBand + 1) * rowBytes);
+		if (rowsWritten == 0) {
+			// Two bytes for the zlib header: 32K window, deflate and the
+			// compression level hint
+			const int levelFlags = compressionLevel == Z_DEFAULT_COMPRESSION ||
+				compressionLevel == 6 ? 2 :
+				compressionLevel < 2 ? 0 : (compressionLevel < 6 ? 1 : 3);
+			int header = (0x78 << 8) | (levelFlags << 6);
+			header += 31 - (header % 31);
+			band->output.push_back(static_cast<png_byte>(header >> 8));
+			band->output.push_back(static_cast<png_byte>(header));
+		} else {
+			// The previous scanline is the last one of the previous band
+			memcpy(&band->pixels[0], &lastRow[0], rowBytes);
+		}
+		current = band;
+	}
 
+	void submitBand()
+	{
+		Band *band = current;
+		current = NULL;
+		band->isLast = rowsWritten == height;
+		band->pixels.resize((band->numRows + 1) * rowBytes);
+		lastRow.assign(band->pixels.end() - rowBytes, band->pixels.end());
+
+		pending.push_back(band);
+		const CompressBand task(*band, rowBytes, bitDepth / 8 * 3,
+			compressionLevel, filter);
+		const RunBand run(group, task);
+		if (arena == NULL) {
+			run();
+		} else {
+			arena->execute(run);
+		}
+
+		if (static_cast<int>(pending.size()) >= maxPending) {
+			waitBands();
+		}
+		flushBands();
 	}
 
-	// Helper functions
-	inline bool isLittleEndian()
+	void waitBands()
 	{
-#if (defined(_WIN32) || defined(__i386__) || defined(__x86_64__) || defined(__LITTLE_ENDIAN__))
-		return true;
-#elif defined(__BIG_ENDIAN__)
-		return false;
+		const WaitBands wait(group);
+		if (arena == NULL) {
+			wait();
+		} else {
+			arena->execute(wait);
+		}
+	}
+
+	// Writes the leading bands which are already compressed
+	void flushBands()
+	{
+		while (!pending.empty() && pending.front()->isDone()) {
+			Band *band = pending.front();
+			pending.pop_front();
+			adler = adler32_combine(adler, band->adler, band->length);
+			if (band->isLast) {
+				png_byte trailer[4];
+				putUInt32(trailer, static_cast<png_uint_32>(adler));
+				band->output.insert(band->output.end(), trailer, trailer + 4);
+			}
+			try {
+				writeChunk(fp, "IDAT", &band->output[0], band->output.size());
+			}
+			catch (...) {
+				delete band;
+				throw;
+			}
+			delete band;
+		}
+	}
+};
+
+
+
+pcg::PngWriter::PngWriter(const char *filename, int width, int height,
+	int bitDepth, bool isSrgb, float invGamma, int compressionLevel,
+	PngIO::Filter filter) : impl(NULL)
+{
+	if (width <= 0 || height <= 0) {
+		throw IllegalArgumentException("Invalid image size.");
+	}
+	if (bitDepth != 8 && bitDepth != 16) {
+		throw IllegalArgumentException("Error: Invalid bit depth "
+			"(only 8 & 16 accepted).");
+	}
+	if (compressionLevel < Z_DEFAULT_COMPRESSION ||
+		compressionLevel > Z_BEST_COMPRESSION) {
+		throw IllegalArgumentException("Invalid compression level.");
+	}
+	if (filter < PngIO::FILTER_NONE || filter > PngIO::FILTER_ADAPTIVE) {
+		throw IllegalArgumentException("Invalid filter.");
+	}
+
+	impl = new Impl;
+	impl->width    = width;
+	impl->height   = height;
+	impl->bitDepth = bitDepth;
+	impl->compressionLevel = compressionLevel;
+	impl->filter   = filter;
+	impl->rowBytes = static_cast<size_t>(width) * (bitDepth / 8) * 3;
+	impl->rowsPerBand = static_cast<int>(std::min(size_t(height),
+		std::max(size_t(1), BAND_SIZE / (impl->rowBytes + 1))));
+	impl->maxPending = BANDS_PER_THREAD * std::min(Concurrency::MaxThreads(),
+		tbb::task_scheduler_init::default_num_threads());
+
+	bool err;
+#if defined(_MSC_VER) && _MSC_VER >= 1500
+	err = fopen_s(&impl->fp, filename, "wb") != 0;
 #else
-		union { int i; char c[4]; };
-		i = 1;
-		return c[0] != 0;
+	impl->fp = fopen(filename, "wb");
+	err = impl->fp == 0;
 #endif
+	if (err) {
+		delete impl;
+		throw IOException("Cannot open the file.");
+	}
+
+	if (!writeHeader(impl->fp, width, height, bitDepth, isSrgb, invGamma)) {
+		delete impl;
+		throw RuntimeException("Error: Couldn't write the PNG header.");
+	}
+}
+
+
+
+pcg::PngWriter::~PngWriter()
+{
+	delete impl;
+}
+
+
+
+void pcg::PngWriter::WriteRows(const Rgba16 *pixels, int numRows)
+{
+	impl->writeRows(pixels, numRows);
+}
+
+void pcg::PngWriter::WriteRows(const Rgba8 *pixels, int numRows)
+{
+	impl->writeRows(pixels, numRows);
+}
+
+void pcg::PngWriter::WriteRows(const Bgra8 *pixels, int numRows)
+{
+	impl->writeRows(pixels, numRows);
+}
+
+
+
+int pcg::PngWriter::RowsWritten() const
+{
+	return impl->rowsWritten;
+}
+
+
+
+void pcg::PngWriter::Close()
+{
+	if (impl->fp == NULL) {
+		return;
+	}
+	if (impl->rowsWritten != impl->height) {
+		throw RuntimeException("Not all the scanlines were written.");
+	}
+	impl->waitBands();
+	impl->flushBands();
+	assert(impl->pending.empty());
+
+	writeChunk(impl->fp, "IEND", NULL, 0);
+	const bool err = fclose(impl->fp) != 0;
+	impl->fp = NULL;
+	if (err) {
+		throw IOException("Error: Couldn't write the file.");
+	}
+}
+
+
+
+namespace pcg {
+namespace pngio_internal {
+
+	template <typename T>
+	void Save(const ImageView<const T> &img, const char *filename, 
+		const bool isSrgb, const float invGamma,
+		const int compressionLevel, const PngIO::Filter filter)
+	{
+		const int bitDepth = sizeof(typename T::pixel_t) * 8;
+		PngWriter writer(filename, img.Width(), img.Height(), bitDepth,
+			isSrgb, invGamma, compressionLevel, filter);
+		if (img.Stride() == img.Width()) {
+			writer.WriteRows(img.GetDataPointer(), img.Height());
+		} else {
+			for (int i = 0; i < img.Height(); ++i) {
+				writer.WriteRows(img.GetScanlinePointer(i), 1);
+			}
+		}
+		writer.Close();
+	}
+
+	template <typename T, ScanLineMode S>
+	inline void Save(const Image<T, S> &img, const char *filename, 
+		const bool isSrgb, const float invGamma,
+		const int compressionLevel, const PngIO::Filter filter)
+	{
+		Save(ImageView<const T>(img), filename, isSrgb, invGamma,
+			compressionLevel, filter);
 	}
 
 }} /* End of private namespace */
 
 void pcg::PngIO::Save(Image<Rgba16,TopDown> &img, 
-	const char *filename, const bool isSrgb, const float invGamma)
+	const char *filename, const bool isSrgb, const float invGamma,
+	const int compressionLevel, const Filter filter)
 {
 	pcg::pngio_internal::Save(img, filename, isSrgb, invGamma,
-		PNG_TRANSFORM_STRIP_FILLER_AFTER | 
-		(pcg::pngio_internal::isLittleEndian() ? PNG_TRANSFORM_SWAP_ENDIAN : 0));
+		compressionLevel, filter);
 }
 void pcg::PngIO::Save(Image<Rgba16,BottomUp> &img, 
-	const char *filename, const bool isSrgb, const float invGamma)
+	const char *filename, const bool isSrgb, const float invGamma,
+	const int compressionLevel, const Filter filter)
 {
 	pcg::pngio_internal::Save(img, filename, isSrgb, invGamma,
-		PNG_TRANSFORM_STRIP_FILLER_AFTER | 
-		(pcg::pngio_internal::isLittleEndian() ? PNG_TRANSFORM_SWAP_ENDIAN : 0));
+		compressionLevel, filter);
+}
+
+void pcg::PngIO::Save(const ImageView<const Rgba16> &img, 
+	const char *filename, const bool isSrgb, const float invGamma,
+	const int compressionLevel, const Filter filter)
+{
+	pcg::pngio_internal::Save(img, filename, isSrgb, invGamma,
+		compressionLevel, filter);
 }
 
 void pcg::PngIO::Save(Image<Rgba8,TopDown> &img, 
-	const char *filename, const bool isSrgb, const float invGamma)
+	const char *filename, const bool isSrgb, const float invGamma,
+	const int compressionLevel, const Filter filter)
 {
 	pcg::pngio_internal::Save(img, filename, isSrgb, invGamma,
-		PNG_TRANSFORM_STRIP_FILLER_AFTER);
+		compressionLevel, filter);
 }
 void pcg::PngIO::Save(Image<Rgba8,BottomUp> &img, 
-	const char *filename, const bool isSrgb, const float invGamma)
+	const char *filename, const bool isSrgb, const float invGamma,
+	const int compressionLevel, const Filter filter)
+{
+	pcg::pngio_internal::Save(img, filename, isSrgb, invGamma,
+		compressionLevel, filter);
+}
+
+void pcg::PngIO::Save(const ImageView<const Rgba8> &img, 
+	const char *filename, const bool isSrgb, const float invGamma,
+	const int compressionLevel, const Filter filter)
 {
 	pcg::pngio_internal::Save(img, filename, isSrgb, invGamma,
-		PNG_TRANSFORM_STRIP_FILLER_AFTER);
+		compressionLevel, filter);
 }
 
 void pcg::PngIO::Save(Image<Bgra8,TopDown> &img, 
-	const char *filename, const bool isSrgb, const float invGamma)
+	const char *filename, const bool isSrgb, const float invGamma,
+	const int compressionLevel, const Filter filter)
 {
 	pcg::pngio_internal::Save(img, filename, isSrgb, invGamma,
-		PNG_TRANSFORM_BGR | PNG_TRANSFORM_STRIP_FILLER_AFTER);
+		compressionLevel, filter);
 }
 void pcg::PngIO::Save(Image<Bgra8,BottomUp> &img, 
-	const char *filename, const bool isSrgb, const float invGamma)
+	const char *filename, const bool isSrgb, const float invGamma,
+	const int compressionLevel, const Filter filter)
+{
+	pcg::pngio_internal::Save(img, filename, isSrgb, invGamma,
+		compressionLevel, filter);
+}
+
+void pcg::PngIO::Save(const ImageView<const Bgra8> &img, 
+	const char *filename, const bool isSrgb, const float invGamma,
+	const int compressionLevel, const Filter filter)
 {
 	pcg::pngio_internal::Save(img, filename, isSrgb, invGamma,
-		PNG_TRANSFORM_BGR | PNG_TRANSFORM_STRIP_FILLER_AFTER);
+		compressionLevel, filter);
 }
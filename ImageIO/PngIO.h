@@ -18,6 +18,7 @@
 
 #include "ImageIO.h"
 #include "Image.h"
+#include "ImageView.h"
 #include "LDRPixels.h"
 
 namespace pcg {
@@ -25,20 +26,104 @@ namespace pcg {
 	class PngIO {
 	public:
 
+		// Filters applied to the scanlines before compressing them. The
+		// adaptive one chooses the filter of each scanline with the same
+		// heuristic as libpng and usually gives the smallest files.
+		enum Filter {
+			FILTER_NONE,
+			FILTER_SUB,
+			FILTER_UP,
+			FILTER_AVERAGE,
+			FILTER_PAETH,
+			FILTER_ADAPTIVE
+		};
+
+		// The zlib compression levels go from 0 (no compression) to 9 (best
+		// compression); this one selects the zlib default, currently 6.
+		static const int DEFAULT_COMPRESSION = -1;
+
+		// All the variants write only the RGB channels. The image data is
+		// filtered and compressed in parallel bands, see PngWriter.
 		static IMAGEIO_API void Save(Image<Rgba16,TopDown>   &img, 
-			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f);
+			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f,
+			const int compressionLevel = DEFAULT_COMPRESSION, const Filter filter = FILTER_ADAPTIVE);
 		static IMAGEIO_API void Save(Image<Rgba16,BottomUp>  &img, 
-			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f);
+			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f,
+			const int compressionLevel = DEFAULT_COMPRESSION, const Filter filter = FILTER_ADAPTIVE);
 
 		static IMAGEIO_API void Save(Image<Rgba8,TopDown>   &img, 
-			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f);
+			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f,
+			const int compressionLevel = DEFAULT_COMPRESSION, const Filter filter = FILTER_ADAPTIVE);
 		static IMAGEIO_API void Save(Image<Rgba8,BottomUp>  &img, 
-			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f);
+			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f,
+			const int compressionLevel = DEFAULT_COMPRESSION, const Filter filter = FILTER_ADAPTIVE);
 		
 		static IMAGEIO_API void Save(Image<Bgra8,TopDown>   &img, 
-			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f);
+			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f,
+			const int compressionLevel = DEFAULT_COMPRESSION, const Filter filter = FILTER_ADAPTIVE);
 		static IMAGEIO_API void Save(Image<Bgra8,BottomUp>  &img, 
-			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f);
+			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f,
+			const int compressionLevel = DEFAULT_COMPRESSION, const Filter filter = FILTER_ADAPTIVE);
+
+		// Variants for the pixels of views, such as a region of an image
+		static IMAGEIO_API void Save(const ImageView<const Rgba16> &img, 
+			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f,
+			const int compressionLevel = DEFAULT_COMPRESSION, const Filter filter = FILTER_ADAPTIVE);
+		static IMAGEIO_API void Save(const ImageView<const Rgba8> &img, 
+			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f,
+			const int compressionLevel = DEFAULT_COMPRESSION, const Filter filter = FILTER_ADAPTIVE);
+		static IMAGEIO_API void Save(const ImageView<const Bgra8> &img, 
+			const char *filename, const bool isSrgb = true, const float invGamma = 1.0f/2.2f,
+			const int compressionLevel = DEFAULT_COMPRESSION, const Filter filter = FILTER_ADAPTIVE);
+	};
+
+
+	// Writes a PNG file incrementally, with the scanlines given from top to
+	// bottom in as many calls as convenient, for example as they get tone
+	// mapped. The scanlines are grouped in bands of about 1 MB which are
+	// filtered and deflated in parallel, each one independently of the others,
+	// and then stitched together into a single zlib stream. Only the RGB
+	// channels are written; the bit depth is either 8 or 16 and it must match
+	// the pixels passed to WriteRows, otherwise it throws
+	// IllegalArgumentException.
+	//
+	// The writer itself is not thread safe: WriteRows and Close must be called
+	// from one thread at a time. The bands are compressed within the execution
+	// context of the thread which creates the writer, thus a writer created
+	// inside a Concurrency::Scope must be destroyed before it.
+	class IMAGEIO_API PngWriter {
+	public:
+		// Creates the file and writes the header chunks. It throws IOException
+		// if the file cannot be created and IllegalArgumentException for
+		// invalid sizes, bit depths or compression levels.
+		PngWriter(const char *filename, int width, int height, int bitDepth,
+			bool isSrgb = true, float invGamma = 1.0f/2.2f,
+			int compressionLevel = PngIO::DEFAULT_COMPRESSION,
+			PngIO::Filter filter = PngIO::FILTER_ADAPTIVE);
+
+		// If the writer was not closed the file is left incomplete
+		~PngWriter();
+
+		// Appends numRows contiguous scanlines of width pixels each
+		void WriteRows(const Rgba16 *pixels, int numRows);
+		void WriteRows(const Rgba8  *pixels, int numRows);
+		void WriteRows(const Bgra8  *pixels, int numRows);
+
+		// Number of scanlines written so far
+		int RowsWritten() const;
+
+		// Waits for the pending bands and completes the file. All the
+		// scanlines must have been written, otherwise it throws
+		// RuntimeException.
+		void Close();
+
+	private:
+		// Non-copyable
+		PngWriter(const PngWriter&);
+		PngWriter& operator=(const PngWriter&);
+
+		struct Impl;
+		Impl *impl;
 	};
 
 }
@@ -33,6 +33,8 @@
 
 #include "Reinhard02.h"
 #include "ImageIterators.h"
+#include "SimdDispatch.h"
+#include "ConcurrencyPrivate.h"
 #include "Vec4f.h"
 #include "Vec4i.h"
 #if PCG_USE_AVX
@@ -44,6 +46,7 @@
 #include <vector>
 #include <memory>
 
+#include <tbb/parallel_for.h>
 #include <tbb/parallel_reduce.h>
 #include <tbb/blocked_range.h>
 #include <tbb/enumerable_thread_specific.h>
@@ -56,9 +59,12 @@
 #if USE_AM_LOG
 #include "Amaths.h"
 #else
+// Internal linkage, as this file is also compiled for other instruction sets
+namespace {
 namespace ssemath {
 #include "sse_mathfun.h"
 }
+}
 #endif
 
 
@@ -136,22 +142,24 @@ static const VecfUnion LUM_MINVAL = {PCG_VEC_UNION( float_limits::min() )};
 static const VeciUnion INT_ONE = {PCG_VEC_UNION( 1 )};
 static const VeciUnion MASK_NAN = {PCG_VEC_UNION( 0x7f800000 )};
 
-const Vec4f LUM_TAIL_MASKS_V4[3] = {
-    Vec4f(_mm_castsi128_ps(Vec4i::constant<0, 0, 0,-1>())),
-    Vec4f(_mm_castsi128_ps(Vec4i::constant<0, 0,-1,-1>())),
-    Vec4f(_mm_castsi128_ps(Vec4i::constant<0,-1,-1,-1>()))
+// Integer unions so that the masks are constant-initialized. Unlike the
+// arguments of Vec4i::constant, the elements are in memory order.
+static const Vec4iUnion LUM_TAIL_MASKS_V4[3] = {
+    {{-1, 0, 0, 0}},
+    {{-1,-1, 0, 0}},
+    {{-1,-1,-1, 0}}
 };
 
 #if PCG_USE_AVX
 static const VecfUnion LUM_MAXVAL = {PCG_VEC_UNION( float_limits::max() )};
-const Vec8f LUM_TAIL_MASKS_V8[7] = {
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0, 0, 0, 0, 0, 0,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0, 0, 0, 0, 0,-1,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0, 0, 0, 0,-1,-1,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0, 0, 0,-1,-1,-1,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0, 0,-1,-1,-1,-1,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0, 0,-1,-1,-1,-1,-1,-1>())),
-    Vec8f(_mm256_castsi256_ps(Vec8i::constant<0,-1,-1,-1,-1,-1,-1,-1>()))
+static const Vec8iUnion LUM_TAIL_MASKS_V8[7] = {
+    {{-1, 0, 0, 0, 0, 0, 0, 0}},
+    {{-1,-1, 0, 0, 0, 0, 0, 0}},
+    {{-1,-1,-1, 0, 0, 0, 0, 0}},
+    {{-1,-1,-1,-1, 0, 0, 0, 0}},
+    {{-1,-1,-1,-1,-1, 0, 0, 0}},
+    {{-1,-1,-1,-1,-1,-1, 0, 0}},
+    {{-1,-1,-1,-1,-1,-1,-1, 0}}
 };
 #endif
 
@@ -270,7 +278,8 @@ struct tail_mask_traits<Vec4f>
 {
     template <int tailElements>
     static inline const Vec4f& getTailMask() {
-        return constants::LUM_TAIL_MASKS_V4[tailElements-1];
+        return constants::get<Vec4f>(
+            constants::LUM_TAIL_MASKS_V4[tailElements-1]);
     }
 };
 
@@ -280,7 +289,8 @@ struct tail_mask_traits<Vec8f>
 {
     template <int tailElements>
     static inline const Vec8f& getTailMask() {
-        return constants::LUM_TAIL_MASKS_V8[tailElements-1];
+        return constants::get<Vec8f>(
+            constants::LUM_TAIL_MASKS_V8[tailElements-1]);
     }
 };
 #endif
@@ -295,14 +305,14 @@ inline const VecType& getTailMask() {
 template <>
 inline const Vec4f& getTailMask<Vec4f,0>() {
     assert("This should never be used" == 0);
-    return constants::LUM_TAIL_MASKS_V4[0];
+    return constants::get<Vec4f>(constants::LUM_TAIL_MASKS_V4[0]);
 }
 
 #if PCG_USE_AVX
 template <>
 inline const Vec8f& getTailMask<Vec8f,0>() {
     assert("This should never be used" == 0);
-    return constants::LUM_TAIL_MASKS_V8[0];
+    return constants::get<Vec8f>(constants::LUM_TAIL_MASKS_V8[0]);
 }
 #endif
 
@@ -854,7 +864,7 @@ AccumulateNoHistogramFunctor::accumulate (const float * PCG_RESTRICT Lw,
     AccumulateNoHistogramFunctor acc (LwVecEnd, numElements % VEC_LEN);
     
     tbb::blocked_range<const Vecf*> range(LwVecBegin, LwVecEnd, 32/VEC_LEN);
-    tbb::parallel_reduce (range, acc);
+    pcg::concurrency::parallel_reduce (range, acc, VEC_LEN);
     return static_cast<float>(acc.Lsum());
 }
 
@@ -1092,7 +1102,7 @@ AccumulateHistogramFunctor::accumulate (const float * PCG_RESTRICT Lw,
     AccumulateHistogramFunctor acc (LwVecEnd, params, numElements % VEC_LEN);
     
     tbb::blocked_range<const Vecf*> range(LwVecBegin, LwVecEnd, 32/VEC_LEN);
-    tbb::parallel_reduce (range, acc);
+    pcg::concurrency::parallel_reduce (range, acc, VEC_LEN);
 
     AccumulateHistogramFunctor::hist_t & histogram = params.flatHistogram();
     const float & Lmin_log = params.Lmin_log;
@@ -1185,13 +1195,54 @@ float sumBeyondThreshold(const float * Lw, const float * Lw_end,
 
     // Run in parallel
     SumThresholdFunctor stf(lum_cutoff, threshold);
-    tbb::parallel_reduce(SumThresholdFunctor::range_t(Lw, Lw_end, 4), stf);
+    pcg::concurrency::parallel_reduce(
+        SumThresholdFunctor::range_t(Lw, Lw_end, 4), stf);
     removed_count = stf.removed_count;
     return static_cast<float> (stf.removed_sum);
 }
 
 
 
+// Final step of the estimation, from the average log luminance and the log
+// luminance of the 1 and 99 percentiles, all of them natural logarithms, plus
+// the minimum and maximum non-zero luminance
+Reinhard02::Params paramsFromLogStats(float Lw_log, float L1, float L99,
+    float Lmin, float Lmax)
+{
+    typedef Reinhard02::Params Params;
+    const float Lmin_log = logf (Lmin);
+    const float Lmax_log = logf (Lmax);
+    const float l_w = expf (Lw_log);
+
+    // Extimate the key using the reduced range (equation 4 of the JGT paper)
+    // Note that the equation requires the log2 of Lmin, Lmax and Lw. At this
+    // point L1 = ln(Lmin), L99 = ln(Lmax) and also Lw_log is expressed in
+    // terms of the natural logarithm. Given that 
+    //   log2(exp(x)) == x/ln(x) ~= 1.4427 x
+    // that constant factor cancels out from Equation 4 therefore it is
+    // possible to use the ln-based values.
+    const float key = (L99-L1) > std::numeric_limits<float>::min() ?
+        (0.18f * powf (4.0f, (2.0f*Lw_log - L1-L99) / (L99 - L1))) : 0.18f;
+
+    // Use the full range for the white point (equation 5 of the JGT paper)
+    // This computes log2(exp(Lmax_log)) - log2(exp(Lmin_log))
+    // The expression checks that the formula will be larger than the average
+    // log luminance
+    const float full_range = 1.442695040888963f * (Lmax_log - Lmin_log);
+    float l_white = full_range > 1.4426950408f*Lw_log + 4.415037499278f ?
+        (1.5f * exp2f(full_range - 5.0f)) : (1.5f * expf(Lmax_log));
+    assert (l_white >= l_w);
+    // If the largest luminance value is valid and large enough, the white
+    // point value might have overflowed into infinity
+    if (l_white == std::numeric_limits<float>::infinity()) {
+        l_white = std::max(0.125f * std::numeric_limits<float>::max(), l_w);
+    }
+   
+    return Params(key, l_white, l_w, Lmin, Lmax);
+}
+
+
+
 // Helper to call the appropriate instantiation of the luminance helper:
 // Stores the luminance in the destination Lw array, zeroing invalid values.
 // Returns the count of zero values and the non-zero minimum and maximum 
@@ -1212,24 +1263,92 @@ void LuminanceHelper(SourceIterator begin, SourceIterator end,
     tbb::blocked_range<SourceIterator> range(begin, end, VEC_LEN);
 
     LuminanceFunctor<SourceIterator> lumFunctor(begin,end,LwVec, tailElements);
-    tbb::parallel_reduce(range, lumFunctor);
+    pcg::concurrency::parallel_reduce(range, lumFunctor, VEC_LEN);
     *outZeroCount = lumFunctor.zero_count;
     *outLmin      = lumFunctor.Lmin;
     *outLmax      = lumFunctor.Lmax;
 }
 
+
+
+// Luminance of the scanlines of a view, which need not be aligned, stored
+// consecutively in Lw with the same semantics as LuminanceFunctor
+class LuminanceViewFunctor
+{
+public:
+    LuminanceViewFunctor(const ConstRGBAImageSoAView& view,
+        afloat_t * PCG_RESTRICT Lw) :
+    m_view(view), m_Lw(Lw), zero_count(0),
+    Lmin(float_limits::infinity()), Lmax(-float_limits::infinity()) {}
+
+    LuminanceViewFunctor(LuminanceViewFunctor& l, tbb::split) :
+    m_view(l.m_view), m_Lw(l.m_Lw), zero_count(0),
+    Lmin(float_limits::infinity()), Lmax(-float_limits::infinity()) {}
+
+    void join (LuminanceViewFunctor& rhs)
+    {
+        zero_count += rhs.zero_count;
+        Lmin = fminf (Lmin, rhs.Lmin);
+        Lmax = fmaxf (Lmax, rhs.Lmax);
+    }
+
+    void operator() (const tbb::blocked_range<int>& range)
+    {
+        const int width = m_view.Width();
+        for (int j = range.begin(); j != range.end(); ++j) {
+            const float* r = m_view.GetScanlinePointer<RGBAImageSoA::R>(j);
+            const float* g = m_view.GetScanlinePointer<RGBAImageSoA::G>(j);
+            const float* b = m_view.GetScanlinePointer<RGBAImageSoA::B>(j);
+            float* dest = m_Lw + static_cast<ptrdiff_t>(j) * width;
+            for (int i = 0; i < width; ++i) {
+                const float Lw = 0.27f*r[i] + 0.67f*g[i] + 0.06f*b[i];
+                if (!(Lw >= float_limits::min() && Lw <= float_limits::max())) {
+                    dest[i] = 0.0f;
+                    ++zero_count;
+                    continue;
+                }
+                dest[i] = Lw;
+                Lmin = fminf (Lmin, Lw);
+                Lmax = fmaxf (Lmax, Lw);
+            }
+        }
+    }
+
+private:
+    const ConstRGBAImageSoAView& m_view;
+    afloat_t * const PCG_RESTRICT m_Lw;
+
+public:
+    size_t zero_count;
+    float Lmin;
+    float Lmax;
+};
+
 } // namespace
 
 
 
+namespace pcg
+{
+PCG_SIMD_DECLARE_KERNEL(Reinhard02::Params, estimateParams,
+    (afloat_t * const PCG_RESTRICT Lw, size_t count,
+     size_t zero_count, float Lmin, float Lmax))
+PCG_SIMD_DECLARE_KERNEL(Reinhard02::Params, estimateParams,
+    (const Rgba32F * const pixels, size_t count))
+PCG_SIMD_DECLARE_KERNEL(Reinhard02::Params, estimateParams,
+    (const RGBAImageSoA& img))
+PCG_SIMD_DECLARE_KERNEL(Reinhard02::Params, estimateParams,
+    (const ConstRGBAImageSoAView& view))
+} // namespace pcg
+
+
+
 Reinhard02::Params
-Reinhard02::EstimateParams (afloat_t * const PCG_RESTRICT Lw, size_t count,
-    const LuminanceResult& lumResult)
+pcg::PCG_SIMD_NAMESPACE::estimateParams (afloat_t * const PCG_RESTRICT Lw,
+    size_t count, size_t zero_count, float Lmin, float Lmax)
 {
-    assert (lumResult.zero_count <= count);
-    const size_t& zero_count = lumResult.zero_count;
-    const float& Lmin        = lumResult.Lmin;
-    const float& Lmax        = lumResult.Lmax;
+    typedef Reinhard02::Params Params;
+    assert (zero_count <= count);
 
     // Abort if all the values are zero
     if (zero_count == count) {
@@ -1272,38 +1391,13 @@ Reinhard02::EstimateParams (afloat_t * const PCG_RESTRICT Lw, size_t count,
 
     // Average log luminance (equation 1 of the JGT paper)
     const float Lw_log = L_sum / (count - nonzero_off - removed_count);
-    const float l_w = expf (Lw_log);
-
-    // Extimate the key using the reduced range (equation 4 of the JGT paper)
-    // Note that the equation requires the log2 of Lmin, Lmax and Lw. At this
-    // point L1 = ln(Lmin), L99 = ln(Lmax) and also Lw_log is expressed in
-    // terms of the natural logarithm. Given that 
-    //   log2(exp(x)) == x/ln(x) ~= 1.4427 x
-    // that constant factor cancels out from Equation 4 therefore it is
-    // possible to use the ln-based values.
-    const float key = (L99-L1) > std::numeric_limits<float>::min() ?
-        (0.18f * powf (4.0f, (2.0f*Lw_log - L1-L99) / (L99 - L1))) : 0.18f;
-
-    // Use the full range for the white point (equation 5 of the JGT paper)
-    // This computes log2(exp(Lmax_log)) - log2(exp(Lmin_log))
-    // The expression checks that the formula will be larger than the average
-    // log luminance
-    const float full_range = 1.442695040888963f * (Lmax_log - Lmin_log);
-    float l_white = full_range > 1.4426950408f*Lw_log + 4.415037499278f ?
-        (1.5f * exp2f(full_range - 5.0f)) : (1.5f * expf(Lmax_log));
-    assert (l_white >= l_w);
-    // If the largest luminance value is valid and large enough, the white
-    // point value might have overflowed into infinity
-    if (l_white == std::numeric_limits<float>::infinity()) {
-        l_white = std::max(0.125f * std::numeric_limits<float>::max(), l_w);
-    }
-   
-    return Params(key, l_white, l_w, Lmin, Lmax);
+    return paramsFromLogStats(Lw_log, L1, L99, Lmin, Lmax);
 }
 
 
 Reinhard02::Params
-Reinhard02::EstimateParams (const Rgba32F * const pixels, size_t count)
+pcg::PCG_SIMD_NAMESPACE::estimateParams (const Rgba32F * const pixels,
+    size_t count)
 {
     assert(pixels != NULL);   
     assert(reinterpret_cast<uintptr_t>(pixels) % 16 == 0);
@@ -1321,23 +1415,18 @@ Reinhard02::EstimateParams (const Rgba32F * const pixels, size_t count)
     RGBA32FVec4ImageIterator begin(pixels);
     RGBA32FVec4ImageIterator end(pixels + ((count + 3) & ~0x3));
     const size_t numTail = count % 4;
-    LuminanceResult lumResult;
-    LuminanceHelper(begin, end, Lw, numTail,
-        &lumResult.zero_count, &lumResult.Lmin, &lumResult.Lmax);
+    size_t zero_count;
+    float Lmin, Lmax;
+    LuminanceHelper(begin, end, Lw, numTail, &zero_count, &Lmin, &Lmax);
 
     // Estimate the values
-    Params params = EstimateParams(Lw, count, lumResult);
-    return params;
+    return estimateParams(Lw, count, zero_count, Lmin, Lmax);
 }
 
 
 Reinhard02::Params
-Reinhard02::EstimateParams (const RGBAImageSoA& img)
+pcg::PCG_SIMD_NAMESPACE::estimateParams (const RGBAImageSoA& img)
 {
-    if (img.Size() == 0) {
-        throw IllegalArgumentException("Empty image");
-    }
-
     // Allocate the array with the luminances with AVX[2]-friendly alignment
     const size_t count = static_cast<size_t>(img.Size());
     afloat_t * PCG_RESTRICT Lw = alloc_align<float> (32, (count+7) & ~0x7);  
@@ -1357,11 +1446,255 @@ Reinhard02::EstimateParams (const RGBAImageSoA& img)
     ImageIterator begin = ImageIterator::begin(img);
     ImageIterator end   = ImageIterator::end(img);
     const size_t numTail = count % iterator_traits<ImageIterator>::VEC_LEN;
-    LuminanceResult lumResult;
-    LuminanceHelper(begin, end, Lw, numTail,
-        &lumResult.zero_count, &lumResult.Lmin, &lumResult.Lmax);
+    size_t zero_count;
+    float Lmin, Lmax;
+    LuminanceHelper(begin, end, Lw, numTail, &zero_count, &Lmin, &Lmax);
+
+    // Estimate the values
+    return estimateParams(Lw, count, zero_count, Lmin, Lmax);
+}
+
+
+Reinhard02::Params
+pcg::PCG_SIMD_NAMESPACE::estimateParams (const ConstRGBAImageSoAView& view)
+{
+    // Allocate the array with the luminances with AVX[2]-friendly alignment
+    const size_t count = static_cast<size_t>(view.Size());
+    afloat_t * PCG_RESTRICT Lw = alloc_align<float> (32, (count+7) & ~0x7);  
+    if (Lw == NULL) {
+        throw RuntimeException("Couldn't allocate the memory for the "
+            "luminance buffer");
+    }
+    // Use a special auto pointer to get rid of the aligned buffer
+    auto_afloat_ptr Lw_autoptr (Lw);
+
+    // Compute the luminance one scanline after the other
+    LuminanceViewFunctor lumFunctor(view, Lw);
+    pcg::concurrency::parallel_reduce(tbb::blocked_range<int>(0,
+        view.Height()), lumFunctor, view.Width());
 
     // Estimate the values
-    Params params = EstimateParams(Lw, count, lumResult);
-    return params;
+    return estimateParams(Lw, count, lumFunctor.zero_count,
+        lumFunctor.Lmin, lumFunctor.Lmax);
+}
+
+
+
+// The entry points are only compiled once, for the baseline instruction set
+#if !PCG_SIMD_VARIANT
+
+Reinhard02::Params
+Reinhard02::EstimateParams (afloat_t * const PCG_RESTRICT Lw, size_t count,
+    const LuminanceResult& lumResult)
+{
+    PCG_SIMD_DISPATCH(estimateParams(Lw, count,
+        lumResult.zero_count, lumResult.Lmin, lumResult.Lmax));
+}
+
+
+Reinhard02::Params
+Reinhard02::EstimateParams (const Rgba32F * const pixels, size_t count)
+{
+    PCG_SIMD_DISPATCH(estimateParams(pixels, count));
 }
+
+
+Reinhard02::Params
+Reinhard02::EstimateParams (const RGBAImageSoA& img)
+{
+    if (img.Size() == 0) {
+        throw IllegalArgumentException("Empty image");
+    }
+    PCG_SIMD_DISPATCH(estimateParams(img));
+}
+
+
+Reinhard02::Params
+Reinhard02::EstimateParams (const ConstRGBAImageSoAView& view)
+{
+    if (view.Size() == 0) {
+        throw IllegalArgumentException("Empty image");
+    }
+    PCG_SIMD_DISPATCH(estimateParams(view));
+}
+
+
+
+
+namespace
+{
+
+// The streaming estimator bins the natural logarithm of every valid luminance,
+// from FLT_MIN to FLT_MAX, with the resolution of AccumulateHistogramFunctor
+const float LOG_HIST_MIN = -87.3365448f;
+const float LOG_HIST_MAX =  88.7228394f;
+const float LOG_HIST_RESOLUTION = 100.0f;
+const int   LOG_HIST_BINS = 17607;
+
+struct LogHistogram
+{
+    std::vector<size_t> counts;
+    std::vector<double> logSums;
+    size_t zero_count;
+    float Lmin;
+    float Lmax;
+
+    LogHistogram() : counts(LOG_HIST_BINS, 0), logSums(LOG_HIST_BINS, 0.0),
+    zero_count(0),
+    Lmin(float_limits::infinity()), Lmax(-float_limits::infinity()) {}
+
+    void add(const LogHistogram& other)
+    {
+        for (int i = 0; i < LOG_HIST_BINS; ++i) {
+            counts[i]  += other.counts[i];
+            logSums[i] += other.logSums[i];
+        }
+        zero_count += other.zero_count;
+        Lmin = std::min(Lmin, other.Lmin);
+        Lmax = std::max(Lmax, other.Lmax);
+    }
+
+    // Log luminance at the lower edge of the bin
+    static inline float binLog(int i) {
+        return LOG_HIST_MIN + i / LOG_HIST_RESOLUTION;
+    }
+};
+
+typedef tbb::enumerable_thread_specific<LogHistogram> LogHistogramTLS;
+
+// Adds the luminance of the scanlines to the thread local histograms. As in
+// LuminanceFunctor, only the normal values count, the rest are zeros.
+class AccumulateBandFunctor
+{
+public:
+    AccumulateBandFunctor(const ConstRGBAImageSoAView& img,
+        LogHistogramTLS& tls) :
+    m_img(img), m_tls(tls) {}
+
+    void operator() (const tbb::blocked_range<int>& range) const
+    {
+        LogHistogram& hist = m_tls.local();
+        const int width = m_img.Width();
+        for (int j = range.begin(); j != range.end(); ++j) {
+            const float* r = m_img.GetScanlinePointer<RGBAImageSoA::R>(j);
+            const float* g = m_img.GetScanlinePointer<RGBAImageSoA::G>(j);
+            const float* b = m_img.GetScanlinePointer<RGBAImageSoA::B>(j);
+            for (int i = 0; i < width; ++i) {
+                const float Lw = 0.27f*r[i] + 0.67f*g[i] + 0.06f*b[i];
+                if (!(Lw >= float_limits::min() && Lw <= float_limits::max())) {
+                    ++hist.zero_count;
+                    continue;
+                }
+                const float logLw = logf(Lw);
+                const int idx = std::min(LOG_HIST_BINS - 1, std::max(0,
+                    static_cast<int>((logLw-LOG_HIST_MIN)*LOG_HIST_RESOLUTION)));
+                ++hist.counts[idx];
+                hist.logSums[idx] += logLw;
+                hist.Lmin = fminf(hist.Lmin, Lw);
+                hist.Lmax = fmaxf(hist.Lmax, Lw);
+            }
+        }
+    }
+
+private:
+    const ConstRGBAImageSoAView& m_img;
+    LogHistogramTLS& m_tls;
+};
+
+} // namespace
+
+
+
+struct Reinhard02::Estimator::Impl
+{
+    LogHistogram hist;
+};
+
+
+Reinhard02::Estimator::Estimator() : impl(new Impl)
+{
+}
+
+
+Reinhard02::Estimator::~Estimator()
+{
+    delete impl;
+}
+
+
+void Reinhard02::Estimator::Accumulate(const RGBAImageSoA& band)
+{
+    Accumulate(ConstRGBAImageSoAView(band));
+}
+
+
+void Reinhard02::Estimator::Accumulate(const ConstRGBAImageSoAView& band)
+{
+    LogHistogramTLS tls;
+    AccumulateBandFunctor functor(band, tls);
+    pcg::concurrency::parallel_for(tbb::blocked_range<int>(0, band.Height()),
+        functor, band.Width());
+    for (LogHistogramTLS::const_iterator it = tls.begin();
+         it != tls.end(); ++it) {
+        impl->hist.add(*it);
+    }
+}
+
+
+Reinhard02::Params Reinhard02::Estimator::Estimate() const
+{
+    const LogHistogram& hist = impl->hist;
+    size_t count = 0;
+    double L_sum = 0.0;
+    for (int i = 0; i < LOG_HIST_BINS; ++i) {
+        count += hist.counts[i];
+        L_sum += hist.logSums[i];
+    }
+    if (count == 0 && hist.zero_count == 0) {
+        throw IllegalArgumentException("Empty image");
+    }
+    if (count == 0) {
+        return Params(0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    // Percentiles 1 and 99, as the lower edges of their bins
+    const float Lmin_log = logf (hist.Lmin);
+    const float Lmax_log = logf (hist.Lmax);
+    float L1  = Lmin_log;
+    float L99 = Lmax_log;
+    const ptrdiff_t threshold = static_cast<ptrdiff_t> (0.01 * count);
+    if ((Lmax_log - Lmin_log) > 5e-8) {
+        for (ptrdiff_t sum = 0, i = LOG_HIST_BINS - 1; i >= 0; --i) {
+            sum += hist.counts[i];
+            if (sum > threshold) {
+                L99 = std::max(Lmin_log, LogHistogram::binLog(i));
+                break;
+            }
+        }
+        for (ptrdiff_t sum = 0, i = 0; i < LOG_HIST_BINS; ++i) {
+            sum += hist.counts[i];
+            if (sum > threshold) {
+                L1 = std::min(L99, std::max(Lmin_log, LogHistogram::binLog(i)));
+                break;
+            }
+        }
+    }
+
+    // Remove the same outliers as sumBeyondThreshold, at the granularity
+    // of the bins
+    const float log_cutoff = expf (L99);
+    ptrdiff_t removed_count = 0;
+    double removed_sum = 0.0;
+    for (int i = LOG_HIST_BINS - 1; i >= 0 && removed_count < threshold &&
+         LogHistogram::binLog(i) > log_cutoff; --i) {
+        removed_count += hist.counts[i];
+        removed_sum   += hist.logSums[i];
+    }
+
+    // Average log luminance (equation 1 of the JGT paper)
+    const float Lw_log = static_cast<float>((L_sum - removed_sum) /
+        (count - removed_count));
+    return paramsFromLogStats(Lw_log, L1, L99, hist.Lmin, hist.Lmax);
+}
+
+#endif // !PCG_SIMD_VARIANT
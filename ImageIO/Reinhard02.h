@@ -20,6 +20,7 @@
 #include "ImageIO.h"
 #include "Image.h"
 #include "ImageSoA.h"
+#include "ImageView.h"
 #include "Rgba32F.h"
 
 namespace pcg
@@ -68,6 +69,40 @@ public:
 
     static IMAGEIO_API Params EstimateParams (const RGBAImageSoA& img);
 
+    // Parameters of the pixels of a view, such as a region of an image. The
+    // result is that of a copy of those pixels, up to rounding.
+    static IMAGEIO_API Params EstimateParams (const ConstRGBAImageSoAView& view);
+
+
+    // Estimates the parameters of an image given in consecutive bands of
+    // scanlines, so that huge images never need to be in memory at once.
+    // The log-luminances are binned into a fixed histogram spanning the whole
+    // float range, with the same resolution as EstimateParams, thus the
+    // parameters are very close to those of the whole image, but not
+    // necessarily identical.
+    class IMAGEIO_API Estimator
+    {
+    public:
+        Estimator();
+        ~Estimator();
+
+        // Adds the pixels of the band to the statistics
+        void Accumulate(const RGBAImageSoA& band);
+        void Accumulate(const ConstRGBAImageSoAView& band);
+
+        // Parameters for all the pixels accumulated so far. It throws
+        // IllegalArgumentException if there were no pixels.
+        Params Estimate() const;
+
+    private:
+        // Non-copyable
+        Estimator(const Estimator&);
+        Estimator& operator=(const Estimator&);
+
+        struct Impl;
+        Impl *impl;
+    };
+
 
 private:
 
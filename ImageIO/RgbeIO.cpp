@@ -42,13 +42,23 @@
 
 #include "RgbeIO.h"
 #include "RgbeIOPrivate.h"
+#include "LoadWindowPrivate.h"
 #include "Exception.h"
-#include "Vec4f.h"
-#include "Vec4i.h"
+#include "MappedFile.h"
+#include "ConcurrencyPrivate.h"
 
 #include <string.h>
 #include <fstream>
 #include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 using namespace pcg;
 
@@ -193,16 +203,73 @@ int rgbeions::readHeader(istream &is, int &width, int &height, rgbe_header_info
 }
 
 
+namespace
+{
+
+// Index of the lowest set bit, the value must not be zero
+inline int countTrailingZeros(unsigned int value)
+{
+	assert(value != 0);
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(value);
+#endif
+}
+
+// Counts how many consecutive bytes starting at data[beg] have the same value,
+// up to 127 and without going past numbytes. It always returns at least 1.
+// Several bytes are compared at once, finding the first mismatch through
+// the comparison bit mask.
+inline int runLength(const unsigned char *data, int beg, int numbytes)
+{
+	const int limit = std::min(127, numbytes - beg);
+	if (limit <= 1)
+		return 1;
+
+	const unsigned char *ptr = data + beg;
+	int count = 1;
+#if PCG_USE_AVX2
+	const __m256i value32 = _mm256_set1_epi8(static_cast<char>(ptr[0]));
+	while (count + 32 <= limit) {
+		const __m256i x = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(ptr + count));
+		const unsigned int mask = static_cast<unsigned int>(
+			_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, value32)));
+		if (mask != 0xFFFFFFFFu)
+			return count + countTrailingZeros(~mask);
+		count += 32;
+	}
+#endif
+	const __m128i value = _mm_set1_epi8(static_cast<char>(ptr[0]));
+	while (count + 16 <= limit) {
+		const __m128i x = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(ptr + count));
+		const unsigned int mask = static_cast<unsigned int>(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(x, value)));
+		if (mask != 0xFFFFu)
+			return count + countTrailingZeros(~mask);
+		count += 16;
+	}
+	while ((count < limit) && (ptr[0] == ptr[count]))
+		count++;
+	return count;
+}
+
+} // namespace
+
+
 /* The code below is only needed for the run-length encoded files. */
 /* Run length encoding adds considerable complexity but does */
 /* save some space.  For each scanline, each channel (r,g,b,e) is */
 /* encoded separately for better compression. */
-int rgbeions::writeBytes_RLE(ostream &os, const unsigned char *data, int numbytes)
+void rgbeions::encodeBytes_RLE(const unsigned char *data, int numbytes,
+	std::vector<unsigned char> &out)
 {
 	int cur, beg_run, run_count, old_run_count, nonrun_count;
-	unsigned char buf[2];
 	const int MINRUNLENGTH = 4;
-	const char *bufC = reinterpret_cast<char*>(&buf[0]);	// To make os.write() happy
 
 	cur = 0;
 	while(cur < numbytes) {
@@ -212,18 +279,12 @@ int rgbeions::writeBytes_RLE(ostream &os, const unsigned char *data, int numbyte
 		while((run_count < MINRUNLENGTH) && (beg_run < numbytes)) {
 			beg_run += run_count;
 			old_run_count = run_count;
-			run_count = 1;
-			while((beg_run + run_count < numbytes) && (run_count < 127)
-				&& (data[beg_run] == data[beg_run + run_count]))
-				run_count++;
+			run_count = runLength(data, beg_run, numbytes);
 		}
 		/* if data before next big run is a short run then write it as such */
 		if ((old_run_count > 1)&&(old_run_count == beg_run - cur)) {
-			buf[0] = 128 + old_run_count;   /*write short run*/
-			buf[1] = data[cur];
-			os.write(bufC, 2);
-			if ( os.fail() )
-				return rgbe_error(rgbe_write_error,NULL);
+			out.push_back(static_cast<unsigned char>(128 + old_run_count));
+			out.push_back(data[cur]);
 			cur = beg_run;
 		}
 		/* write out bytes until we reach the start of the next run */
@@ -231,25 +292,31 @@ int rgbeions::writeBytes_RLE(ostream &os, const unsigned char *data, int numbyte
 			nonrun_count = beg_run - cur;
 			if (nonrun_count > 128) 
 				nonrun_count = 128;
-			buf[0] = nonrun_count;
-			os.write(bufC, 1);
-			if ( os.fail() )
-				return rgbe_error(rgbe_write_error,NULL);
-			os.write(reinterpret_cast<const char*>(&data[cur]), nonrun_count);
-			if ( os.fail() )
-				return rgbe_error(rgbe_write_error,NULL);
+			out.push_back(static_cast<unsigned char>(nonrun_count));
+			out.insert(out.end(), data + cur, data + cur + nonrun_count);
 			cur += nonrun_count;
 		}
 		/* write out next run if one was found */
 		if (run_count >= MINRUNLENGTH) {
-			buf[0] = 128 + run_count;
-			buf[1] = data[beg_run];
-			os.write(bufC, 2);
-			if ( os.fail() )
-				return rgbe_error(rgbe_write_error,NULL);
+			out.push_back(static_cast<unsigned char>(128 + run_count));
+			out.push_back(data[beg_run]);
 			cur += run_count;
 		}
 	}
+}
+
+
+int rgbeions::writeBytes_RLE(ostream &os, const unsigned char *data, int numbytes)
+{
+	std::vector<unsigned char> buffer;
+	buffer.reserve(numbytes + numbytes/128 + 1);
+	encodeBytes_RLE(data, numbytes, buffer);
+	if (!buffer.empty()) {
+		os.write(reinterpret_cast<const char*>(&buffer[0]),
+			static_cast<std::streamsize>(buffer.size()));
+		if ( os.fail() )
+			return rgbe_error(rgbe_write_error,NULL);
+	}
 	return RGBE_RETURN_SUCCESS;
 }
 
@@ -262,150 +329,301 @@ namespace pcg {
 		// ####################################################################
 		// ####         READING         #######################################
 		// ####################################################################
-		
-		// Forward declaration
-		template <class T>
-		int readPixels_RLE(istream&, T*, int, int);
 
-		// The basic utility methods for loading from an RGBE file which has
-		// already been successfully open. This handles the general case by going line by line
-		template < class T, ScanLineMode S >
-		int read(istream &is, Image<T,S> &img)
+		// Pixel data which follows the header. Memory streams are accessed
+		// in place, otherwise the pixels are read into a buffer only as far
+		// as the scanlines go: seekable streams are read ahead in chunks and
+		// then sought back right after the last scanline, while the other
+		// streams are read exactly, one piece of scanline at a time.
+		struct PixelSource
 		{
-			const int width  = img.Width();
-			const int height = img.Height();
-			for (int j = 0; j < height; ++j) {
+			MemoryStreamBuf *memBuf;
+			istream *is;
+			istream::pos_type start;
+			std::vector<unsigned char> buffer;
+			const unsigned char *data;
+			size_t size;
+
+			PixelSource() : memBuf(NULL), is(NULL), start(-1),
+				data(NULL), size(0) {}
+
+			int init(istream &stream) {
+				memBuf = MemoryStreamBuf::fromStream(stream);
+				if (memBuf != NULL) {
+					data = reinterpret_cast<const unsigned char*>(
+						memBuf->current());
+					size = memBuf->remaining();
+					return RGBE_RETURN_SUCCESS;
+				}
 
-				T* dest = img.GetScanlinePointer(j, TopDown);
-				int retVal = readPixels_RLE(is, dest, width, 1);
-				if (retVal != RGBE_RETURN_SUCCESS) {
-					return retVal;
+				if (!stream.good()) {
+					return rgbe_error(rgbe_read_error,NULL);
 				}
+				is = &stream;
+				start = stream.tellg();
+				return RGBE_RETURN_SUCCESS;
 			}
-			return RGBE_RETURN_SUCCESS;
-		}
 
-		// Easy case: the destination is TopDown, just as the RGBE files
-		template <class T>
-		int read(istream &is, Image<T,TopDown> &img)
-		{
-			return readPixels_RLE(is, img.GetDataPointer(), img.Width(), img.Height());
-		}
+			inline bool isSeekable() const {
+				return start != istream::pos_type(-1);
+			}
 
-		/* simple read routine.  will not correctly handle run length encoding.
-		 * It's also quite slow because it reads element by element and converts them on the fly
-		 */
-		template <class T>
-		int readPixels(istream &is, T *data, int numpixels)
+			// Makes available at least the first "end" bytes of the pixels,
+			// updating data and size. Returns false if the source is shorter.
+			bool ensure(size_t end) {
+				if (end <= size) {
+					return true;
+				}
+				if (is == NULL || !is->good()) {
+					return false;
+				}
+
+				const size_t CHUNK_SIZE = 1 << 20;
+				size_t count = end - size;
+				if (isSeekable()) {
+					count = std::max(count, std::max(size, CHUNK_SIZE));
+				}
+				buffer.resize(size + count);
+				is->read(reinterpret_cast<char*>(&buffer[size]),
+					static_cast<std::streamsize>(count));
+				size += static_cast<size_t>(is->gcount());
+				buffer.resize(size);
+				data = buffer.empty() ? NULL : &buffer[0];
+
+				// Reading ahead past the end of the stream is expected
+				if (isSeekable() && !is->bad()) {
+					is->clear();
+				}
+				return end <= size;
+			}
+
+			// Advances the stream right after the pixels used
+			void consume(size_t count) {
+				if (memBuf != NULL) {
+					memBuf->consume(count);
+				}
+				else if (isSeekable()) {
+					is->clear();
+					is->seekg(start + static_cast<std::streamoff>(count));
+				}
+			}
+		};
+
+
+		// Location of each scanline within a memory buffer with the RGBE
+		// pixels. RLE scanlines are not self-delimiting, hence all the headers
+		// and counts are walked serially once; after that each scanline may
+		// be decoded independently. Files are allowed to switch to flat
+		// (non-RLE) pixels at any scanline, from which point all the
+		// remaining scanlines are stored flat, contiguous to each other.
+		struct ScanlineIndex
 		{
+			std::vector<size_t> offsets;
+			int flatStart;
+			size_t end;
 
-			Rgbe rgbe;
+			ScanlineIndex() : flatStart(0), end(0) {}
 
-			while(numpixels-- > 0) {
-				is.read(reinterpret_cast<char*>(&rgbe), sizeof(Rgbe));
-				if ( is.fail() )
-					return rgbe_error(rgbe_read_error,NULL);
-				*data++ = rgbe;
+			inline bool isFlat(int j) const {
+				return j >= flatStart;
 			}
-			return RGBE_RETURN_SUCCESS;
-		}
+		};
 
-		// If we are just directly copying RGBE pixels we can do much better (about 10x faster). 
-		// It assumes that the data has been already allocated!
-		template <>
-		int readPixels(istream &is, Rgbe *data, int numpixels)
+		// Walks the scanlines of the source, which reads no further than
+		// the end of the last one. Note that the buffer of the source may be
+		// reallocated after each call to ensure.
+		int scanOffsets_RLE(PixelSource &source,
+			int scanline_width, int num_scanlines, ScanlineIndex &index)
 		{
-			is.read(reinterpret_cast<char*>(data), sizeof(Rgbe)*numpixels);
-			if ( is.fail() )
+			index.offsets.resize(num_scanlines);
+			index.flatStart = 0;
+
+			const size_t scanline_bytes = 4 * static_cast<size_t>(scanline_width);
+			size_t pos = 0;
+			int j = 0;
+
+			// Run length encoding is not allowed for these widths
+			if ((scanline_width >= 8) && (scanline_width <= 0x7fff)) {
+				for (; j < num_scanlines; ++j) {
+					if (!source.ensure(pos + 4)) {
+						return rgbe_error(rgbe_read_error,NULL);
+					}
+					const unsigned char *rgbe = source.data + pos;
+					if ((rgbe[0] != 2)||(rgbe[1] != 2)||(rgbe[2] & 0x80)) {
+						/* the rest of the file is not run length encoded */
+						break;
+					}
+					if ((((int)rgbe[2])<<8 | rgbe[3]) != scanline_width) {
+						return rgbe_error(rgbe_format_error,"wrong scanline width");
+					}
+					index.offsets[j] = pos;
+					pos += 4;
+
+					/* walk each of the four channels without decoding them */
+					for (int i = 0; i < 4; ++i) {
+						int remaining = scanline_width;
+						while (remaining > 0) {
+							if (!source.ensure(pos + 2)) {
+								return rgbe_error(rgbe_read_error,NULL);
+							}
+							const unsigned char code = source.data[pos];
+							int count;
+							size_t len;
+							if (code > 128) {
+								/* a run of the same value */
+								count = code - 128;
+								len = 2;
+							}
+							else {
+								/* a non-run */
+								count = code;
+								len = 1 + count;
+							}
+							if ((count == 0)||(count > remaining)) {
+								return rgbe_error(rgbe_format_error,"bad scanline data");
+							}
+							if (!source.ensure(pos + len)) {
+								return rgbe_error(rgbe_read_error,NULL);
+							}
+							remaining -= count;
+							pos += len;
+						}
+					}
+				}
+			}
+
+			index.flatStart = j;
+			if (!source.ensure(pos +
+				static_cast<size_t>(num_scanlines - j) * scanline_bytes)) {
 				return rgbe_error(rgbe_read_error,NULL);
+			}
+			for (; j < num_scanlines; ++j) {
+				index.offsets[j] = pos;
+				pos += scanline_bytes;
+			}
+			index.end = pos;
 			return RGBE_RETURN_SUCCESS;
 		}
 
+
+		// Converts flat RGBE pixels into the destination type
 		template <class T>
-		int readPixels_RLE(istream &is, T *data, int scanline_width,
-			int num_scanlines)
+		inline void convertPixels(T *dest, const unsigned char *src,
+			int numpixels)
 		{
-			Rgbe rgbe;
-			unsigned char *scanline_buffer = NULL, *ptr = NULL, *ptr_end = NULL;
-			int i, count;
-			unsigned char buf[2];
-
-			if ((scanline_width < 8)||(scanline_width > 0x7fff))
-				/* run length encoding is not allowed so read flat*/
-				return readPixels(is,data,scanline_width*num_scanlines);
-			scanline_buffer = NULL;
-			/* read in each successive scanline */
-			while(num_scanlines > 0) {
-				is.read(reinterpret_cast<char*>(&rgbe), sizeof(rgbe));
-				if ( is.fail() ) {
-					delete [] scanline_buffer;
-					return rgbe_error(rgbe_read_error,NULL);
-				}
-				if ((rgbe[0] != 2)||(rgbe[1] != 2)||(rgbe[2] & 0x80)) {
-					/* this file is not run length encoded */
-					*data++ = rgbe;
-					delete [] scanline_buffer;
-					return readPixels(is,data,scanline_width*num_scanlines-1);
+			for (int i = 0; i < numpixels; ++i, src += 4) {
+				dest[i] = Rgbe(src[0], src[1], src[2], src[3]);
+			}
+		}
+
+		template <>
+		inline void convertPixels(Rgbe *dest, const unsigned char *src,
+			int numpixels)
+		{
+			memcpy(reinterpret_cast<unsigned char*>(dest), src,
+				sizeof(Rgbe)*numpixels);
+		}
+
+
+		// Expands an RLE scanline which has already been validated by
+		// scanOffsets_RLE into the four separate channels of the buffer
+		inline void decodeScanline_RLE(const unsigned char *src,
+			unsigned char *scanline_buffer, int scanline_width)
+		{
+			unsigned char *ptr = scanline_buffer;
+			const unsigned char *ptr_end = ptr + 4 * scanline_width;
+			src += 4;
+			while (ptr < ptr_end) {
+				if (*src > 128) {
+					/* a run of the same value */
+					const int count = *src - 128;
+					memset(ptr, src[1], count);
+					ptr += count;
+					src += 2;
 				}
-				if ((((int)rgbe[2])<<8 | rgbe[3]) != scanline_width) {
-					delete [] scanline_buffer;
-					return rgbe_error(rgbe_format_error,"wrong scanline width");
+				else {
+					/* a non-run */
+					const int count = *src;
+					memcpy(ptr, src + 1, count);
+					ptr += count;
+					src += 1 + count;
 				}
-				if (scanline_buffer == NULL)
-					scanline_buffer = new unsigned char[4*scanline_width];
-				if (scanline_buffer == NULL) 
-					return rgbe_error(rgbe_memory_error,"unable to allocate buffer space");
-
-				ptr = &scanline_buffer[0];
-				/* read each of the four channels for the scanline into the buffer */
-				for(i=0;i<4;i++) {
-					ptr_end = &scanline_buffer[(i+1)*scanline_width];
-					while(ptr < ptr_end) {
-						is.read(reinterpret_cast<char*>(&buf[0]), 2);
-						if ( is.fail() ) {
-							delete [] scanline_buffer;
-							return rgbe_error(rgbe_read_error,NULL);
-						}
-						if (buf[0] > 128) {
-							/* a run of the same value */
-							count = buf[0]-128;
-							if ((count == 0)||(count > ptr_end - ptr)) {
-								delete [] scanline_buffer;
-								return rgbe_error(rgbe_format_error,"bad scanline data");
-							}
-							while(count-- > 0)
-								*ptr++ = buf[1];
-						}
-						else {
-							/* a non-run */
-							count = buf[0];
-							if ((count == 0)||(count > ptr_end - ptr)) {
-								delete [] scanline_buffer;
-								return rgbe_error(rgbe_format_error,"bad scanline data");
-							}
-							*ptr++ = buf[1];
-							if (--count > 0) {
-								is.read( reinterpret_cast<char*>(ptr), count );
-								if ( is.fail() ) {
-									delete [] scanline_buffer;
-									return rgbe_error(rgbe_read_error,NULL);
-								}
-								ptr += count;
-							}
-						}
+			}
+		}
+
+
+		// TBB functor which decodes a range of scanlines using a previously
+		// computed index. Since the index has already validated all the run
+		// counts, the decoding itself cannot fail.
+		template <class T, ScanLineMode S>
+		class DecodeFunctor
+		{
+		public:
+			typedef tbb::blocked_range<int> Range;
+
+			DecodeFunctor(const unsigned char *data, const ScanlineIndex &index,
+				Image<T,S> &img) :
+			m_data(data), m_index(index), m_img(img) {}
+
+			void operator() (const Range &range) const
+			{
+				const int width = m_img.Width();
+				std::vector<unsigned char> scanline_buffer;
+
+				for (int j = range.begin(); j != range.end(); ++j) {
+					const unsigned char *src = m_data + m_index.offsets[j];
+					T *dest = m_img.GetScanlinePointer(j, TopDown);
+					if (m_index.isFlat(j)) {
+						convertPixels(dest, src, width);
+						continue;
+					}
+
+					if (scanline_buffer.empty()) {
+						scanline_buffer.resize(4 * width);
+					}
+					decodeScanline_RLE(src, &scanline_buffer[0], width);
+
+					/* now transpose the channels into pixels */
+					const unsigned char *r = &scanline_buffer[0];
+					const unsigned char *g = r + width;
+					const unsigned char *b = g + width;
+					const unsigned char *e = b + width;
+					for (int i = 0; i < width; ++i) {
+						dest[i] = Rgbe(r[i], g[i], b[i], e[i]);
 					}
 				}
-				/* now convert data from buffer into floats */
-				for(i=0;i<scanline_width;i++) {
-					rgbe.r = scanline_buffer[i];
-					rgbe.g = scanline_buffer[i+scanline_width];
-					rgbe.b = scanline_buffer[i+2*scanline_width];
-					rgbe.e = scanline_buffer[i+3*scanline_width];
-					*data++ = rgbe;
-				}
-				num_scanlines--;
 			}
-			delete [] scanline_buffer;
+
+		private:
+			const unsigned char *m_data;
+			const ScanlineIndex &m_index;
+			Image<T,S> &m_img;
+		};
+
+
+		// Reads the pixels of an RGBE file which has already been
+		// successfully open into an image of the appropriate size: first the
+		// start of each scanline is located, then the scanlines are decoded
+		// in parallel. The stream is left right after the last scanline.
+		template < class T, ScanLineMode S >
+		int read(istream &is, Image<T,S> &img)
+		{
+			PixelSource source;
+			int retVal = source.init(is);
+			if (retVal != RGBE_RETURN_SUCCESS) {
+				return retVal;
+			}
+
+			ScanlineIndex index;
+			retVal = scanOffsets_RLE(source, img.Width(), img.Height(), index);
+			if (retVal != RGBE_RETURN_SUCCESS) {
+				return retVal;
+			}
+
+			DecodeFunctor<T,S> functor(source.data, index, img);
+			pcg::concurrency::parallel_for(typename DecodeFunctor<T,S>::Range(0,
+				img.Height()), functor, img.Width());
+			source.consume(index.end);
 			return RGBE_RETURN_SUCCESS;
 		}
 
@@ -414,33 +632,108 @@ namespace pcg {
 		// ####         WRITING         #######################################
 		// ####################################################################
 		
+		// Encodes a range of scanlines of the band starting at firstRow, each
+		// one into its own buffer so that they can be written in order.
+		template <class T, ScanLineMode S>
+		class EncodeFunctor
+		{
+		public:
+			typedef tbb::blocked_range<int> Range;
+
+			EncodeFunctor(const Image<T,S> &img, int firstRow,
+				std::vector<std::vector<unsigned char> > &buffers) :
+			m_img(img), m_firstRow(firstRow), m_buffers(buffers) {}
+
+			void operator() (const Range &range) const
+			{
+				const int width = m_img.Width();
+				std::vector<unsigned char> scanline_buffer(4 * width);
+				unsigned char *r = &scanline_buffer[0];
+				unsigned char *g = r + width;
+				unsigned char *b = g + width;
+				unsigned char *e = b + width;
+
+				for (int j = range.begin(); j != range.end(); ++j) {
+					const T *pixels =
+						m_img.GetScanlinePointer(m_firstRow + j, TopDown);
+					for (int i = 0; i < width; ++i) {
+						const Rgbe rgbe = (Rgbe)pixels[i];
+						r[i] = rgbe[0];
+						g[i] = rgbe[1];
+						b[i] = rgbe[2];
+						e[i] = rgbe[3];
+					}
+
+					std::vector<unsigned char> &out = m_buffers[j];
+					out.clear();
+					out.push_back(2);
+					out.push_back(2);
+					out.push_back(static_cast<unsigned char>(width >> 8));
+					out.push_back(static_cast<unsigned char>(width & 0xFF));
+
+					/* encode each of the four channels separately */
+					/* first red, then green, then blue, then exponent */
+					for (int i = 0; i < 4; ++i) {
+						encodeBytes_RLE(&scanline_buffer[i*width], width, out);
+					}
+				}
+			}
+
+		private:
+			const Image<T,S> &m_img;
+			const int m_firstRow;
+			std::vector<std::vector<unsigned char> > &m_buffers;
+		};
+
+
 		// Forward declaration
 		template <class T>
-		int writePixels_RLE(ostream&, const T*, int, int);
+		int writePixels(ostream&, const T*, const int);
 
 		// The basic utility methods for saving to an RGBE file which has
-		// already been successfully open. This handles the general case by going line by line
+		// already been successfully open. The scanlines are run length
+		// encoded in parallel by bands, so that only the compressed data of
+		// a single band is kept in memory, and each band is written in order.
 		template < class T, ScanLineMode S >
 		int write(ostream &os, const Image<T,S> &img)
 		{
 			const int width  = img.Width();
 			const int height = img.Height();
-			for (int j = 0; j < height; ++j) {
 
-				T* dest = img.GetScanlinePointer(j, TopDown);
-				int retVal = writePixels_RLE(os, dest, width, 1);
-				if (retVal != RGBE_RETURN_SUCCESS) {
-					return retVal;
+			if ((width < 8)||(width > 0x7fff)) {
+				/* run length encoding is not allowed so write flat*/
+				for (int j = 0; j < height; ++j) {
+					const T* src = img.GetScanlinePointer(j, TopDown);
+					int retVal = writePixels(os, src, width);
+					if (retVal != RGBE_RETURN_SUCCESS) {
+						return retVal;
+					}
 				}
+				return RGBE_RETURN_SUCCESS;
 			}
-			return RGBE_RETURN_SUCCESS;
-		}
 
-		// Easy case: the destination is TopDown, just as the RGBE files
-		template <class T>
-		int write(ostream &os, const Image<T,TopDown> &img)
-		{
-			return writePixels_RLE(os, img.GetDataPointer(), img.Width(), img.Height());
+			// About 4 million pixels per band
+			const int bandHeight = std::max(1, (1 << 22) / width);
+			std::vector<std::vector<unsigned char> > buffers(
+				std::min(bandHeight, height));
+
+			for (int firstRow = 0; firstRow < height; firstRow += bandHeight) {
+				const int rows = std::min(bandHeight, height - firstRow);
+				EncodeFunctor<T,S> functor(img, firstRow, buffers);
+				pcg::concurrency::parallel_for(
+					typename EncodeFunctor<T,S>::Range(0, rows), functor,
+					img.Width());
+
+				for (int j = 0; j < rows; ++j) {
+					const std::vector<unsigned char> &buf = buffers[j];
+					os.write(reinterpret_cast<const char*>(&buf[0]),
+						static_cast<std::streamsize>(buf.size()));
+					if ( os.fail() ) {
+						return rgbe_error(rgbe_write_error,NULL);
+					}
+				}
+			}
+			return RGBE_RETURN_SUCCESS;
 		}
 
 		/* simple write routine that does not use run length encoding */
@@ -478,54 +771,6 @@ namespace pcg {
 		}
 
 
-		template <class T>
-		int writePixels_RLE(ostream &os, const T *pixels, int scanline_width,
-			int num_scanlines)
-		{
-			unsigned char rgbe[4];
-			unsigned char *buffer;
-			int i, err;
-
-			if ((scanline_width < 8)||(scanline_width > 0x7fff))
-				/* run length encoding is not allowed so write flat*/
-				return writePixels(os,pixels,scanline_width*num_scanlines);
-			buffer = new unsigned char[4*scanline_width];
-			if (buffer == NULL) 
-				/* no buffer space so write flat */
-				return writePixels(os,pixels,scanline_width*num_scanlines);
-			while(num_scanlines-- > 0) {
-				rgbe[0] = 2;
-				rgbe[1] = 2;
-				rgbe[2] = scanline_width >> 8;
-				rgbe[3] = scanline_width & 0xFF;
-				os.write(reinterpret_cast<char*>(&rgbe[0]), 4);
-				if ( os.fail() ) {
-					delete [] buffer;
-					return rgbe_error(rgbe_write_error,NULL);
-				}
-				for(i=0;i<scanline_width;i++) {
-
-					const Rgbe rgbe = (Rgbe)*pixels++;
-					buffer[i]                  = rgbe[0];
-					buffer[i+scanline_width]   = rgbe[1];
-					buffer[i+2*scanline_width] = rgbe[2];
-					buffer[i+3*scanline_width] = rgbe[3];
-				}
-				/* write out each of the four channels separately run length encoded */
-				/* first red, then green, then blue, then exponent */
-				for(i=0;i<4;i++) {
-					if ((err = writeBytes_RLE(os,&buffer[i*scanline_width],
-						scanline_width)) != RGBE_RETURN_SUCCESS) {
-							delete [] buffer;
-							return err;
-					}
-				}
-			}
-			delete [] buffer;
-			return RGBE_RETURN_SUCCESS;
-		}
-
-
 		// ####################################################################
 		// ####         LOADING         #######################################
 		// ####################################################################
@@ -559,18 +804,16 @@ namespace pcg {
 			}
 		}
 
-		// The same as above, only that it creates the stream for you
+		// The same as above, only that it maps the file for you
 		template < class T, ScanLineMode S >
 		inline void Load(Image<T,S> &img, const char *filename) {
-			
-			ifstream rgbeFile(filename, ios_base::binary);
-			if (! rgbeFile.fail() ) {
-				Load(img, rgbeFile);
-			}
-			else {
-				// Something terrible takes place here
-				throw IOException("RGBE Load badness!!");
+
+			FileInputStream rgbeFile;
+			if (!rgbeFile.open(filename)) {
+				throw IOException(std::string("Couldn't open the file ") +
+					filename);
 			}
+			Load(img, rgbeFile);
 		}
 
 
@@ -724,186 +967,263 @@ void RgbeIO::Save(const Image<Rgb32F,BottomUp> &img, const char *filename) {
 namespace
 {
 
-inline void stream(Vec4f& target, const Vec4f& value) {
-    _mm_stream_ps(reinterpret_cast<float*>(&target), value);
-}
+// Fused decoder: each RLE scanline is expanded into a small buffer which
+// stays in cache and is immediately converted into the float planes. The
+// scanline j of the image comes from the scanline firstRow + j of the file.
+class DecodeSoAFunctor
+{
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    DecodeSoAFunctor(const unsigned char* data,
+        const rgbeions::ScanlineIndex& index, RGBAImageSoA& img,
+        int firstRow = 0) :
+    m_data(data), m_index(index), m_img(img), m_firstRow(firstRow) {}
+
+    void operator() (const Range& range) const
+    {
+        const int width = m_img.Width();
+        std::vector<unsigned char> scanline_buffer;
+
+        for (int j = range.begin(); j != range.end(); ++j) {
+            const int sy = m_firstRow + j;
+            const unsigned char* src = m_data + m_index.offsets[sy];
+            if (m_index.isFlat(sy)) {
+                rgbeions::convertScanlineSoA(src, false, m_img, j);
+                continue;
+            }
+
+            if (scanline_buffer.empty()) {
+                scanline_buffer.resize(4 * width);
+            }
+            rgbeions::decodeScanline_RLE(src, &scanline_buffer[0], width);
+            rgbeions::convertScanlineSoA(&scanline_buffer[0], true, m_img, j);
+        }
+
+        // Make the streamed values visible before the task finishes
+        _mm_sfence();
+    }
 
-inline Vec4i sll(const Vec4i& a, int count) {
-    return _mm_slli_epi32(a, count);
-}
+private:
+    const unsigned char* m_data;
+    const rgbeions::ScanlineIndex& m_index;
+    RGBAImageSoA& m_img;
+    const int m_firstRow;
+};
 
-inline Vec4i srl(const Vec4i& a, int count) {
-    return _mm_srli_epi32(a, count);
-}
 
-inline Vec4f toFloat(const Vec4i& a) {
-    return _mm_cvtepi32_ps(a);
-}
 
-inline Vec4f castAsFloat(const Vec4i& a) {
-    return _mm_castsi128_ps(a);
-}
+void LoadImageSoA(RGBAImageSoA& img, istream& is)
+{
+    // Read the header
+    int width, height;
+    rgbeions::rgbe_header_info info;
+    if (rgbeions::readHeader(is, width, height, info) !=
+        rgbeions::RGBE_RETURN_SUCCESS) {
+        throw IOException("Couldn't read RGBE header.");
+    }
+    img.Alloc(width, height);
+
+    rgbeions::PixelSource source;
+    rgbeions::ScanlineIndex index;
+    if (source.init(is) != rgbeions::RGBE_RETURN_SUCCESS ||
+        rgbeions::scanOffsets_RLE(source, width, height, index) !=
+        rgbeions::RGBE_RETURN_SUCCESS) {
+        throw IOException("Couldn't read RGBE pixel data.");
+    }
 
-inline Vec4f castAsFloat(const Vec4bi& a) {
-    return _mm_castsi128_ps(a);
+    DecodeSoAFunctor functor(source.data, index, img);
+    pcg::concurrency::parallel_for(DecodeSoAFunctor::Range(0, height),
+        functor, width);
+    source.consume(index.end);
 }
 
-inline Vec4i castAsInt(const Vec4f& a) {
-    return _mm_castps_si128(a);
+
+
+void SaveImageSoA(Image<Rgbe, TopDown>& dest, const RGBAImageSoA& src)
+{
+    dest.Alloc(src.Width(), src.Height());
+    rgbeions::encodeSoA(dest, src);
 }
 
 
 
-void LoadImageSoA(const Image<Rgbe, TopDown>& imgRGBE, RGBAImageSoA& img)
+// Decoder for windows: only the scanlines of the window are decoded, RLE
+// ones still in full, and only the pixels of the window are converted
+template <class ImageCls>
+class DecodeWindowFunctor
 {
-    img.Alloc(imgRGBE.Width(), imgRGBE.Height());
-
-    // Convert them using the RTGI2 method, processing multiple pixels at a time
-    const Vec4i* PCG_RESTRICT vecRGBE =
-        reinterpret_cast<Vec4i*>(imgRGBE.GetDataPointer());
-    assert(reinterpret_cast<uintptr_t>(vecRGBE) % 16 == 0);
-
-    const Vec4i const_0xFF(Vec4i::constant<0xFF>());
-    const Vec4i const_9(Vec4i::constant<9>());
-    const Vec4f const_1p(1.0f);
-
-    typedef Vec4f* PCG_RESTRICT RVec4f;
-    RVec4f rPtr=reinterpret_cast<Vec4f*>(img.GetDataPointer<RGBAImageSoA::R>());
-    RVec4f gPtr=reinterpret_cast<Vec4f*>(img.GetDataPointer<RGBAImageSoA::G>());
-    RVec4f bPtr=reinterpret_cast<Vec4f*>(img.GetDataPointer<RGBAImageSoA::B>());
-    RVec4f aPtr=reinterpret_cast<Vec4f*>(img.GetDataPointer<RGBAImageSoA::A>());
-
-    const int vecCount = imgRGBE.Size() / 4;
-    for (int i = 0; i != vecCount; ++i) {
-        const Vec4i& rgbe = vecRGBE[i];
-        // Unpack the RGBE pixel
-        Vec4f r = toFloat(const_0xFF & rgbe);
-        Vec4f g = toFloat(const_0xFF & (srl(rgbe,  8)));
-        Vec4f b = toFloat(const_0xFF & (srl(rgbe, 16)));
-        Vec4i e = srl(rgbe, 24);
-
-        // Values in the range 1 to 9 would require "denormal" multipliers and
-        // are below minimum values for RGBE exponents so we truncate them to 0
-        const Vec4i exponentMask(e > const_9);
-        e =  sll((e - const_9), 23) & exponentMask;
-        const Vec4f scale = castAsFloat(e);
-
-        r *= scale;
-        g *= scale;
-        b *= scale;
-        stream(rPtr[i], r);
-        stream(gPtr[i], g);
-        stream(bPtr[i], b);
-        stream(aPtr[i], const_1p);
+public:
+    typedef tbb::blocked_range<int> Range;
+
+    DecodeWindowFunctor(const unsigned char* data, int width,
+        const rgbeions::ScanlineIndex& index, const LoadWindow& window,
+        ImageCls& img) :
+    m_data(data), m_width(width), m_index(index), m_window(window),
+    m_img(img) {}
+
+    void operator() (const Range& range) const
+    {
+        const int outWidth = m_img.Width();
+        std::vector<unsigned char> scanline_buffer;
+        std::vector<float> pixels(4 * outWidth);
+
+        for (int j = range.begin(); j != range.end(); ++j) {
+            const int sy = m_window.sourceY(j);
+            const unsigned char* src = m_data + m_index.offsets[sy];
+            if (m_index.isFlat(sy)) {
+                for (int i = 0; i < outWidth; ++i) {
+                    const unsigned char* p = src + 4*m_window.sourceX(i);
+                    setPixel(&pixels[4*i], Rgbe(p[0], p[1], p[2], p[3]));
+                }
+            } else {
+                if (scanline_buffer.empty()) {
+                    scanline_buffer.resize(4 * m_width);
+                }
+                rgbeions::decodeScanline_RLE(src, &scanline_buffer[0],
+                    m_width);
+                const unsigned char* r = &scanline_buffer[0];
+                const unsigned char* g = r + m_width;
+                const unsigned char* b = g + m_width;
+                const unsigned char* e = b + m_width;
+                for (int i = 0; i < outWidth; ++i) {
+                    const int x = m_window.sourceX(i);
+                    setPixel(&pixels[4*i], Rgbe(r[x], g[x], b[x], e[x]));
+                }
+            }
+            storeWindowScanline(m_img, j, &pixels[0], &pixels[1],
+                &pixels[2], NULL, 4);
+        }
     }
+
+private:
+    static inline void setPixel(float* dest, const Rgbe& rgbe) {
+        const Rgba32F p = rgbe;
+        dest[0] = p.r();
+        dest[1] = p.g();
+        dest[2] = p.b();
+    }
+
+    const unsigned char* m_data;
+    const int m_width;
+    const rgbeions::ScanlineIndex& m_index;
+    const LoadWindow& m_window;
+    ImageCls& m_img;
+};
+
+
+
+template <class ImageCls>
+void LoadWindowImpl(ImageCls& img, istream& is, const LoadWindow& window)
+{
+    int width, height;
+    rgbeions::rgbe_header_info info;
+    if (rgbeions::readHeader(is, width, height, info) !=
+        rgbeions::RGBE_RETURN_SUCCESS) {
+        throw IOException("Couldn't read RGBE header.");
+    }
+    const LoadWindow w = window.resolve(width, height);
+    img.Alloc(w.outputWidth(), w.outputHeight());
+
+    // RLE scanlines are not self-delimiting, so the index still needs to
+    // walk the whole file, but that is much cheaper than decoding it
+    rgbeions::PixelSource source;
+    rgbeions::ScanlineIndex index;
+    if (source.init(is) != rgbeions::RGBE_RETURN_SUCCESS ||
+        rgbeions::scanOffsets_RLE(source, width, height, index) !=
+        rgbeions::RGBE_RETURN_SUCCESS) {
+        throw IOException("Couldn't read RGBE pixel data.");
+    }
+
+    DecodeWindowFunctor<ImageCls> functor(source.data, width, index, w, img);
+    pcg::concurrency::parallel_for(
+        typename DecodeWindowFunctor<ImageCls>::Range(0, img.Height()),
+        functor, img.Width());
+    source.consume(index.end);
 }
 
+} // namespace
 
 
-void SaveImageSoA(Image<Rgbe, TopDown>& dest, const RGBAImageSoA& src)
+
+struct rgbeions::BandDecoder::Impl
 {
-    dest.Alloc(src.Width(), src.Height());
+    int width;
+    int height;
+    rgbeions::PixelSource source;
+    rgbeions::ScanlineIndex index;
+};
+
 
-    // Convert them using the RTGI2 method, processing multiple pixels at a time
-    Vec4i* PCG_RESTRICT vecRGBE=reinterpret_cast<Vec4i*>(dest.GetDataPointer());
-    assert(reinterpret_cast<uintptr_t>(vecRGBE) % 16 == 0);
-
-    typedef const Vec4f* PCG_RESTRICT const RVec4f;
-    RVec4f rPtr=reinterpret_cast<Vec4f*>(src.GetDataPointer<RGBAImageSoA::R>());
-    RVec4f gPtr=reinterpret_cast<Vec4f*>(src.GetDataPointer<RGBAImageSoA::G>());
-    RVec4f bPtr=reinterpret_cast<Vec4f*>(src.GetDataPointer<RGBAImageSoA::B>());
-
-    const Vec4f min_val(1e-32f);
-    const Vec4i const_0xFF(Vec4i::constant<0xFF>());
-    const Vec4i const_0x1FF(Vec4i::constant<0x1FF>());
-    const Vec4i const_253(Vec4i::constant<253>());
-    const Vec4i const_1(Vec4i::constant<1>());
-
-    const int vecCount = src.Size() / 4;
-    for (int i = 0; i != vecCount; ++i) {
-        Vec4f red   = rPtr[i];
-        Vec4f green = gPtr[i];
-        Vec4f blue  = bPtr[i];
-
-        // Kill NaN pixels to avoid signaling errors
-        Vec4f maskValid((red == red) & (green == green) & (blue == blue));
-        red   &= maskValid;
-        green &= maskValid;
-        blue  &= maskValid;
-
-        // Negative values cannot be encoded, so we truncate them to zero
-        red   = simd_max(red,   Vec4f::zero());
-        green = simd_max(green, Vec4f::zero());
-        blue  = simd_max(blue,  Vec4f::zero());
-
-        // Find the largest value of the three color components
-        Vec4f maxValue = simd_max(blue, simd_max(red, green));
-
-        // Consider all values less than this to be zero. This constant comes
-        // from Ward's definition in "Real Pixels" (Graphics Gems II)
-        maskValid &= Vec4f(maxValue >= min_val);
-
-        // Extract the exponent from the IEEE single precision value
-        Vec4i biasedExponent = srl(castAsInt(maxValue), 23) & const_0xFF;
-        // Overflow
-        maskValid = andnot(castAsFloat(biasedExponent > const_253), maskValid);
-
-        // Construct an additive normalizer which is just 2^(exp+1).
-        // Adding this to each float will move the relevant mantissa bits to a
-        // known fixed location for easy extraction
-        Vec4f additiveNormalizer = castAsFloat(sll(biasedExponent+const_1, 23));
-        // Initially we keep an extra bit (9-bits) so that we can perform
-        // rounding to 8-bits in the next step
-        Vec4i rawR = srl(castAsInt(red  +additiveNormalizer), 14) & const_0x1FF;
-        Vec4i rawG = srl(castAsInt(green+additiveNormalizer), 14) & const_0x1FF;
-        Vec4i rawB = srl(castAsInt(blue +additiveNormalizer), 14) & const_0x1FF;
-        // rgbeBiasedExponent = (ieeeBiasedExponent-127) + 128 since IEEE single
-        // float and rgbe have different exponent bias values
-        Vec4i e = biasedExponent + const_1 + const_1;
-        // round to nearest representable 8 bit value
-        Vec4i r = srl(rawR + const_1, 1);
-        Vec4i g = srl(rawG + const_1, 1);
-        Vec4i b = srl(rawB + const_1, 1);
-
-        // Check to see if rounding causes an overflow condition and fix if
-        // necessary. Note that we actually avoid branches
-        Vec4bi maskOverflow = (r>const_0xFF) | (g>const_0xFF) | (b>const_0xFF);
-        e += Vec4i(maskOverflow) & const_1;
-        const Vec4i const_2 = const_1 + const_1;
-        Vec4i rOver = srl(rawR + const_2, 2);
-        Vec4i gOver = srl(rawG + const_2, 2);
-        Vec4i bOver = srl(rawB + const_2, 2);
-        r = select(maskOverflow, rOver, r);
-        g = select(maskOverflow, gOver, g);
-        b = select(maskOverflow, bOver, b);
-        // Overflow after rounding
-        Vec4i finalMask = andnot(Vec4i(e > const_0xFF), castAsInt(maskValid));
-
-        // Set to zero if the pixel is invalid, then build the final value
-        r &= finalMask;
-        g &= finalMask;
-        b &= finalMask;
-        e &= finalMask;
-        vecRGBE[i] = sll(e, 24) | sll(b, 16) | sll(g, 8) | r;
+rgbeions::BandDecoder::BandDecoder(istream& is) : m_impl(new Impl)
+{
+    rgbeions::rgbe_header_info info;
+    if (rgbeions::readHeader(is, m_impl->width, m_impl->height, info) !=
+        rgbeions::RGBE_RETURN_SUCCESS) {
+        delete m_impl;
+        throw IOException("Couldn't read RGBE header.");
+    }
+    if (m_impl->source.init(is) != rgbeions::RGBE_RETURN_SUCCESS ||
+        rgbeions::scanOffsets_RLE(m_impl->source,
+        m_impl->width, m_impl->height, m_impl->index) !=
+        rgbeions::RGBE_RETURN_SUCCESS) {
+        delete m_impl;
+        throw IOException("Couldn't read RGBE pixel data.");
     }
+    m_impl->source.consume(m_impl->index.end);
 }
 
-} // namespace
+rgbeions::BandDecoder::~BandDecoder()
+{
+    delete m_impl;
+}
+
+int rgbeions::BandDecoder::width() const
+{
+    return m_impl->width;
+}
+
+int rgbeions::BandDecoder::height() const
+{
+    return m_impl->height;
+}
+
+void rgbeions::BandDecoder::decode(RGBAImageSoA& img, int y) const
+{
+    if (img.Width() != m_impl->width || y < 0 ||
+        img.Height() > m_impl->height - y) {
+        throw IllegalArgumentException("The band is not within the image.");
+    }
+    DecodeSoAFunctor functor(m_impl->source.data, m_impl->index, img, y);
+    pcg::concurrency::parallel_for(DecodeSoAFunctor::Range(0, img.Height()),
+        functor, img.Width());
+}
 
 
 
 void RgbeIO::Load(RGBAImageSoA& img, istream& is)
 {
-    Image<Rgbe, TopDown> imgRGBE;
-    Load(imgRGBE, is);
-    LoadImageSoA(imgRGBE, img);
+    LoadImageSoA(img, is);
 }
 
 void RgbeIO::Load(RGBAImageSoA& img, const char* filename)
 {
-    Image<Rgbe, TopDown> imgRGBE;
-    Load(imgRGBE, filename);
-    LoadImageSoA(imgRGBE, img);
+    FileInputStream is;
+    if (!is.open(filename)) {
+        throw IOException(std::string("Couldn't open the file ") + filename);
+    }
+    LoadImageSoA(img, is);
+}
+
+void RgbeIO::Load(Image<Rgba32F,TopDown>& img, istream& is,
+    const LoadWindow& window)
+{
+    LoadWindowImpl(img, is, window);
+}
+
+void RgbeIO::Load(RGBAImageSoA& img, istream& is, const LoadWindow& window)
+{
+    LoadWindowImpl(img, is, window);
 }
 
 void RgbeIO::Save(const RGBAImageSoA& img, ostream& os)
@@ -24,6 +24,7 @@
 #include "Rgb32F.h"
 #include "Image.h"
 #include "ImageSoA.h"
+#include "LoadWindow.h"
 
 namespace pcg {
 
@@ -57,6 +58,13 @@ namespace pcg {
 		static IMAGEIO_API void Load(RGBAImageSoA& img, istream& is);
 		static IMAGEIO_API void Load(RGBAImageSoA& img, const char* filename);
 
+		// Window of pixels, subsampled by an integer step. Only the
+		// scanlines of the window are decoded.
+		static IMAGEIO_API void Load(Image<Rgba32F,TopDown>& img, istream& is,
+			const LoadWindow& window);
+		static IMAGEIO_API void Load(RGBAImageSoA& img, istream& is,
+			const LoadWindow& window);
+
 
 		// ### Save functions ###
 
@@ -18,6 +18,12 @@
 #if !defined(RGBEIOPRIVATE_H)
 #define RGBEIOPRIVATE_H
 
+#include "Image.h"
+#include "ImageSoA.h"
+#include "rgbe.h"
+
+#include <vector>
+
 namespace pcg {
 
 	// The is stuff which won't be defined here because it uses a lot of templates
@@ -132,6 +138,49 @@ namespace pcg {
 		/* encoded separately for better compression. */
 		int writeBytes_RLE(ostream &os, const unsigned char *data, int numbytes);
 
+		// Same as above, appending the encoded bytes to the buffer
+		void encodeBytes_RLE(const unsigned char *data, int numbytes,
+			std::vector<unsigned char> &out);
+
+
+		// ####################################################################
+		// ####         SoA IMAGES      #######################################
+		// ####################################################################
+
+		// Converts the scanline j of the SoA image from its RGBE pixels,
+		// either interleaved as in flat files or as the four planes of an
+		// expanded RLE scanline. Defined in RgbeSoA.cpp, using the SIMD
+		// kernels for the active instruction set.
+		void convertScanlineSoA(const unsigned char *data, bool isPlanar,
+			RGBAImageSoA &img, int j);
+
+		// Encodes the SoA image into dest, which must have the same size
+		void encodeSoA(Image<Rgbe, TopDown> &dest, const RGBAImageSoA &src);
+
+		// Decodes bands of scanlines of an RGBE file into SoA images. The
+		// constructor reads the header and locates every scanline once,
+		// throwing IOException if the file is not valid. Memory streams are
+		// decoded in place, thus their buffer must outlive the decoder.
+		class BandDecoder {
+		public:
+			BandDecoder(istream &is);
+			~BandDecoder();
+
+			int width() const;
+			int height() const;
+
+			// Decodes the scanlines [y, y + img.Height()) of the file into
+			// the image, which must be as wide as the file
+			void decode(RGBAImageSoA &img, int y) const;
+
+		private:
+			BandDecoder(const BandDecoder&);
+			BandDecoder& operator=(const BandDecoder&);
+
+			struct Impl;
+			Impl *m_impl;
+		};
+
 	}
 
 }
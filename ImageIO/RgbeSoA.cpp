@@ -0,0 +1,400 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// SIMD conversions between RGBE pixels and SoA images. They live apart from
+// the rest of RgbeIO so that they may be compiled for several instruction
+// sets, as described in SimdDispatch.h
+
+#include "RgbeIO.h"
+#include "RgbeIOPrivate.h"
+#include "SimdDispatch.h"
+#include "Vec4f.h"
+#include "Vec4i.h"
+
+#include <string.h>
+#include <algorithm>
+#include <cassert>
+
+using namespace pcg;
+
+// Alias the private namespace
+namespace rgbeions = pcg::rgbeio_internal;
+
+
+namespace
+{
+
+inline void stream(Vec4f& target, const Vec4f& value) {
+    _mm_stream_ps(reinterpret_cast<float*>(&target), value);
+}
+
+inline Vec4i sll(const Vec4i& a, int count) {
+    return _mm_slli_epi32(a, count);
+}
+
+inline Vec4i srl(const Vec4i& a, int count) {
+    return _mm_srli_epi32(a, count);
+}
+
+inline Vec4f toFloat(const Vec4i& a) {
+    return _mm_cvtepi32_ps(a);
+}
+
+inline Vec4f castAsFloat(const Vec4i& a) {
+    return _mm_castsi128_ps(a);
+}
+
+inline Vec4f castAsFloat(const Vec4bi& a) {
+    return _mm_castsi128_ps(a);
+}
+
+inline Vec4i castAsInt(const Vec4f& a) {
+    return _mm_castps_si128(a);
+}
+
+
+
+// Unpacks four RGBE pixels using the RTGI2 method
+inline void rgbe2float(const Vec4i& rgbe, Vec4f& r, Vec4f& g, Vec4f& b)
+{
+    const Vec4i const_0xFF(Vec4i::constant<0xFF>());
+    const Vec4i const_9(Vec4i::constant<9>());
+
+    r = toFloat(const_0xFF & rgbe);
+    g = toFloat(const_0xFF & (srl(rgbe,  8)));
+    b = toFloat(const_0xFF & (srl(rgbe, 16)));
+    Vec4i e = srl(rgbe, 24);
+
+    // Values in the range 1 to 9 would require "denormal" multipliers and
+    // are below minimum values for RGBE exponents so we truncate them to 0
+    const Vec4i exponentMask(e > const_9);
+    e =  sll((e - const_9), 23) & exponentMask;
+    const Vec4f scale = castAsFloat(e);
+
+    r *= scale;
+    g *= scale;
+    b *= scale;
+}
+
+#if PCG_USE_AVX2
+// Unpacks eight RGBE pixels, exactly as rgbe2float
+inline void rgbe2float8(__m256i rgbe, __m256& r, __m256& g, __m256& b)
+{
+    const __m256i const_0xFF = _mm256_set1_epi32(0xFF);
+    const __m256i const_9    = _mm256_set1_epi32(9);
+
+    r = _mm256_cvtepi32_ps(_mm256_and_si256(const_0xFF, rgbe));
+    g = _mm256_cvtepi32_ps(_mm256_and_si256(const_0xFF,
+        _mm256_srli_epi32(rgbe,  8)));
+    b = _mm256_cvtepi32_ps(_mm256_and_si256(const_0xFF,
+        _mm256_srli_epi32(rgbe, 16)));
+    __m256i e = _mm256_srli_epi32(rgbe, 24);
+
+    const __m256i exponentMask = _mm256_cmpgt_epi32(e, const_9);
+    e = _mm256_and_si256(_mm256_slli_epi32(_mm256_sub_epi32(e, const_9), 23),
+        exponentMask);
+    const __m256 scale = _mm256_castsi256_ps(e);
+
+    r = _mm256_mul_ps(r, scale);
+    g = _mm256_mul_ps(g, scale);
+    b = _mm256_mul_ps(b, scale);
+}
+#endif
+
+inline int32_t load32(const unsigned char* ptr) {
+    int32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+// Accessors for the pixels of a single scanline, either as stored in flat
+// files (interleaved) or after expanding an RLE scanline (planar)
+class FlatScanline
+{
+public:
+    FlatScanline(const unsigned char* data) : m_data(data) {}
+
+    inline Vec4i get1(int i) const {
+        return _mm_cvtsi32_si128(load32(m_data + 4*i));
+    }
+
+    inline Vec4i get4(int i) const {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_data+4*i));
+    }
+
+#if PCG_USE_AVX2
+    inline __m256i get8(int i) const {
+        return _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(m_data + 4*i));
+    }
+#endif
+
+private:
+    const unsigned char* m_data;
+};
+
+class PlanarScanline
+{
+public:
+    PlanarScanline(const unsigned char* data, int width) :
+    m_r(data), m_g(data + width), m_b(data + 2*width), m_e(data + 3*width) {}
+
+    inline Vec4i get1(int i) const {
+        return _mm_cvtsi32_si128(m_r[i] | (m_g[i] << 8) |
+            (m_b[i] << 16) | (m_e[i] << 24));
+    }
+
+    inline Vec4i get4(int i) const {
+        const __m128i r = _mm_cvtsi32_si128(load32(m_r + i));
+        const __m128i g = _mm_cvtsi32_si128(load32(m_g + i));
+        const __m128i b = _mm_cvtsi32_si128(load32(m_b + i));
+        const __m128i e = _mm_cvtsi32_si128(load32(m_e + i));
+        return _mm_unpacklo_epi16(_mm_unpacklo_epi8(r, g),
+            _mm_unpacklo_epi8(b, e));
+    }
+
+#if PCG_USE_AVX2
+    static inline __m128i load64(const unsigned char* ptr) {
+        return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ptr));
+    }
+
+    inline __m256i get8(int i) const {
+        const __m128i r = load64(m_r + i);
+        const __m128i g = load64(m_g + i);
+        const __m128i b = load64(m_b + i);
+        const __m128i e = load64(m_e + i);
+        const __m128i rg = _mm_unpacklo_epi8(r, g);
+        const __m128i be = _mm_unpacklo_epi8(b, e);
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(
+            _mm_unpacklo_epi16(rg, be)), _mm_unpackhi_epi16(rg, be), 1);
+    }
+#endif
+
+private:
+    const unsigned char* m_r;
+    const unsigned char* m_g;
+    const unsigned char* m_b;
+    const unsigned char* m_e;
+};
+
+
+
+// Number of pixels converted at once by the vector code
+#if PCG_USE_AVX2
+const int VEC_LEN = 8;
+#else
+const int VEC_LEN = 4;
+#endif
+
+// Converts a full scanline into the SoA image. The planes share the same
+// alignment, so the pixels before the first multiple of the vector size and
+// after the last one are converted individually.
+template <class ScanlineAccessor>
+void convertScanline(const ScanlineAccessor& src, RGBAImageSoA& img, int j)
+{
+    float* r = img.GetScanlinePointer<RGBAImageSoA::R>(j, TopDown);
+    float* g = img.GetScanlinePointer<RGBAImageSoA::G>(j, TopDown);
+    float* b = img.GetScanlinePointer<RGBAImageSoA::B>(j, TopDown);
+    float* a = img.GetScanlinePointer<RGBAImageSoA::A>(j, TopDown);
+
+    const int width = img.Width();
+    const int misalignment = static_cast<int>(
+        (reinterpret_cast<uintptr_t>(r) % (VEC_LEN * sizeof(float))) /
+        sizeof(float));
+    const int beginSIMD = std::min(misalignment != 0 ?
+        VEC_LEN - misalignment : 0, width);
+    const int endSIMD = beginSIMD + ((width - beginSIMD) & ~(VEC_LEN - 1));
+
+    Vec4f red, green, blue;
+    for (int i = 0; i < beginSIMD; ++i) {
+        rgbe2float(src.get1(i), red, green, blue);
+        _mm_store_ss(r + i, red);
+        _mm_store_ss(g + i, green);
+        _mm_store_ss(b + i, blue);
+        a[i] = 1.0f;
+    }
+
+#if PCG_USE_AVX2
+    const __m256 const_1p = _mm256_set1_ps(1.0f);
+    for (int i = beginSIMD; i < endSIMD; i += 8) {
+        __m256 red8, green8, blue8;
+        rgbe2float8(src.get8(i), red8, green8, blue8);
+        _mm256_stream_ps(r + i, red8);
+        _mm256_stream_ps(g + i, green8);
+        _mm256_stream_ps(b + i, blue8);
+        _mm256_stream_ps(a + i, const_1p);
+    }
+#else
+    const Vec4f const_1p(1.0f);
+    for (int i = beginSIMD; i < endSIMD; i += 4) {
+        rgbe2float(src.get4(i), red, green, blue);
+        stream(*reinterpret_cast<Vec4f*>(r + i), red);
+        stream(*reinterpret_cast<Vec4f*>(g + i), green);
+        stream(*reinterpret_cast<Vec4f*>(b + i), blue);
+        stream(*reinterpret_cast<Vec4f*>(a + i), const_1p);
+    }
+#endif
+
+    for (int i = endSIMD; i < width; ++i) {
+        rgbe2float(src.get1(i), red, green, blue);
+        _mm_store_ss(r + i, red);
+        _mm_store_ss(g + i, green);
+        _mm_store_ss(b + i, blue);
+        a[i] = 1.0f;
+    }
+}
+
+} // namespace
+
+
+
+namespace pcg
+{
+PCG_SIMD_DECLARE_KERNEL(void, convertScanlineSoA,
+    (const unsigned char *data, bool isPlanar, RGBAImageSoA &img, int j))
+PCG_SIMD_DECLARE_KERNEL(void, encodeSoA,
+    (Image<Rgbe, TopDown> &dest, const RGBAImageSoA &src))
+} // namespace pcg
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::convertScanlineSoA(const unsigned char *data,
+    bool isPlanar, RGBAImageSoA &img, int j)
+{
+    if (isPlanar) {
+        convertScanline(PlanarScanline(data, img.Width()), img, j);
+    } else {
+        convertScanline(FlatScanline(data), img, j);
+    }
+}
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::encodeSoA(Image<Rgbe, TopDown>& dest,
+    const RGBAImageSoA& src)
+{
+    assert(dest.Width() == src.Width() && dest.Height() == src.Height());
+
+    // Convert them using the RTGI2 method, processing multiple pixels at a time
+    Vec4i* PCG_RESTRICT vecRGBE=reinterpret_cast<Vec4i*>(dest.GetDataPointer());
+    assert(reinterpret_cast<uintptr_t>(vecRGBE) % 16 == 0);
+
+    typedef const Vec4f* PCG_RESTRICT const RVec4f;
+    RVec4f rPtr=reinterpret_cast<Vec4f*>(src.GetDataPointer<RGBAImageSoA::R>());
+    RVec4f gPtr=reinterpret_cast<Vec4f*>(src.GetDataPointer<RGBAImageSoA::G>());
+    RVec4f bPtr=reinterpret_cast<Vec4f*>(src.GetDataPointer<RGBAImageSoA::B>());
+
+    const Vec4f min_val(1e-32f);
+    const Vec4i const_0xFF(Vec4i::constant<0xFF>());
+    const Vec4i const_0x1FF(Vec4i::constant<0x1FF>());
+    const Vec4i const_253(Vec4i::constant<253>());
+    const Vec4i const_1(Vec4i::constant<1>());
+
+    // The source planes are padded to whole vectors but the destination is
+    // not, so the last pixels are stored separately
+    const ptrdiff_t count = src.Size();
+    const ptrdiff_t vecCount = (count + 3) / 4;
+    for (ptrdiff_t i = 0; i != vecCount; ++i) {
+        Vec4f red   = rPtr[i];
+        Vec4f green = gPtr[i];
+        Vec4f blue  = bPtr[i];
+
+        // Kill NaN pixels to avoid signaling errors
+        Vec4f maskValid((red == red) & (green == green) & (blue == blue));
+        red   &= maskValid;
+        green &= maskValid;
+        blue  &= maskValid;
+
+        // Negative values cannot be encoded, so we truncate them to zero
+        red   = simd_max(red,   Vec4f::zero());
+        green = simd_max(green, Vec4f::zero());
+        blue  = simd_max(blue,  Vec4f::zero());
+
+        // Find the largest value of the three color components
+        Vec4f maxValue = simd_max(blue, simd_max(red, green));
+
+        // Consider all values less than this to be zero. This constant comes
+        // from Ward's definition in "Real Pixels" (Graphics Gems II)
+        maskValid &= Vec4f(maxValue >= min_val);
+
+        // Extract the exponent from the IEEE single precision value
+        Vec4i biasedExponent = srl(castAsInt(maxValue), 23) & const_0xFF;
+        // Overflow
+        maskValid = andnot(castAsFloat(biasedExponent > const_253), maskValid);
+
+        // Construct an additive normalizer which is just 2^(exp+1).
+        // Adding this to each float will move the relevant mantissa bits to a
+        // known fixed location for easy extraction
+        Vec4f additiveNormalizer = castAsFloat(sll(biasedExponent+const_1, 23));
+        // Initially we keep an extra bit (9-bits) so that we can perform
+        // rounding to 8-bits in the next step
+        Vec4i rawR = srl(castAsInt(red  +additiveNormalizer), 14) & const_0x1FF;
+        Vec4i rawG = srl(castAsInt(green+additiveNormalizer), 14) & const_0x1FF;
+        Vec4i rawB = srl(castAsInt(blue +additiveNormalizer), 14) & const_0x1FF;
+        // rgbeBiasedExponent = (ieeeBiasedExponent-127) + 128 since IEEE single
+        // float and rgbe have different exponent bias values
+        Vec4i e = biasedExponent + const_1 + const_1;
+        // round to nearest representable 8 bit value
+        Vec4i r = srl(rawR + const_1, 1);
+        Vec4i g = srl(rawG + const_1, 1);
+        Vec4i b = srl(rawB + const_1, 1);
+
+        // Check to see if rounding causes an overflow condition and fix if
+        // necessary. Note that we actually avoid branches
+        Vec4bi maskOverflow = (r>const_0xFF) | (g>const_0xFF) | (b>const_0xFF);
+        e += Vec4i(maskOverflow) & const_1;
+        const Vec4i const_2 = const_1 + const_1;
+        Vec4i rOver = srl(rawR + const_2, 2);
+        Vec4i gOver = srl(rawG + const_2, 2);
+        Vec4i bOver = srl(rawB + const_2, 2);
+        r = select(maskOverflow, rOver, r);
+        g = select(maskOverflow, gOver, g);
+        b = select(maskOverflow, bOver, b);
+        // Overflow after rounding
+        Vec4i finalMask = andnot(Vec4i(e > const_0xFF), castAsInt(maskValid));
+
+        // Set to zero if the pixel is invalid, then build the final value
+        r &= finalMask;
+        g &= finalMask;
+        b &= finalMask;
+        e &= finalMask;
+        const Vec4i rgbe = sll(e, 24) | sll(b, 16) | sll(g, 8) | r;
+        if (4*i + 4 <= count) {
+            vecRGBE[i] = rgbe;
+        } else {
+            memcpy(vecRGBE + i, &rgbe, (count - 4*i) * sizeof(Rgbe));
+        }
+    }
+}
+
+
+
+// The entry points are only compiled once, for the baseline instruction set
+#if !PCG_SIMD_VARIANT
+
+void rgbeions::convertScanlineSoA(const unsigned char *data, bool isPlanar,
+    RGBAImageSoA &img, int j)
+{
+    PCG_SIMD_DISPATCH(convertScanlineSoA(data, isPlanar, img, j));
+}
+
+
+
+void rgbeions::encodeSoA(Image<Rgbe, TopDown> &dest, const RGBAImageSoA &src)
+{
+    PCG_SIMD_DISPATCH(encodeSoA(dest, src));
+}
+
+#endif // !PCG_SIMD_VARIANT
@@ -0,0 +1,75 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+/*
+ * Internal helpers for the sources whose SIMD kernels are compiled once per
+ * instruction set. The build compiles each of those sources normally and, for
+ * every instruction set above the baseline, once more with the corresponding
+ * compiler flags plus PCG_SIMD_VARIANT, PCG_USE_AVX and PCG_USE_AVX2 defined
+ * as appropriate. The availability of those extra variants is advertised to
+ * all the sources through PCG_SIMD_HAS_AVX and PCG_SIMD_HAS_AVX2.
+ *
+ * In such sources the kernels live in the namespace PCG_SIMD_NAMESPACE and
+ * everything else must have internal linkage, except for the public entry
+ * points: those are only compiled when PCG_SIMD_VARIANT is not defined and
+ * use PCG_SIMD_DISPATCH to call the kernel for CpuFeatures::Active().
+ */
+
+#pragma once
+#if !defined(PCG_SIMDDISPATCH_H)
+#define PCG_SIMDDISPATCH_H
+
+#include "CpuFeatures.h"
+
+#if PCG_USE_AVX2
+# define PCG_SIMD_NAMESPACE simd_avx2
+#elif PCG_USE_AVX
+# define PCG_SIMD_NAMESPACE simd_avx
+#else
+# define PCG_SIMD_NAMESPACE simd_sse2
+#endif
+
+// Declares a kernel with the same signature for every instruction set. The
+// parameters go within parenthesis, e.g. (const float *src, size_t count)
+#define PCG_SIMD_DECLARE_KERNEL(ret, name, params) \
+    namespace simd_sse2 { ret name params; }       \
+    namespace simd_avx  { ret name params; }       \
+    namespace simd_avx2 { ret name params; }
+
+#if PCG_SIMD_HAS_AVX
+# define PCG_SIMD_CASE_AVX(call) \
+    case pcg::CpuFeatures::AVX: return pcg::simd_avx::call;
+#else
+# define PCG_SIMD_CASE_AVX(call)
+#endif
+
+#if PCG_SIMD_HAS_AVX2
+# define PCG_SIMD_CASE_AVX2(call) \
+    case pcg::CpuFeatures::AVX2: return pcg::simd_avx2::call;
+#else
+# define PCG_SIMD_CASE_AVX2(call)
+#endif
+
+// Returns the result of calling the kernel for the active instruction set,
+// e.g. PCG_SIMD_DISPATCH(convert(dest, src, count)). The baseline kernel is
+// used for any instruction set which was not built separately.
+#define PCG_SIMD_DISPATCH(call)                        \
+    switch (pcg::CpuFeatures::Active()) {              \
+    PCG_SIMD_CASE_AVX2(call)                           \
+    PCG_SIMD_CASE_AVX(call)                            \
+    default: return pcg::PCG_SIMD_NAMESPACE::call;     \
+    }
+
+#endif /* PCG_SIMDDISPATCH_H */
@@ -21,9 +21,13 @@
 
 #include "ToneMapperSoA.h"
 #include "StdAfx.h"
+#include "ImageComparatorPrivate.h"
 #include "ToneMapper.h"
 #include "ImageSoA.h"
 #include "ImageIterators.h"
+#include "ImageView.h"
+#include "SimdDispatch.h"
+#include "ConcurrencyPrivate.h"
 #include "Vec4f.h"
 #include "Vec4i.h"
 
@@ -47,10 +51,14 @@
 #endif
 
 
+// Internal linkage, as this file is also compiled for other instruction sets
+namespace
+{
 namespace ssemath
 {
 #include "sse_mathfun.h"
 }
+}
 #include "Amaths.h"
 
 
@@ -426,9 +434,7 @@ typedef pcg::Vec4fUnion VecfUnion;
 static const VecfUnion ONE  = {PCG_TMOSOA_VECF( 1.0f )};
     
 static const VecfUnion Q_8bit  = {PCG_TMOSOA_VECF(   255.0f )};
-#if TONEMAPPERSOA_HAS_16BIT
 static const VecfUnion Q_16bit = {PCG_TMOSOA_VECF( 65535.0f )};
-#endif
 
 // Luminance conversion
 static const VecfUnion LVec[3] = {
@@ -777,7 +783,6 @@ struct Quantizer8bit
 };
 
 
-#if TONEMAPPERSOA_HAS_16BIT
 template <typename T, typename QT>
 struct Quantizer16bit
 {
@@ -789,7 +794,6 @@ struct Quantizer16bit
         return ops::round<QT>(FACTOR * x);
     }
 };
-#endif // TONEMAPPERSOA_HAS_16BIT
 
 
 
@@ -815,11 +819,15 @@ struct PixelAssembler_BGRA8
 
 
 
-struct PixelAssembler_BGRA8Vec4
+// Packs 8-bit pixels into 32-bit words, with alpha always in the MSB. The
+// shifts of red and blue select between BGRA8 and RGBA8: both have the same
+// storage, thus the packed BGRA8 groups are used for both.
+template <int R_SHIFT, int B_SHIFT>
+struct PixelAssembler_8bitVec4
 {
     typedef pcg::PixelBGRA8Vec4 pixel_t;
     typedef Quantizer8bit<pcg::Vec4f, pcg::Vec4i> quantizer_t;
-    typedef quantizer_t::value_t value_t;
+    typedef typename quantizer_t::value_t value_t;
 
     inline void operator() (
         const value_t& r, const value_t& g, const value_t& b, const value_t& a,
@@ -827,23 +835,61 @@ struct PixelAssembler_BGRA8Vec4
     {
         // For some stupid reason the operator<< overload doesn't seem to work
         pcg::Vec4i aShift = _mm_slli_epi32(a, 24);
-        pcg::Vec4i rShift = _mm_slli_epi32(r, 16);
+        pcg::Vec4i rShift = _mm_slli_epi32(r, R_SHIFT);
         pcg::Vec4i gShift = _mm_slli_epi32(g, 8);
+        pcg::Vec4i bShift = _mm_slli_epi32(b, B_SHIFT);
 
-        const pcg::Vec4i pixel = aShift | rShift | gShift | b;
+        const pcg::Vec4i pixel = aShift | rShift | gShift | bShift;
         _mm_stream_si128(&outPixel.xmm, pixel);
     }
 };
 
+typedef PixelAssembler_8bitVec4<16, 0> PixelAssembler_BGRA8Vec4;
+typedef PixelAssembler_8bitVec4<0, 16> PixelAssembler_RGBA8Vec4;
+
+
+
+// Group of 4 RGBA16 pixels, 64 bits each
+struct PixelRGBA16Vec4
+{
+    __m128i xmm[2];
+};
+
+// Packs the 16-bit channels of 4 pixels: each pixel is split in the red-green
+// and blue-alpha 32-bit halves, which are then interleaved
+inline void packRGBA16(const pcg::Vec4i& r, const pcg::Vec4i& g,
+    const pcg::Vec4i& b, const pcg::Vec4i& a, __m128i* out) throw()
+{
+    const pcg::Vec4i rg = r | pcg::Vec4i(_mm_slli_epi32(g, 16));
+    const pcg::Vec4i ba = b | pcg::Vec4i(_mm_slli_epi32(a, 16));
+    _mm_stream_si128(out,     _mm_unpacklo_epi32(rg, ba));
+    _mm_stream_si128(out + 1, _mm_unpackhi_epi32(rg, ba));
+}
+
+struct PixelAssembler_RGBA16Vec4
+{
+    typedef PixelRGBA16Vec4 pixel_t;
+    typedef Quantizer16bit<pcg::Vec4f, pcg::Vec4i> quantizer_t;
+    typedef quantizer_t::value_t value_t;
+
+    inline void operator() (
+        const value_t& r, const value_t& g, const value_t& b, const value_t& a,
+        pixel_t& outPixel) const throw()
+    {
+        packRGBA16(r, g, b, a, outPixel.xmm);
+    }
+};
+
 
 
 #if PCG_USE_AVX
 
-struct PixelAssembler_BGRA8Vec8
+template <int R_SHIFT, int B_SHIFT>
+struct PixelAssembler_8bitVec8
 {
     typedef pcg::PixelBGRA8Vec8 pixel_t;
     typedef Quantizer8bit<pcg::Vec8f, pcg::Vec8i> quantizer_t;
-    typedef quantizer_t::value_t value_t;
+    typedef typename quantizer_t::value_t value_t;
 
 #if !PCG_USE_AVX2
     template <int offset>
@@ -858,10 +904,11 @@ struct PixelAssembler_BGRA8Vec8
         pcg::Vec4i b0 = _mm256_extractf128_si256(b, offset);
 
         pcg::Vec4i a0Shift = _mm_slli_epi32(a0, 24);
-        pcg::Vec4i r0Shift = _mm_slli_epi32(r0, 16);
+        pcg::Vec4i r0Shift = _mm_slli_epi32(r0, R_SHIFT);
         pcg::Vec4i g0Shift = _mm_slli_epi32(g0, 8);
+        pcg::Vec4i b0Shift = _mm_slli_epi32(b0, B_SHIFT);
 
-        const pcg::Vec4i pixel = a0Shift | r0Shift | g0Shift | b0;
+        const pcg::Vec4i pixel = a0Shift | r0Shift | g0Shift | b0Shift;
         return pixel;
     }
 #endif /* !PCG_USE_AVX2 */
@@ -881,16 +928,49 @@ struct PixelAssembler_BGRA8Vec8
             _mm256_insertf128_si256(_mm256_castsi128_si256(pix0), pix1, 1);
 #else
         pcg::Vec8i aShift = _mm256_slli_epi32(a, 24);
-        pcg::Vec8i rShift = _mm256_slli_epi32(r, 16);
+        pcg::Vec8i rShift = _mm256_slli_epi32(r, R_SHIFT);
         pcg::Vec8i gShift = _mm256_slli_epi32(g, 8);
+        pcg::Vec8i bShift = _mm256_slli_epi32(b, B_SHIFT);
 
-        const pcg::Vec8i pixel = aShift | rShift | gShift | b;
+        const pcg::Vec8i pixel = aShift | rShift | gShift | bShift;
 #endif /* !PCG_USE_AVX2 */
 
         _mm256_stream_si256(&outPixel.ymm, pixel);
     }
 };
 
+typedef PixelAssembler_8bitVec8<16, 0> PixelAssembler_BGRA8Vec8;
+typedef PixelAssembler_8bitVec8<0, 16> PixelAssembler_RGBA8Vec8;
+
+
+
+// Group of 8 RGBA16 pixels, 64 bits each
+struct PixelRGBA16Vec8
+{
+    __m128i xmm[4];
+};
+
+struct PixelAssembler_RGBA16Vec8
+{
+    typedef PixelRGBA16Vec8 pixel_t;
+    typedef Quantizer16bit<pcg::Vec8f, pcg::Vec8i> quantizer_t;
+    typedef quantizer_t::value_t value_t;
+
+    inline void operator() (
+        const value_t& r, const value_t& g, const value_t& b, const value_t& a,
+        pixel_t& outPixel) const throw()
+    {
+        // The interleaving crosses the 128-bit lanes, thus each half is
+        // packed on its own
+        packRGBA16(_mm256_extractf128_si256(r, 0),
+            _mm256_extractf128_si256(g, 0), _mm256_extractf128_si256(b, 0),
+            _mm256_extractf128_si256(a, 0), outPixel.xmm);
+        packRGBA16(_mm256_extractf128_si256(r, 1),
+            _mm256_extractf128_si256(g, 1), _mm256_extractf128_si256(b, 1),
+            _mm256_extractf128_si256(a, 1), outPixel.xmm + 2);
+    }
+};
+
 #endif // PCG_USE_AVX
 
 
@@ -909,6 +989,7 @@ template<class LuminanceScaler, class DisplayTransformer, class PixelAssembler,
 struct ToneMappingKernel
 {
     typedef typename LuminanceScaler::value_t value_t;
+    typedef typename PixelAssembler::pixel_t pixel_t;
 
     ToneMappingKernel(const LuminanceScaler& scaler,
         const DisplayTransformer& display, const PixelAssembler& assembler) :
@@ -997,19 +1078,262 @@ private:
 
 template <class Kernel, typename SourceIter, typename DestIter>
 void processPixels(const Kernel& kernel, 
-    SourceIter begin, SourceIter end, DestIter dest)
+    SourceIter begin, SourceIter end, DestIter dest, size_t pixelsPerItem)
 {
     ProcessorTBB<SourceIter, DestIter, Kernel> pTBB(begin, dest, kernel);
     tbb::blocked_range<SourceIter> range(begin, end);
     
 #if 1
-    tbb::parallel_for(range, pTBB);
+    pcg::concurrency::parallel_for(range, pTBB, pixelsPerItem);
 #else
     pTBB(range);
 #endif
 }
 
 
+
+#if PCG_USE_AVX
+typedef pcg::RGBA32FVec8ImageSoAIterator IteratorSoA;
+typedef pcg::Vec8f ScalerValueType;
+const int SOA_PIXELS_PER_STEP = 8;
+#else
+typedef pcg::RGBA32FVec4ImageSoAIterator IteratorSoA;
+typedef pcg::Vec4f ScalerValueType;
+const int SOA_PIXELS_PER_STEP = 4;
+#endif
+
+
+
+// Rectangle of pixels to tone map. The iterators advance by groups of
+// pixelsPerStep contiguous pixels, thus the rectangle is extended to cover
+// whole groups.
+struct Region
+{
+    int x, y, width, height;
+    int imageWidth;
+    int pixelsPerStep;
+};
+
+// Region of the pixels provided by iterators over a whole image, whose
+// results are written in top-down order from dest
+template <typename SourceIter, typename DestType>
+struct IteratorRegion
+{
+    typedef DestType dest_t;
+
+    SourceIter begin, end;
+    DestType* dest;
+    Region region;
+};
+
+// Pixels of a SoA view tone mapped into the pixels of a view of the same size
+template <typename DestType>
+struct ViewRegion
+{
+    typedef DestType dest_t;
+
+    pcg::ConstRGBAImageSoAView src;
+    pcg::ImageView<DestType> dest;
+};
+
+// Processes the groups of pixels of each scanline of a region
+template <typename SourceIter, typename DestIter, class Kernel>
+class RowProcessorTBB
+{
+public:
+    RowProcessorTBB(SourceIter src, DestIter dest, const Kernel &k,
+        const Region& region) :
+    m_src(src), m_dest(dest), m_kernel(k), m_region(region)
+    {}
+
+    inline void operator() (tbb::blocked_range<int>& range) const
+    {
+        const ptrdiff_t n = m_region.pixelsPerStep;
+        for (int j = range.begin(); j != range.end(); ++j) {
+            const ptrdiff_t first = static_cast<ptrdiff_t>(j) *
+                m_region.imageWidth + m_region.x;
+            const ptrdiff_t begin = first / n;
+            const ptrdiff_t end   = (first + m_region.width + n - 1) / n;
+            m_kernel(m_src + begin, m_src + end, m_dest + begin);
+        }
+    }
+
+private:
+    SourceIter m_src;
+    DestIter   m_dest;
+    const Kernel& m_kernel;
+    const Region& m_region;
+};
+
+template <class Kernel, typename SourceIter, typename DestType>
+void processRegion(const Kernel& kernel,
+    const IteratorRegion<SourceIter, DestType>& source)
+{
+    typedef typename Kernel::pixel_t* DestIter;
+    const SourceIter& begin = source.begin;
+    const SourceIter& end = source.end;
+    const DestIter dest = reinterpret_cast<DestIter>(source.dest);
+    const Region& region = source.region;
+
+    // Unless the groups of adjacent scanlines are at least one group apart,
+    // different tasks could write the same group. In that case process the
+    // whole scanlines as a single contiguous range.
+    const int n = region.pixelsPerStep;
+    if (region.imageWidth - region.width < 2 * n) {
+        const ptrdiff_t first =
+            static_cast<ptrdiff_t>(region.y) * region.imageWidth;
+        const ptrdiff_t last = first +
+            static_cast<ptrdiff_t>(region.height) * region.imageWidth;
+        const ptrdiff_t rangeBegin = first / n;
+        const ptrdiff_t rangeEnd = std::min(static_cast<ptrdiff_t>(end-begin),
+            (last + n - 1) / n);
+        processPixels(kernel, begin + rangeBegin, begin + rangeEnd,
+            dest + rangeBegin, n);
+    } else {
+        RowProcessorTBB<SourceIter, DestIter, Kernel> pTBB(begin, dest,
+            kernel, region);
+        pcg::concurrency::parallel_for(tbb::blocked_range<int>(region.y,
+            region.y + region.height), pTBB, region.width);
+    }
+}
+
+
+
+// Whether the address is aligned to a group of SOA_PIXELS_PER_STEP floats,
+// which is also enough for the groups of destination pixels
+inline bool isGroupAligned(const void* ptr)
+{
+    return reinterpret_cast<intptr_t>(ptr) %
+        (SOA_PIXELS_PER_STEP * sizeof(float)) == 0;
+}
+
+// Aligned buffers for a few pixels which are tone mapped out of place
+template <typename DestType>
+struct StagingBuffers
+{
+    static const int SIZE = 512;
+
+    StagingBuffers() : src(SIZE, 1), dest(SIZE, 1)
+    {
+        // The values past the staged pixels are processed as well
+        std::fill_n(src.GetDataPointer<pcg::RGBAImageSoA::R>(), SIZE, 0.0f);
+        std::fill_n(src.GetDataPointer<pcg::RGBAImageSoA::G>(), SIZE, 0.0f);
+        std::fill_n(src.GetDataPointer<pcg::RGBAImageSoA::B>(), SIZE, 0.0f);
+        std::fill_n(src.GetDataPointer<pcg::RGBAImageSoA::A>(), SIZE, 0.0f);
+    }
+
+    pcg::RGBAImageSoA src;
+    pcg::Image<DestType, pcg::TopDown> dest;
+};
+
+// Processes the scanlines of a view. The groups of pixels of the scanlines
+// whose values and destination pixels are aligned are processed in place,
+// the remaining pixels are copied through the staging buffers of the task.
+template <typename DestType, class Kernel>
+class ViewRowProcessorTBB
+{
+public:
+    ViewRowProcessorTBB(const Kernel &k, const ViewRegion<DestType>& region,
+        bool allAligned) :
+    m_kernel(k), m_region(region), m_allAligned(allAligned)
+    {}
+
+    void operator() (const tbb::blocked_range<int>& range) const
+    {
+        typedef typename Kernel::pixel_t* DestIter;
+        typedef pcg::RGBAImageSoA I;
+        const int n = SOA_PIXELS_PER_STEP;
+        const int width = m_region.src.Width();
+
+        if (m_allAligned) {
+            for (int j = range.begin(); j != range.end(); ++j) {
+                const IteratorSoA it = rowBegin(j);
+                m_kernel(it, it + width / n, reinterpret_cast<DestIter>(
+                    m_region.dest.GetScanlinePointer(j)));
+            }
+            return;
+        }
+
+        StagingBuffers<DestType> staging;
+        const IteratorSoA stagedIt = IteratorSoA::begin(staging.src);
+        const DestIter stagedOut =
+            reinterpret_cast<DestIter>(staging.dest.GetDataPointer());
+
+        for (int j = range.begin(); j != range.end(); ++j) {
+            const float *r = m_region.src.template GetScanlinePointer<I::R>(j);
+            const float *g = m_region.src.template GetScanlinePointer<I::G>(j);
+            const float *b = m_region.src.template GetScanlinePointer<I::B>(j);
+            const float *a = m_region.src.template GetScanlinePointer<I::A>(j);
+            DestType *out = m_region.dest.GetScanlinePointer(j);
+
+            int i = 0;
+            if (isGroupAligned(r) && isGroupAligned(g) && isGroupAligned(b) &&
+                isGroupAligned(a) && isGroupAligned(out)) {
+                const int groups = width / n;
+                const IteratorSoA it = IteratorSoA::begin(r, g, b, a);
+                m_kernel(it, it + groups, reinterpret_cast<DestIter>(out));
+                i = groups * n;
+            }
+
+            for (; i < width; i += StagingBuffers<DestType>::SIZE) {
+                const int count =
+                    std::min(width - i, int(StagingBuffers<DestType>::SIZE));
+                std::copy(r + i, r + i + count,
+                    staging.src.template GetDataPointer<I::R>());
+                std::copy(g + i, g + i + count,
+                    staging.src.template GetDataPointer<I::G>());
+                std::copy(b + i, b + i + count,
+                    staging.src.template GetDataPointer<I::B>());
+                std::copy(a + i, a + i + count,
+                    staging.src.template GetDataPointer<I::A>());
+                m_kernel(stagedIt, stagedIt + (count + n - 1) / n, stagedOut);
+                const DestType *staged = staging.dest.GetDataPointer();
+                std::copy(staged, staged + count, out + i);
+            }
+        }
+    }
+
+private:
+    IteratorSoA rowBegin(int j) const {
+        typedef pcg::RGBAImageSoA I;
+        return IteratorSoA::begin(
+            m_region.src.template GetScanlinePointer<I::R>(j),
+            m_region.src.template GetScanlinePointer<I::G>(j),
+            m_region.src.template GetScanlinePointer<I::B>(j),
+            m_region.src.template GetScanlinePointer<I::A>(j));
+    }
+
+    const Kernel& m_kernel;
+    const ViewRegion<DestType>& m_region;
+    const bool m_allAligned;
+};
+
+template <class Kernel, typename DestType>
+void processRegion(const Kernel& kernel, const ViewRegion<DestType>& source)
+{
+    typedef pcg::RGBAImageSoA I;
+    const pcg::ConstRGBAImageSoAView& src = source.src;
+    const int n = SOA_PIXELS_PER_STEP;
+
+    // Every scanline is in place when the first ones are aligned and so
+    // are the strides
+    bool allAligned = src.Width() % n == 0 && src.Stride() % n == 0 &&
+        isGroupAligned(source.dest.GetDataPointer()) &&
+        isGroupAligned(src.GetDataPointer<I::R>()) &&
+        isGroupAligned(src.GetDataPointer<I::G>()) &&
+        isGroupAligned(src.GetDataPointer<I::B>()) &&
+        isGroupAligned(src.GetDataPointer<I::A>());
+    if (source.dest.Height() > 1) {
+        allAligned = allAligned &&
+            isGroupAligned(source.dest.GetScanlinePointer(1));
+    }
+
+    ViewRowProcessorTBB<DestType, Kernel> pTBB(kernel, source, allAligned);
+    pcg::concurrency::parallel_for(tbb::blocked_range<int>(0, src.Height()),
+        pTBB, src.Width());
+}
+
+
 template<class LuminanceScaler, class DisplayTransformer, class PixelAssembler>
 ToneMappingKernel<LuminanceScaler, DisplayTransformer, PixelAssembler>
 setupKernel(const LuminanceScaler& luminanceScaler,
@@ -1042,28 +1366,54 @@ struct pixel_assembler_traits<pcg::Vec4f, pcg::Bgra8>
     typedef PixelAssembler_BGRA8Vec4 assembler_t;
 };
 
+template <>
+struct pixel_assembler_traits<pcg::Vec4f, pcg::Rgba8>
+{
+    typedef PixelAssembler_RGBA8Vec4 assembler_t;
+};
+
+template <>
+struct pixel_assembler_traits<pcg::Vec4f, pcg::Rgba16>
+{
+    typedef PixelAssembler_RGBA16Vec4 assembler_t;
+};
+
 #if PCG_USE_AVX
 template <>
 struct pixel_assembler_traits<pcg::Vec8f, pcg::Bgra8>
 {
     typedef PixelAssembler_BGRA8Vec8 assembler_t;
 };
+
+template <>
+struct pixel_assembler_traits<pcg::Vec8f, pcg::Rgba8>
+{
+    typedef PixelAssembler_RGBA8Vec8 assembler_t;
+};
+
+template <>
+struct pixel_assembler_traits<pcg::Vec8f, pcg::Rgba16>
+{
+    typedef PixelAssembler_RGBA16Vec8 assembler_t;
+};
 #endif
 
 
 
-template <class LuminanceScaler, class DisplayTransform, typename SourceIter, typename DestIter>
+// The destination pixels are written in groups by the pixel assembler for
+// their type, so they need the same padding as the SoA images.
+template <class LuminanceScaler, class DisplayTransform, class Source>
 void ToneMapAux(const LuminanceScaler &scaler, const DisplayTransform &display,
-    SourceIter begin, SourceIter end, DestIter dest)
+    const Source& source)
 {
     typedef typename pixel_assembler_traits<typename LuminanceScaler::value_t,
-        pcg::Bgra8>::assembler_t assembler_t;
+        typename Source::dest_t>::assembler_t assembler_t;
     assembler_t assembler;
     typedef ToneMappingKernel<LuminanceScaler, DisplayTransform,
         assembler_t> kernel_t;
 
     kernel_t kernel=setupKernel(scaler, display, assembler);
-    processPixels(kernel, begin, end, dest);
+    processRegion(kernel, source);
 }
 
 
@@ -1076,7 +1426,10 @@ enum DisplayMethod
     EDISPLAY_SRGB_FAST2
 };
 
-inline DisplayMethod getDisplayMethod(const pcg::ToneMapperSoA& tm)
+// The fastest approximations are only accurate enough for 8-bit pixels, for
+// wider ones they are replaced by the next more accurate method
+inline DisplayMethod getDisplayMethod(const pcg::ToneMapperSoA& tm,
+    bool highPrecision = false)
 {
     if (tm.isSRGB()) {
         switch (tm.SRGBMethod()) {
@@ -1085,7 +1438,7 @@ inline DisplayMethod getDisplayMethod(const pcg::ToneMapperSoA& tm)
         case pcg::ToneMapperSoA::SRGB_FAST1:
             return EDISPLAY_SRGB_FAST1;
         case pcg::ToneMapperSoA::SRGB_FAST2:
-            return EDISPLAY_SRGB_FAST2;
+            return highPrecision ? EDISPLAY_SRGB_FAST1 : EDISPLAY_SRGB_FAST2;
         default:
             throw pcg::RuntimeException("Unexpected sRGB method");
         }
@@ -1095,7 +1448,7 @@ inline DisplayMethod getDisplayMethod(const pcg::ToneMapperSoA& tm)
         case pcg::ToneMapperSoA::GAMMA_REF:
             return EDISPLAY_GAMMA_REF;
         case pcg::ToneMapperSoA::GAMMA_FAST:
-            return EDISPLAY_GAMMA_FAST;
+            return highPrecision ? EDISPLAY_GAMMA_REF : EDISPLAY_GAMMA_FAST;
         default:
             throw pcg::RuntimeException("Unexpected gamma method");
         }
@@ -1104,9 +1457,9 @@ inline DisplayMethod getDisplayMethod(const pcg::ToneMapperSoA& tm)
 
 
 
-template <class LuminanceScaler, typename SourceIter, typename DestIter>
+template <class LuminanceScaler, class Source>
 void ToneMapAuxDelegate(const LuminanceScaler& scaler, DisplayMethod dMethod,
-    float invGamma, SourceIter begin, SourceIter end, DestIter dest)
+    float invGamma, const Source& source)
 {
     // Setup the display transforms
     typedef typename LuminanceScaler::value_t value_t;
@@ -1118,30 +1471,369 @@ void ToneMapAuxDelegate(const LuminanceScaler& scaler, DisplayMethod dMethod,
 
     switch(dMethod) {
     case EDISPLAY_GAMMA_REF:
-        ToneMapAux(scaler, displayGamma, begin, end, dest);
+        ToneMapAux(scaler, displayGamma, source);
         break;
     case EDISPLAY_GAMMA_FAST:
-        ToneMapAux(scaler, displayGammaFast, begin, end, dest);
+        ToneMapAux(scaler, displayGammaFast, source);
         break;
     case EDISPLAY_SRGB_REF:
-        ToneMapAux(scaler, displaySRGB0, begin, end, dest);
+        ToneMapAux(scaler, displaySRGB0, source);
         break;
     case EDISPLAY_SRGB_FAST1:
-        ToneMapAux(scaler, displaySRGB1, begin, end, dest);
+        ToneMapAux(scaler, displaySRGB1, source);
         break;
     case EDISPLAY_SRGB_FAST2:
-        ToneMapAux(scaler, displaySRGB2, begin, end, dest);
+        ToneMapAux(scaler, displaySRGB2, source);
         break;
     default:
         throw pcg::IllegalArgumentException("Unknown display method");
     }
 }
 
+
+// Group of RGBA pixels in SoA form, held by value
+struct RGBAVecValue
+{
+    comparator::vf rv, gv, bv, av;
+
+    inline comparator::vf& r() { return rv; }
+    inline comparator::vf& g() { return gv; }
+    inline comparator::vf& b() { return bv; }
+    inline comparator::vf& a() { return av; }
+
+    inline const comparator::vf& r() const { return rv; }
+    inline const comparator::vf& g() const { return gv; }
+    inline const comparator::vf& b() const { return bv; }
+    inline const comparator::vf& a() const { return av; }
+};
+
+// Read-only iterator over the comparison of two SoA images of the same size,
+// with the semantics of ImageComparator. Each group of pixels is compared
+// only when the iterator is dereferenced, so the comparison of the pixels
+// which are not tone mapped is never computed nor stored.
+template <class Op>
+class ComparisonIterator :
+public std::iterator<std::random_access_iterator_tag, RGBAVecValue>
+{
+public:
+    ComparisonIterator() {}
+
+    ComparisonIterator(const IteratorSoA& src1, const IteratorSoA& src2) :
+    m_src1(src1), m_src2(src2)
+    {}
+
+    // Both sources always advance together, so comparing one is enough
+
+    inline bool operator== (const ComparisonIterator& other) const {
+        return m_src1 == other.m_src1;
+    }
+    inline bool operator!= (const ComparisonIterator& other) const {
+        return m_src1 != other.m_src1;
+    }
+    inline bool operator< (const ComparisonIterator& other) const {
+        return m_src1 < other.m_src1;
+    }
+
+    inline ComparisonIterator& operator++() {
+        ++m_src1;
+        ++m_src2;
+        return *this;
+    }
+
+    inline ComparisonIterator& operator+=(difference_type offset) {
+        m_src1 += offset;
+        m_src2 += offset;
+        return *this;
+    }
+
+    inline friend ComparisonIterator operator+ (const ComparisonIterator& a,
+        difference_type offset)
+    {
+        ComparisonIterator it(a);
+        it += offset;
+        return it;
+    }
+
+    inline friend difference_type operator- (const ComparisonIterator& a,
+        const ComparisonIterator& b)
+    {
+        return a.m_src1 - b.m_src1;
+    }
+
+    inline value_type operator*() const {
+        value_type pixel;
+        Op::apply(*m_src1, *m_src2, pixel);
+        return pixel;
+    }
+
+private:
+    IteratorSoA m_src1;
+    IteratorSoA m_src2;
+};
+
+
+
+// Tone maps the SoA pixels of the source, either an IteratorRegion or a
+// ViewRegion
+template <class Source>
+void toneMapSoAIter(const Source& source,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    const bool highPrecision =
+        sizeof(typename Source::dest_t::pixel_t) > 1;
+    const DisplayMethod dMethod(getDisplayMethod(tm, highPrecision));
+
+    LuminanceScaler_Reinhard02<ScalerValueType> sReinhard02;
+    LuminanceScaler_Exposure<ScalerValueType> sExposure;
+
+    switch(technique) {
+    case pcg::REINHARD02:
+        sReinhard02.setExposureFactor(exposureFactor);
+        sReinhard02.SetParams(tm.ParamsReinhard02());
+        ToneMapAuxDelegate(sReinhard02, dMethod, tm.InvGamma(), source);
+        break;
+    case pcg::EXPOSURE:
+        sExposure.setExposureFactor(exposureFactor);
+        ToneMapAuxDelegate(sExposure, dMethod, tm.InvGamma(), source);
+        break;
+    default:
+        throw pcg::IllegalArgumentException("Invalid tone mapping technique");
+        break;
+    }
+}
+
+template <class Op>
+void toneMapComparison(pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoA& src1, const pcg::RGBAImageSoA& src2,
+    const Region& region, pcg::TmoTechnique technique,
+    const pcg::ToneMapperSoA& tm, float exposureFactor)
+{
+    typedef ComparisonIterator<Op> iterator_t;
+    const IteratorRegion<iterator_t, pcg::Bgra8> source = {
+        iterator_t(IteratorSoA::begin(src1), IteratorSoA::begin(src2)),
+        iterator_t(IteratorSoA::end(src1), IteratorSoA::end(src2)),
+        dest.GetDataPointer(), region
+    };
+    toneMapSoAIter(source, technique, tm, exposureFactor);
+}
+
+template <typename DestType>
+void toneMapSoAImpl(DestType* dest,
+    const pcg::RGBAImageSoA& src, int x, int y, int width, int height,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    const IteratorRegion<IteratorSoA, DestType> source = {
+        IteratorSoA::begin(src), IteratorSoA::end(src), dest,
+        {x, y, width, height, src.Width(), SOA_PIXELS_PER_STEP}
+    };
+    toneMapSoAIter(source, technique, tm, exposureFactor);
+}
+
+template <typename DestType>
+void toneMapSoAViewImpl(const pcg::ImageView<DestType>& dest,
+    const pcg::ConstRGBAImageSoAView& src,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    const ViewRegion<DestType> source = {src, dest};
+    toneMapSoAIter(source, technique, tm, exposureFactor);
+}
+
+
+
+// Swaps the scanlines of an image, to turn the top-down result of the
+// kernels into bottom-up order
+template <typename T>
+class FlipScanlinesTBB
+{
+public:
+    FlipScanlinesTBB(T* pixels, int width, int height) :
+    m_pixels(pixels), m_width(width), m_height(height)
+    {}
+
+    void operator() (const tbb::blocked_range<int>& range) const
+    {
+        for (int j = range.begin(); j != range.end(); ++j) {
+            T* top = m_pixels + static_cast<ptrdiff_t>(j) * m_width;
+            T* bottom = m_pixels +
+                static_cast<ptrdiff_t>(m_height - 1 - j) * m_width;
+            std::swap_ranges(top, top + m_width, bottom);
+        }
+    }
+
+private:
+    T* const m_pixels;
+    const int m_width;
+    const int m_height;
+};
+
+template <typename T>
+inline void toBottomUp(pcg::Image<T, pcg::TopDown>&)
+{
+}
+
+template <typename T>
+void toBottomUp(pcg::Image<T, pcg::BottomUp>& img)
+{
+    FlipScanlinesTBB<T> flipper(img.GetDataPointer(), img.Width(),
+        img.Height());
+    pcg::concurrency::parallel_for(tbb::blocked_range<int>(0,
+        img.Height() / 2), flipper, img.Width());
+}
+
 } // namespace
 
 
 
 
+namespace pcg
+{
+PCG_SIMD_DECLARE_KERNEL(void, toneMapSoA, (Bgra8* dest,
+    const RGBAImageSoA& src, int x, int y, int width, int height,
+    TmoTechnique technique, const ToneMapperSoA& tm, float exposureFactor))
+
+PCG_SIMD_DECLARE_KERNEL(void, toneMapSoA, (Rgba8* dest,
+    const RGBAImageSoA& src, int x, int y, int width, int height,
+    TmoTechnique technique, const ToneMapperSoA& tm, float exposureFactor))
+
+PCG_SIMD_DECLARE_KERNEL(void, toneMapSoA, (Rgba16* dest,
+    const RGBAImageSoA& src, int x, int y, int width, int height,
+    TmoTechnique technique, const ToneMapperSoA& tm, float exposureFactor))
+
+PCG_SIMD_DECLARE_KERNEL(void, toneMapSoAView, (const ImageView<Bgra8>& dest,
+    const ConstRGBAImageSoAView& src,
+    TmoTechnique technique, const ToneMapperSoA& tm, float exposureFactor))
+
+PCG_SIMD_DECLARE_KERNEL(void, toneMapSoAView, (const ImageView<Rgba8>& dest,
+    const ConstRGBAImageSoAView& src,
+    TmoTechnique technique, const ToneMapperSoA& tm, float exposureFactor))
+
+PCG_SIMD_DECLARE_KERNEL(void, toneMapSoAView, (const ImageView<Rgba16>& dest,
+    const ConstRGBAImageSoAView& src,
+    TmoTechnique technique, const ToneMapperSoA& tm, float exposureFactor))
+
+PCG_SIMD_DECLARE_KERNEL(void, toneMapCompareSoA, (Image<Bgra8, TopDown>& dest,
+    const RGBAImageSoA& src1, const RGBAImageSoA& src2,
+    ImageComparator::Type type, int x, int y, int width, int height,
+    TmoTechnique technique, const ToneMapperSoA& tm, float exposureFactor))
+} // namespace pcg
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::toneMapSoA(pcg::Bgra8* dest,
+    const pcg::RGBAImageSoA& src, int x, int y, int width, int height,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    toneMapSoAImpl(dest, src, x, y, width, height, technique, tm,
+        exposureFactor);
+}
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::toneMapSoA(pcg::Rgba8* dest,
+    const pcg::RGBAImageSoA& src, int x, int y, int width, int height,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    toneMapSoAImpl(dest, src, x, y, width, height, technique, tm,
+        exposureFactor);
+}
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::toneMapSoA(pcg::Rgba16* dest,
+    const pcg::RGBAImageSoA& src, int x, int y, int width, int height,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    toneMapSoAImpl(dest, src, x, y, width, height, technique, tm,
+        exposureFactor);
+}
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::toneMapSoAView(
+    const pcg::ImageView<pcg::Bgra8>& dest,
+    const pcg::ConstRGBAImageSoAView& src,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    toneMapSoAViewImpl(dest, src, technique, tm, exposureFactor);
+}
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::toneMapSoAView(
+    const pcg::ImageView<pcg::Rgba8>& dest,
+    const pcg::ConstRGBAImageSoAView& src,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    toneMapSoAViewImpl(dest, src, technique, tm, exposureFactor);
+}
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::toneMapSoAView(
+    const pcg::ImageView<pcg::Rgba16>& dest,
+    const pcg::ConstRGBAImageSoAView& src,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    toneMapSoAViewImpl(dest, src, technique, tm, exposureFactor);
+}
+
+
+
+void pcg::PCG_SIMD_NAMESPACE::toneMapCompareSoA(
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoA& src1, const pcg::RGBAImageSoA& src2,
+    pcg::ImageComparator::Type type, int x, int y, int width, int height,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    const Region region = {x, y, width, height, src1.Width(),
+        SOA_PIXELS_PER_STEP};
+
+    switch (type) {
+    case ImageComparator::AbsoluteDifference:
+        toneMapComparison<comparator::AbsoluteDifference>(dest, src1, src2,
+            region, technique, tm, exposureFactor);
+        break;
+    case ImageComparator::Addition:
+        toneMapComparison<comparator::Addition>(dest, src1, src2,
+            region, technique, tm, exposureFactor);
+        break;
+    case ImageComparator::Division:
+        toneMapComparison<comparator::Division>(dest, src1, src2,
+            region, technique, tm, exposureFactor);
+        break;
+    case ImageComparator::RelativeError:
+        toneMapComparison<comparator::RelativeError>(dest, src1, src2,
+            region, technique, tm, exposureFactor);
+        break;
+    case ImageComparator::PositiveNegative:
+        toneMapComparison<comparator::PositiveNegative>(dest, src1, src2,
+            region, technique, tm, exposureFactor);
+        break;
+    case ImageComparator::PositiveNegativeRelativeError:
+        toneMapComparison<comparator::PositiveNegativeRelativeError>(dest,
+            src1, src2, region, technique, tm, exposureFactor);
+        break;
+    default:
+        throw IllegalArgumentException("Invalid comparison type");
+        break;
+    }
+}
+
+
+
+// The entry points are only compiled once, for the baseline instruction set
+#if !PCG_SIMD_VARIANT
+
 void pcg::ToneMapperSoA::SetExposure(float exposure)
 {
     m_exposure = exposure;
@@ -1163,13 +1855,17 @@ void pcg::ToneMapperSoA::ToneMap(
 #if !USE_VECTOR4_ITERATOR
     const pcg::Rgba32F* begin = src.GetDataPointer();
     const pcg::Rgba32F* end   = begin + src.Size();
-    PixelBGRA8* out = reinterpret_cast<PixelBGRA8*>(dest.GetDataPointer());
+    Bgra8* out = dest.GetDataPointer();
     typedef float ScalerValueType;
+    const IteratorRegion<const pcg::Rgba32F*, Bgra8> source = {begin, end,
+        out, {0, 0, src.Width(), src.Height(), src.Width(), 1}};
 #else
     RGBA32FVec4ImageIterator begin = RGBA32FVec4ImageIterator::begin(src);
     RGBA32FVec4ImageIterator end   = RGBA32FVec4ImageIterator::end(src);
-    PixelBGRA8Vec4* out            = PixelBGRA8Vec4::begin(dest);
+    Bgra8* out                     = dest.GetDataPointer();
     typedef Vec4f ScalerValueType;
+    const IteratorRegion<RGBA32FVec4ImageIterator, Bgra8> source = {begin,
+        end, out, {0, 0, src.Width(), src.Height(), src.Width(), 4}};
 #endif
     LuminanceScaler_Reinhard02<ScalerValueType> sReinhard02;
     LuminanceScaler_Exposure<ScalerValueType>   sExposure;
@@ -1178,11 +1874,11 @@ void pcg::ToneMapperSoA::ToneMap(
     case pcg::REINHARD02:
         sReinhard02.setExposureFactor(this->m_exposureFactor);
         sReinhard02.SetParams(this->ParamsReinhard02());
-        ToneMapAuxDelegate(sReinhard02, dMethod, m_invGamma, begin, end, out);
+        ToneMapAuxDelegate(sReinhard02, dMethod, m_invGamma, source);
         break;
     case pcg::EXPOSURE:
         sExposure.setExposureFactor(this->m_exposureFactor);
-        ToneMapAuxDelegate(sExposure, dMethod, m_invGamma, begin, end, out);
+        ToneMapAuxDelegate(sExposure, dMethod, m_invGamma, source);
         break;
     default:
         throw IllegalArgumentException("Invalid tone mapping technique");
@@ -1200,37 +1896,194 @@ void pcg::ToneMapperSoA::ToneMap(
     assert(src.Width()  == dest.Width());
     assert(src.Height() == dest.Height());
 
-    const DisplayMethod dMethod(getDisplayMethod(*this));
-    
-#if PCG_USE_AVX
-    typedef RGBA32FVec8ImageSoAIterator IteratorSoA;
-    typedef PixelBGRA8Vec8 PixelVec;
-    typedef Vec8f ScalerValueType;
-#else
-    typedef RGBA32FVec4ImageSoAIterator IteratorSoA;
-    typedef PixelBGRA8Vec4 PixelVec;
-    typedef Vec4f ScalerValueType;
-#endif
+    PCG_SIMD_DISPATCH(toneMapSoA(dest.GetDataPointer(), src,
+        0, 0, src.Width(), src.Height(), technique, *this, m_exposureFactor));
+}
 
-    IteratorSoA begin = IteratorSoA::begin(src);
-    IteratorSoA end   = IteratorSoA::end(src);
-    PixelVec* out     = PixelVec::begin(dest);
 
-    LuminanceScaler_Reinhard02<ScalerValueType> sReinhard02;
-    LuminanceScaler_Exposure<ScalerValueType> sExposure;
 
-    switch(technique) {
-    case pcg::REINHARD02:
-        sReinhard02.setExposureFactor(this->m_exposureFactor);
-        sReinhard02.SetParams(this->ParamsReinhard02());
-        ToneMapAuxDelegate(sReinhard02, dMethod, m_invGamma, begin, end, out);
-        break;
-    case pcg::EXPOSURE:
-        sExposure.setExposureFactor(this->m_exposureFactor);
-        ToneMapAuxDelegate(sExposure, dMethod, m_invGamma, begin, end, out);
-        break;
-    default:
-        throw IllegalArgumentException("Invalid tone mapping technique");
-        break;
+namespace
+{
+
+// Tone maps the whole image in top-down order into the destination pixels
+template <typename T>
+void dispatchToneMapSoA(T* dest, const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    PCG_SIMD_DISPATCH(toneMapSoA(dest, src, 0, 0, src.Width(), src.Height(),
+        technique, tm, exposureFactor));
+}
+
+template <typename T>
+void toneMapView(const pcg::ImageView<T>& dest,
+    const pcg::ConstRGBAImageSoAView& src, pcg::TmoTechnique technique,
+    const pcg::ToneMapperSoA& tm, float exposureFactor)
+{
+    if (dest.Width() != src.Width() || dest.Height() != src.Height()) {
+        throw pcg::IllegalArgumentException("Incompatible views size");
+    }
+    if (src.Size() == 0) {
+        return;
     }
+    PCG_SIMD_DISPATCH(toneMapSoAView(dest, src, technique, tm,
+        exposureFactor));
 }
+
+template <typename T, pcg::ScanLineMode S>
+void toneMapImage(pcg::Image<T, S>& dest, const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique, const pcg::ToneMapperSoA& tm,
+    float exposureFactor)
+{
+    if (dest.Width() != src.Width() || dest.Height() != src.Height()) {
+        throw pcg::IllegalArgumentException("Incompatible images size");
+    }
+    if (src.Size() == 0) {
+        return;
+    }
+    dispatchToneMapSoA(dest.GetDataPointer(), src, technique, tm,
+        exposureFactor);
+    toBottomUp(dest);
+}
+
+} // namespace
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::BottomUp>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    toneMapImage(dest, src, technique, *this, m_exposureFactor);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    toneMapImage(dest, src, technique, *this, m_exposureFactor);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba8, pcg::BottomUp>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    toneMapImage(dest, src, technique, *this, m_exposureFactor);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba16, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    toneMapImage(dest, src, technique, *this, m_exposureFactor);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Rgba16, pcg::BottomUp>& dest,
+    const pcg::RGBAImageSoA& src,
+    pcg::TmoTechnique technique) const
+{
+    toneMapImage(dest, src, technique, *this, m_exposureFactor);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Bgra8>& dest,
+    const pcg::ConstRGBAImageSoAView& src,
+    pcg::TmoTechnique technique) const
+{
+    toneMapView(dest, src, technique, *this, m_exposureFactor);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Rgba8>& dest,
+    const pcg::ConstRGBAImageSoAView& src,
+    pcg::TmoTechnique technique) const
+{
+    toneMapView(dest, src, technique, *this, m_exposureFactor);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    const pcg::ImageView<pcg::Rgba16>& dest,
+    const pcg::ConstRGBAImageSoAView& src,
+    pcg::TmoTechnique technique) const
+{
+    toneMapView(dest, src, technique, *this, m_exposureFactor);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoA& src, int x, int y, int width, int height,
+    pcg::TmoTechnique technique) const
+{
+    assert(src.Width()  == dest.Width());
+    assert(src.Height() == dest.Height());
+    if (x < 0 || y < 0 || width < 0 || height < 0 ||
+        width > src.Width() - x || height > src.Height() - y) {
+        throw IllegalArgumentException("The region is outside the image");
+    }
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    PCG_SIMD_DISPATCH(toneMapSoA(dest.GetDataPointer(), src,
+        x, y, width, height, technique, *this, m_exposureFactor));
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoA& src1, const pcg::RGBAImageSoA& src2,
+    pcg::ImageComparator::Type type,
+    pcg::TmoTechnique technique) const
+{
+    ToneMap(dest, src1, src2, type, 0, 0, src1.Width(), src1.Height(),
+        technique);
+}
+
+
+
+void pcg::ToneMapperSoA::ToneMap(
+    pcg::Image<pcg::Bgra8, pcg::TopDown>& dest,
+    const pcg::RGBAImageSoA& src1, const pcg::RGBAImageSoA& src2,
+    pcg::ImageComparator::Type type, int x, int y, int width, int height,
+    pcg::TmoTechnique technique) const
+{
+    if (dest.Width() != src1.Width() || dest.Height() != src1.Height() ||
+        src1.Width() != src2.Width() || src1.Height() != src2.Height())
+    {
+        throw IllegalArgumentException("Incompatible images size");
+    }
+    if (x < 0 || y < 0 || width < 0 || height < 0 ||
+        width > src1.Width() - x || height > src1.Height() - y) {
+        throw IllegalArgumentException("The region is outside the image");
+    }
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    PCG_SIMD_DISPATCH(toneMapCompareSoA(dest, src1, src2, type,
+        x, y, width, height, technique, *this, m_exposureFactor));
+}
+
+#endif // !PCG_SIMD_VARIANT
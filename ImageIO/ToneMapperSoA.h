@@ -18,7 +18,9 @@
 #define PCG_TONEMAPPERSOA_H
 
 #include "Image.h"
+#include "ImageComparator.h"
 #include "ImageSoA.h"
+#include "ImageView.h"
 #include "Reinhard02.h"
 #include "Rgba32F.h"
 #include "LDRPixels.h"
@@ -145,6 +147,74 @@ public:
         const RGBAImageSoA& src,
         TmoTechnique technique = EXPOSURE) const;
 
+    // Variants for the other LDR pixel types and scanline orders. Both images
+    // must have the same size, otherwise they throw IllegalArgumentException.
+    // The 16-bit pixels use the more accurate SRGB_FAST1 and GAMMA_REF
+    // methods in place of SRGB_FAST2 and GAMMA_FAST, which are only precise
+    // enough for 8-bit pixels.
+    void ToneMap(Image<Bgra8, BottomUp>& dest,
+        const RGBAImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba8, TopDown>& dest,
+        const RGBAImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba8, BottomUp>& dest,
+        const RGBAImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba16, TopDown>& dest,
+        const RGBAImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(Image<Rgba16, BottomUp>& dest,
+        const RGBAImageSoA& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    // Tone maps only the region of width x height pixels whose top-left
+    // corner is the pixel (x,y). Both images must have the same size. The
+    // pixels are processed in groups of up to 8 contiguous pixels, thus some
+    // pixels next to the region, up to whole scanlines, may be tone mapped
+    // as well. It throws IllegalArgumentException if the region is not
+    // within the image.
+    void ToneMap(Image<Bgra8, TopDown>& dest,
+        const RGBAImageSoA& src, int x, int y, int width, int height,
+        TmoTechnique technique = EXPOSURE) const;
+
+    // Tone maps the pixels of a view into those of another view of the same
+    // size, otherwise it throws IllegalArgumentException. Unlike the region
+    // variant, only the pixels of the destination view are written. Scanlines
+    // not aligned to the groups of pixels are slower.
+    void ToneMap(const ImageView<Bgra8>& dest,
+        const ConstRGBAImageSoAView& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(const ImageView<Rgba8>& dest,
+        const ConstRGBAImageSoAView& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    void ToneMap(const ImageView<Rgba16>& dest,
+        const ConstRGBAImageSoAView& src,
+        TmoTechnique technique = EXPOSURE) const;
+
+    // Tone maps the comparison of two images, as computed by
+    // ImageComparator::Compare(type, tmp, src1, src2), without storing the
+    // comparison anywhere: it is evaluated only for the pixels being tone
+    // mapped. All images must have the same size, otherwise it throws
+    // IllegalArgumentException.
+    void ToneMap(Image<Bgra8, TopDown>& dest,
+        const RGBAImageSoA& src1, const RGBAImageSoA& src2,
+        ImageComparator::Type type,
+        TmoTechnique technique = EXPOSURE) const;
+
+    // Tone maps the comparison of two images only within the region, with
+    // the same semantics as the single image version.
+    void ToneMap(Image<Bgra8, TopDown>& dest,
+        const RGBAImageSoA& src1, const RGBAImageSoA& src2,
+        ImageComparator::Type type, int x, int y, int width, int height,
+        TmoTechnique technique = EXPOSURE) const;
+
 
 private:
 
@@ -0,0 +1,232 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "BenchUtil.h"
+
+#include "dSFMT/RandomMT.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#if defined(_WIN32)
+# include <process.h>
+# define getpid _getpid
+#else
+# include <unistd.h>
+#endif
+
+using pcg::Image;
+using pcg::Rgba32F;
+using pcg::RGBAImageSoA;
+using pcg::TopDown;
+
+
+namespace
+{
+
+typedef Image<Rgba32F, TopDown> ImageAoS;
+
+const int WIDTHS[]  = {320, 1920, 3840};
+const int HEIGHTS[] = {240, 1080, 2160};
+
+RGBAImageSoA* imagesSoA[bench::SIZE_CLASS_COUNT];
+RGBAImageSoA* othersSoA[bench::SIZE_CLASS_COUNT];
+ImageAoS* images[bench::SIZE_CLASS_COUNT];
+ImageAoS* others[bench::SIZE_CLASS_COUNT];
+
+// Fills the image with a few soft blobs of different colors over a gradient,
+// with multiplicative noise. The seed changes the noise and the phases.
+void fillSynthetic(RGBAImageSoA& img, unsigned int seed)
+{
+    RandomMT rnd(seed);
+    const float phase = 6.2831853f * rnd.nextFloat();
+    const float invW = 1.0f / img.Width();
+    const float invH = 1.0f / img.Height();
+
+    for (int j = 0; j < img.Height(); ++j) {
+        const float y = j * invH;
+        for (int i = 0; i < img.Width(); ++i) {
+            const float x = i * invW;
+
+            // Exponent within [-4,4], thus roughly 8 stops of range
+            const float e = 4.0f *
+                std::sin(7.0f * x + phase) * std::cos(5.0f * y - phase);
+            const float L = std::pow(2.0f, e) * (0.25f + y);
+            const float noise = 1.0f + 0.05f * (rnd.nextFloat() - 0.5f);
+
+            const int idx = j * img.Width() + i;
+            img.ElementAt<RGBAImageSoA::R>(idx) = L * noise * (0.5f + x);
+            img.ElementAt<RGBAImageSoA::G>(idx) = L * noise;
+            img.ElementAt<RGBAImageSoA::B>(idx) = L * noise * (1.5f - x);
+            img.ElementAt<RGBAImageSoA::A>(idx) = 1.0f;
+        }
+    }
+}
+
+ImageAoS* toAoS(const RGBAImageSoA& src)
+{
+    ImageAoS* img = new ImageAoS(src.Width(), src.Height());
+    for (int i = 0; i < src.Size(); ++i) {
+        (*img)[i].set(src.ElementAt<RGBAImageSoA::R>(i),
+            src.ElementAt<RGBAImageSoA::G>(i),
+            src.ElementAt<RGBAImageSoA::B>(i),
+            src.ElementAt<RGBAImageSoA::A>(i));
+    }
+    return img;
+}
+
+const RGBAImageSoA& cachedSoA(RGBAImageSoA* (&cache)[bench::SIZE_CLASS_COUNT],
+    bench::SizeClass size, unsigned int seed)
+{
+    assert(size >= 0 && size < bench::SIZE_CLASS_COUNT);
+    if (cache[size] == NULL) {
+        cache[size] = new RGBAImageSoA(bench::Width(size), bench::Height(size));
+        fillSynthetic(*cache[size], seed);
+    }
+    return *cache[size];
+}
+
+template <class T>
+void release(T* (&cache)[bench::SIZE_CLASS_COUNT])
+{
+    for (int i = 0; i < bench::SIZE_CLASS_COUNT; ++i) {
+        delete cache[i];
+        cache[i] = NULL;
+    }
+}
+
+} // namespace
+
+
+
+int bench::Width(SizeClass size)
+{
+    assert(size >= 0 && size < SIZE_CLASS_COUNT);
+    return WIDTHS[size];
+}
+
+
+
+int bench::Height(SizeClass size)
+{
+    assert(size >= 0 && size < SIZE_CLASS_COUNT);
+    return HEIGHTS[size];
+}
+
+
+
+std::string bench::SizeName(SizeClass size)
+{
+    std::ostringstream os;
+    os << Width(size) << 'x' << Height(size);
+    return os.str();
+}
+
+
+
+const RGBAImageSoA& bench::InputImageSoA(SizeClass size)
+{
+    return cachedSoA(imagesSoA, size, 5489u);
+}
+
+
+
+const ImageAoS& bench::InputImage(SizeClass size)
+{
+    if (images[size] == NULL) {
+        images[size] = toAoS(InputImageSoA(size));
+    }
+    return *images[size];
+}
+
+
+
+const RGBAImageSoA& bench::OtherImageSoA(SizeClass size)
+{
+    return cachedSoA(othersSoA, size, 1812433253u);
+}
+
+
+
+const ImageAoS& bench::OtherImage(SizeClass size)
+{
+    if (others[size] == NULL) {
+        others[size] = toAoS(OtherImageSoA(size));
+    }
+    return *others[size];
+}
+
+
+
+void bench::ReleaseImages()
+{
+    release(imagesSoA);
+    release(othersSoA);
+    release(images);
+    release(others);
+}
+
+
+
+bench::TempFile::TempFile(const char* extension)
+{
+    static int counter = 0;
+
+    const char* dir = getenv("TMPDIR");
+#if defined(_WIN32)
+    if (dir == NULL) {
+        dir = getenv("TEMP");
+    }
+    const char separator = '\\';
+#else
+    const char separator = '/';
+#endif
+    if (dir == NULL) {
+#if defined(_WIN32)
+        dir = ".";
+#else
+        dir = "/tmp";
+#endif
+    }
+
+    std::ostringstream os;
+    os << dir << separator << "ImageIO_bench_" << getpid() << '_'
+       << counter++ << extension;
+    m_path = os.str();
+}
+
+
+
+bench::TempFile::~TempFile()
+{
+    remove(m_path.c_str());
+}
+
+
+
+long bench::TempFile::size() const
+{
+    FILE* f = fopen(m_path.c_str(), "rb");
+    if (f == NULL) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    const long s = ftell(f);
+    fclose(f);
+    return s;
+}
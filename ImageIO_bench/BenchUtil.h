@@ -0,0 +1,85 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Helpers shared by the benchmarks: image sizes, input images and files
+
+#pragma once
+#if !defined(PCG_BENCHUTIL_H)
+#define PCG_BENCHUTIL_H
+
+#include <Image.h>
+#include <ImageSoA.h>
+#include <Rgba32F.h>
+
+#include <string>
+
+namespace bench
+{
+
+// Classes of image sizes used by the codec and kernel benchmarks
+enum SizeClass
+{
+    SIZE_SMALL = 0,  // 320x240
+    SIZE_HD,         // 1920x1080
+    SIZE_UHD,        // 3840x2160
+    SIZE_CLASS_COUNT
+};
+
+int Width(SizeClass size);
+int Height(SizeClass size);
+
+// Dimensions as text, e.g. "1920x1080"
+std::string SizeName(SizeClass size);
+
+// Synthetic HDR image of the given size class: smooth features spanning
+// about 8 stops plus some noise, so that the codecs do not compress it
+// unrealistically well. The images are created once and then reused.
+const pcg::RGBAImageSoA& InputImageSoA(SizeClass size);
+const pcg::Image<pcg::Rgba32F, pcg::TopDown>& InputImage(SizeClass size);
+
+// Second image to compare against the input image of the same size class
+const pcg::RGBAImageSoA& OtherImageSoA(SizeClass size);
+const pcg::Image<pcg::Rgba32F, pcg::TopDown>& OtherImage(SizeClass size);
+
+// Releases the cached images, to keep the memory usage in check
+void ReleaseImages();
+
+
+
+// Name of a file in the temporary directory which is deleted on destruction
+class TempFile
+{
+public:
+    // The extension includes the dot, e.g. ".exr"
+    explicit TempFile(const char* extension);
+    ~TempFile();
+
+    const char* path() const {
+        return m_path.c_str();
+    }
+
+    // Size in bytes of the file, or -1 if it does not exist
+    long size() const;
+
+private:
+    std::string m_path;
+
+    TempFile(const TempFile&);
+    TempFile& operator= (const TempFile&);
+};
+
+} // namespace bench
+
+#endif /* PCG_BENCHUTIL_H */
@@ -0,0 +1,420 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "Benchmark.h"
+#include "BenchUtil.h"
+
+#include <Concurrency.h>
+#include <CpuFeatures.h>
+
+#include <tbb/task_scheduler_init.h>
+
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <iostream>
+
+
+namespace
+{
+
+// Upper bound of the timed iterations, regardless of the minimum time
+const int64_t MAX_ITERATIONS = 1000000000;
+
+struct Entry
+{
+    std::string name;
+    bench::Function fn;
+    int arg;
+
+    Entry(const std::string& n, bench::Function f, int a) :
+    name(n), fn(f), arg(a) {}
+};
+
+// Function-local so that it is ready during static initialization
+std::vector<Entry>& registry()
+{
+    static std::vector<Entry> entries;
+    return entries;
+}
+
+struct Result
+{
+    std::string name;
+    int threads;
+    int64_t iterations;
+    double seconds;
+    double mpixelsPerSecond;
+    double gbPerSecond;
+    std::string error;
+
+    // Milliseconds per iteration
+    double milliTime() const {
+        return iterations > 0 ? 1e3 * seconds / iterations : 0.0;
+    }
+};
+
+Result makeResult(const std::string& name, const bench::State& state)
+{
+    Result r;
+    r.name = name;
+    r.threads = state.threads();
+    r.iterations = state.iterations();
+    r.seconds = state.seconds();
+    r.mpixelsPerSecond = 0.0;
+    r.gbPerSecond = 0.0;
+    if (r.seconds > 0.0) {
+        const double n = static_cast<double>(r.iterations);
+        r.mpixelsPerSecond = 1e-6 * n * state.pixelsProcessed() / r.seconds;
+        r.gbPerSecond = 1e-9 * n * state.bytesProcessed() / r.seconds;
+    }
+    if (state.hasError()) {
+        r.error = state.errorMessage();
+    }
+    return r;
+}
+
+
+
+// Context of the run, reported along with the results
+struct Context
+{
+    std::string date;
+    int numCpus;
+    std::string isa;
+    double minTime;
+};
+
+Context makeContext(const bench::Options& options)
+{
+    Context c;
+    char buf[64];
+    const time_t now = time(NULL);
+    if (strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", localtime(&now)) > 0) {
+        c.date = buf;
+    }
+    c.numCpus = tbb::task_scheduler_init::default_num_threads();
+    c.isa = pcg::CpuFeatures::Name(pcg::CpuFeatures::Active());
+    c.minTime = options.minTime;
+    return c;
+}
+
+
+
+std::string jsonEscape(const std::string& str)
+{
+    std::string out;
+    for (size_t i = 0; i < str.size(); ++i) {
+        const char c = str[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            sprintf(buf, "\\u%04x", static_cast<unsigned int>(c));
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+std::string csvEscape(const std::string& str)
+{
+    if (str.find_first_of(",\"\n") == std::string::npos) {
+        return str;
+    }
+    std::string out("\"");
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (str[i] == '"') {
+            out += '"';
+        }
+        out += str[i];
+    }
+    out += '"';
+    return out;
+}
+
+
+
+void writeConsoleHeader(std::ostream& os, const Context& context)
+{
+    char line[256];
+    sprintf(line, "%-60s %7s %10s %12s %11s %9s",
+        "Benchmark", "Threads", "Iterations", "Time", "MPixels/s", "GB/s");
+    os << "Run on " << context.date << ", " << context.numCpus
+       << " CPUs, " << context.isa << " kernels\n"
+       << line << '\n' << std::string(114, '-') << std::endl;
+}
+
+void writeConsole(std::ostream& os, const Result& r)
+{
+    char line[256];
+    if (r.error.empty()) {
+        sprintf(line, "%-60s %7d %10lld %9.3f ms %11.2f %9.3f",
+            r.name.c_str(), r.threads, static_cast<long long>(r.iterations),
+            r.milliTime(), r.mpixelsPerSecond, r.gbPerSecond);
+        os << line << std::endl;
+    } else {
+        sprintf(line, "%-60s %7d ", r.name.c_str(), r.threads);
+        os << line << "ERROR: " << r.error << std::endl;
+    }
+}
+
+void writeJSON(std::ostream& os, const Context& context,
+    const std::vector<Result>& results)
+{
+    char buf[512];
+    os << "{\n  \"context\": {\n"
+       << "    \"date\": \"" << context.date << "\",\n"
+       << "    \"num_cpus\": " << context.numCpus << ",\n"
+       << "    \"instruction_set\": \"" << context.isa << "\",\n"
+       << "    \"min_time\": " << context.minTime << "\n"
+       << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        os << (i == 0 ? "\n" : ",\n")
+           << "    {\n      \"name\": \"" << jsonEscape(r.name) << "\",\n";
+        sprintf(buf,
+            "      \"threads\": %d,\n"
+            "      \"iterations\": %lld,\n"
+            "      \"real_time_ms\": %.6f,\n"
+            "      \"mpixels_per_second\": %.6f,\n"
+            "      \"gb_per_second\": %.6f",
+            r.threads, static_cast<long long>(r.iterations), r.milliTime(),
+            r.mpixelsPerSecond, r.gbPerSecond);
+        os << buf;
+        if (!r.error.empty()) {
+            os << ",\n      \"error_message\": \"" << jsonEscape(r.error) << '"';
+        }
+        os << "\n    }";
+    }
+    os << "\n  ]\n}" << std::endl;
+}
+
+void writeCSV(std::ostream& os, const std::vector<Result>& results)
+{
+    char buf[256];
+    os << "name,threads,iterations,real_time_ms,mpixels_per_second,"
+          "gb_per_second,error_message\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        sprintf(buf, ",%d,%lld,%.6f,%.6f,%.6f,",
+            r.threads, static_cast<long long>(r.iterations), r.milliTime(),
+            r.mpixelsPerSecond, r.gbPerSecond);
+        os << csvEscape(r.name) << buf << csvEscape(r.error) << '\n';
+    }
+    os.flush();
+}
+
+void writeResults(std::ostream& os, bench::Format format,
+    const Context& context, const std::vector<Result>& results)
+{
+    switch (format) {
+    case bench::FORMAT_JSON:
+        writeJSON(os, context, results);
+        break;
+    case bench::FORMAT_CSV:
+        writeCSV(os, results);
+        break;
+    default:
+        writeConsoleHeader(os, context);
+        for (size_t i = 0; i < results.size(); ++i) {
+            writeConsole(os, results[i]);
+        }
+        break;
+    }
+}
+
+} // namespace
+
+
+
+bench::State::State(int arg, int threads, double minTime) :
+m_arg(arg), m_threads(threads), m_minTime(minTime),
+m_phase(PHASE_SETUP), m_running(false), m_iterations(0),
+m_pixels(0), m_bytes(0), m_hasError(false)
+{
+}
+
+
+
+bool bench::State::KeepRunning()
+{
+    switch (m_phase) {
+    case PHASE_SETUP:
+        m_phase = m_hasError ? PHASE_DONE : PHASE_WARMUP;
+        return !m_hasError;
+    case PHASE_WARMUP:
+        break;
+    case PHASE_TIMING:
+        if (m_running) {
+            m_timer.stop();
+            m_running = false;
+        }
+        ++m_iterations;
+        if (m_iterations >= MAX_ITERATIONS || seconds() >= m_minTime) {
+            m_phase = PHASE_DONE;
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+
+    if (m_hasError) {
+        m_phase = PHASE_DONE;
+        return false;
+    }
+    m_phase = PHASE_TIMING;
+    m_running = true;
+    m_timer.start();
+    return true;
+}
+
+
+
+void bench::State::PauseTiming()
+{
+    if (m_running) {
+        m_timer.stop();
+        m_running = false;
+    }
+}
+
+
+
+void bench::State::ResumeTiming()
+{
+    if (m_phase == PHASE_TIMING && !m_running) {
+        m_running = true;
+        m_timer.start();
+    }
+}
+
+
+
+void bench::State::SkipWithError(const std::string& message)
+{
+    PauseTiming();
+    m_hasError = true;
+    m_error = message;
+}
+
+
+
+double bench::State::seconds() const
+{
+    return 1e-9 * m_timer.nanoTime();
+}
+
+
+
+bool bench::Register(const std::string& name, Function fn, int arg)
+{
+    registry().push_back(Entry(name, fn, arg));
+    return true;
+}
+
+
+
+bool bench::RegisterSizes(const std::string& name, Function fn)
+{
+    for (int i = 0; i < SIZE_CLASS_COUNT; ++i) {
+        const SizeClass size = static_cast<SizeClass>(i);
+        Register(name + '/' + SizeName(size), fn, i);
+    }
+    return true;
+}
+
+
+
+int bench::RunBenchmarks(const Options& options)
+{
+    std::vector<const Entry*> selected;
+    const std::vector<Entry>& entries = registry();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].name.find(options.filter) != std::string::npos) {
+            selected.push_back(&entries[i]);
+        }
+    }
+    if (options.list) {
+        for (size_t i = 0; i < selected.size(); ++i) {
+            std::cout << selected[i]->name << '\n';
+        }
+        std::cout.flush();
+        return 0;
+    }
+
+    std::vector<int> threads(options.threads);
+    if (threads.empty()) {
+        const int numCpus = tbb::task_scheduler_init::default_num_threads();
+        threads.push_back(1);
+        if (numCpus > 1) {
+            threads.push_back(numCpus);
+        }
+    }
+
+    const Context context = makeContext(options);
+    if (options.format == FORMAT_CONSOLE) {
+        writeConsoleHeader(std::cout, context);
+    }
+
+    int failures = 0;
+    std::vector<Result> results;
+    for (size_t t = 0; t < threads.size(); ++t) {
+        // Everything within this scope, including the setup of each
+        // benchmark, uses a task scheduler with the requested threads
+        tbb::task_scheduler_init init(threads[t]);
+        pcg::Concurrency::SetMaxThreads(threads[t]);
+
+        for (size_t i = 0; i < selected.size(); ++i) {
+            State state(selected[i]->arg, threads[t], options.minTime);
+            try {
+                selected[i]->fn(state);
+            }
+            catch (std::exception& e) {
+                state.SkipWithError(e.what());
+            }
+            catch (...) {
+                state.SkipWithError("Unknown exception");
+            }
+
+            results.push_back(makeResult(selected[i]->name, state));
+            if (state.hasError()) {
+                ++failures;
+            }
+            if (options.format == FORMAT_CONSOLE) {
+                writeConsole(std::cout, results.back());
+            }
+        }
+    }
+    ReleaseImages();
+
+    if (options.format != FORMAT_CONSOLE) {
+        writeResults(std::cout, options.format, context, results);
+    }
+    if (!options.outFile.empty()) {
+        std::ofstream os(options.outFile.c_str());
+        if (!os) {
+            std::cerr << "Could not open " << options.outFile << std::endl;
+            return failures + 1;
+        }
+        writeResults(os, options.fileFormat, context, results);
+    }
+    return failures;
+}
@@ -0,0 +1,182 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Minimal benchmark harness in the spirit of Google Benchmark. Each benchmark
+// is a function which does its setup and then runs the code to measure in a
+// loop such as
+//
+//     void BM_Something(bench::State& state) {
+//         ... setup, not timed ...
+//         while (state.KeepRunning()) {
+//             ... timed code ...
+//         }
+//         state.SetPixelsProcessed(pixelsPerIteration);
+//     }
+//
+// The benchmarks are registered during static initialization and run for
+// each of the requested thread counts by RunBenchmarks().
+
+#pragma once
+#if !defined(PCG_BENCHMARK_H)
+#define PCG_BENCHMARK_H
+
+#include "Timer.h"
+
+#include <string>
+#include <vector>
+
+namespace bench
+{
+
+// Timing state of a running benchmark
+class State
+{
+public:
+    State(int arg, int threads, double minTime);
+
+    // Returns whether the timed loop should run one more iteration. The first
+    // iteration is an untimed warm-up, the following ones are timed until
+    // they add up to the minimum time.
+    bool KeepRunning();
+
+    // Excludes a section of the timed loop from the measurements
+    void PauseTiming();
+    void ResumeTiming();
+
+    // Work done by each iteration, used to report the throughput. By
+    // convention the bytes are the in-memory size of the uncompressed input
+    // pixels, or of the decoded pixels when loading files.
+    void SetPixelsProcessed(int64_t pixels) {
+        m_pixels = pixels;
+    }
+    void SetBytesProcessed(int64_t bytes) {
+        m_bytes = bytes;
+    }
+
+    // Stops the benchmark, which is reported as failed with the message
+    void SkipWithError(const std::string& message);
+
+    // Argument given at registration, such as the size class of the images
+    int arg() const {
+        return m_arg;
+    }
+
+    // Number of threads of the task scheduler for this run
+    int threads() const {
+        return m_threads;
+    }
+
+    int64_t iterations() const {
+        return m_iterations;
+    }
+
+    // Total timed seconds over all the iterations
+    double seconds() const;
+
+    int64_t pixelsProcessed() const {
+        return m_pixels;
+    }
+
+    int64_t bytesProcessed() const {
+        return m_bytes;
+    }
+
+    bool hasError() const {
+        return m_hasError;
+    }
+
+    const std::string& errorMessage() const {
+        return m_error;
+    }
+
+private:
+    const int m_arg;
+    const int m_threads;
+    const double m_minTime;
+
+    enum Phase
+    {
+        PHASE_SETUP,
+        PHASE_WARMUP,
+        PHASE_TIMING,
+        PHASE_DONE
+    };
+
+    Timer m_timer;
+    Phase m_phase;
+    bool m_running;
+    int64_t m_iterations;
+    int64_t m_pixels;
+    int64_t m_bytes;
+
+    bool m_hasError;
+    std::string m_error;
+};
+
+
+
+typedef void (*Function)(State& state);
+
+// Registers a benchmark under a unique name, such as "RgbeIO/Load/SoA". The
+// argument is available through State::arg(). Returns true so that it may
+// be used to initialize a static variable.
+bool Register(const std::string& name, Function fn, int arg = 0);
+
+// Registers a benchmark once per size class (see BenchUtil.h), appending the
+// image dimensions to the name, e.g. "RgbeIO/Load/SoA/1920x1080"
+bool RegisterSizes(const std::string& name, Function fn);
+
+
+
+// Output formats of the results
+enum Format
+{
+    FORMAT_CONSOLE,
+    FORMAT_JSON,
+    FORMAT_CSV
+};
+
+struct Options
+{
+    // Only the benchmarks whose name contains this string are run
+    std::string filter;
+
+    // Thread counts of the task scheduler; empty means 1 and the default
+    std::vector<int> threads;
+
+    // Minimum timed seconds of each benchmark
+    double minTime;
+
+    // Format of the standard output
+    Format format;
+
+    // Optional file which also receives the results, in fileFormat
+    std::string outFile;
+    Format fileFormat;
+
+    // Only print the names of the matching benchmarks
+    bool list;
+
+    Options() : minTime(0.5), format(FORMAT_CONSOLE),
+        fileFormat(FORMAT_JSON), list(false) {}
+};
+
+// Runs all the registered benchmarks which match the options, returning the
+// number of failed benchmarks
+int RunBenchmarks(const Options& options);
+
+} // namespace bench
+
+#endif /* PCG_BENCHMARK_H */
@@ -0,0 +1,239 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Benchmarks of loading and saving files in every supported format. The
+// files live in the temporary directory, which is usually cached by the
+// operating system, thus the results mostly reflect the codecs themselves.
+
+#include "Benchmark.h"
+#include "BenchUtil.h"
+
+#include <LDRPixels.h>
+#include <OpenEXRIO.h>
+#include <PfmIO.h>
+#include <PngIO.h>
+#include <RgbeIO.h>
+#include <ToneMapper.h>
+
+
+using namespace pcg;
+
+namespace
+{
+
+typedef Image<Rgba32F, TopDown> ImageAoS;
+
+
+// Each codec trait provides the image type, the file extension, the input
+// image for a size class and the load and save operations
+
+struct RgbeAoS
+{
+    typedef ImageAoS image_t;
+    static const char* extension() { return ".hdr"; }
+    static const image_t& input(bench::SizeClass size) {
+        return bench::InputImage(size);
+    }
+    static void save(const image_t& img, const char* filename) {
+        RgbeIO::Save(img, filename);
+    }
+    static void load(image_t& img, const char* filename) {
+        RgbeIO::Load(img, filename);
+    }
+};
+
+struct RgbeSoA
+{
+    typedef RGBAImageSoA image_t;
+    static const char* extension() { return ".hdr"; }
+    static const image_t& input(bench::SizeClass size) {
+        return bench::InputImageSoA(size);
+    }
+    static void save(const image_t& img, const char* filename) {
+        RgbeIO::Save(img, filename);
+    }
+    static void load(image_t& img, const char* filename) {
+        RgbeIO::Load(img, filename);
+    }
+};
+
+struct PfmAoS
+{
+    typedef ImageAoS image_t;
+    static const char* extension() { return ".pfm"; }
+    static const image_t& input(bench::SizeClass size) {
+        return bench::InputImage(size);
+    }
+    static void save(const image_t& img, const char* filename) {
+        PfmIO::Save(img, filename);
+    }
+    static void load(image_t& img, const char* filename) {
+        PfmIO::Load(img, filename);
+    }
+};
+
+struct PfmSoA
+{
+    typedef RGBAImageSoA image_t;
+    static const char* extension() { return ".pfm"; }
+    static const image_t& input(bench::SizeClass size) {
+        return bench::InputImageSoA(size);
+    }
+    static void save(const image_t& img, const char* filename) {
+        PfmIO::Save(img, filename);
+    }
+    static void load(image_t& img, const char* filename) {
+        PfmIO::Load(img, filename);
+    }
+};
+
+template <OpenEXRIO::Compression C>
+struct OpenEXRAoS
+{
+    typedef ImageAoS image_t;
+    static const char* extension() { return ".exr"; }
+    static const image_t& input(bench::SizeClass size) {
+        return bench::InputImage(size);
+    }
+    static void save(const image_t& img, const char* filename) {
+        OpenEXRIO::Save(img, filename, OpenEXRIO::WRITE_RGBA, C);
+    }
+    static void load(image_t& img, const char* filename) {
+        OpenEXRIO::Load(img, filename);
+    }
+};
+
+template <OpenEXRIO::Compression C>
+struct OpenEXRSoA
+{
+    typedef RGBAImageSoA image_t;
+    static const char* extension() { return ".exr"; }
+    static const image_t& input(bench::SizeClass size) {
+        return bench::InputImageSoA(size);
+    }
+    static void save(const image_t& img, const char* filename) {
+        OpenEXRIO::Save(img, filename, OpenEXRIO::WRITE_RGBA, C);
+    }
+    static void load(image_t& img, const char* filename) {
+        OpenEXRIO::Load(img, filename);
+    }
+};
+
+
+
+// The throughput is relative to the uncompressed floating point pixels
+template <class Codec>
+void BM_Save(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    const typename Codec::image_t& img = Codec::input(size);
+    bench::TempFile file(Codec::extension());
+
+    while (state.KeepRunning()) {
+        Codec::save(img, file.path());
+    }
+    state.SetPixelsProcessed(img.Size());
+    state.SetBytesProcessed(img.Size() * 4 * sizeof(float));
+}
+
+template <class Codec>
+void BM_Load(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    bench::TempFile file(Codec::extension());
+    Codec::save(Codec::input(size), file.path());
+
+    typename Codec::image_t img;
+    while (state.KeepRunning()) {
+        Codec::load(img, file.path());
+    }
+    state.SetPixelsProcessed(img.Size());
+    state.SetBytesProcessed(img.Size() * 4 * sizeof(float));
+}
+
+// Reading the RGBE pixels without converting them to floating point
+void BM_RgbeLoadRaw(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    bench::TempFile file(".hdr");
+    RgbeIO::Save(bench::InputImage(size), file.path());
+
+    Image<Rgbe, TopDown> img;
+    while (state.KeepRunning()) {
+        RgbeIO::Load(img, file.path());
+    }
+    state.SetPixelsProcessed(img.Size());
+    state.SetBytesProcessed(img.Size() * sizeof(Rgbe));
+}
+
+// PngIO only saves files, from the tone mapped input image
+template <class T>
+void BM_PngSave(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    Image<T, TopDown> img(bench::Width(size), bench::Height(size));
+    ToneMapper toneMapper(-2.0f, 4096);
+    toneMapper.ToneMap(img, bench::InputImage(size));
+    bench::TempFile file(".png");
+
+    while (state.KeepRunning()) {
+        PngIO::Save(img, file.path());
+    }
+    state.SetPixelsProcessed(img.Size());
+    state.SetBytesProcessed(img.Size() * sizeof(T));
+}
+
+
+
+bool registerBenchmarks()
+{
+    using bench::RegisterSizes;
+
+    RegisterSizes("RgbeIO/Save/AoS", &BM_Save<RgbeAoS>);
+    RegisterSizes("RgbeIO/Save/SoA", &BM_Save<RgbeSoA>);
+    RegisterSizes("RgbeIO/Load/AoS", &BM_Load<RgbeAoS>);
+    RegisterSizes("RgbeIO/Load/SoA", &BM_Load<RgbeSoA>);
+    RegisterSizes("RgbeIO/Load/Rgbe", &BM_RgbeLoadRaw);
+
+    RegisterSizes("PfmIO/Save/AoS", &BM_Save<PfmAoS>);
+    RegisterSizes("PfmIO/Save/SoA", &BM_Save<PfmSoA>);
+    RegisterSizes("PfmIO/Load/AoS", &BM_Load<PfmAoS>);
+    RegisterSizes("PfmIO/Load/SoA", &BM_Load<PfmSoA>);
+
+    RegisterSizes("OpenEXRIO/Save/AoS/ZIP",
+        &BM_Save<OpenEXRAoS<OpenEXRIO::ZIP> >);
+    RegisterSizes("OpenEXRIO/Load/AoS/ZIP",
+        &BM_Load<OpenEXRAoS<OpenEXRIO::ZIP> >);
+    RegisterSizes("OpenEXRIO/Save/SoA/None",
+        &BM_Save<OpenEXRSoA<OpenEXRIO::None> >);
+    RegisterSizes("OpenEXRIO/Save/SoA/ZIP",
+        &BM_Save<OpenEXRSoA<OpenEXRIO::ZIP> >);
+    RegisterSizes("OpenEXRIO/Save/SoA/PIZ",
+        &BM_Save<OpenEXRSoA<OpenEXRIO::PIZ> >);
+    RegisterSizes("OpenEXRIO/Load/SoA/None",
+        &BM_Load<OpenEXRSoA<OpenEXRIO::None> >);
+    RegisterSizes("OpenEXRIO/Load/SoA/ZIP",
+        &BM_Load<OpenEXRSoA<OpenEXRIO::ZIP> >);
+    RegisterSizes("OpenEXRIO/Load/SoA/PIZ",
+        &BM_Load<OpenEXRSoA<OpenEXRIO::PIZ> >);
+
+    RegisterSizes("PngIO/Save/Rgba8", &BM_PngSave<Rgba8>);
+    RegisterSizes("PngIO/Save/Rgba16", &BM_PngSave<Rgba16>);
+    return true;
+}
+
+const bool registered = registerBenchmarks();
+
+} // namespace
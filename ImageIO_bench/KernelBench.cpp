@@ -0,0 +1,272 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Benchmarks of the in-memory kernels: pixel conversions, tone mapping,
+// parameter estimation and image comparisons. The SoA kernels use the
+// instruction set selected with CpuFeatures.
+
+#include "Benchmark.h"
+#include "BenchUtil.h"
+
+#include <ImageComparator.h>
+#include <LDRPixels.h>
+#include <Reinhard02.h>
+#include <rgbe.h>
+#include <ToneMapper.h>
+#include <ToneMapperSoA.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+
+using namespace pcg;
+
+namespace
+{
+
+typedef Image<Rgba32F, TopDown> ImageAoS;
+
+
+// Scanline-parallel conversions between floating point and RGBE pixels
+
+class ToRgbeFunctor
+{
+public:
+    ToRgbeFunctor(Image<Rgbe, TopDown>& dest, const ImageAoS& src) :
+    m_dest(dest), m_src(src) {}
+
+    void operator() (const tbb::blocked_range<int>& range) const {
+        for (int j = range.begin(); j != range.end(); ++j) {
+            const Rgba32F* src = m_src.GetScanlinePointer(j);
+            Rgbe* dest = m_dest.GetScanlinePointer(j);
+            for (int i = 0; i < m_src.Width(); ++i) {
+                dest[i].set(src[i]);
+            }
+        }
+    }
+
+private:
+    Image<Rgbe, TopDown>& m_dest;
+    const ImageAoS& m_src;
+};
+
+class ToFloatFunctor
+{
+public:
+    ToFloatFunctor(ImageAoS& dest, const Image<Rgbe, TopDown>& src) :
+    m_dest(dest), m_src(src) {}
+
+    void operator() (const tbb::blocked_range<int>& range) const {
+        for (int j = range.begin(); j != range.end(); ++j) {
+            const Rgbe* src = m_src.GetScanlinePointer(j);
+            Rgba32F* dest = m_dest.GetScanlinePointer(j);
+            for (int i = 0; i < m_src.Width(); ++i) {
+                dest[i] = static_cast<Rgba32F>(src[i]);
+            }
+        }
+    }
+
+private:
+    ImageAoS& m_dest;
+    const Image<Rgbe, TopDown>& m_src;
+};
+
+void BM_RgbeFromFloat(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    const ImageAoS& src = bench::InputImage(size);
+    Image<Rgbe, TopDown> dest(src.Width(), src.Height());
+
+    while (state.KeepRunning()) {
+        tbb::parallel_for(tbb::blocked_range<int>(0, src.Height()),
+            ToRgbeFunctor(dest, src));
+    }
+    state.SetPixelsProcessed(src.Size());
+    state.SetBytesProcessed(src.Size() * sizeof(Rgba32F));
+}
+
+void BM_RgbeToFloat(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    const ImageAoS& input = bench::InputImage(size);
+    Image<Rgbe, TopDown> src(input.Width(), input.Height());
+    tbb::parallel_for(tbb::blocked_range<int>(0, src.Height()),
+        ToRgbeFunctor(src, input));
+    ImageAoS dest(src.Width(), src.Height());
+
+    while (state.KeepRunning()) {
+        tbb::parallel_for(tbb::blocked_range<int>(0, src.Height()),
+            ToFloatFunctor(dest, src));
+    }
+    state.SetPixelsProcessed(src.Size());
+    state.SetBytesProcessed(src.Size() * sizeof(Rgbe));
+}
+
+
+
+// Tone mapping to 8-bit BGRA with each operator and display curve. The AoS
+// version uses its lookup table for the display curve.
+
+template <TmoTechnique TMO, bool SRGB>
+void BM_ToneMapper(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    const ImageAoS& src = bench::InputImage(size);
+    Image<Bgra8, TopDown> dest(src.Width(), src.Height());
+
+    ToneMapper toneMapper(-2.0f, 4096);
+    if (!SRGB) {
+        toneMapper.SetGamma(2.2f);
+    }
+    if (TMO == REINHARD02) {
+        toneMapper.SetParams(Reinhard02::EstimateParams(src));
+    }
+
+    while (state.KeepRunning()) {
+        toneMapper.ToneMap(dest, src, true, TMO);
+    }
+    state.SetPixelsProcessed(src.Size());
+    state.SetBytesProcessed(src.Size() * sizeof(Rgba32F));
+}
+
+template <TmoTechnique TMO, bool SRGB>
+void BM_ToneMapperSoA(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    const RGBAImageSoA& src = bench::InputImageSoA(size);
+    Image<Bgra8, TopDown> dest(src.Width(), src.Height());
+
+    ToneMapperSoA toneMapper(SRGB, 2.2f);
+    toneMapper.SetExposure(-2.0f);
+    if (TMO == REINHARD02) {
+        toneMapper.SetParams(Reinhard02::EstimateParams(src));
+    }
+
+    while (state.KeepRunning()) {
+        toneMapper.ToneMap(dest, src, TMO);
+    }
+    state.SetPixelsProcessed(src.Size());
+    state.SetBytesProcessed(src.Size() * 4 * sizeof(float));
+}
+
+
+
+void BM_Reinhard02AoS(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    const ImageAoS& src = bench::InputImage(size);
+
+    while (state.KeepRunning()) {
+        Reinhard02::EstimateParams(src);
+    }
+    state.SetPixelsProcessed(src.Size());
+    state.SetBytesProcessed(src.Size() * sizeof(Rgba32F));
+}
+
+void BM_Reinhard02SoA(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    const RGBAImageSoA& src = bench::InputImageSoA(size);
+
+    while (state.KeepRunning()) {
+        Reinhard02::EstimateParams(src);
+    }
+    state.SetPixelsProcessed(src.Size());
+    state.SetBytesProcessed(src.Size() * 4 * sizeof(float));
+}
+
+
+
+template <ImageComparator::Type TYPE>
+void BM_CompareAoS(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    const ImageAoS& src1 = bench::InputImage(size);
+    const ImageAoS& src2 = bench::OtherImage(size);
+    ImageAoS dest(src1.Width(), src1.Height());
+
+    while (state.KeepRunning()) {
+        ImageComparator::Compare(TYPE, dest, src1, src2);
+    }
+    state.SetPixelsProcessed(src1.Size());
+    state.SetBytesProcessed(2 * src1.Size() * sizeof(Rgba32F));
+}
+
+template <ImageComparator::Type TYPE>
+void BM_CompareSoA(bench::State& state)
+{
+    const bench::SizeClass size = static_cast<bench::SizeClass>(state.arg());
+    const RGBAImageSoA& src1 = bench::InputImageSoA(size);
+    const RGBAImageSoA& src2 = bench::OtherImageSoA(size);
+    RGBAImageSoA dest(src1.Width(), src1.Height());
+
+    while (state.KeepRunning()) {
+        ImageComparator::Compare(TYPE, dest, src1, src2);
+    }
+    state.SetPixelsProcessed(src1.Size());
+    state.SetBytesProcessed(2 * src1.Size() * 4 * sizeof(float));
+}
+
+template <ImageComparator::Type TYPE>
+void registerCompare(const std::string& name)
+{
+    bench::RegisterSizes("ImageComparator/" + name + "/AoS",
+        &BM_CompareAoS<TYPE>);
+    bench::RegisterSizes("ImageComparator/" + name + "/SoA",
+        &BM_CompareSoA<TYPE>);
+}
+
+
+
+bool registerBenchmarks()
+{
+    using bench::RegisterSizes;
+
+    RegisterSizes("Rgbe/FromFloat", &BM_RgbeFromFloat);
+    RegisterSizes("Rgbe/ToFloat", &BM_RgbeToFloat);
+
+    RegisterSizes("ToneMapper/Exposure/sRGB",
+        &BM_ToneMapper<EXPOSURE, true>);
+    RegisterSizes("ToneMapper/Exposure/Gamma",
+        &BM_ToneMapper<EXPOSURE, false>);
+    RegisterSizes("ToneMapper/Reinhard02/sRGB",
+        &BM_ToneMapper<REINHARD02, true>);
+    RegisterSizes("ToneMapper/Reinhard02/Gamma",
+        &BM_ToneMapper<REINHARD02, false>);
+    RegisterSizes("ToneMapperSoA/Exposure/sRGB",
+        &BM_ToneMapperSoA<EXPOSURE, true>);
+    RegisterSizes("ToneMapperSoA/Exposure/Gamma",
+        &BM_ToneMapperSoA<EXPOSURE, false>);
+    RegisterSizes("ToneMapperSoA/Reinhard02/sRGB",
+        &BM_ToneMapperSoA<REINHARD02, true>);
+    RegisterSizes("ToneMapperSoA/Reinhard02/Gamma",
+        &BM_ToneMapperSoA<REINHARD02, false>);
+
+    RegisterSizes("Reinhard02/EstimateParams/AoS", &BM_Reinhard02AoS);
+    RegisterSizes("Reinhard02/EstimateParams/SoA", &BM_Reinhard02SoA);
+
+    registerCompare<ImageComparator::AbsoluteDifference>("AbsoluteDifference");
+    registerCompare<ImageComparator::Addition>("Addition");
+    registerCompare<ImageComparator::Division>("Division");
+    registerCompare<ImageComparator::RelativeError>("RelativeError");
+    registerCompare<ImageComparator::PositiveNegative>("PositiveNegative");
+    registerCompare<ImageComparator::PositiveNegativeRelativeError>(
+        "PositiveNegativeRelativeError");
+    return true;
+}
+
+const bool registered = registerBenchmarks();
+
+} // namespace
@@ -0,0 +1,152 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Performance suite for the ImageIO kernels and codecs
+
+#include "Benchmark.h"
+
+#include <CpuFeatures.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+
+namespace
+{
+
+void usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+        "Options:\n"
+        "  --filter=<text>        Run only the benchmarks whose name contains "
+        "the text\n"
+        "  --list                 List the benchmarks and exit\n"
+        "  --threads=<n>[,<n>..]  Thread counts to run each benchmark with "
+        "(default: 1\n"
+        "                         and the number of CPUs)\n"
+        "  --min_time=<seconds>   Minimum timed seconds per benchmark "
+        "(default: 0.5)\n"
+        "  --isa=<name>           Instruction set of the SIMD kernels: SSE2, "
+        "AVX or AVX2\n"
+        "  --format=<fmt>         Output format: console, json or csv\n"
+        "  --out=<file>           Also write the results to the file\n"
+        "  --out_format=<fmt>     Format of the file: json (default) or csv\n";
+}
+
+// Returns the value of an option of the form --name=value, or NULL
+const char* optionValue(const char* arg, const char* name)
+{
+    const size_t len = strlen(name);
+    if (strncmp(arg, name, len) == 0 && arg[len] == '=') {
+        return arg + len + 1;
+    }
+    return NULL;
+}
+
+bool parseFormat(const char* value, bench::Format& format)
+{
+    if (strcmp(value, "console") == 0) {
+        format = bench::FORMAT_CONSOLE;
+    } else if (strcmp(value, "json") == 0) {
+        format = bench::FORMAT_JSON;
+    } else if (strcmp(value, "csv") == 0) {
+        format = bench::FORMAT_CSV;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parseThreads(const char* value, std::vector<int>& threads)
+{
+    std::istringstream is(value);
+    std::string token;
+    while (std::getline(is, token, ',')) {
+        const int n = atoi(token.c_str());
+        if (n < 1) {
+            return false;
+        }
+        threads.push_back(n);
+    }
+    return !threads.empty();
+}
+
+bool parseISA(const char* value, pcg::CpuFeatures::InstructionSet& isa)
+{
+    for (int i = pcg::CpuFeatures::SSE2; i <= pcg::CpuFeatures::AVX2; ++i) {
+        isa = static_cast<pcg::CpuFeatures::InstructionSet>(i);
+        if (strcmp(value, pcg::CpuFeatures::Name(isa)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+    bench::Options options;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value;
+        bool ok = true;
+
+        if (strcmp(arg, "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else if ((value = optionValue(arg, "--filter")) != NULL) {
+            options.filter = value;
+        } else if (strcmp(arg, "--list") == 0) {
+            options.list = true;
+        } else if ((value = optionValue(arg, "--threads")) != NULL) {
+            ok = parseThreads(value, options.threads);
+        } else if ((value = optionValue(arg, "--min_time")) != NULL) {
+            options.minTime = atof(value);
+            ok = options.minTime >= 0.0;
+        } else if ((value = optionValue(arg, "--isa")) != NULL) {
+            pcg::CpuFeatures::InstructionSet isa;
+            ok = parseISA(value, isa) && pcg::CpuFeatures::IsAvailable(isa);
+            if (ok) {
+                pcg::CpuFeatures::SetActive(isa);
+            } else {
+                std::cerr << "Instruction set not available: " << value
+                          << std::endl;
+                return 1;
+            }
+        } else if ((value = optionValue(arg, "--format")) != NULL) {
+            ok = parseFormat(value, options.format);
+        } else if ((value = optionValue(arg, "--out")) != NULL) {
+            options.outFile = value;
+        } else if ((value = optionValue(arg, "--out_format")) != NULL) {
+            ok = parseFormat(value, options.fileFormat);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cerr << "Invalid option: " << arg << std::endl;
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    const int failures = bench::RunBenchmarks(options);
+    return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,414 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <Concurrency.h>
+#include <OpenEXRIO.h>
+#include <ImageSoA.h>
+#include <ImageComparator.h>
+#include <Exception.h>
+
+#include "dSFMT/RandomMT.h"
+#include "TestUtil.h"
+
+#include <gtest/gtest.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/spin_mutex.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#include <tbb/tick_count.h>
+
+#include <IlmBaseConfig.h>
+#include <IlmThreadPool.h>
+
+#include <algorithm>
+#include <cstdio>
+
+
+namespace
+{
+
+typedef pcg::RGBAImageSoA ImageSoA;
+
+const char *FILENAME = "test-concurrency.exr";
+
+// Loads the file into each image from the TBB worker threads
+class LoadFunctor
+{
+public:
+    LoadFunctor(ImageSoA *images) : m_images(images) {}
+
+    void operator()(const tbb::blocked_range<size_t> &range) const {
+        for (size_t i = range.begin(); i != range.end(); ++i) {
+            pcg::OpenEXRIO::Load(m_images[i], FILENAME);
+        }
+    }
+
+    // Loads only the first image
+    void operator()() const {
+        pcg::OpenEXRIO::Load(m_images[0], FILENAME);
+    }
+
+private:
+    ImageSoA *m_images;
+};
+
+bool equalPixels(const ImageSoA &a, const ImageSoA &b)
+{
+    if (a.Width() != b.Width() || a.Height() != b.Height()) {
+        return false;
+    }
+    for (int i = 0; i < a.Size(); ++i) {
+        if (a.ElementAt<ImageSoA::R>(i) != b.ElementAt<ImageSoA::R>(i) ||
+            a.ElementAt<ImageSoA::G>(i) != b.ElementAt<ImageSoA::G>(i) ||
+            a.ElementAt<ImageSoA::B>(i) != b.ElementAt<ImageSoA::B>(i) ||
+            a.ElementAt<ImageSoA::A>(i) != b.ElementAt<ImageSoA::A>(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Cancels its own task group, then compares the images
+class CancelledCompare
+{
+public:
+    CancelledCompare(tbb::task_group &group, ImageSoA &dest,
+        const ImageSoA &src1, const ImageSoA &src2) :
+    m_group(group), m_dest(dest), m_src1(src1), m_src2(src2) {}
+
+    void operator()() const {
+        m_group.cancel();
+        pcg::ImageComparator::Compare(pcg::ImageComparator::Division,
+            m_dest, m_src1, m_src2);
+    }
+
+private:
+    tbb::task_group &m_group;
+    ImageSoA &m_dest;
+    const ImageSoA &m_src1;
+    const ImageSoA &m_src2;
+};
+
+
+
+#if defined(ILMBASE_HAS_THREAD_POOL_PROVIDER)
+
+// What the IlmThread tasks observe while they run
+struct TaskStats
+{
+    TaskStats() : active(0), peak(0), count(0), threads(0) {}
+
+    tbb::spin_mutex mutex;
+    int active;
+    int peak;
+    int count;
+
+    // Number of tasks run by each thread
+    tbb::enumerable_thread_specific<int> threads;
+};
+
+// IlmThread task which keeps its thread busy for a while, so that other
+// threads, if any, pick up the other tasks meanwhile
+class CountingTask : public IlmThread::Task
+{
+public:
+    CountingTask(IlmThread::TaskGroup *group, TaskStats &stats) :
+    IlmThread::Task(group), m_stats(stats) {}
+
+    virtual void execute() {
+        {
+            tbb::spin_mutex::scoped_lock lock(m_stats.mutex);
+            ++m_stats.active;
+            m_stats.peak = std::max(m_stats.peak, m_stats.active);
+            ++m_stats.count;
+        }
+        ++m_stats.threads.local();
+        const tbb::tick_count start = tbb::tick_count::now();
+        while ((tbb::tick_count::now() - start).seconds() < 0.002) {
+        }
+        tbb::spin_mutex::scoped_lock lock(m_stats.mutex);
+        --m_stats.active;
+    }
+
+private:
+    TaskStats &m_stats;
+};
+
+// Runs the tasks through the global IlmThread pool, as IlmImf does, and
+// waits for them
+class RunTasks
+{
+public:
+    RunTasks(TaskStats &stats, int count) : m_stats(stats), m_count(count) {}
+
+    void operator()() const {
+        IlmThread::TaskGroup group;
+        for (int i = 0; i < m_count; ++i) {
+            IlmThread::ThreadPool::addGlobalTask(
+                new CountingTask(&group, m_stats));
+        }
+    }
+
+private:
+    TaskStats &m_stats;
+    const int m_count;
+};
+
+#endif // ILMBASE_HAS_THREAD_POOL_PROVIDER
+
+} // namespace
+
+
+
+TEST(Concurrency, MaxThreads)
+{
+    const int maxThreads = pcg::Concurrency::MaxThreads();
+    EXPECT_GE(maxThreads, 1);
+
+    EXPECT_THROW(pcg::Concurrency::SetMaxThreads(0),
+        pcg::IllegalArgumentException);
+    pcg::Concurrency::SetMaxThreads(3);
+    EXPECT_EQ(3, pcg::Concurrency::MaxThreads());
+
+    // The OpenEXR setting is the same one
+    pcg::OpenEXRIO::setNumThreads(0);
+    EXPECT_EQ(1, pcg::Concurrency::MaxThreads());
+    EXPECT_THROW(pcg::OpenEXRIO::setNumThreads(-1),
+        pcg::IllegalArgumentException);
+
+    pcg::Concurrency::SetMaxThreads(maxThreads);
+}
+
+
+
+// Files decoded at the same time from the TBB worker threads, whose IlmThread
+// tasks run in those very threads
+TEST(Concurrency, OpenEXR)
+{
+    RandomMT rnd;
+    ImageSoA src(301, 517);
+    fillRandom(src, rnd, true);
+    pcg::OpenEXRIO::Save(src, FILENAME, pcg::OpenEXRIO::WRITE_RGBA,
+        pcg::OpenEXRIO::PIZ);
+
+    const int maxThreads = pcg::Concurrency::MaxThreads();
+    ImageSoA reference;
+    pcg::OpenEXRIO::Load(reference, FILENAME);
+    ASSERT_EQ(src.Width(),  reference.Width());
+    ASSERT_EQ(src.Height(), reference.Height());
+
+    const int threads[] = {maxThreads, 1, 4};
+    for (size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); ++k) {
+        pcg::Concurrency::SetMaxThreads(threads[k]);
+        ImageSoA img;
+        pcg::OpenEXRIO::Load(img, FILENAME);
+        EXPECT_TRUE(equalPixels(reference, img));
+
+        const size_t count = 16;
+        ImageSoA images[count];
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, count, 1),
+            LoadFunctor(images));
+        for (size_t i = 0; i < count; ++i) {
+            EXPECT_TRUE(equalPixels(reference, images[i]));
+        }
+    }
+
+    pcg::Concurrency::SetMaxThreads(maxThreads);
+    remove(FILENAME);
+}
+
+
+
+TEST(Concurrency, Scope)
+{
+    EXPECT_TRUE(pcg::Concurrency::CurrentScope() == NULL);
+    EXPECT_THROW(pcg::Concurrency::Scope(0), pcg::IllegalArgumentException);
+    EXPECT_THROW(pcg::Concurrency::Scope(2, -1),
+        pcg::IllegalArgumentException);
+    EXPECT_TRUE(pcg::Concurrency::CurrentScope() == NULL);
+
+    tbb::task_arena arena(2);
+    {
+        pcg::Concurrency::Scope outer(arena, 1000);
+        EXPECT_EQ(&outer, pcg::Concurrency::CurrentScope());
+        EXPECT_EQ(&arena, &outer.Arena());
+        EXPECT_EQ(1000, outer.GrainSize());
+        {
+            pcg::Concurrency::Scope inner(1);
+            EXPECT_EQ(&inner, pcg::Concurrency::CurrentScope());
+            EXPECT_EQ(0, inner.GrainSize());
+        }
+        EXPECT_EQ(&outer, pcg::Concurrency::CurrentScope());
+    }
+    EXPECT_TRUE(pcg::Concurrency::CurrentScope() == NULL);
+}
+
+
+
+// The kernels and the codecs give the same results whatever the scope
+TEST(Concurrency, ScopeResults)
+{
+    RandomMT rnd;
+    ImageSoA src1(301, 517);
+    fillRandom(src1, rnd, true);
+    ImageSoA src2(301, 517);
+    fillRandom(src2, rnd, true);
+    pcg::OpenEXRIO::Save(src1, FILENAME, pcg::OpenEXRIO::WRITE_RGBA,
+        pcg::OpenEXRIO::ZIP);
+
+    ImageSoA reference(301, 517);
+    pcg::ImageComparator::Compare(pcg::ImageComparator::Division,
+        reference, src1, src2);
+    ImageSoA loaded;
+    pcg::OpenEXRIO::Load(loaded, FILENAME);
+
+    tbb::task_arena arena(4);
+    const int grainSizes[] = {0, 1, 4096, 1 << 20};
+    for (size_t k = 0; k < sizeof(grainSizes) / sizeof(grainSizes[0]); ++k) {
+        {
+            pcg::Concurrency::Scope scope(1, grainSizes[k]);
+            ImageSoA img(301, 517);
+            pcg::ImageComparator::Compare(pcg::ImageComparator::Division,
+                img, src1, src2);
+            EXPECT_TRUE(equalPixels(reference, img));
+            pcg::OpenEXRIO::Load(img, FILENAME);
+            EXPECT_TRUE(equalPixels(loaded, img));
+        }
+        {
+            pcg::Concurrency::Scope scope(arena, grainSizes[k]);
+            ImageSoA img(301, 517);
+            pcg::ImageComparator::Compare(pcg::ImageComparator::Division,
+                img, src1, src2);
+            EXPECT_TRUE(equalPixels(reference, img));
+            pcg::OpenEXRIO::Load(img, FILENAME);
+            EXPECT_TRUE(equalPixels(loaded, img));
+        }
+    }
+    remove(FILENAME);
+}
+
+
+
+// Only oneTBB tells the library the context of the calling task
+#if TBB_INTERFACE_VERSION >= 12000
+
+// Cancelling the task group of the caller also cancels the loops which the
+// library runs within the arena of the scope
+TEST(Concurrency, ScopeCancellation)
+{
+    RandomMT rnd;
+    ImageSoA src1(301, 517);
+    fillRandom(src1, rnd, true);
+    ImageSoA src2(301, 517);
+    fillRandom(src2, rnd, true);
+    ImageSoA img(301, 517);
+    for (int i = 0; i < img.Size(); ++i) {
+        img.ElementAt<ImageSoA::R>(i) = -1.0f;
+    }
+
+    tbb::task_arena arena(2);
+    pcg::Concurrency::Scope scope(arena);
+    tbb::task_group group;
+    EXPECT_EQ(tbb::canceled,
+        group.run_and_wait(CancelledCompare(group, img, src1, src2)));
+    for (int i = 0; i < img.Size(); ++i) {
+        ASSERT_EQ(-1.0f, img.ElementAt<ImageSoA::R>(i)) << "Pixel " << i;
+    }
+}
+
+#endif // TBB_INTERFACE_VERSION >= 12000
+
+
+
+#if defined(ILMBASE_HAS_THREAD_POOL_PROVIDER)
+
+// The tasks of the IlmThread pool run with the concurrency of the scope
+TEST(Concurrency, ThreadPoolScope)
+{
+    // Any OpenEXR operation installs the provider of the pool
+    RandomMT rnd;
+    ImageSoA src(64, 64);
+    fillRandom(src, rnd, true);
+    pcg::OpenEXRIO::Save(src, FILENAME);
+    ImageSoA reference;
+    pcg::OpenEXRIO::Load(reference, FILENAME);
+
+    const int numTasks = 64;
+    const int maxThreads = pcg::Concurrency::MaxThreads();
+    IlmThread::ThreadPool &pool = IlmThread::ThreadPool::globalThreadPool();
+
+    // A single thread runs the tasks right away in the calling thread
+    {
+        pcg::Concurrency::Scope scope(1);
+        EXPECT_EQ(1, pool.numThreads());
+        TaskStats stats;
+        RunTasks(stats, numTasks)();
+        EXPECT_EQ(numTasks, stats.count);
+        EXPECT_EQ(1, stats.peak);
+        EXPECT_EQ(numTasks, stats.threads.local());
+    }
+
+    // Otherwise the calling thread only waits for the TBB workers
+    {
+        pcg::Concurrency::Scope scope(2);
+        EXPECT_EQ(2, pool.numThreads());
+        TaskStats stats;
+        RunTasks(stats, numTasks)();
+        EXPECT_EQ(numTasks, stats.count);
+        EXPECT_LE(stats.peak, 2);
+        EXPECT_EQ(0, stats.threads.local());
+        if (tbb::this_task_arena::max_concurrency() >= 2) {
+            EXPECT_EQ(2, stats.peak);
+        }
+    }
+
+    // The innermost scope applies, then the process-wide setting
+    pcg::Concurrency::SetMaxThreads(3);
+    {
+        pcg::Concurrency::Scope outer(4);
+        pcg::Concurrency::Scope inner(1);
+        EXPECT_EQ(1, pool.numThreads());
+    }
+    {
+        EXPECT_EQ(3, pool.numThreads());
+        TaskStats stats;
+        RunTasks(stats, numTasks)();
+        EXPECT_EQ(numTasks, stats.count);
+        EXPECT_LE(stats.peak, 3);
+    }
+    pcg::Concurrency::SetMaxThreads(maxThreads);
+
+    // A thread within a single-slot arena cannot wait for another thread to
+    // run the tasks there, nor does it have to
+    {
+        tbb::task_arena arena(1);
+        pcg::Concurrency::Scope scope(arena);
+        TaskStats stats;
+        arena.execute(RunTasks(stats, numTasks));
+        EXPECT_EQ(numTasks, stats.count);
+        EXPECT_EQ(1, stats.peak);
+
+        ImageSoA img;
+        arena.execute(LoadFunctor(&img));
+        EXPECT_TRUE(equalPixels(reference, img));
+    }
+
+    remove(FILENAME);
+}
+
+#endif // ILMBASE_HAS_THREAD_POOL_PROVIDER
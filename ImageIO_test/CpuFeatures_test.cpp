@@ -0,0 +1,192 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <CpuFeatures.h>
+#include <Exception.h>
+#include <ImageComparator.h>
+#include <ImageSoA.h>
+#include <Reinhard02.h>
+#include <RgbeIO.h>
+#include <ToneMapperSoA.h>
+
+#include "dSFMT/RandomMT.h"
+#include "TestUtil.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+
+namespace
+{
+
+typedef pcg::CpuFeatures CpuFeatures;
+typedef pcg::RGBAImageSoA ImageSoA;
+
+// Restores the instruction set which was active on construction
+class ActiveGuard
+{
+public:
+    ActiveGuard() : m_isa(CpuFeatures::Active()) {}
+    ~ActiveGuard() {
+        CpuFeatures::SetActive(m_isa);
+    }
+private:
+    const CpuFeatures::InstructionSet m_isa;
+};
+
+// Results of the dispatched kernels for one instruction set
+struct KernelResults
+{
+    pcg::Reinhard02::Params params;
+    std::vector<pcg::Bgra8> toneMapped;
+    std::vector<pcg::Rgba16> toneMapped16;
+    std::vector<float> relativeError;
+    std::string rgbe;
+    std::vector<float> decoded;
+};
+
+void runKernels(const ImageSoA &img, const ImageSoA &other, KernelResults &res)
+{
+    res.params = pcg::Reinhard02::EstimateParams(img);
+
+    pcg::Image<pcg::Bgra8, pcg::TopDown> ldr(img.Width(), img.Height());
+    pcg::ToneMapperSoA tm;
+    tm.SetParams(res.params);
+    tm.ToneMap(ldr, img, pcg::REINHARD02);
+    res.toneMapped.assign(ldr.GetDataPointer(),
+        ldr.GetDataPointer() + ldr.Size());
+    pcg::Image<pcg::Rgba16, pcg::BottomUp> ldr16(img.Width(), img.Height());
+    tm.ToneMap(ldr16, img, pcg::REINHARD02);
+    res.toneMapped16.assign(ldr16.GetDataPointer(),
+        ldr16.GetDataPointer() + ldr16.Size());
+
+    ImageSoA cmp(img.Width(), img.Height());
+    pcg::ImageComparator::Compare(pcg::ImageComparator::RelativeError,
+        cmp, img, other);
+    res.relativeError.assign(cmp.GetDataPointer<ImageSoA::A>(),
+        cmp.GetDataPointer<ImageSoA::A>() + cmp.Size());
+
+    std::stringstream file;
+    pcg::RgbeIO::Save(img, file);
+    res.rgbe = file.str();
+    ImageSoA decoded;
+    pcg::RgbeIO::Load(decoded, file);
+    res.decoded.assign(decoded.GetDataPointer<ImageSoA::R>(),
+        decoded.GetDataPointer<ImageSoA::R>() + decoded.Size());
+}
+
+} // namespace
+
+
+
+TEST(CpuFeatures, Query)
+{
+    const CpuFeatures::InstructionSet best = CpuFeatures::Best();
+    EXPECT_TRUE(CpuFeatures::IsAvailable(best));
+    EXPECT_TRUE(CpuFeatures::IsAvailable(CpuFeatures::Active()));
+    EXPECT_LE(CpuFeatures::Active(), best);
+    for (int isa = best + 1; isa <= CpuFeatures::AVX2; ++isa) {
+        EXPECT_FALSE(CpuFeatures::IsAvailable(
+            static_cast<CpuFeatures::InstructionSet>(isa)));
+    }
+    EXPECT_STREQ("SSE2", CpuFeatures::Name(CpuFeatures::SSE2));
+    EXPECT_STREQ("AVX2", CpuFeatures::Name(CpuFeatures::AVX2));
+}
+
+
+
+TEST(CpuFeatures, SetActive)
+{
+    ActiveGuard guard;
+    for (int i = CpuFeatures::SSE2; i <= CpuFeatures::AVX2; ++i) {
+        const CpuFeatures::InstructionSet isa =
+            static_cast<CpuFeatures::InstructionSet>(i);
+        if (CpuFeatures::IsAvailable(isa)) {
+            CpuFeatures::SetActive(isa);
+            EXPECT_EQ(isa, CpuFeatures::Active());
+        } else {
+            EXPECT_THROW(CpuFeatures::SetActive(isa),
+                pcg::IllegalArgumentException);
+        }
+    }
+}
+
+
+
+// Every code path must produce the same results, up to the rounding
+// differences of the approximations and of fused multiply-add instructions
+TEST(CpuFeatures, Kernels)
+{
+    ActiveGuard guard;
+    RandomMT rnd;
+    ImageSoA img(203, 61), other(203, 61);
+    fillRandom(img, rnd, true);
+    fillRandom(other, rnd, true);
+
+    bool hasReference = false;
+    KernelResults ref;
+    for (int i = CpuFeatures::SSE2; i <= CpuFeatures::AVX2; ++i) {
+        const CpuFeatures::InstructionSet isa =
+            static_cast<CpuFeatures::InstructionSet>(i);
+        if (!CpuFeatures::IsAvailable(isa)) {
+            continue;
+        }
+        CpuFeatures::SetActive(isa);
+        if (!hasReference) {
+            runKernels(img, other, ref);
+            hasReference = true;
+            continue;
+        }
+
+        SCOPED_TRACE(CpuFeatures::Name(isa));
+        KernelResults res;
+        runKernels(img, other, res);
+
+        EXPECT_NEAR(ref.params.key, res.params.key, 1e-5f * ref.params.key);
+        EXPECT_NEAR(ref.params.l_white, res.params.l_white,
+            1e-5f * ref.params.l_white);
+        EXPECT_NEAR(ref.params.l_w, res.params.l_w, 1e-5f * ref.params.l_w);
+        EXPECT_NEAR(ref.params.l_min, res.params.l_min,
+            1e-6f * ref.params.l_min);
+        EXPECT_NEAR(ref.params.l_max, res.params.l_max,
+            1e-6f * ref.params.l_max);
+
+        ASSERT_EQ(ref.toneMapped.size(), res.toneMapped.size());
+        for (size_t k = 0; k < ref.toneMapped.size(); ++k) {
+            ASSERT_LE(abs(ref.toneMapped[k].r - res.toneMapped[k].r), 1);
+            ASSERT_LE(abs(ref.toneMapped[k].g - res.toneMapped[k].g), 1);
+            ASSERT_LE(abs(ref.toneMapped[k].b - res.toneMapped[k].b), 1);
+        }
+        ASSERT_EQ(ref.toneMapped16.size(), res.toneMapped16.size());
+        for (size_t k = 0; k < ref.toneMapped16.size(); ++k) {
+            ASSERT_LE(abs(ref.toneMapped16[k].r - res.toneMapped16[k].r), 2);
+            ASSERT_LE(abs(ref.toneMapped16[k].g - res.toneMapped16[k].g), 2);
+            ASSERT_LE(abs(ref.toneMapped16[k].b - res.toneMapped16[k].b), 2);
+        }
+
+        ASSERT_EQ(ref.relativeError.size(), res.relativeError.size());
+        for (size_t k = 0; k < ref.relativeError.size(); ++k) {
+            ASSERT_NEAR(ref.relativeError[k], res.relativeError[k],
+                1e-4f * ref.relativeError[k]);
+        }
+
+        // The RGBE conversions are exact
+        EXPECT_TRUE(ref.rgbe == res.rgbe);
+        EXPECT_TRUE(ref.decoded == res.decoded);
+    }
+}
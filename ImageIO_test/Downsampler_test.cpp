@@ -0,0 +1,118 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <Downsampler.h>
+#include <ImageSoA.h>
+#include <Exception.h>
+
+#include "dSFMT/RandomMT.h"
+#include "TestUtil.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+
+namespace
+{
+
+typedef pcg::RGBAImageSoA ImageSoA;
+
+} // namespace
+
+
+
+// Both filters must preserve a constant image, whatever the reduction
+TEST(Downsampler, Constant)
+{
+    const int sizes[][4] = {
+        {64, 32, 32, 16}, {101, 57, 50, 28}, {37, 5, 3, 1}, {9, 80, 9, 13}
+    };
+    const pcg::Downsampler::Filter filters[] = {
+        pcg::Downsampler::BOX, pcg::Downsampler::LANCZOS3
+    };
+
+    for (size_t f = 0; f < 2; ++f) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+            ImageSoA src(sizes[s][0], sizes[s][1]);
+            for (int i = 0; i < src.Size(); ++i) {
+                src.ElementAt<ImageSoA::R>(i) = 0.5f;
+                src.ElementAt<ImageSoA::G>(i) = 2.0f;
+                src.ElementAt<ImageSoA::B>(i) = 8.0f;
+                src.ElementAt<ImageSoA::A>(i) = 1.0f;
+            }
+            ImageSoA dest(sizes[s][2], sizes[s][3]);
+            pcg::Downsampler::Downsample(src, dest, filters[f]);
+            for (int i = 0; i < dest.Size(); ++i) {
+                ASSERT_NEAR(0.5f, dest.ElementAt<ImageSoA::R>(i), 1e-5f);
+                ASSERT_NEAR(2.0f, dest.ElementAt<ImageSoA::G>(i), 1e-5f);
+                ASSERT_NEAR(8.0f, dest.ElementAt<ImageSoA::B>(i), 1e-4f);
+                ASSERT_NEAR(1.0f, dest.ElementAt<ImageSoA::A>(i), 1e-5f);
+            }
+        }
+    }
+}
+
+
+
+// The box filter is the area average of the covered pixels
+TEST(Downsampler, Box)
+{
+    RandomMT rnd;
+    const int sizes[][4] = {
+        {130, 66, 65, 33}, {99, 61, 33, 61}, {8, 75, 8, 25}, {7, 7, 2, 3}
+    };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        ImageSoA src(sizes[s][0], sizes[s][1]);
+        fillRandom(src, rnd);
+        ImageSoA dest(sizes[s][2], sizes[s][3]);
+        pcg::Downsampler::Downsample(src, dest, pcg::Downsampler::BOX);
+
+        const double sx = static_cast<double>(src.Width())  / dest.Width();
+        const double sy = static_cast<double>(src.Height()) / dest.Height();
+        for (int j = 0; j < dest.Height(); ++j) {
+            for (int i = 0; i < dest.Width(); ++i) {
+                // Area weighted reference
+                double sum = 0.0;
+                for (int y = 0; y < src.Height(); ++y) {
+                    const double wy = std::min(y + 1.0, (j + 1) * sy) -
+                        std::max(1.0 * y, j * sy);
+                    if (wy <= 0.0) continue;
+                    for (int x = 0; x < src.Width(); ++x) {
+                        const double wx = std::min(x + 1.0, (i + 1) * sx) -
+                            std::max(1.0 * x, i * sx);
+                        if (wx <= 0.0) continue;
+                        sum += wx * wy * src.ElementAt<ImageSoA::R>(x, y);
+                    }
+                }
+                const double expected = sum / (sx * sy);
+                ASSERT_NEAR(expected, dest.ElementAt<ImageSoA::R>(i, j),
+                    1e-4 * expected);
+            }
+        }
+    }
+}
+
+
+
+TEST(Downsampler, Arguments)
+{
+    ImageSoA src(16, 16), larger(17, 8), empty;
+    EXPECT_THROW(pcg::Downsampler::Downsample(src, larger),
+        pcg::IllegalArgumentException);
+    EXPECT_THROW(pcg::Downsampler::Downsample(src, empty),
+        pcg::IllegalArgumentException);
+}
@@ -0,0 +1,120 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <HalfConversion.h>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+
+namespace
+{
+
+// Reference decoding of a half from its bit pattern
+float halfBitsToFloat(unsigned short h)
+{
+    const int exponent = (h >> 10) & 0x1f;
+    const int mantissa = h & 0x3ff;
+    const float sign = (h & 0x8000) != 0 ? -1.0f : 1.0f;
+    if (exponent == 0) {
+        return sign * static_cast<float>(ldexp(mantissa, -24));
+    } else if (exponent == 31) {
+        return mantissa == 0 ? sign * std::numeric_limits<float>::infinity() :
+            std::numeric_limits<float>::quiet_NaN();
+    } else {
+        return sign * static_cast<float>(ldexp(mantissa + 1024, exponent-25));
+    }
+}
+
+inline bool isNaNBits(unsigned short h) {
+    return (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0;
+}
+
+} // namespace
+
+
+
+// Every half must convert to the exact float and back to the same bits
+TEST(HalfConversion, AllHalves)
+{
+    // Use an odd count to exercise the vector and the scalar code paths
+    const size_t count = 0x10000 + 3;
+    std::vector<unsigned short> halves(count);
+    for (size_t i = 0; i < count; ++i) {
+        halves[i] = static_cast<unsigned short>(i);
+    }
+
+    std::vector<float> floats(count);
+    pcg::convertHalfToFloat(&floats[0], &halves[0], count);
+    for (size_t i = 0; i < count; ++i) {
+        const float expected = halfBitsToFloat(halves[i]);
+        if (isNaNBits(halves[i])) {
+            ASSERT_NE(floats[i], floats[i]) << "half 0x" << std::hex << i;
+        } else {
+            ASSERT_EQ(expected, floats[i]) << "half 0x" << std::hex << i;
+        }
+    }
+
+    std::vector<unsigned short> result(count);
+    pcg::convertFloatToHalf(&result[0], &floats[0], count);
+    for (size_t i = 0; i < count; ++i) {
+        if (isNaNBits(halves[i])) {
+            ASSERT_TRUE(isNaNBits(result[i])) << "half 0x" << std::hex << i;
+        } else {
+            ASSERT_EQ(halves[i], result[i]) << "half 0x" << std::hex << i;
+        }
+    }
+}
+
+
+
+// Floats between two halves round to the nearest one, ties to even
+TEST(HalfConversion, Rounding)
+{
+    const float values[] = {
+        1.0f + 1.0f/2048.0f,        // Tie, rounds down to the even 1.0
+        1.0f + 3.0f/2048.0f,        // Tie, rounds up to the even 1+2/1024
+        1.0f + 1.1f/2048.0f,        // Above the tie
+        65504.0f,                   // Largest half
+        65519.0f,                   // Still rounds to the largest half
+        65520.0f,                   // Overflows to infinity
+        -1e10f,                     // Overflows to negative infinity
+        std::numeric_limits<float>::infinity(),
+        5.9604644775390625e-8f,     // Smallest denormal
+        2.98023223876953125e-8f,    // Half of it, rounds to zero
+        4.5e-8f,                    // Rounds up to the smallest denormal
+        -0.0f,
+        6.097555160522461e-5f,      // Largest denormal
+        std::numeric_limits<float>::quiet_NaN()
+    };
+    const unsigned short expected[] = {
+        0x3c00, 0x3c02, 0x3c01, 0x7bff, 0x7bff, 0x7c00, 0xfc00, 0x7c00,
+        0x0001, 0x0000, 0x0001, 0x8000, 0x03ff, 0x7e00
+    };
+    const size_t count = sizeof(values) / sizeof(float);
+
+    std::vector<unsigned short> result(count);
+    pcg::convertFloatToHalf(&result[0], values, count);
+    for (size_t i = 0; i < count; ++i) {
+        if (isNaNBits(expected[i])) {
+            EXPECT_TRUE(isNaNBits(result[i])) << "value " << values[i];
+        } else {
+            EXPECT_EQ(expected[i], result[i]) << "value " << values[i];
+        }
+    }
+}
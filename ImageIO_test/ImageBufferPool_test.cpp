@@ -0,0 +1,166 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <ImageBufferPool.h>
+#include <Image.h>
+#include <ImageSoA.h>
+#include <LDRPixels.h>
+
+#include <gtest/gtest.h>
+
+#include <utility>
+
+
+namespace
+{
+
+// Enables the pool for the duration of a test, then frees its buffers
+class ImageBufferPoolTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp() {
+        m_previous = pcg::ImageBufferPool::MaxBuffers();
+        pcg::ImageBufferPool::SetMaxBuffers(4);
+    }
+
+    virtual void TearDown() {
+        pcg::ImageBufferPool::Purge();
+        pcg::ImageBufferPool::SetMaxBuffers(m_previous);
+    }
+
+private:
+    size_t m_previous;
+};
+
+} // namespace
+
+
+
+TEST_F(ImageBufferPoolTest, Reuse)
+{
+    void *ptr = pcg::ImageBufferPool::Acquire(1024, 64);
+    ASSERT_TRUE(ptr != NULL);
+    EXPECT_EQ(0, reinterpret_cast<intptr_t>(ptr) % 64);
+    pcg::ImageBufferPool::Release(ptr, 1024, 64);
+
+    // Only the same size and alignment get the cached buffer
+    void *other = pcg::ImageBufferPool::Acquire(2048, 64);
+    EXPECT_NE(ptr, other);
+    void *same = pcg::ImageBufferPool::Acquire(1024, 64);
+    EXPECT_EQ(ptr, same);
+    pcg::ImageBufferPool::Release(other, 2048, 64);
+    pcg::ImageBufferPool::Release(same, 1024, 64);
+    pcg::ImageBufferPool::Release(NULL, 1024, 64);
+
+    // Images of the same size get the buffer of the previous one
+    const pcg::Bgra8 *pixels;
+    {
+        pcg::Image<pcg::Bgra8> img(320, 240);
+        pixels = img.GetDataPointer();
+    }
+    {
+        pcg::Image<pcg::Bgra8> img(240, 320);
+        EXPECT_EQ(pixels, img.GetDataPointer());
+    }
+
+    const float *r;
+    {
+        pcg::RGBAImageSoA img(320, 240);
+        r = img.GetDataPointer<pcg::RGBAImageSoA::R>();
+    }
+    {
+        pcg::RGBAImageSoA img(320, 240);
+        EXPECT_EQ(r, img.GetDataPointer<pcg::RGBAImageSoA::R>());
+    }
+}
+
+
+
+TEST_F(ImageBufferPoolTest, Eviction)
+{
+    void *ptrs[6];
+    for (int i = 0; i < 6; ++i) {
+        ptrs[i] = pcg::ImageBufferPool::Acquire(4096, 64);
+        ASSERT_TRUE(ptrs[i] != NULL);
+    }
+    for (int i = 0; i < 6; ++i) {
+        pcg::ImageBufferPool::Release(ptrs[i], 4096, 64);
+    }
+
+    // Only the 4 most recently released buffers remain, the last one first
+    for (int i = 5; i >= 2; --i) {
+        void *ptr = pcg::ImageBufferPool::Acquire(4096, 64);
+        EXPECT_EQ(ptrs[i], ptr);
+    }
+    for (int i = 2; i < 6; ++i) {
+        pcg::ImageBufferPool::Release(ptrs[i], 4096, 64);
+    }
+
+    pcg::ImageBufferPool::SetMaxBuffers(1);
+    void *last = pcg::ImageBufferPool::Acquire(4096, 64);
+    EXPECT_EQ(ptrs[5], last);
+    pcg::ImageBufferPool::Release(last, 4096, 64);
+}
+
+
+
+TEST_F(ImageBufferPoolTest, Move)
+{
+    pcg::Image<pcg::Rgba16> img(13, 7);
+    const pcg::Rgba16 *pixels = img.GetDataPointer();
+
+    // Same memory needed, the image keeps its pixels
+    img.Alloc(7, 13);
+    EXPECT_EQ(pixels, img.GetDataPointer());
+    EXPECT_EQ(7, img.Width());
+    EXPECT_EQ(13, img.Height());
+
+    pcg::Image<pcg::Rgba16> other;
+    other.Swap(img);
+    EXPECT_EQ(pixels, other.GetDataPointer());
+    EXPECT_EQ(7, other.Width());
+    EXPECT_EQ(0, img.Size());
+    EXPECT_TRUE(img.GetDataPointer() == NULL);
+
+    pcg::RGBAImageSoA soa(31, 5);
+    const float *a = soa.GetDataPointer<pcg::RGBAImageSoA::A>();
+    pcg::RGBAImageSoA soaOther;
+    soaOther.Swap(soa);
+    EXPECT_EQ(a, soaOther.GetDataPointer<pcg::RGBAImageSoA::A>());
+    EXPECT_EQ(31, soaOther.Width());
+    EXPECT_EQ(5, soaOther.Height());
+    EXPECT_EQ(0, soa.Size());
+
+    // The emptied image is still usable
+    soa.Alloc(2, 2);
+    soa.ElementAt<pcg::RGBAImageSoA::B>(1, 1) = 1.0f;
+    EXPECT_EQ(1.0f, soa.ElementAt<pcg::RGBAImageSoA::B>(3));
+
+#if PCG_HAS_RVALUE_REFS
+    pcg::Image<pcg::Rgba16> moved(std::move(other));
+    EXPECT_EQ(pixels, moved.GetDataPointer());
+    EXPECT_EQ(0, other.Size());
+    other = std::move(moved);
+    EXPECT_EQ(pixels, other.GetDataPointer());
+
+    pcg::RGBAImageSoA soaMoved(std::move(soaOther));
+    EXPECT_EQ(a, soaMoved.GetDataPointer<pcg::RGBAImageSoA::A>());
+    EXPECT_EQ(0, soaOther.Size());
+    soaOther = std::move(soaMoved);
+    EXPECT_EQ(a, soaOther.GetDataPointer<pcg::RGBAImageSoA::A>());
+    soaMoved.Alloc(3, 3);
+    EXPECT_EQ(9, soaMoved.Size());
+#endif
+}
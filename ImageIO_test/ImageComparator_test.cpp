@@ -305,6 +305,12 @@ protected:
 #endif
         }
 
+        // Test the single pixel version
+        for (int i = 0; i < numPixels; ++i) {
+            ASSERT_RGBA32F_CLOSE (reference[i],
+                ImageComparator::Compare (type, src1[i], src2[i]));
+        }
+
         // Test the SoA version
         pcg::RGBAImageSoA src1SoA(src1);
         pcg::RGBAImageSoA src2SoA(src2);
@@ -0,0 +1,337 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <ImageView.h>
+#include <ImageComparator.h>
+#include <OpenEXRIO.h>
+#include <PngIO.h>
+#include <Reinhard02.h>
+#include <ToneMapperSoA.h>
+#include <Exception.h>
+
+#include "dSFMT/RandomMT.h"
+#include "TestUtil.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+
+namespace
+{
+
+typedef pcg::RGBAImageSoA ImageSoA;
+
+// Regions of the 203x97 test images, some with unaligned origins and widths
+const int REGIONS[][4] = {
+    {0, 0, 203, 97}, {0, 0, 200, 97}, {8, 5, 64, 40}, {37, 11, 61, 29},
+    {5, 40, 190, 3}, {202, 96, 1, 1}, {1, 50, 7, 47}
+};
+const int NUM_REGIONS = sizeof(REGIONS) / sizeof(REGIONS[0]);
+
+// Copies the pixels of the view into a new image of its size
+void copyView(ImageSoA &dest, const pcg::ConstRGBAImageSoAView &view)
+{
+    dest.Alloc(view.Width(), view.Height());
+    for (int j = 0; j < view.Height(); ++j) {
+        for (int i = 0; i < view.Width(); ++i) {
+            dest.ElementAt<ImageSoA::R>(i, j) = view.ElementAt<ImageSoA::R>(i,j);
+            dest.ElementAt<ImageSoA::G>(i, j) = view.ElementAt<ImageSoA::G>(i,j);
+            dest.ElementAt<ImageSoA::B>(i, j) = view.ElementAt<ImageSoA::B>(i,j);
+            dest.ElementAt<ImageSoA::A>(i, j) = view.ElementAt<ImageSoA::A>(i,j);
+        }
+    }
+}
+
+bool equalPixels(const pcg::ConstRGBAImageSoAView &a,
+    const pcg::ConstRGBAImageSoAView &b)
+{
+    if (a.Width() != b.Width() || a.Height() != b.Height()) {
+        return false;
+    }
+    for (int j = 0; j < a.Height(); ++j) {
+        for (int i = 0; i < a.Width(); ++i) {
+            if (a.ElementAt<ImageSoA::R>(i,j) != b.ElementAt<ImageSoA::R>(i,j) ||
+                a.ElementAt<ImageSoA::G>(i,j) != b.ElementAt<ImageSoA::G>(i,j) ||
+                a.ElementAt<ImageSoA::B>(i,j) != b.ElementAt<ImageSoA::B>(i,j) ||
+                a.ElementAt<ImageSoA::A>(i,j) != b.ElementAt<ImageSoA::A>(i,j)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool equalFiles(const char *filename1, const char *filename2)
+{
+    std::ifstream f1(filename1, std::ios::binary);
+    std::ifstream f2(filename2, std::ios::binary);
+    const std::vector<char> data1((std::istreambuf_iterator<char>(f1)),
+        std::istreambuf_iterator<char>());
+    const std::vector<char> data2((std::istreambuf_iterator<char>(f2)),
+        std::istreambuf_iterator<char>());
+    return !data1.empty() && data1 == data2;
+}
+
+} // namespace
+
+
+
+TEST(ImageView, Basic)
+{
+    pcg::Image<pcg::Rgba8, pcg::BottomUp> img(5, 4);
+    for (int j = 0; j < img.Height(); ++j) {
+        for (int i = 0; i < img.Width(); ++i) {
+            img.ElementAt(i, j, pcg::TopDown).set(i, j, 0, 255);
+        }
+    }
+
+    // Views are always top-down
+    const pcg::ImageView<pcg::Rgba8> view(img);
+    EXPECT_EQ(5, view.Width());
+    EXPECT_EQ(4, view.Height());
+    EXPECT_EQ(-5, view.Stride());
+    EXPECT_FALSE(view.IsContiguous());
+    EXPECT_EQ(&img.ElementAt(3, 1, pcg::TopDown), &view.ElementAt(3, 1));
+
+    const pcg::ImageView<const pcg::Rgba8> sub = view.SubView(1, 2, 3, 2);
+    EXPECT_EQ(3, sub.Width());
+    EXPECT_EQ(2, sub.Height());
+    EXPECT_EQ(-5, sub.Stride());
+    EXPECT_EQ(&img.ElementAt(1, 2, pcg::TopDown), &sub.ElementAt(0, 0));
+    EXPECT_EQ(&img.ElementAt(3, 3, pcg::TopDown), &sub.ElementAt(2, 1));
+    EXPECT_EQ(3, sub.ElementAt(2, 1).r);
+
+    EXPECT_THROW(view.SubView(3, 0, 3, 1), pcg::IllegalArgumentException);
+    EXPECT_THROW(view.SubView(-1, 0, 1, 1), pcg::IllegalArgumentException);
+    EXPECT_EQ(0, view.SubView(5, 4, 0, 0).Size());
+
+    ImageSoA soa(7, 3);
+    const pcg::RGBAImageSoAView soaView(soa);
+    EXPECT_TRUE(soaView.IsContiguous());
+    const pcg::ConstRGBAImageSoAView soaSub = soaView.SubView(2, 1, 4, 2);
+    EXPECT_EQ(7, soaSub.Stride());
+    EXPECT_EQ(&soa.ElementAt<ImageSoA::G>(5, 2),
+        &soaSub.ElementAt<ImageSoA::G>(3, 1));
+    EXPECT_THROW(soaView.SubView(0, 0, 8, 1), pcg::IllegalArgumentException);
+}
+
+
+
+// Tone mapping a view must produce the same pixels as tone mapping a copy of
+// its pixels, without touching anything else
+TEST(ImageView, ToneMap)
+{
+    RandomMT rnd;
+    ImageSoA img(203, 97);
+    fillRandom(img, rnd);
+    pcg::Image<pcg::Rgba16> out(img.Width(), img.Height());
+    pcg::Rgba16 marker;
+    marker.set(1, 2, 3, 4);
+
+    pcg::ToneMapperSoA tm;
+    tm.SetExposure(-5.0f);
+
+    for (int k = 0; k < NUM_REGIONS; ++k) {
+        const int x = REGIONS[k][0], y = REGIONS[k][1];
+        const int w = REGIONS[k][2], h = REGIONS[k][3];
+
+        ImageSoA region;
+        copyView(region, pcg::ConstRGBAImageSoAView(img).SubView(x, y, w, h));
+        pcg::Image<pcg::Rgba16> expected(w, h);
+        tm.ToneMap(expected, region, pcg::EXPOSURE);
+
+        for (int i = 0; i < out.Size(); ++i) {
+            out[i] = marker;
+        }
+        tm.ToneMap(pcg::ImageView<pcg::Rgba16>(out).SubView(x, y, w, h),
+            pcg::ConstRGBAImageSoAView(img).SubView(x, y, w, h),
+            pcg::EXPOSURE);
+
+        for (int j = 0; j < out.Height(); ++j) {
+            for (int i = 0; i < out.Width(); ++i) {
+                const pcg::Rgba16 &actual = out.ElementAt(i, j);
+                const pcg::Rgba16 &ref =
+                    (i >= x && i < x + w && j >= y && j < y + h) ?
+                    expected.ElementAt(i - x, j - y) : marker;
+                ASSERT_TRUE(ref.r == actual.r && ref.g == actual.g &&
+                    ref.b == actual.b && ref.a == actual.a)
+                    << "Region " << k << ", pixel (" << i << ',' << j << ')';
+            }
+        }
+    }
+
+    pcg::Image<pcg::Bgra8> small(3, 3);
+    EXPECT_THROW(tm.ToneMap(pcg::ImageView<pcg::Bgra8>(small),
+        pcg::ConstRGBAImageSoAView(img)), pcg::IllegalArgumentException);
+}
+
+
+
+TEST(ImageView, Compare)
+{
+    RandomMT rnd;
+    ImageSoA src1(203, 97);
+    fillRandom(src1, rnd);
+    ImageSoA src2(203, 97);
+    fillRandom(src2, rnd);
+
+    for (int k = 0; k < NUM_REGIONS; ++k) {
+        const int x = REGIONS[k][0], y = REGIONS[k][1];
+        const int w = REGIONS[k][2], h = REGIONS[k][3];
+
+        ImageSoA region1, region2;
+        copyView(region1, pcg::ConstRGBAImageSoAView(src1).SubView(x,y,w,h));
+        copyView(region2, pcg::ConstRGBAImageSoAView(src2).SubView(x,y,w,h));
+        ImageSoA expected(w, h);
+        pcg::ImageComparator::Compare(pcg::ImageComparator::RelativeError,
+            expected, region1, region2);
+
+        // In place, into the first source
+        ImageSoA dest;
+        copyView(dest, src1);
+        const pcg::RGBAImageSoAView destView =
+            pcg::RGBAImageSoAView(dest).SubView(x, y, w, h);
+        pcg::ImageComparator::Compare(pcg::ImageComparator::RelativeError,
+            destView, destView,
+            pcg::ConstRGBAImageSoAView(src2).SubView(x, y, w, h));
+        EXPECT_TRUE(equalPixels(expected, destView)) << "Region " << k;
+    }
+
+    ImageSoA small(3, 3);
+    EXPECT_THROW(pcg::ImageComparator::Compare(
+        pcg::ImageComparator::Addition, small, src1, src2),
+        pcg::IllegalArgumentException);
+    EXPECT_THROW(pcg::ImageComparator::Compare(
+        pcg::ImageComparator::Addition, pcg::RGBAImageSoAView(small),
+        src1, src2), pcg::IllegalArgumentException);
+}
+
+
+
+TEST(ImageView, EstimateParams)
+{
+    RandomMT rnd;
+    ImageSoA img(203, 97);
+    fillRandom(img, rnd);
+
+    for (int k = 0; k < NUM_REGIONS; ++k) {
+        const int x = REGIONS[k][0], y = REGIONS[k][1];
+        const int w = REGIONS[k][2], h = REGIONS[k][3];
+        const pcg::ConstRGBAImageSoAView view =
+            pcg::ConstRGBAImageSoAView(img).SubView(x, y, w, h);
+        ImageSoA region;
+        copyView(region, view);
+
+        const pcg::Reinhard02::Params expected =
+            pcg::Reinhard02::EstimateParams(region);
+        const pcg::Reinhard02::Params actual =
+            pcg::Reinhard02::EstimateParams(view);
+        EXPECT_FLOAT_EQ(expected.key,     actual.key)     << "Region " << k;
+        EXPECT_FLOAT_EQ(expected.l_white, actual.l_white) << "Region " << k;
+        EXPECT_FLOAT_EQ(expected.l_w,     actual.l_w)     << "Region " << k;
+        EXPECT_FLOAT_EQ(expected.l_min,   actual.l_min)   << "Region " << k;
+        EXPECT_FLOAT_EQ(expected.l_max,   actual.l_max)   << "Region " << k;
+    }
+
+    EXPECT_THROW(pcg::Reinhard02::EstimateParams(
+        pcg::ConstRGBAImageSoAView(img).SubView(0, 0, 0, 0)),
+        pcg::IllegalArgumentException);
+}
+
+
+
+// Saving a view writes the same file as saving a copy of its pixels, and
+// loading into a view fills only its pixels
+TEST(ImageView, Codecs)
+{
+    const char *FILENAME1 = "test-imageview1.exr";
+    const char *FILENAME2 = "test-imageview2.exr";
+    RandomMT rnd;
+    ImageSoA img(203, 97);
+    fillRandom(img, rnd);
+
+    const int x = 37, y = 11, w = 61, h = 29;
+    const pcg::ConstRGBAImageSoAView view =
+        pcg::ConstRGBAImageSoAView(img).SubView(x, y, w, h);
+    ImageSoA region;
+    copyView(region, view);
+
+    const pcg::OpenEXRIO::Compression compressions[] = {
+        pcg::OpenEXRIO::None, pcg::OpenEXRIO::PIZ
+    };
+    for (int k = 0; k < 2; ++k) {
+        pcg::OpenEXRIO::Save(region, FILENAME1, pcg::OpenEXRIO::WRITE_RGBA,
+            compressions[k]);
+        pcg::OpenEXRIO::Save(view, FILENAME2, pcg::OpenEXRIO::WRITE_RGBA,
+            compressions[k]);
+        EXPECT_TRUE(equalFiles(FILENAME1, FILENAME2));
+
+        ImageSoA expected;
+        pcg::OpenEXRIO::Load(expected, FILENAME1);
+        ImageSoA dest(img.Width(), img.Height());
+        copyView(dest, img);
+        pcg::OpenEXRIO::Load(
+            pcg::RGBAImageSoAView(dest).SubView(x, y, w, h), FILENAME2);
+        EXPECT_TRUE(equalPixels(expected,
+            pcg::RGBAImageSoAView(dest).SubView(x, y, w, h)));
+        EXPECT_TRUE(equalPixels(pcg::ConstRGBAImageSoAView(img).SubView(
+            0, 0, img.Width(), y), pcg::ConstRGBAImageSoAView(dest).SubView(
+            0, 0, img.Width(), y)));
+
+        EXPECT_THROW(pcg::OpenEXRIO::Load(
+            pcg::RGBAImageSoAView(dest).SubView(x, y, w, h - 1), FILENAME2),
+            pcg::IllegalArgumentException);
+    }
+
+    // Files with float channels are read straight into the view
+    pcg::Image<pcg::Rgba32F> aos(w, h);
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            aos.ElementAt(i, j).set(view.ElementAt<ImageSoA::R>(i, j),
+                view.ElementAt<ImageSoA::G>(i, j),
+                view.ElementAt<ImageSoA::B>(i, j),
+                view.ElementAt<ImageSoA::A>(i, j));
+        }
+    }
+    pcg::OpenEXRIO::Save(aos, FILENAME1, pcg::OpenEXRIO::WRITE_RGBA);
+    pcg::OpenEXRIO::Save(pcg::ImageView<const pcg::Rgba32F>(aos), FILENAME2,
+        pcg::OpenEXRIO::WRITE_RGBA);
+    EXPECT_TRUE(equalFiles(FILENAME1, FILENAME2));
+    remove(FILENAME1);
+    remove(FILENAME2);
+
+    const char *PNG1 = "test-imageview1.png";
+    const char *PNG2 = "test-imageview2.png";
+    pcg::Image<pcg::Bgra8, pcg::BottomUp> ldr(img.Width(), img.Height());
+    pcg::ToneMapperSoA tm;
+    tm.ToneMap(ldr, img);
+    const pcg::ImageView<const pcg::Bgra8> ldrView =
+        pcg::ImageView<const pcg::Bgra8>(ldr).SubView(x, y, w, h);
+    pcg::Image<pcg::Bgra8> ldrRegion(w, h);
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            ldrRegion.ElementAt(i, j) = ldrView.ElementAt(i, j);
+        }
+    }
+    pcg::PngIO::Save(ldrRegion, PNG1);
+    pcg::PngIO::Save(ldrView, PNG2);
+    EXPECT_TRUE(equalFiles(PNG1, PNG2));
+    remove(PNG1);
+    remove(PNG2);
+}
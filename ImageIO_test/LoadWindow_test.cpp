@@ -0,0 +1,225 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <LoadHDR.h>
+#include <PfmIO.h>
+#include <RgbeIO.h>
+#include <ImageSoA.h>
+#include <Exception.h>
+
+#include "dSFMT/RandomMT.h"
+#include "TestUtil.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+
+typedef pcg::RGBAImageSoA ImageSoA;
+
+// Every pixel of the window must be the corresponding one of the full image
+void checkWindow(const ImageSoA &full, const ImageSoA &img,
+    const pcg::LoadWindow &window)
+{
+    const pcg::LoadWindow w = window.resolve(full.Width(), full.Height());
+    ASSERT_EQ(w.outputWidth(),  img.Width());
+    ASSERT_EQ(w.outputHeight(), img.Height());
+    for (int j = 0; j < img.Height(); ++j) {
+        for (int i = 0; i < img.Width(); ++i) {
+            const int x = w.sourceX(i);
+            const int y = w.sourceY(j);
+            ASSERT_EQ(full.ElementAt<ImageSoA::R>(x, y),
+                img.ElementAt<ImageSoA::R>(i, j));
+            ASSERT_EQ(full.ElementAt<ImageSoA::G>(x, y),
+                img.ElementAt<ImageSoA::G>(i, j));
+            ASSERT_EQ(full.ElementAt<ImageSoA::B>(x, y),
+                img.ElementAt<ImageSoA::B>(i, j));
+        }
+    }
+}
+
+} // namespace
+
+
+
+TEST(LoadWindow, Resolve)
+{
+    const pcg::LoadWindow w = pcg::LoadWindow(10, 20, 0, 0, 8).resolve(99, 60);
+    EXPECT_EQ(89, w.width);
+    EXPECT_EQ(40, w.height);
+    EXPECT_EQ(12, w.outputWidth());
+    EXPECT_EQ(5,  w.outputHeight());
+    EXPECT_EQ(98, w.sourceX(11));
+    EXPECT_EQ(52, w.sourceY(4));
+
+    EXPECT_THROW(pcg::LoadWindow(0, 0, 0, 0, 0).resolve(8, 8),
+        pcg::IllegalArgumentException);
+    EXPECT_THROW(pcg::LoadWindow(8, 0).resolve(8, 8),
+        pcg::IllegalArgumentException);
+    EXPECT_THROW(pcg::LoadWindow(4, 4, 5, 1).resolve(8, 8),
+        pcg::IllegalArgumentException);
+    EXPECT_THROW(pcg::LoadWindow(-1, 0).resolve(8, 8),
+        pcg::IllegalArgumentException);
+}
+
+
+
+TEST(LoadWindow, Formats)
+{
+    RandomMT rnd;
+    ImageSoA src(123, 77);
+    fillRandom(src, rnd, true);
+
+    const pcg::LoadWindow windows[] = {
+        pcg::LoadWindow(),
+        pcg::LoadWindow::subsampled(8),
+        pcg::LoadWindow(7, 5, 0, 0, 3),
+        pcg::LoadWindow(11, 13, 64, 32),
+        pcg::LoadWindow(122, 76, 1, 1, 4)
+    };
+
+    for (int format = 0; format < 2; ++format) {
+        std::stringstream file;
+        if (format == 0) {
+            pcg::PfmIO::Save(src, file);
+        } else {
+            pcg::RgbeIO::Save(src, file);
+        }
+        ImageSoA full;
+        file.seekg(0);
+        pcg::LoadHDR(full, file);
+
+        for (size_t k = 0; k < sizeof(windows) / sizeof(windows[0]); ++k) {
+            ImageSoA img;
+            file.clear();
+            file.seekg(0);
+            pcg::LoadHDR(img, file, windows[k]);
+            checkWindow(full, img, windows[k]);
+        }
+    }
+}
+
+
+
+TEST(LoadWindow, ScanlineReader)
+{
+    RandomMT rnd;
+    ImageSoA src(97, 61);
+    fillRandom(src, rnd, true);
+
+    const char *filenames[] = {"test-scanlinereader.pfm",
+        "test-scanlinereader.hdr"};
+    pcg::PfmIO::Save(src, filenames[0]);
+    pcg::RgbeIO::Save(src, filenames[1]);
+
+    for (int format = 0; format < 2; ++format) {
+        ImageSoA full;
+        pcg::LoadHDR(full, filenames[format]);
+        {
+            pcg::ScanlineReader reader(filenames[format]);
+            ASSERT_EQ(full.Width(),  reader.Width());
+            ASSERT_EQ(full.Height(), reader.Height());
+
+            // Bottom to top, with a shorter band at the end of the image
+            const int bandHeight = 16;
+            for (int y = (full.Height() - 1) / bandHeight * bandHeight;
+                y >= 0; y -= bandHeight) {
+                const int rows = std::min(bandHeight, full.Height() - y);
+                ImageSoA band;
+                reader.Read(band, y, rows);
+                checkWindow(full, band, pcg::LoadWindow(0, y, 0, rows));
+            }
+
+            ImageSoA band;
+            EXPECT_THROW(reader.Read(band, 60, 2),
+                pcg::IllegalArgumentException);
+            EXPECT_THROW(reader.Read(band, -1, 1),
+                pcg::IllegalArgumentException);
+        }
+        remove(filenames[format]);
+    }
+}
+
+
+
+#if !defined(_WIN32)
+// Files which cannot be mapped, such as FIFOs, go through the regular streams
+TEST(LoadWindow, NonMappableFiles)
+{
+    RandomMT rnd;
+    ImageSoA src(83, 41);
+    fillRandom(src, rnd, true);
+
+    const char *filenames[] = {"test-nonmappable.pfm", "test-nonmappable.hdr"};
+    const char *fifoName = "test-nonmappable.fifo";
+    pcg::PfmIO::Save(src, filenames[0]);
+    pcg::RgbeIO::Save(src, filenames[1]);
+
+    for (int format = 0; format < 2; ++format) {
+        ImageSoA full;
+        pcg::LoadHDR(full, filenames[format]);
+
+        std::ifstream file(filenames[format], std::ios::binary);
+        const std::string data((std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>());
+
+        remove(fifoName);
+        ASSERT_EQ(0, mkfifo(fifoName, 0600));
+        const pid_t pid = fork();
+        ASSERT_NE(-1, pid);
+        if (pid == 0) {
+            std::ofstream fifo(fifoName, std::ios::binary);
+            fifo.write(data.data(), data.size());
+            fifo.close();
+            _exit(fifo.fail() ? 1 : 0);
+        }
+
+        ImageSoA img;
+        if (format == 0) {
+            pcg::PfmIO::Load(img, fifoName);
+        } else {
+            pcg::RgbeIO::Load(img, fifoName);
+        }
+        int status = -1;
+        waitpid(pid, &status, 0);
+        EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        checkWindow(full, img, pcg::LoadWindow());
+        remove(fifoName);
+        remove(filenames[format]);
+    }
+
+    // Empty files cannot be mapped either, the format errors still apply
+    const char *emptyName = "test-nonmappable-empty.pfm";
+    std::ofstream(emptyName, std::ios::binary).close();
+    ImageSoA img;
+    EXPECT_THROW(pcg::PfmIO::Load(img, emptyName), pcg::PfmIOException);
+    remove(emptyName);
+    EXPECT_THROW(pcg::PfmIO::Load(img, emptyName), pcg::PfmIOException);
+}
+#endif
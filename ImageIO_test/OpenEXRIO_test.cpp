@@ -0,0 +1,284 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <OpenEXRIO.h>
+#include <Downsampler.h>
+#include <ImageSoA.h>
+#include <Exception.h>
+
+#include "dSFMT/RandomMT.h"
+#include "TestUtil.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+
+namespace
+{
+
+typedef pcg::RGBAImageSoA ImageSoA;
+
+const char *FILENAME = "test-openexrio.exr";
+
+// 203x97 does not divide evenly into any of the tile sizes
+const int WIDTH  = 203;
+const int HEIGHT = 97;
+
+// The files store halves, thus the pixels are only as precise as those
+inline bool nearHalf(float expected, float actual)
+{
+    return std::fabs(expected - actual) <=
+        1e-3f * std::max(std::fabs(expected), std::fabs(actual)) + 1e-6f;
+}
+
+// Compares the pixels of img with those of the region of ref whose top-left
+// corner is (x,y), either exactly or up to half precision
+::testing::AssertionResult equalRegion(const ImageSoA &ref, int x, int y,
+    const ImageSoA &img, bool exact)
+{
+    if (x + img.Width() > ref.Width() || y + img.Height() > ref.Height()) {
+        return ::testing::AssertionFailure() << "The region is too large";
+    }
+    for (int j = 0; j < img.Height(); ++j) {
+        for (int i = 0; i < img.Width(); ++i) {
+            const float expected[] = {
+                ref.ElementAt<ImageSoA::R>(x + i, y + j),
+                ref.ElementAt<ImageSoA::G>(x + i, y + j),
+                ref.ElementAt<ImageSoA::B>(x + i, y + j),
+                ref.ElementAt<ImageSoA::A>(x + i, y + j)
+            };
+            const float actual[] = {
+                img.ElementAt<ImageSoA::R>(i, j),
+                img.ElementAt<ImageSoA::G>(i, j),
+                img.ElementAt<ImageSoA::B>(i, j),
+                img.ElementAt<ImageSoA::A>(i, j)
+            };
+            for (int c = 0; c < 4; ++c) {
+                if (exact ? expected[c] != actual[c] :
+                    !nearHalf(expected[c], actual[c])) {
+                    return ::testing::AssertionFailure() << "Pixel (" << i <<
+                        ',' << j << "), channel " << c << ": expected " <<
+                        expected[c] << ", actual " << actual[c];
+                }
+            }
+        }
+    }
+    return ::testing::AssertionSuccess();
+}
+
+// Size of a level with the rounding mode of the tiled files
+inline int levelSize(int size, int l)
+{
+    return std::max(1, size >> l);
+}
+
+} // namespace
+
+
+
+TEST(OpenEXRIO, TiledRoundTrip)
+{
+    RandomMT rnd;
+    ImageSoA src(WIDTH, HEIGHT);
+    fillRandom(src, rnd);
+
+    const int tileSizes[][2] = {{16, 16}, {64, 32}, {37, 23}, {1, 97},
+        {256, 256}};
+    for (size_t k = 0; k < sizeof(tileSizes) / sizeof(tileSizes[0]); ++k) {
+        pcg::OpenEXRIO::SaveTiled(src, FILENAME,
+            tileSizes[k][0], tileSizes[k][1]);
+
+        int numXLevels = 0, numYLevels = 0;
+        pcg::OpenEXRIO::GetNumLevels(FILENAME, numXLevels, numYLevels);
+        EXPECT_EQ(1, numXLevels);
+        EXPECT_EQ(1, numYLevels);
+
+        ImageSoA full;
+        pcg::OpenEXRIO::Load(full, FILENAME);
+        ASSERT_EQ(WIDTH,  full.Width());
+        ASSERT_EQ(HEIGHT, full.Height());
+        EXPECT_TRUE(equalRegion(src, 0, 0, full, false)) << "Tiles " << k;
+
+        ImageSoA level;
+        pcg::OpenEXRIO::LoadLevel(level, FILENAME, 0, 0);
+        EXPECT_TRUE(equalRegion(full, 0, 0, level, true)) << "Tiles " << k;
+    }
+
+    EXPECT_THROW(pcg::OpenEXRIO::SaveTiled(src, FILENAME, 0, 16),
+        pcg::IllegalArgumentException);
+    remove(FILENAME);
+}
+
+
+
+TEST(OpenEXRIO, Levels)
+{
+    RandomMT rnd;
+    ImageSoA src(WIDTH, HEIGHT);
+    fillRandom(src, rnd);
+    int numXLevels = 0, numYLevels = 0, width = 0, height = 0;
+
+    // 203 -> 101 -> 50 -> 25 -> 12 -> 6 -> 3 -> 1, 97 -> 48 -> ... -> 1 -> 1
+    pcg::OpenEXRIO::SaveTiled(src, FILENAME, 32, 16,
+        pcg::OpenEXRIO::MIPMAP_LEVELS);
+    pcg::OpenEXRIO::GetNumLevels(FILENAME, numXLevels, numYLevels);
+    EXPECT_EQ(8, numXLevels);
+    EXPECT_EQ(8, numYLevels);
+    for (int l = 0; l < numXLevels; ++l) {
+        pcg::OpenEXRIO::GetLevelSize(FILENAME, l, l, width, height);
+        EXPECT_EQ(levelSize(WIDTH,  l), width)  << "Level " << l;
+        EXPECT_EQ(levelSize(HEIGHT, l), height) << "Level " << l;
+    }
+    EXPECT_THROW(pcg::OpenEXRIO::GetLevelSize(FILENAME, 1, 0, width, height),
+        pcg::IllegalArgumentException);
+    EXPECT_THROW(pcg::OpenEXRIO::GetLevelSize(FILENAME, 8, 8, width, height),
+        pcg::IllegalArgumentException);
+
+    pcg::OpenEXRIO::SaveTiled(src, FILENAME, 32, 16,
+        pcg::OpenEXRIO::RIPMAP_LEVELS);
+    pcg::OpenEXRIO::GetNumLevels(FILENAME, numXLevels, numYLevels);
+    EXPECT_EQ(8, numXLevels);
+    EXPECT_EQ(7, numYLevels);
+    for (int ly = 0; ly < numYLevels; ++ly) {
+        for (int lx = 0; lx < numXLevels; ++lx) {
+            pcg::OpenEXRIO::GetLevelSize(FILENAME, lx, ly, width, height);
+            EXPECT_EQ(levelSize(WIDTH,  lx), width);
+            EXPECT_EQ(levelSize(HEIGHT, ly), height);
+        }
+    }
+    EXPECT_THROW(pcg::OpenEXRIO::GetLevelSize(FILENAME, 0, 7, width, height),
+        pcg::IllegalArgumentException);
+
+    // Scanline files only have the level (0,0)
+    pcg::OpenEXRIO::Save(src, FILENAME, pcg::OpenEXRIO::WRITE_RGBA);
+    pcg::OpenEXRIO::GetNumLevels(FILENAME, numXLevels, numYLevels);
+    EXPECT_EQ(1, numXLevels);
+    EXPECT_EQ(1, numYLevels);
+    pcg::OpenEXRIO::GetLevelSize(FILENAME, 0, 0, width, height);
+    EXPECT_EQ(WIDTH,  width);
+    EXPECT_EQ(HEIGHT, height);
+    remove(FILENAME);
+}
+
+
+
+// Each level must be the output of the downsampler from the previous one
+TEST(OpenEXRIO, LoadLevel)
+{
+    RandomMT rnd;
+    ImageSoA src(WIDTH, HEIGHT);
+    fillRandom(src, rnd);
+
+    pcg::OpenEXRIO::SaveTiled(src, FILENAME, 16, 16,
+        pcg::OpenEXRIO::MIPMAP_LEVELS, pcg::Downsampler::LANCZOS3);
+    ImageSoA expected[2];
+    const ImageSoA *previous = &src;
+    for (int l = 0; l < 8; ++l) {
+        if (l > 0) {
+            ImageSoA &next = expected[l % 2];
+            next.Alloc(levelSize(WIDTH, l), levelSize(HEIGHT, l));
+            pcg::Downsampler::Downsample(*previous, next,
+                pcg::Downsampler::LANCZOS3);
+            previous = &next;
+        }
+        ImageSoA level;
+        pcg::OpenEXRIO::LoadLevel(level, FILENAME, l, l);
+        ASSERT_EQ(previous->Width(),  level.Width());
+        ASSERT_EQ(previous->Height(), level.Height());
+        EXPECT_TRUE(equalRegion(*previous, 0, 0, level, false))
+            << "Level " << l;
+    }
+
+    // Ripmaps reduce the height first, then the width
+    pcg::OpenEXRIO::SaveTiled(src, FILENAME, 16, 16,
+        pcg::OpenEXRIO::RIPMAP_LEVELS);
+    const int levels[][2] = {{0, 0}, {3, 0}, {0, 2}, {2, 5}, {7, 6}};
+    for (size_t k = 0; k < sizeof(levels) / sizeof(levels[0]); ++k) {
+        const int lx = levels[k][0], ly = levels[k][1];
+        ImageSoA rowStart[2], level[2];
+        const ImageSoA *current = &src;
+        for (int y = 1; y <= ly; ++y) {
+            ImageSoA &next = rowStart[y % 2];
+            next.Alloc(WIDTH, levelSize(HEIGHT, y));
+            pcg::Downsampler::Downsample(*current, next);
+            current = &next;
+        }
+        for (int x = 1; x <= lx; ++x) {
+            ImageSoA &next = level[x % 2];
+            next.Alloc(levelSize(WIDTH, x), levelSize(HEIGHT, ly));
+            pcg::Downsampler::Downsample(*current, next);
+            current = &next;
+        }
+
+        ImageSoA img;
+        pcg::OpenEXRIO::LoadLevel(img, FILENAME, lx, ly);
+        EXPECT_TRUE(equalRegion(*current, 0, 0, img, false))
+            << "Level (" << lx << ',' << ly << ')';
+    }
+    remove(FILENAME);
+}
+
+
+
+// Regions must match the corresponding crop of the whole level
+TEST(OpenEXRIO, LoadRegion)
+{
+    RandomMT rnd;
+    ImageSoA src(WIDTH, HEIGHT);
+    fillRandom(src, rnd);
+
+    const int regions[][4] = {
+        {0, 0, WIDTH, HEIGHT}, {0, 0, 1, 1}, {202, 96, 1, 1},
+        {15, 15, 2, 2}, {31, 17, 64, 33}, {5, 40, 198, 3}, {100, 0, 7, 97}
+    };
+    for (int kind = 0; kind < 3; ++kind) {
+        if (kind == 0) {
+            pcg::OpenEXRIO::Save(src, FILENAME, pcg::OpenEXRIO::WRITE_RGBA);
+        } else if (kind == 1) {
+            pcg::OpenEXRIO::SaveTiled(src, FILENAME, 16, 16);
+        } else {
+            pcg::OpenEXRIO::SaveTiled(src, FILENAME, 37, 23,
+                pcg::OpenEXRIO::MIPMAP_LEVELS);
+        }
+
+        ImageSoA full;
+        pcg::OpenEXRIO::Load(full, FILENAME);
+        for (size_t k = 0; k < sizeof(regions) / sizeof(regions[0]); ++k) {
+            const int *r = regions[k];
+            ImageSoA img;
+            pcg::OpenEXRIO::LoadRegion(img, FILENAME, r[0], r[1], r[2], r[3]);
+            EXPECT_TRUE(equalRegion(full, r[0], r[1], img, true))
+                << "File " << kind << ", region " << k;
+        }
+
+        EXPECT_THROW(pcg::OpenEXRIO::LoadRegion(full, FILENAME,
+            200, 0, 4, 1), pcg::IllegalArgumentException);
+        EXPECT_THROW(pcg::OpenEXRIO::LoadRegion(full, FILENAME,
+            0, 0, 0, 1), pcg::IllegalArgumentException);
+    }
+
+    // Regions of a lower resolution level
+    ImageSoA level;
+    pcg::OpenEXRIO::LoadLevel(level, FILENAME, 2, 2);
+    ImageSoA img;
+    pcg::OpenEXRIO::LoadRegion(img, FILENAME, 7, 3, 30, 17, 2, 2);
+    EXPECT_TRUE(equalRegion(level, 7, 3, img, true));
+    EXPECT_THROW(pcg::OpenEXRIO::LoadRegion(img, FILENAME, 40, 0, 11, 1, 2, 2),
+        pcg::IllegalArgumentException);
+    remove(FILENAME);
+}
@@ -0,0 +1,203 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <PngIO.h>
+#include <Image.h>
+#include <LDRPixels.h>
+#include <Exception.h>
+
+#include "dSFMT/RandomMT.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <vector>
+
+#include <png.h>
+
+
+namespace
+{
+
+const char *FILENAME = "test-pngio.png";
+
+// Smooth gradients plus a bit of noise, so that the filters matter
+template <typename T>
+void fillImage(pcg::Image<T> &img, RandomMT &rnd)
+{
+    const int maxVal = (1 << (8 * sizeof(typename T::pixel_t))) - 1;
+    for (int j = 0; j < img.Height(); ++j) {
+        for (int i = 0; i < img.Width(); ++i) {
+            const int noise = static_cast<int>(4 * rnd.nextFloat());
+            T &p = img.ElementAt(i, j);
+            p.r = static_cast<typename T::pixel_t>(
+                (i * maxVal / img.Width() + noise) & maxVal);
+            p.g = static_cast<typename T::pixel_t>(
+                (j * maxVal / img.Height() + noise) & maxVal);
+            p.b = static_cast<typename T::pixel_t>(maxVal * rnd.nextFloat());
+        }
+    }
+}
+
+// Reads the file with libpng as 8 or 16-bit RGB samples
+struct PngData
+{
+    int width;
+    int height;
+    int bitDepth;
+    double gamma;
+    bool hasTime;
+    std::vector<unsigned int> samples;
+};
+
+bool readPng(const char *filename, PngData &data)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    png_structp pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+        NULL, NULL, NULL);
+    png_infop infoPtr = png_create_info_struct(pngPtr);
+    if (setjmp(png_jmpbuf(pngPtr))) {
+        png_destroy_read_struct(&pngPtr, &infoPtr, NULL);
+        fclose(fp);
+        return false;
+    }
+    png_init_io(pngPtr, fp);
+    png_read_png(pngPtr, infoPtr, PNG_TRANSFORM_IDENTITY, NULL);
+
+    data.width    = png_get_image_width(pngPtr, infoPtr);
+    data.height   = png_get_image_height(pngPtr, infoPtr);
+    data.bitDepth = png_get_bit_depth(pngPtr, infoPtr);
+    data.gamma    = 0.0;
+    png_get_gAMA(pngPtr, infoPtr, &data.gamma);
+    png_timep pngTime = NULL;
+    data.hasTime  = png_get_tIME(pngPtr, infoPtr, &pngTime) != 0;
+
+    png_bytepp rows = png_get_rows(pngPtr, infoPtr);
+    data.samples.clear();
+    for (int j = 0; j < data.height; ++j) {
+        for (int i = 0; i < 3 * data.width; ++i) {
+            data.samples.push_back(data.bitDepth == 8 ? rows[j][i] :
+                (rows[j][2*i] << 8) | rows[j][2*i + 1]);
+        }
+    }
+
+    png_destroy_read_struct(&pngPtr, &infoPtr, NULL);
+    fclose(fp);
+    return true;
+}
+
+template <typename T>
+void checkPixels(const pcg::Image<T> &img, const PngData &data)
+{
+    ASSERT_EQ(img.Width(),  data.width);
+    ASSERT_EQ(img.Height(), data.height);
+    ASSERT_EQ(8 * sizeof(typename T::pixel_t), size_t(data.bitDepth));
+    for (int j = 0; j < img.Height(); ++j) {
+        for (int i = 0; i < img.Width(); ++i) {
+            const T &p = img.ElementAt(i, j);
+            const unsigned int *s = &data.samples[3 * (j*img.Width() + i)];
+            ASSERT_EQ(p.r, s[0]);
+            ASSERT_EQ(p.g, s[1]);
+            ASSERT_EQ(p.b, s[2]);
+        }
+    }
+}
+
+} // namespace
+
+
+
+// Images spanning several bands with every filter and some levels
+TEST(PngIO, RoundTrip)
+{
+    RandomMT rnd;
+    pcg::Image<pcg::Rgba16> img16(700, 401);
+    fillImage(img16, rnd);
+    pcg::Image<pcg::Rgba8> img8(517, 803);
+    fillImage(img8, rnd);
+
+    const int levels[] = {pcg::PngIO::DEFAULT_COMPRESSION, 0, 1};
+    for (int f = pcg::PngIO::FILTER_NONE; f <= pcg::PngIO::FILTER_ADAPTIVE;
+        ++f) {
+        const pcg::PngIO::Filter filter = static_cast<pcg::PngIO::Filter>(f);
+        for (size_t k = 0; k < sizeof(levels) / sizeof(levels[0]); ++k) {
+            PngData data;
+            pcg::PngIO::Save(img16, FILENAME, false, 0.5f, levels[k], filter);
+            ASSERT_TRUE(readPng(FILENAME, data));
+            checkPixels(img16, data);
+            EXPECT_NEAR(0.5, data.gamma, 1e-5);
+            EXPECT_TRUE(data.hasTime);
+
+            pcg::PngIO::Save(img8, FILENAME, true, 0.5f, levels[k], filter);
+            ASSERT_TRUE(readPng(FILENAME, data));
+            checkPixels(img8, data);
+            EXPECT_NEAR(0.45455, data.gamma, 1e-5);
+        }
+    }
+    remove(FILENAME);
+}
+
+
+
+// Scanlines given in arbitrary groups, in BGRA and from bottom-up images
+TEST(PngIO, Writer)
+{
+    RandomMT rnd;
+    pcg::Image<pcg::Bgra8> img(3001, 1000);
+    fillImage(img, rnd);
+
+    pcg::PngWriter writer(FILENAME, img.Width(), img.Height(), 8);
+    EXPECT_THROW(writer.WriteRows(pcg::Image<pcg::Rgba16>(3001, 1)
+        .GetDataPointer(), 1), pcg::IllegalArgumentException);
+    const int counts[] = {1, 2, 300, 345, 17, 1, 334};
+    for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); ++k) {
+        writer.WriteRows(img.GetScanlinePointer(writer.RowsWritten()),
+            counts[k]);
+    }
+    ASSERT_EQ(1000, writer.RowsWritten());
+    EXPECT_THROW(writer.WriteRows(img.GetDataPointer(), 1),
+        pcg::IllegalArgumentException);
+    writer.Close();
+
+    PngData data;
+    ASSERT_TRUE(readPng(FILENAME, data));
+    checkPixels(img, data);
+
+    pcg::Image<pcg::Rgba8, pcg::BottomUp> imgBU(45, 33);
+    for (int j = 0; j < imgBU.Height(); ++j) {
+        for (int i = 0; i < imgBU.Width(); ++i) {
+            imgBU.ElementAt(i, j, pcg::TopDown).set(i, j, i + j);
+        }
+    }
+    pcg::PngIO::Save(imgBU, FILENAME);
+    ASSERT_TRUE(readPng(FILENAME, data));
+    for (int j = 0; j < imgBU.Height(); ++j) {
+        for (int i = 0; i < imgBU.Width(); ++i) {
+            const unsigned int *s = &data.samples[3 * (j*imgBU.Width() + i)];
+            ASSERT_EQ(static_cast<unsigned int>(i), s[0]);
+            ASSERT_EQ(static_cast<unsigned int>(j), s[1]);
+            ASSERT_EQ(static_cast<unsigned int>(i + j), s[2]);
+        }
+    }
+
+    pcg::PngWriter incomplete(FILENAME, 10, 10, 16);
+    EXPECT_THROW(incomplete.Close(), pcg::RuntimeException);
+    EXPECT_THROW(pcg::PngWriter(FILENAME, 10, 10, 12),
+        pcg::IllegalArgumentException);
+    remove(FILENAME);
+}
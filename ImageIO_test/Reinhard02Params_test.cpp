@@ -20,6 +20,7 @@
 #include <gtest/gtest.h>
 
 #include <Reinhard02.h>
+#include <Exception.h>
 #include <Image.h>
 #include <ImageSoA.h>
 
@@ -29,6 +30,7 @@
 #include "dSFMT/RandomMT.h"
 #include "tableau_f32.h"
 
+#include <algorithm>
 #include <cmath>
 
 
@@ -368,6 +370,51 @@ TEST_F(Reinhard02ParamsTest, HistogramKey)
 
 
 
+TEST_F(Reinhard02ParamsTest, Estimator)
+{
+    // The streaming estimator uses a coarser histogram for the percentiles
+    const float tol = 0.02f;
+    const int bandHeights[] = {1, 7, IMG_H};
+    for (int k = 0; k < 8; ++k) {
+        FloatImage img(IMG_W, IMG_H);
+        fillImage(img, k < 4 ? 8.0f : 1000.0f);
+        for (int i = 0; i < IMG_W; ++i) {
+            img[rnd.nextInt(img.Size())].setAll(k % 2 == 0 ? 0.0f : getNaN());
+        }
+        FloatImageSoA imgSoA(img);
+        const Reinhard02::Params ref = Reinhard02::EstimateParams(imgSoA);
+
+        const int bandHeight = bandHeights[k % 3];
+        Reinhard02::Estimator estimator;
+        for (int y = 0; y < IMG_H; y += bandHeight) {
+            const int rows = std::min(bandHeight, IMG_H - y);
+            FloatImageSoA band(IMG_W, rows);
+            for (int j = 0; j < rows; ++j) {
+                for (int i = 0; i < IMG_W; ++i) {
+                    const pcg::Rgba32F& p = img.ElementAt(i, y + j);
+                    band.ElementAt<FloatImageSoA::R>(i, j) = p.r();
+                    band.ElementAt<FloatImageSoA::G>(i, j) = p.g();
+                    band.ElementAt<FloatImageSoA::B>(i, j) = p.b();
+                    band.ElementAt<FloatImageSoA::A>(i, j) = p.a();
+                }
+            }
+            estimator.Accumulate(band);
+        }
+
+        const Reinhard02::Params p = estimator.Estimate();
+        EXPECT_NEAR (ref.key,     p.key,     tol * ref.key);
+        EXPECT_NEAR (ref.l_w,     p.l_w,     tol * ref.l_w);
+        EXPECT_NEAR (ref.l_white, p.l_white, tol * ref.l_white);
+        EXPECT_FLOAT_EQ (ref.l_min, p.l_min);
+        EXPECT_FLOAT_EQ (ref.l_max, p.l_max);
+    }
+
+    Reinhard02::Estimator empty;
+    EXPECT_THROW (empty.Estimate(), pcg::IllegalArgumentException);
+}
+
+
+
 TEST_F(Reinhard02ParamsTest, Benchmark)
 {
     {
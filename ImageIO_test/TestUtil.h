@@ -20,6 +20,9 @@
 
 #include <gtest/gtest.h>
 #include <Rgba32F.h>
+#include <ImageSoA.h>
+
+#include "dSFMT/RandomMT.h"
 
 #include <cmath>
 
@@ -42,6 +45,35 @@ inline bool TestClose (const pcg::Rgba32F &m, const pcg::Rgba32F &n) {
            floatClose(m.a(), n.a());
 }
 
+// Checks that pred holds for each pixel of expected and actual within the
+// region of size w x h whose top-left corner is (x,y)
+template <class Pred, class ImageT>
+::testing::AssertionResult RegionMatches(Pred pred, const ImageT &expected,
+    const ImageT &actual, int x, int y, int w, int h)
+{
+    for (int j = y; j < y + h; ++j) {
+        for (int i = x; i < x + w; ++i) {
+            if (!pred(expected.ElementAt(i, j), actual.ElementAt(i, j))) {
+                return ::testing::AssertionFailure()
+                    << "pixel (" << i << ',' << j << ')';
+            }
+        }
+    }
+    return ::testing::AssertionSuccess();
+}
+
+
+// Fills the image with random pixels, whose channels span different ranges.
+// Opaque images have all the alpha values set to one.
+inline void fillRandom(RGBAImageSoA &img, RandomMT &rnd, bool opaque = false)
+{
+    for (int i = 0; i < img.Size(); ++i) {
+        img.ElementAt<RGBAImageSoA::R>(i) = 100.0f * rnd.nextFloat();
+        img.ElementAt<RGBAImageSoA::G>(i) = rnd.nextFloat();
+        img.ElementAt<RGBAImageSoA::B>(i) = 0.01f * rnd.nextFloat();
+        img.ElementAt<RGBAImageSoA::A>(i) = opaque ? 1.0f : rnd.nextFloat();
+    }
+}
 
 
 // Online variance calulation by Knuth, referenced by Wikipedia [August 2012]
@@ -21,8 +21,11 @@
 
 #include "dSFMT/RandomMT.h"
 #include "Timer.h"
+#include "TestUtil.h"
 
 #include <ToneMapperSoA.h>
+#include <ImageComparator.h>
+#include <Exception.h>
 #include <ImageSoA.h>
 #include <Image.h>
 
@@ -50,6 +53,11 @@ bool PixelsClose(const pcg::Bgra8& p0, const pcg::Bgra8& p1)
     return areClose;
 }
 
+bool PixelsEqual(const pcg::Bgra8& p0, const pcg::Bgra8& p1)
+{
+    return p0.r == p1.r && p0.g == p1.g && p0.b == p1.b && p0.a == p1.a;
+}
+
 }
 
 
@@ -497,6 +505,180 @@ TEST_F(ToneMapperSoATest, Benchmark4K)
 
 
 
+// Tone mapping a region must produce the same pixels as tone mapping the
+// whole image, without touching the scanlines away from the region
+TEST_F(ToneMapperSoATest, Region)
+{
+    pcg::RGBAImageSoA img(203, 97);
+    fillRnd(img);
+    pcg::Image<pcg::Bgra8> outFull(img.Width(), img.Height());
+    pcg::Image<pcg::Bgra8> outRegion(img.Width(), img.Height());
+
+    pcg::ToneMapperSoA tm;
+    tm.SetExposure(-9.0f);
+    tm.ToneMap(outFull, img, pcg::EXPOSURE);
+
+    // Narrow regions go scanline by scanline, wide ones are contiguous
+    const int regions[][4] = {
+        {0, 0, 203, 97}, {37, 11, 61, 29}, {5, 40, 190, 3}, {202, 96, 1, 1},
+        {0, 50, 1, 47}, {17, 3, 0, 10}
+    };
+    const int numRegions = sizeof(regions) / sizeof(regions[0]);
+    pcg::Image<pcg::Bgra8> markers(img.Width(), img.Height());
+    for (int i = 0; i < markers.Size(); ++i) {
+        markers[i].set(1, 2, 3, 4);
+    }
+
+    for (int k = 0; k < numRegions; ++k) {
+        const int x = regions[k][0], y = regions[k][1];
+        const int w = regions[k][2], h = regions[k][3];
+        for (int i = 0; i < outRegion.Size(); ++i) {
+            outRegion[i] = markers[i];
+        }
+        tm.ToneMap(outRegion, img, x, y, w, h, pcg::EXPOSURE);
+
+        ASSERT_TRUE(pcg::RegionMatches(PixelsEqual, outFull, outRegion,
+            x, y, w, h)) << "Region " << k;
+        const int below = y + h + 1;
+        ASSERT_TRUE(pcg::RegionMatches(PixelsEqual, markers, outRegion,
+            0, 0, img.Width(), y - 1)) << "Region " << k;
+        ASSERT_TRUE(pcg::RegionMatches(PixelsEqual, markers, outRegion,
+            0, below, img.Width(), img.Height() - below)) << "Region " << k;
+    }
+
+    EXPECT_THROW(tm.ToneMap(outRegion, img, 200, 0, 4, 1),
+        pcg::IllegalArgumentException);
+    EXPECT_THROW(tm.ToneMap(outRegion, img, -1, 0, 4, 1),
+        pcg::IllegalArgumentException);
+}
+
+
+
+
+// Tone mapping the comparison of two images on the fly must match tone
+// mapping the result of ImageComparator, also within a region
+TEST_F(ToneMapperSoATest, Comparison)
+{
+    pcg::RGBAImageSoA img1(203, 97);
+    pcg::RGBAImageSoA img2(img1.Width(), img1.Height());
+    pcg::RGBAImageSoA diff(img1.Width(), img1.Height());
+    fillRnd(img1);
+    fillRnd(img2);
+    pcg::Image<pcg::Bgra8> expected(img1.Width(), img1.Height());
+    pcg::Image<pcg::Bgra8> actual(img1.Width(), img1.Height());
+
+    const pcg::ImageComparator::Type types[] = {
+        pcg::ImageComparator::AbsoluteDifference,
+        pcg::ImageComparator::Addition,
+        pcg::ImageComparator::Division,
+        pcg::ImageComparator::RelativeError,
+        pcg::ImageComparator::PositiveNegative,
+        pcg::ImageComparator::PositiveNegativeRelativeError
+    };
+    const int numTypes = sizeof(types) / sizeof(types[0]);
+
+    pcg::ToneMapperSoA tm;
+    tm.SetExposure(-6.0f);
+    for (int k = 0; k < numTypes; ++k) {
+        pcg::ImageComparator::Compare(types[k], diff, img1, img2);
+        tm.ToneMap(expected, diff, pcg::EXPOSURE);
+        tm.ToneMap(actual, img1, img2, types[k], pcg::EXPOSURE);
+        ASSERT_TRUE(pcg::RegionMatches(PixelsClose, expected, actual,
+            0, 0, img1.Width(), img1.Height())) << "Type " << types[k];
+
+        const int x = 37, y = 11, w = 61, h = 29;
+        tm.ToneMap(actual, img1, img2, types[k], x, y, w, h, pcg::EXPOSURE);
+        ASSERT_TRUE(pcg::RegionMatches(PixelsClose, expected, actual,
+            x, y, w, h)) << "Type " << types[k];
+    }
+
+    pcg::RGBAImageSoA other(img1.Width(), img1.Height() + 1);
+    EXPECT_THROW(tm.ToneMap(actual, img1, other,
+        pcg::ImageComparator::AbsoluteDifference),
+        pcg::IllegalArgumentException);
+    EXPECT_THROW(tm.ToneMap(actual, img1, img2,
+        pcg::ImageComparator::AbsoluteDifference, 200, 0, 4, 1),
+        pcg::IllegalArgumentException);
+}
+
+
+
+
+
+// The other pixel types and scanline orders must match the BGRA8 top-down
+// pixels, and the 16-bit pixels must be accurate to the last bit or so
+TEST_F(ToneMapperSoATest, PixelFormats)
+{
+    pcg::RGBAImageSoA img(203, 97);
+    fillRnd(img);
+    const int w = img.Width(), h = img.Height();
+    pcg::Image<pcg::Bgra8> expected(w, h);
+    pcg::Image<pcg::Bgra8, pcg::BottomUp> outBgra8BU(w, h);
+    pcg::Image<pcg::Rgba8> outRgba8(w, h);
+    pcg::Image<pcg::Rgba8, pcg::BottomUp> outRgba8BU(w, h);
+    pcg::Image<pcg::Rgba16> outRgba16(w, h);
+    pcg::Image<pcg::Rgba16, pcg::BottomUp> outRgba16BU(w, h);
+
+    const float exposure = -9.0f;
+    const float multiplier = std::pow(2.0f, exposure);
+    pcg::ToneMapperSoA tm;
+    tm.SetExposure(exposure);
+
+    for (int useSRGB = 0; useSRGB < 2; ++useSRGB) {
+        tm.SetSRGB(useSRGB != 0);
+        tm.ToneMap(expected, img, pcg::EXPOSURE);
+        tm.ToneMap(outBgra8BU, img, pcg::EXPOSURE);
+        tm.ToneMap(outRgba8, img, pcg::EXPOSURE);
+        tm.ToneMap(outRgba8BU, img, pcg::EXPOSURE);
+        tm.ToneMap(outRgba16, img, pcg::EXPOSURE);
+        tm.ToneMap(outRgba16BU, img, pcg::EXPOSURE);
+
+        for (int j = 0; j < h; ++j) {
+            for (int i = 0; i < w; ++i) {
+                const pcg::Bgra8& p = expected.ElementAt(i, j);
+                ASSERT_PRED2(PixelsEqual, p,
+                    outBgra8BU.ElementAt(i, j, pcg::TopDown));
+
+                const pcg::Rgba8& q = outRgba8.ElementAt(i, j);
+                const pcg::Rgba8& qBU =
+                    outRgba8BU.ElementAt(i, j, pcg::TopDown);
+                ASSERT_TRUE(p.r == q.r && p.g == q.g && p.b == q.b &&
+                    p.a == q.a) << "Pixel (" << i << ',' << j << ')';
+                ASSERT_TRUE(q.r == qBU.r && q.g == qBU.g && q.b == qBU.b &&
+                    q.a == qBU.a) << "Pixel (" << i << ',' << j << ')';
+
+                const pcg::Rgba32F pixel = img[j * w + i];
+                const float vals[] = {pixel.r(), pixel.g(), pixel.b()};
+                const pcg::Rgba16& p16 = outRgba16.ElementAt(i, j);
+                const pcg::Rgba16& p16BU =
+                    outRgba16BU.ElementAt(i, j, pcg::TopDown);
+                const int actual[] = {p16.r, p16.g, p16.b};
+                for (int c = 0; c < 3; ++c) {
+                    float x = std::min(multiplier * vals[c], 1.0f);
+                    if (useSRGB) {
+                        x = x > 0.0031308f ?
+                            1.055f * std::pow(x, 1.0f/2.4f) - 0.055f :
+                            12.92f * x;
+                    } else {
+                        x = std::pow(x, 1.0f / 2.2f);
+                    }
+                    ASSERT_NEAR(65535.0f * x, actual[c], 2.0f)
+                        << "Pixel (" << i << ',' << j << "), channel " << c;
+                }
+                ASSERT_NEAR(65535.0f * pixel.a(), p16.a, 1.0f);
+                ASSERT_TRUE(p16.r == p16BU.r && p16.g == p16BU.g &&
+                    p16.b == p16BU.b && p16.a == p16BU.a)
+                    << "Pixel (" << i << ',' << j << ')';
+            }
+        }
+    }
+
+    pcg::Image<pcg::Rgba16> wrongSize(w + 1, h);
+    EXPECT_THROW(tm.ToneMap(wrongSize, img), pcg::IllegalArgumentException);
+}
+
+
+
 class ToneMapperSoATestSRGB :
     public ::testing::TestWithParam<pcg::ToneMapperSoA::ESRGBMethod>
 {
@@ -0,0 +1,340 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <ZipFile.h>
+
+#include "dSFMT/RandomMT.h"
+
+#include <gtest/gtest.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+const char *FILENAME = "test-zipstream.zip";
+
+// Distance between the access points of the deflated entries
+const size_t SPAN = 1048576;
+
+// Entry to write into the test zip file
+struct Entry
+{
+    std::string name;
+    int method;
+    std::string data;
+    std::string compressed;
+    unsigned long crc;
+    unsigned long offset;
+};
+
+void put16(std::string &s, unsigned int v)
+{
+    s += static_cast<char>(v & 0xFF);
+    s += static_cast<char>((v >> 8) & 0xFF);
+}
+
+void put32(std::string &s, unsigned long v)
+{
+    put16(s, v & 0xFFFF);
+    put16(s, (v >> 16) & 0xFFFF);
+}
+
+// Raw deflate data, as stored in zip files
+std::string deflateRaw(const std::string &data)
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+        Z_DEFAULT_STRATEGY) != Z_OK) {
+        return std::string();
+    }
+    std::vector<char> out(deflateBound(&strm, data.size()));
+    strm.next_in   = (Bytef*) data.data();
+    strm.avail_in  = static_cast<uInt>(data.size());
+    strm.next_out  = (Bytef*) &out[0];
+    strm.avail_out = static_cast<uInt>(out.size());
+    const int ret = deflate(&strm, Z_FINISH);
+    const size_t count = out.size() - strm.avail_out;
+    deflateEnd(&strm);
+    return ret == Z_STREAM_END ? std::string(&out[0], count) : std::string();
+}
+
+void addEntry(std::vector<Entry> &entries, const char *name, int method,
+    const std::string &data)
+{
+    Entry e;
+    e.name = name;
+    e.method = method;
+    e.data = data;
+    e.compressed = method == Z_DEFLATED ? deflateRaw(data) : data;
+    e.crc = crc32(crc32(0L, Z_NULL, 0),
+        (const Bytef*) data.data(), static_cast<uInt>(data.size()));
+    e.offset = 0;
+    entries.push_back(e);
+}
+
+// Writes the local headers, the data and the central directory
+void writeZip(const char *filename, std::vector<Entry> &entries)
+{
+    std::string zip;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry &e = entries[i];
+        e.offset = static_cast<unsigned long>(zip.size());
+        put32(zip, 0x04034b50);
+        put16(zip, 20);
+        put16(zip, 0);
+        put16(zip, e.method);
+        put16(zip, 0);
+        put16(zip, 0x21);
+        put32(zip, e.crc);
+        put32(zip, static_cast<unsigned long>(e.compressed.size()));
+        put32(zip, static_cast<unsigned long>(e.data.size()));
+        put16(zip, static_cast<unsigned int>(e.name.size()));
+        put16(zip, 0);
+        zip += e.name;
+        zip += e.compressed;
+    }
+
+    const unsigned long dirOffset = static_cast<unsigned long>(zip.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const Entry &e = entries[i];
+        put32(zip, 0x02014b50);
+        put16(zip, 20);
+        put16(zip, 20);
+        put16(zip, 0);
+        put16(zip, e.method);
+        put16(zip, 0);
+        put16(zip, 0x21);
+        put32(zip, e.crc);
+        put32(zip, static_cast<unsigned long>(e.compressed.size()));
+        put32(zip, static_cast<unsigned long>(e.data.size()));
+        put16(zip, static_cast<unsigned int>(e.name.size()));
+        put16(zip, 0);
+        put16(zip, 0);
+        put16(zip, 0);
+        put16(zip, 0);
+        put32(zip, 0);
+        put32(zip, e.offset);
+        zip += e.name;
+    }
+    const unsigned long dirSize =
+        static_cast<unsigned long>(zip.size()) - dirOffset;
+
+    put32(zip, 0x06054b50);
+    put16(zip, 0);
+    put16(zip, 0);
+    put16(zip, static_cast<unsigned int>(entries.size()));
+    put16(zip, static_cast<unsigned int>(entries.size()));
+    put32(zip, dirSize);
+    put32(zip, dirOffset);
+    put16(zip, 0);
+
+    std::ofstream os(filename, std::ios_base::binary);
+    os.write(zip.data(), zip.size());
+}
+
+// Text-like data from a small alphabet, which deflates into many blocks
+std::string randomData(RandomMT &rnd, size_t size)
+{
+    std::string data(size, ' ');
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<char>('a' + rnd.nextInt(20));
+    }
+    return data;
+}
+
+std::string readAll(std::istream &is)
+{
+    std::string data;
+    char buffer[10000];
+    while (is.read(buffer, sizeof(buffer)) || is.gcount() > 0) {
+        data.append(buffer, static_cast<size_t>(is.gcount()));
+    }
+    return data;
+}
+
+const pcg::ZipEntry* findEntry(pcg::ZipFile &zip, const char *name)
+{
+    for (pcg::ZipFile::const_iterator it = zip.begin(); it != zip.end(); ++it) {
+        if (strcmp((*it)->GetName(), name) == 0) {
+            return *it;
+        }
+    }
+    return NULL;
+}
+
+// Reads count bytes at position, seeking in the way given by the mode, and
+// checks them against the expected data
+::testing::AssertionResult readAt(std::istream &is, const std::string &data,
+    size_t position, size_t count, int mode)
+{
+    const std::streamoff pos = static_cast<std::streamoff>(position);
+    const std::streamoff size = static_cast<std::streamoff>(data.size());
+    is.clear();
+    switch (mode) {
+    case 0:
+        is.seekg(pos);
+        break;
+    case 1:
+        is.seekg(pos - static_cast<std::streamoff>(is.tellg()),
+            std::ios_base::cur);
+        break;
+    default:
+        is.seekg(pos - size, std::ios_base::end);
+        break;
+    }
+    if (static_cast<std::streamoff>(is.tellg()) != pos) {
+        return ::testing::AssertionFailure() << "tellg after seeking to "
+            << position;
+    }
+
+    std::vector<char> buffer(count + 1);
+    is.read(&buffer[0], count);
+    const size_t expected = std::min(count, data.size() - position);
+    if (static_cast<size_t>(is.gcount()) != expected) {
+        return ::testing::AssertionFailure() << "read " << is.gcount()
+            << " bytes at " << position << ", expected " << expected;
+    }
+    if (data.compare(position, expected, &buffer[0], expected) != 0) {
+        return ::testing::AssertionFailure() << "different bytes at "
+            << position;
+    }
+    return ::testing::AssertionSuccess();
+}
+
+
+
+class ZipStreamTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp() {
+        RandomMT rnd(0x2a7e51c3);
+        std::vector<Entry> entries;
+        addEntry(entries, "small.txt", Z_DEFLATED, randomData(rnd, 1000));
+        addEntry(entries, "deflated.txt", Z_DEFLATED,
+            randomData(rnd, 6 * SPAN + 12345));
+        addEntry(entries, "stored.txt", 0, randomData(rnd, SPAN + 777));
+        writeZip(FILENAME, entries);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            m_data.push_back(entries[i].data);
+        }
+    }
+
+    virtual void TearDown() {
+        remove(FILENAME);
+    }
+
+    // Seeks to random positions, forwards and backwards, and compares the
+    // bytes with the ones from the sequential read
+    void randomSeeks(const char *name, const std::string &sequential)
+    {
+        pcg::ZipFile zip(FILENAME);
+        const pcg::ZipEntry *entry = findEntry(zip, name);
+        ASSERT_TRUE(entry != NULL);
+        pcg::ZipEntryReader reader(zip, entry);
+        std::istream &is = reader.GetInputStream();
+        const size_t size = sequential.size();
+
+        // Straight to the end, then back over each access point
+        ASSERT_TRUE(readAt(is, sequential, size - 100, 100, 0));
+        for (size_t p = (size / SPAN) * SPAN; p >= SPAN; p -= SPAN) {
+            ASSERT_TRUE(readAt(is, sequential, p - 5000, 10000, 0)) << p;
+        }
+        ASSERT_TRUE(readAt(is, sequential, 0, 100, 2));
+
+        RandomMT rnd(0x5eec0ff5);
+        for (int i = 0; i < 200; ++i) {
+            const size_t position = rnd.nextInt(static_cast<unsigned>(size));
+            const size_t count = 1 + rnd.nextInt(3 * 32768);
+            const int mode = static_cast<int>(rnd.nextInt(3));
+            ASSERT_TRUE(readAt(is, sequential, position, count, mode))
+                << "Iteration " << i << ", mode " << mode;
+        }
+
+        // Reading at the end of the entry only sets eof
+        is.clear();
+        is.seekg(0, std::ios_base::end);
+        EXPECT_EQ(static_cast<std::streamoff>(size),
+            static_cast<std::streamoff>(is.tellg()));
+        EXPECT_EQ(std::char_traits<char>::eof(), is.get());
+        is.clear();
+
+        // Seeking outside of the entry fails
+        is.seekg(static_cast<std::streamoff>(size + 1));
+        EXPECT_TRUE(is.fail());
+    }
+
+    std::vector<std::string> m_data;
+};
+
+} // namespace
+
+
+
+TEST_F(ZipStreamTest, Sequential)
+{
+    pcg::ZipFile zip(FILENAME);
+    ASSERT_EQ(3u, zip.size());
+    const char *names[] = {"small.txt", "deflated.txt", "stored.txt"};
+    for (int i = 0; i < 3; ++i) {
+        const pcg::ZipEntry *entry = findEntry(zip, names[i]);
+        ASSERT_TRUE(entry != NULL) << names[i];
+        EXPECT_EQ(m_data[i].size(), entry->GetSize());
+        const std::string data = readAll(zip.GetInputStream(entry));
+        EXPECT_TRUE(data == m_data[i]) << names[i];
+    }
+}
+
+
+
+TEST_F(ZipStreamTest, RandomSeekDeflated)
+{
+    std::string sequential;
+    {
+        pcg::ZipFile zip(FILENAME);
+        const pcg::ZipEntry *entry = findEntry(zip, "deflated.txt");
+        ASSERT_TRUE(entry != NULL);
+        ASSERT_EQ(Z_DEFLATED, entry->GetMethod());
+        pcg::ZipEntryReader reader(zip, entry);
+        sequential = readAll(reader.GetInputStream());
+    }
+    ASSERT_TRUE(sequential == m_data[1]);
+    randomSeeks("deflated.txt", sequential);
+}
+
+
+
+TEST_F(ZipStreamTest, RandomSeekStored)
+{
+    std::string sequential;
+    {
+        pcg::ZipFile zip(FILENAME);
+        const pcg::ZipEntry *entry = findEntry(zip, "stored.txt");
+        ASSERT_TRUE(entry != NULL);
+        pcg::ZipEntryReader reader(zip, entry);
+        sequential = readAll(reader.GetInputStream());
+    }
+    ASSERT_TRUE(sequential == m_data[2]);
+    randomSeeks("stored.txt", sequential);
+}
@@ -14,6 +14,9 @@
 ============================================================================*/
 
 #include <rgbe.h>
+#include <RgbeIO.h>
+#include <Image.h>
+#include <ImageSoA.h>
 
 #include "dSFMT/RandomMT.h"
 #include "Timer.h"
@@ -26,6 +29,9 @@
 #include <iostream>
 #include <memory>
 #include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
 #include <algorithm>
 
 
@@ -307,6 +313,78 @@ bool equals (const pcg::Rgbe &m, const pcg::Rgbe &n) {
 }
 
 
+
+// Reference run length encoder by Bruce Walter, writing into a vector
+void writeBytes_RLE(std::vector<unsigned char> &out,
+                    const unsigned char *data, int numbytes)
+{
+    int cur, beg_run, run_count, old_run_count, nonrun_count;
+    const int MINRUNLENGTH = 4;
+
+    cur = 0;
+    while(cur < numbytes) {
+        beg_run = cur;
+        /* find next run of length at least 4 if one exists */
+        run_count = old_run_count = 0;
+        while((run_count < MINRUNLENGTH) && (beg_run < numbytes)) {
+            beg_run += run_count;
+            old_run_count = run_count;
+            run_count = 1;
+            while((beg_run + run_count < numbytes) && (run_count < 127)
+                && (data[beg_run] == data[beg_run + run_count]))
+                run_count++;
+        }
+        /* if data before next big run is a short run then write it as such */
+        if ((old_run_count > 1)&&(old_run_count == beg_run - cur)) {
+            out.push_back(static_cast<unsigned char>(128 + old_run_count));
+            out.push_back(data[cur]);
+            cur = beg_run;
+        }
+        /* write out bytes until we reach the start of the next run */
+        while(cur < beg_run) {
+            nonrun_count = beg_run - cur;
+            if (nonrun_count > 128)
+                nonrun_count = 128;
+            out.push_back(static_cast<unsigned char>(nonrun_count));
+            out.insert(out.end(), data + cur, data + cur + nonrun_count);
+            cur += nonrun_count;
+        }
+        /* write out next run if one was found */
+        if (run_count >= MINRUNLENGTH) {
+            out.push_back(static_cast<unsigned char>(128 + run_count));
+            out.push_back(data[beg_run]);
+            cur += run_count;
+        }
+    }
+}
+
+
+
+// Input stream buffer which cannot seek, handing out a few bytes at a time
+// as a pipe would
+class ForwardStreamBuf : public std::streambuf
+{
+public:
+    ForwardStreamBuf(const std::string &data) : m_data(data), m_pos(0) {}
+
+protected:
+    virtual int_type underflow() {
+        if (m_pos >= m_data.size()) {
+            return traits_type::eof();
+        }
+        const size_t count = std::min(m_data.size() - m_pos, size_t(7));
+        char *begin = const_cast<char*>(m_data.data()) + m_pos;
+        setg(begin, begin, begin + count);
+        m_pos += count;
+        return traits_type::to_int_type(*begin);
+    }
+
+private:
+    const std::string m_data;
+    size_t m_pos;
+};
+
+
 } // namespace
 
 
@@ -579,3 +657,159 @@ TEST_F(RgbeTest, Performance2Float)
 
     std::return_temporary_buffer (P.first);
 }
+
+
+
+// Write random images with long runs and read them back through the RLE path
+TEST_F(RgbeTest, RoundTripRLE)
+{
+    const int sizes[][2] = {{640, 480}, {1023, 77}, {5, 9}, {8, 1}};
+    for (size_t n = 0; n < sizeof(sizes)/sizeof(sizes[0]); ++n) {
+        const int width  = sizes[n][0];
+        const int height = sizes[n][1];
+        pcg::Image<pcg::Rgbe, pcg::TopDown> expected(width, height);
+        for (int i = 0; i < expected.Size(); ++i) {
+            const unsigned char r = static_cast<unsigned char>(
+                (i/16) % 3 == 0 ? 64 : rnd.nextInt() & 0xFF);
+            const unsigned char g = static_cast<unsigned char>(
+                rnd.nextInt() & 0x3);
+            const unsigned char b = static_cast<unsigned char>((i/40) & 0xFF);
+            const unsigned char e = static_cast<unsigned char>(
+                128 + (rnd.nextInt() & 0x1));
+            expected[i] = pcg::Rgbe(r, g, b, e);
+        }
+
+        std::stringstream stream;
+        pcg::RgbeIO::Save(expected, stream);
+        const std::string data = stream.str();
+
+        pcg::Image<pcg::Rgbe, pcg::TopDown> result;
+        std::istringstream is(data);
+        pcg::RgbeIO::Load(result, is);
+        ASSERT_EQ(width,  result.Width());
+        ASSERT_EQ(height, result.Height());
+
+        pcg::Image<pcg::Rgba32F, pcg::BottomUp> resultF;
+        std::istringstream isF(data);
+        pcg::RgbeIO::Load(resultF, isF);
+        ASSERT_EQ(width,  resultF.Width());
+        ASSERT_EQ(height, resultF.Height());
+
+        pcg::RGBAImageSoA resultSoA;
+        std::istringstream isSoA(data);
+        pcg::RgbeIO::Load(resultSoA, isSoA);
+        ASSERT_EQ(width,  resultSoA.Width());
+        ASSERT_EQ(height, resultSoA.Height());
+
+        for (int j = 0; j < height; ++j) {
+            for (int i = 0; i < width; ++i) {
+                const pcg::Rgbe& v = expected.ElementAt(i, j);
+                ASSERT_PRED2(equals, v, result.ElementAt(i, j));
+                const pcg::Rgba32F vF = v;
+                ASSERT_RGBA32F_EQ(vF, resultF.ElementAt(i, j, pcg::TopDown));
+
+                const int idx = j*width + i;
+                const pcg::Rgba32F vSoA(
+                    resultSoA.GetDataPointer<pcg::RGBAImageSoA::R>()[idx],
+                    resultSoA.GetDataPointer<pcg::RGBAImageSoA::G>()[idx],
+                    resultSoA.GetDataPointer<pcg::RGBAImageSoA::B>()[idx],
+                    resultSoA.GetDataPointer<pcg::RGBAImageSoA::A>()[idx]);
+                ASSERT_RGBA32F_EQ(vF, vSoA);
+            }
+        }
+    }
+}
+
+
+
+// The encoded pixels must match the reference encoder byte by byte
+TEST_F(RgbeTest, EncodeRLEReference)
+{
+    const int width = 1000, height = 37;
+    pcg::Image<pcg::Rgbe, pcg::TopDown> img(width, height);
+    for (int i = 0; i < img.Size(); ++i) {
+        // Mix runs of every length with noise
+        const int runLen = 1 + (i / 200) % 140;
+        const unsigned char r = static_cast<unsigned char>((i / runLen) & 0x7);
+        const unsigned char g = static_cast<unsigned char>(
+            (i % 97) < 50 ? 3 : rnd.nextInt() & 0xFF);
+        const unsigned char b = static_cast<unsigned char>(rnd.nextInt() & 0x1);
+        const unsigned char e = static_cast<unsigned char>(
+            (i / 300) % 2 == 0 ? 130 : 120 + (rnd.nextInt() % 3));
+        img[i] = pcg::Rgbe(r, g, b, e);
+    }
+
+    std::vector<unsigned char> expected;
+    std::vector<unsigned char> channel(width);
+    for (int j = 0; j < height; ++j) {
+        expected.push_back(2);
+        expected.push_back(2);
+        expected.push_back(static_cast<unsigned char>(width >> 8));
+        expected.push_back(static_cast<unsigned char>(width & 0xFF));
+        for (int c = 0; c < 4; ++c) {
+            for (int i = 0; i < width; ++i) {
+                channel[i] = img.ElementAt(i, j)[c];
+            }
+            writeBytes_RLE(expected, &channel[0], width);
+        }
+    }
+
+    std::stringstream stream;
+    pcg::RgbeIO::Save(img, stream);
+    const std::string data = stream.str();
+    const std::string sizeLine("-Y 37 +X 1000\n");
+    const size_t pos = data.find(sizeLine);
+    ASSERT_NE(std::string::npos, pos);
+    const std::string pixels = data.substr(pos + sizeLine.size());
+    ASSERT_EQ(expected.size(), pixels.size());
+    ASSERT_TRUE(std::equal(expected.begin(), expected.end(),
+        reinterpret_cast<const unsigned char*>(pixels.data())));
+}
+
+
+
+// Files followed by other data, as in containers or pipes: each load has to
+// stop right after the last scanline, leaving the stream ready to continue
+TEST_F(RgbeTest, TrailingData)
+{
+    const int sizes[][2] = {{300, 20}, {5, 9}, {64, 3}};
+    const size_t numImages = sizeof(sizes)/sizeof(sizes[0]);
+    pcg::Image<pcg::Rgbe, pcg::TopDown> expected[numImages];
+    std::stringstream stream;
+    for (size_t n = 0; n < numImages; ++n) {
+        expected[n].Alloc(sizes[n][0], sizes[n][1]);
+        for (int i = 0; i < expected[n].Size(); ++i) {
+            const unsigned char v = static_cast<unsigned char>(
+                (i/8) % 2 == 0 ? 100 : rnd.nextInt() & 0xFF);
+            expected[n][i] = pcg::Rgbe(v, v,
+                static_cast<unsigned char>(rnd.nextInt() & 0xFF), 130);
+        }
+        pcg::RgbeIO::Save(expected[n], stream);
+    }
+    const std::string trailer("Not an RGBE file");
+    stream << trailer;
+    const std::string data = stream.str();
+
+    for (int seekable = 0; seekable < 2; ++seekable) {
+        ForwardStreamBuf forwardBuf(data);
+        std::istream forward(&forwardBuf);
+        std::istringstream sstream(data);
+        std::istream &is = seekable ? static_cast<std::istream&>(sstream) :
+            forward;
+
+        for (size_t n = 0; n < numImages; ++n) {
+            pcg::Image<pcg::Rgbe, pcg::TopDown> result;
+            pcg::RgbeIO::Load(result, is);
+            ASSERT_TRUE(is.good()) << "Image " << n << ", seekable " << seekable;
+            ASSERT_EQ(expected[n].Width(),  result.Width());
+            ASSERT_EQ(expected[n].Height(), result.Height());
+            for (int i = 0; i < result.Size(); ++i) {
+                ASSERT_PRED2(equals, expected[n][i], result[i]);
+            }
+        }
+
+        std::string rest;
+        std::getline(is, rest);
+        EXPECT_EQ(trailer, rest) << "seekable " << seekable;
+    }
+}
@@ -0,0 +1,97 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ ----------------------------------------------------------------------------- 
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "BandToneMapper.h"
+#include "ToneMappingFilter.h"
+
+#include <LoadHDR.h>
+#include <PngIO.h>
+
+#include <QString>
+
+#include <algorithm>
+#include <cassert>
+
+
+namespace
+{
+
+// Tone maps every band of the reader and appends it to the PNG file
+template <class T>
+void toneMapBands(pcg::ScanlineReader &reader, const ToneMapperSoA &tm,
+                  pcg::TmoTechnique technique, int bandHeight,
+                  pcg::PngWriter &writer)
+{
+    pcg::RGBAImageSoA band;
+    pcg::Image<T> ldrBand;
+    for (int y = 0; y < reader.Height(); y += bandHeight) {
+        const int rows = std::min(bandHeight, reader.Height() - y);
+        reader.Read(band, y, rows);
+        if (ldrBand.Height() != rows) {
+            ldrBand.Alloc(reader.Width(), rows);
+        }
+        tm.ToneMap(ldrBand, band, technique);
+        writer.WriteRows(ldrBand.GetDataPointer(), rows);
+    }
+}
+
+} // namespace
+
+
+
+BandToneMapper::BandToneMapper(const ToneMapperSoA &toneMapper, bool useBpp16,
+                               int bandHeight, pcg::TmoTechnique technique,
+                               float k, float wp, float lw) :
+toneMapper(toneMapper), useBpp16(useBpp16), bandHeight(bandHeight),
+technique(technique), key(k), whitePoint(wp), logLumAvg(lw)
+{
+    assert(bandHeight > 0);
+}
+
+
+void BandToneMapper::process(const QString &filename,
+                             const QString &outname) const
+{
+    pcg::ScanlineReader reader(filename.toLocal8Bit());
+
+    ToneMapperSoA tm(toneMapper);
+    if (technique == pcg::REINHARD02) {
+        const float autoParam = ToneMappingFilter::AutoParam();
+        pcg::Reinhard02::Params params;
+        if (key == autoParam || whitePoint == autoParam ||
+            logLumAvg == autoParam) {
+            pcg::Reinhard02::Estimator estimator;
+            pcg::RGBAImageSoA band;
+            for (int y = 0; y < reader.Height(); y += bandHeight) {
+                reader.Read(band, y, std::min(bandHeight, reader.Height()-y));
+                estimator.Accumulate(band);
+            }
+            params = estimator.Estimate();
+        }
+        if (key        != autoParam) params.key     = key;
+        if (whitePoint != autoParam) params.l_white = whitePoint;
+        if (logLumAvg  != autoParam) params.l_w     = logLumAvg;
+        tm.SetParams(params);
+    }
+
+    pcg::PngWriter writer(outname.toLocal8Bit(), reader.Width(),
+        reader.Height(), useBpp16 ? 16 : 8, tm.isSRGB(), tm.InvGamma());
+    if (!useBpp16) {
+        toneMapBands<pcg::Rgba8>(reader, tm, technique, bandHeight, writer);
+    } else {
+        toneMapBands<pcg::Rgba16>(reader, tm, technique, bandHeight, writer);
+    }
+    writer.Close();
+}
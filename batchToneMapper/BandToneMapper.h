@@ -0,0 +1,55 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ ----------------------------------------------------------------------------- 
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// Tone mapping of huge images in bands of scanlines, so that neither the HDR
+// image nor the LDR one are ever in memory as a whole
+
+#if !defined(BANDTONEMAPPER_H)
+#define BANDTONEMAPPER_H
+
+#include <ToneMapperSoA.h>
+
+class QString;
+
+using pcg::ToneMapperSoA;
+
+
+class BandToneMapper
+{
+public:
+    // The parameters have the same meaning as in ToneMappingFilter. Each
+    // band has bandHeight scanlines, except maybe the last one.
+    BandToneMapper(const ToneMapperSoA &toneMapper, bool useBpp16,
+        int bandHeight, pcg::TmoTechnique technique,
+        float key, float whitePoint, float logLumAvg);
+
+    // Tone maps the HDR file into the PNG file outname, one band at a time.
+    // The Reinhard02 parameters which are not set get estimated by a first
+    // pass over the bands. Then each band is read, tone mapped and handed
+    // over to the PNG writer, which deflates it in the background while the
+    // next band gets decoded. Throws an exception if anything fails.
+    void process(const QString &filename, const QString &outname) const;
+
+private:
+    const ToneMapperSoA &toneMapper;
+    const bool useBpp16;
+    const int bandHeight;
+    const pcg::TmoTechnique technique;
+    const float key;
+    const float whitePoint;
+    const float logLumAvg;
+};
+
+#endif /* BANDTONEMAPPER_H */
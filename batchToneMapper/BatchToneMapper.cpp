@@ -22,8 +22,11 @@
 #include "FileInputFilter.h"
 #include "ZipfileInputFilter.h"
 #include "ToneMappingFilter.h"
+#include "BandToneMapper.h"
+#include "FloatImageProcessor.h"
 
 #include <HDRITools_version.h>
+#include <ImageBufferPool.h>
 #include <QString>
 
 #include <cstdio>
@@ -32,6 +35,27 @@ namespace
 {
 QTextStream qcerr(stderr, QIODevice::WriteOnly);
 QTextStream qcout(stdout, QIODevice::WriteOnly);
+
+// While the pipeline runs the image buffer pool keeps the buffers of the
+// finished tokens for the next ones: each token holds at most the HDR image
+// and the LDR image. Afterwards the previous setting is restored, which
+// frees the cached buffers.
+class PooledImageBuffers
+{
+public:
+    explicit PooledImageBuffers(int tokens) :
+    m_previous(pcg::ImageBufferPool::MaxBuffers())
+    {
+        pcg::ImageBufferPool::SetMaxBuffers(2 * static_cast<size_t>(tokens));
+    }
+
+    ~PooledImageBuffers() {
+        pcg::ImageBufferPool::SetMaxBuffers(m_previous);
+    }
+
+private:
+    const size_t m_previous;
+};
 }
 
 using namespace std;
@@ -43,7 +67,7 @@ QString BatchToneMapper::version;
 
 BatchToneMapper::BatchToneMapper(const QStringList& files, bool bpp16) :
 offset(0), format(!bpp16 ? getDefaultFormat() : "png"),
-toneMapper(LUT_SIZE), tokens(0), useBpp16(bpp16), technique(pcg::EXPOSURE),
+toneMapper(), tokens(0), bandHeight(0), useBpp16(bpp16), technique(pcg::EXPOSURE),
 key(ToneMappingFilter::AutoParam()),whitePoint(ToneMappingFilter::AutoParam()),
 logLumAvg(ToneMappingFilter::AutoParam())
 {
@@ -110,7 +134,15 @@ void BatchToneMapper::execute() {
     }
 
     if (!hdrFiles.isEmpty()) {
-        executeHdr();
+        if (bandHeight > 0 && format != "png") {
+            qcerr << "Warning: bands require the png format, processing "
+                     "whole images instead." << endl;
+            executeHdr();
+        } else if (bandHeight > 0) {
+            executeHdrBands();
+        } else {
+            executeHdr();
+        }
         qcout << "All HDR files have been processed." << endl;
     }
 }
@@ -198,15 +230,17 @@ void BatchToneMapper::executeZip() {
     // Creates and uses a TBB pipeline
     tbb::pipeline pipeline;
 
-    // Adds the zip-reading filter
-    ZipfileInputFilter zipFilter(zipFiles, format, offset);
+    // Adds the zip-reading filter and the parallel entry loader
+    ZipfileInputFilter   zipFilter(zipFiles);
+    ZipEntryLoaderFilter loaderFilter(format, offset);
     pipeline.add_filter(zipFilter);
+    pipeline.add_filter(loaderFilter);
 
     // Adds the tone mapping filter
     ToneMappingFilter *toneFilter = createToneMappingFilter();
     pipeline.add_filter(*toneFilter);
 
-    
+    PooledImageBuffers pooledBuffers(tokens);
     pipeline.run(tokens);
 
     // Clears the filters after it's done
@@ -231,6 +265,7 @@ void BatchToneMapper::executeHdr() {
     ToneMappingFilter *toneFilter = createToneMappingFilter();
     pipeline.add_filter(*toneFilter);
 
+    PooledImageBuffers pooledBuffers(tokens);
     pipeline.run(tokens);
 
     // Clears the filters after it's done
@@ -239,10 +274,31 @@ void BatchToneMapper::executeHdr() {
 }
 
 
+void BatchToneMapper::executeHdrBands() {
+
+    // Huge files would not fit in memory several at once, thus they go one
+    // by one, each band being processed in parallel
+    BandToneMapper bandToneMapper(toneMapper, useBpp16, bandHeight,
+        technique, key, whitePoint, logLumAvg);
+    for (QStringList::const_iterator it = hdrFiles.constBegin();
+         it != hdrFiles.constEnd(); ++it) {
+        QString outname(*it);
+        FloatImageProcessor::setTargetName(outname, format, offset);
+        try {
+            bandToneMapper.process(*it, outname);
+            qcout << *it << " -> " << outname << endl;
+        }
+        catch (std::exception &e) {
+            qcerr << "Ooops! unable to tone map " << *it << ": "
+                  << e.what() << endl;
+        }
+    }
+}
+
+
 ostream& operator<<(ostream& os, const BatchToneMapper& b)
 {
-    os << "BatchToneMapper: LUT size " << BatchToneMapper::LUT_SIZE 
-       << ", using " << b.tokens << " pipeline tokens." << endl
+    os << "BatchToneMapper: using " << b.tokens << " pipeline tokens." << endl
        << "Conversion parameters:" << endl
        << "  Exposure:  " << b.toneMapper.Exposure() << endl
        << "  Gamma:     " ;
@@ -254,6 +310,9 @@ ostream& operator<<(ostream& os, const BatchToneMapper& b)
        os << b.toneMapper.Gamma() << endl;
     }
 
+    if (b.bandHeight > 0) {
+        os << "  Band:      " << b.bandHeight << " scanlines" << endl;
+    }
     os << "  Offset:    " << b.offset << endl
        << "  BPP:       " << (b.useBpp16 ? 16 : 8) << endl
        << "  Format:    " << b.format.toStdString() << endl;
@@ -26,7 +26,7 @@
 #include <QString>
 #include <QStringList>
 
-#include <ToneMapper.h>
+#include <ToneMapperSoA.h>
 
 class BatchToneMapper {
 
@@ -60,6 +60,14 @@ public:
     // Main method: once everything is setup, process the files
     void execute();
 
+    // Sets the number of scanlines per band to tone map the HDR files one at
+    // a time in bands, bounding the memory to a few bands instead of whole
+    // images. It only works with PNG output and zero disables it, which is
+    // the default.
+    void setBandHeight(int height) {
+        bandHeight = height;
+    }
+
     // Sets the offset for the filenames (it's zero by default)
     void setOffset(int newOffset) {
         offset = newOffset;
@@ -78,18 +86,19 @@ public:
 
 private:
 
-    const static int LUT_SIZE = 8192;
-
     // General parameters
     int offset;
     QString format;
 
     // Tone mapper
-    pcg::ToneMapper toneMapper;
+    pcg::ToneMapperSoA toneMapper;
 
     // Number of tokens in the pipeline
     int tokens;
 
+    // Scanlines per band, or zero to process whole images
+    int bandHeight;
+
     // Whether to use 16 bpp in the LDR files or the default 8
     const bool useBpp16;
 
@@ -123,6 +132,7 @@ private:
     // Individual pipelines
     void executeZip();
     void executeHdr();
+    void executeHdrBands();
 };
 
 
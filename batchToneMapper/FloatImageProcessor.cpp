@@ -17,8 +17,7 @@
 #include "ImageInfo.h"
 
 #include <istream>
-#include <Rgba32F.h>
-#include <Image.h>
+#include <ImageSoA.h>
 #include <RgbeIO.h>
 #include <OpenEXRIO.h>
 #include <PfmIO.h>
@@ -47,25 +46,26 @@ ImageInfo* FloatImageProcessor::load(const QString& filenameStr,
     // Local copy of the filename
     QString filename(filenameStr);
 
-    // Pointer with the result image
-    Image<Rgba32F> *floatImage = new Image<Rgba32F>();
+    // The result image, in SoA form for the tone mapper. Its buffer comes
+    // from the image buffer pool and goes to the ImageInfo without a copy.
+    RGBAImageSoA floatImage;
 
     // Tries to find the type of image based on the extension
     try {
         if (rgbeRegex.exactMatch(filename)) {
 
             // Creates the RGBE Image from the stream
-            RgbeIO::Load(*floatImage, is);
+            RgbeIO::Load(floatImage, is);
         }
         else if (exrRegex.exactMatch(filename)) {
 
             // Loads the OpenEXR file
-            OpenEXRIO::Load(*floatImage, is);
+            OpenEXRIO::Load(floatImage, is);
         }
         else if (pfmRegex.exactMatch(filename)) {
 
             // Loads the Pfm file
-            PfmIO::Load(*floatImage, is);
+            PfmIO::Load(floatImage, is);
         }
         else {
             qcerr << "Ooops! Unrecognized file : " << filename << endl;
@@ -78,7 +78,7 @@ ImageInfo* FloatImageProcessor::load(const QString& filenameStr,
         return new ImageInfo;
     }
 
-    assert(floatImage->Height() > 0 && floatImage->Width() > 0);
+    assert(floatImage.Height() > 0 && floatImage.Width() > 0);
 
     // Gets the output name
     setTargetName(filename, formatStr, offset);
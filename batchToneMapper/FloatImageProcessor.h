@@ -34,7 +34,6 @@ public:
     static ImageInfo* load(const QString& filenameStr, std::istream & is, 
         const QString& formatStr, int offset = 0);
 
-private:
     // To get the output filename it adds the offset (if it makes sense)
     // and changes the extension
     static void setTargetName(QString & filename, const QString & formatStr,
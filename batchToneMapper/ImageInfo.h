@@ -16,8 +16,7 @@
 #if !defined IMAGEINFO_H
 #define IMAGEINFO_H
 
-#include <Image.h>
-#include <Rgba32F.h>
+#include <ImageSoA.h>
 #include <QString>
 
 using namespace pcg;
@@ -25,24 +24,24 @@ using namespace pcg;
 /** Small Transfer object to pass info between the pipeline stages */
 
 struct ImageInfo {
-    const Image<Rgba32F> *img;
+    RGBAImageSoA img;
     const QString originalFile;
     const QString filename;
     const bool isValid;
 
-    ImageInfo(Image<Rgba32F> *image, const char *input, const char *outname) :
-        img(image), originalFile(input), filename(outname), isValid(true) {}
-
-    ImageInfo(Image<Rgba32F> *image, const QString &input, const QString &outname) :
-        img(image), originalFile(input), filename(outname), isValid(true) {}
-
-    ImageInfo() : img(NULL), isValid(false) {}
+    // Both constructors take the pixels of image without copying them,
+    // leaving it empty
+    ImageInfo(RGBAImageSoA &image, const char *input, const char *outname) :
+        originalFile(input), filename(outname), isValid(true) {
+        img.Swap(image);
+    }
 
-    ~ImageInfo() {
-        if (img != NULL) {
-            delete img;
-        }
+    ImageInfo(RGBAImageSoA &image, const QString &input, const QString &outname) :
+        originalFile(input), filename(outname), isValid(true) {
+        img.Swap(image);
     }
+
+    ImageInfo() : isValid(false) {}
 };
 
 #endif /* IMAGEINFO_H */
@@ -34,7 +34,7 @@ QMutex write_mutex;
 }
 
 
-ToneMappingFilter::ToneMappingFilter(ToneMapper &toneMapper, bool useBpp16) : 
+ToneMappingFilter::ToneMappingFilter(const ToneMapperSoA &toneMapper, bool useBpp16) : 
 filter(/*is_serial=*/false),
 toneMapper(toneMapper), useBpp16(useBpp16), technique(pcg::EXPOSURE),
 key(AutoParam()), whitePoint(AutoParam()), logLumAvg(AutoParam())
@@ -42,9 +42,9 @@ key(AutoParam()), whitePoint(AutoParam()), logLumAvg(AutoParam())
 }
 
 
-ToneMappingFilter::ToneMappingFilter(ToneMapper &toneMapper, bool useBpp16,
+ToneMappingFilter::ToneMappingFilter(const ToneMapperSoA &toneMapper, bool useBpp16,
                                      float k, float wp, float lw) :
-filter(/*is_serial=*/!isReinhard02Fixed(k, wp, lw)),
+filter(/*is_serial=*/false),
 toneMapper(toneMapper), useBpp16(useBpp16), technique(pcg::REINHARD02),
 key(k), whitePoint(wp), logLumAvg(lw)
 {
@@ -63,7 +63,10 @@ void* ToneMappingFilter::operator()(void* item)
             return NULL;
         }
 
-        const Image<Rgba32F> &floatImage = *(info->img);
+        // The tone mapper is a small value type: each image gets its own copy
+        // with its Reinhard02 parameters, leaving the shared one untouched
+        const RGBAImageSoA &floatImage = info->img;
+        ToneMapperSoA tm(toneMapper);
         if (technique == pcg::REINHARD02) {
             pcg::Reinhard02::Params params;
             if (isReinhard02Fixed()) {
@@ -76,13 +79,14 @@ void* ToneMappingFilter::operator()(void* item)
                 if (whitePoint != AutoParam()) params.l_white = whitePoint;
                 if (logLumAvg  != AutoParam()) params.l_w     = logLumAvg;
             }
-            toneMapper.SetParams(params);
+            tm.SetParams(params);
         }
 
-        // Allocates the LDR Image and tonemaps it
+        // Allocates the LDR Image and tonemaps it. For images of the same
+        // size its buffer is a warm one from the image buffer pool.
         if (!useBpp16) {
             Image<Bgra8> ldrImage(floatImage.Width(), floatImage.Height());
-            toneMapper.ToneMap(ldrImage, floatImage, true, technique);
+            tm.ToneMap(ldrImage, floatImage, technique);
 
             // Finally wraps the ldrImage into a QImage and saves it 
             // with the specified name
@@ -97,11 +101,11 @@ void* ToneMappingFilter::operator()(void* item)
         }
         else {
             Image<Rgba16> ldrImage(floatImage.Width(), floatImage.Height());
-            toneMapper.ToneMap(ldrImage, floatImage, technique);
+            tm.ToneMap(ldrImage, floatImage, technique);
 
             try {
                 PngIO::Save(ldrImage, info->filename.toLocal8Bit(),
-                    toneMapper.isSRGB(), toneMapper.InvGamma());
+                    tm.isSRGB(), tm.InvGamma());
             }
             catch (std::exception &e) {
                 cerr << "Ooops! unable to save " << info->filename << ": " << e.what() << endl;
@@ -16,20 +16,20 @@
 #if !defined(TONEMAPPINGFILTER_H)
 #define TONEMAPPINGFILTER_H
 
-#include <ToneMapper.h>
+#include <ToneMapperSoA.h>
 
 // TBB import for the filter stuff
 #include <tbb/pipeline.h>
 
 using tbb::filter;
-using pcg::ToneMapper;
+using pcg::ToneMapperSoA;
 
 // The class in charge of tone mapping. This guy is pretty transparent :)
 class ToneMappingFilter : public tbb::filter {
 
 private:
 
-    ToneMapper &toneMapper;
+    const ToneMapperSoA &toneMapper;
     const bool useBpp16;
     const pcg::TmoTechnique technique;
     const float key;
@@ -42,7 +42,7 @@ private:
             logLumAvg != AutoParam();
     }
 
-    inline bool isReinhard02Fixed() {
+    inline bool isReinhard02Fixed() const {
         return isReinhard02Fixed(key, whitePoint, logLumAvg);
     }
 
@@ -55,15 +55,14 @@ public:
 
     // By default the tone mapped images are RGB with 8 bpp. If the
     // useBpp16 is activated, the saved images will have instead 16 bpp.
-    // Note that this makes the tone mapping much slower, and so
-    // far the only supported format is PNG.
-    ToneMappingFilter(ToneMapper &toneMapper, bool useBpp16);
-
-    // Alternate constructor which uses the Reinhard02 TMO. Given the
-    // horribly obfuscated [pcg]ImageIO tonemapping API, unless all
-    // parameters are explicitly set the filter will have to become serial
-    // since the tone mapper doesn't support re-entrant TMO settings.
-    ToneMappingFilter(ToneMapper &toneMapper, bool useBpp16,
+    // So far the only supported format for those is PNG.
+    ToneMappingFilter(const ToneMapperSoA &toneMapper, bool useBpp16);
+
+    // Alternate constructor which uses the Reinhard02 TMO. The parameters
+    // which are not explicitly set get estimated for each image. The
+    // parameters go to a copy of the tone mapper for each image, thus the
+    // filter is always parallel.
+    ToneMappingFilter(const ToneMapperSoA &toneMapper, bool useBpp16,
         float key, float whitePoint, float logLumAvg);
 
     // This method receives pointers to ImageInfo structures.
@@ -48,14 +48,10 @@ struct ZipfileInputFilter::zipfile_t {
 };
 
 
-ZipfileInputFilter::ZipfileInputFilter(const QStringList &zipfiles, 
-                                       const QString &format,
-                                       int filenameOffset) :
+ZipfileInputFilter::ZipfileInputFilter(const QStringList &zipfiles) :
     filter(/*is_serial=*/true),
     zipfiles(zipfiles),
-    formatStr(format),
-    zipfile(NULL),
-    offset(filenameOffset)
+    zipfile(NULL)
 {
     filename = this->zipfiles.begin();
 }
@@ -113,8 +109,8 @@ void* ZipfileInputFilter::operator()(void*) {
     // Gets the next entry, this is also our condition to continue
     for(;;) {
         try {
-            // We try to load the file from the current entry, convert it into the
-            // suitable Rgba32F image and submit it to the next stage
+            // Only opens the reader of the current entry; the next stage
+            // loads the file from it, in parallel with the other entries
 
             ZipEntry *entry = nextEntry();
             if (entry == NULL) {
@@ -124,8 +120,8 @@ void* ZipfileInputFilter::operator()(void*) {
             // Make the target name relative to the parent of the zip file
             QString entryName = zipfile->cleanFilePath(entry->GetName());
 
-            return FloatImageProcessor::load(entryName, 
-                zipfile->zip->GetInputStream(entry), formatStr, offset);
+            return new entry_t(new ZipEntryReader(*zipfile->zip, entry),
+                entryName);
 
         }
         catch(std::exception &e) {
@@ -133,3 +129,32 @@ void* ZipfileInputFilter::operator()(void*) {
         }
     }
 }
+
+
+
+ZipEntryLoaderFilter::ZipEntryLoaderFilter(const QString &format,
+                                           int filenameOffset) :
+    tbb::filter(/*is_serial*/false),
+    formatStr(format),
+    offset(filenameOffset)
+{}
+
+
+void* ZipEntryLoaderFilter::operator()(void* arg)
+{
+    ZipfileInputFilter::entry_t *entry =
+        static_cast<ZipfileInputFilter::entry_t*>(arg);
+
+    // Converts the entry into the suitable SoA image for the next stage
+    ImageInfo *info = NULL;
+    try {
+        info = FloatImageProcessor::load(entry->name,
+            entry->reader->GetInputStream(), formatStr, offset);
+    }
+    catch(std::exception &e) {
+        cerr << "Ooops! " << e.what() << endl;
+        info = new ImageInfo;
+    }
+    delete entry;
+    return info;
+}
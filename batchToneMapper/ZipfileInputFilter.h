@@ -28,10 +28,12 @@ using std::vector;
 using std::string;
 using pcg::ZipFile;
 using pcg::ZipEntry;
+using pcg::ZipEntryReader;
 
 
-// Input filter class. It opens each zip file from the input and
-// sends it through the pipeline
+// Input filter class. It opens each zip file from the input and sends an
+// independent reader for each of its entries through the pipeline, so that
+// the entries are decompressed and decoded by the parallel loader filter
 class ZipfileInputFilter : public tbb::filter {
 
 private:
@@ -42,10 +44,6 @@ private:
     // The list of files to process
     const QStringList &zipfiles;
 
-    // The output format to use. It is assumed to be one of those returned by
-    // QImageWriter::supportedImageFormats() and lowercase
-    const QString formatStr;
-
     // Iterator to the list of files
     QStringList::const_iterator filename;
 
@@ -57,17 +55,46 @@ private:
 
     ZipEntry* nextEntry();
 
-    // The optional offset to add to the numeric filenames
-    const int offset;
-
 
 public:
-    ZipfileInputFilter(const QStringList &zipfiles, const QString &format, int filenameOffset = 0);
+    // Entry ready to be read, with its name relative to the parent of the
+    // zip file. It owns its reader.
+    struct entry_t {
+        ZipEntryReader *reader;
+        QString name;
+
+        entry_t(ZipEntryReader *entryReader, const QString &entryName) :
+            reader(entryReader), name(entryName) {}
+
+        ~entry_t() {
+            delete reader;
+        }
+    };
 
-    // This will be invoked serially, its job is to return pointers to the opened zipfiles.
-    // The next filter in the chain must close the zip files when it's done!
+    ZipfileInputFilter(const QStringList &zipfiles);
+
+    // This will be invoked serially, its job is to return pointers to new
+    // entry_t structures. The next filter in the chain must delete them!
     void* operator()(void*);
 };
 
 
+class ZipEntryLoaderFilter : public tbb::filter {
+
+public:
+    // The output format to use. It is assumed to be one of those returned by
+    // QImageWriter::supportedImageFormats() and lowercase
+    ZipEntryLoaderFilter(const QString &format, int filenameOffset = 0);
+
+    // The input of this filter are the entry_t* from ZipfileInputFilter,
+    // which get deleted here. It returns pointers to the proper ImageInfo
+    // structures, NOT null.
+    void* operator()(void* arg);
+
+protected:
+    const QString formatStr;
+    const int offset;
+};
+
+
 #endif /* ZIPFILEINPUTFILTER_H */
@@ -32,6 +32,7 @@
 # include <cmath>
 #endif
 
+#include <algorithm>
 #include <iostream>
 
 #include <tclap/CmdLine.h>
@@ -163,7 +164,8 @@ private:
 void parseArgs(float &exposure, bool &srgb, float &gamma, bool &bpp16,
                pcg::TmoTechnique &technique,
                float &key, float &whitePoint, float &logLumAvg,
-               int &offset, QString &format, QStringList &files) 
+               int &offset, int &bandHeight, QString &format,
+               QStringList &files) 
 {
     try {
 
@@ -248,6 +250,15 @@ void parseArgs(float &exposure, bool &srgb, float &gamma, bool &bpp16,
             "added to it for each final output file.",
             false, 0, "integer");
 
+        // Height of the bands for huge images
+        ValueArg<int> bandArg("b", "band",
+            "Band height. "
+            "When greater than zero the HDR files are tone mapped one at a "
+            "time in bands of this many scanlines, so that huge images never "
+            "get fully loaded in memory. It requires the png format and it "
+            "does not apply to the files within zip files (default 0).",
+            false, 0, "integer");
+
         // Output format constraint
         const QStringList & supportedFormatsQt = Util::supportedWriteImageFormats();
         vector<string> supportedFormats;
@@ -278,6 +289,7 @@ void parseArgs(float &exposure, bool &srgb, float &gamma, bool &bpp16,
         cmdline.add(keyArg);
         cmdline.xorAdd(srgbArg, gammaArg);
         cmdline.add(offsetArg);
+        cmdline.add(bandArg);
         cmdline.add(formatArg);
         cmdline.add(filesArg);
         
@@ -309,6 +321,7 @@ void parseArgs(float &exposure, bool &srgb, float &gamma, bool &bpp16,
         logLumAvg = logLumAvgArg.getValue();
 
         offset = offsetArg.getValue();
+        bandHeight = std::max(0, bandArg.getValue());
         format = QString::fromStdString(formatArg.getValue());
         bpp16  = format == Util::PNG16_FORMAT_STR;
         const vector<string> &filesUtf8 = filesArg.getValue();
@@ -349,6 +362,7 @@ int main(int argc, char* argv[])
 
     // Working parameters
     int offset;
+    int bandHeight;
     float exposure;
     bool srgb;
     bool bpp16;
@@ -360,7 +374,7 @@ int main(int argc, char* argv[])
 
     // Parses the arguments
     parseArgs(exposure, srgb, gamma, bpp16, technique,
-        key, whitePoint, logLumAvg, offset, format, files);
+        key, whitePoint, logLumAvg, offset, bandHeight, format, files);
 
     // Creates the batch tone mapper with those arguments
     BatchToneMapper batchToneMapper(files, bpp16);
@@ -375,6 +389,7 @@ int main(int argc, char* argv[])
         batchToneMapper.setReinhard02Params(key, whitePoint, logLumAvg);
     }
     batchToneMapper.setOffset(offset);
+    batchToneMapper.setBandHeight(bandHeight);
     batchToneMapper.setFormat(format);
 
     if( !batchToneMapper.hasWork() ) {
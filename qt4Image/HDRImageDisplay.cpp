@@ -14,6 +14,7 @@
 ============================================================================*/
 
 #include "HDRImageDisplay.h"
+#include "ToneMapWorker.h"
 
 #include "RgbeIO.h"
 #include "OpenEXRIO.h"
@@ -23,27 +24,40 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QPainter>
+#include <QPaintEvent>
 #include <QMouseEvent>
 #include <QApplication>
 #include <QClipboard>
 #include <QtDebug>
 
+#include <cstring>
 #include <fstream>
 
 
 
 HDRImageDisplay::HDRImageDisplay(QWidget *parent) : QWidget(parent), 
-    toneMapper(0.0f, 2.2f), dataProvider(hdrImage, ldrImage),
-    scaleFactor(1), needsToneMap(true), technique(EXPOSURE)
+    pyramid(hdrImage), otherPyramid(otherImage), comparing(false),
+    compareMethod(ImageComparator::AbsoluteDifference),
+    toneMapper(0.0f, 2.2f),
+    dataProvider(hdrImage, ldrImage), scaleFactor(1), technique(EXPOSURE),
+    toneMapGeneration(1), displayedGeneration(1), displayLevel(0)
 {
     // By default we want to receive events whenever the mouse moves around
     setMouseTracking(true);
+
+    toneMapWorker = new ToneMapWorker(this);
+    connect(toneMapWorker, SIGNAL(toneMapDone()), this, SLOT(updateToneMap()));
+    connect(toneMapWorker, SIGNAL(toneMapFailed(QString)),
+        this, SIGNAL(toneMapFailed(QString)));
+    toneMapWorker->start();
 }
 
 
 
 HDRImageDisplay::~HDRImageDisplay()
 {
+    // The worker might be still reading the HDR image
+    toneMapWorker->stop();
 }
 
 
@@ -55,30 +69,39 @@ bool HDRImageDisplay::open(const QString &fileName, HdrResult * result)
 
     try {
 
+        // The worker must be done with the current image before replacing it
+        toneMapWorker->cancel();
+
         // Try to load the image
         if (!loadHdr(fileName, hdrImage)) {
             // Terrible case: we don't know what kind of file is this one!
             if (result != NULL) { *result = UnknownType; }
             return false;
         }
+        clearComparison();
 
         // At this point we must have a valid HDR image loaded
         Q_ASSERT(hdrImage.Width() > 0 && hdrImage.Height() > 0);
 
-        // Updates the size of the LDR image, also a tone map will be needed.
-        ldrImage.Alloc(hdrImage.Width(), hdrImage.Height());
-
-        qImage = QImage(reinterpret_cast<uchar *>(ldrImage.GetDataPointer()), 
-            ldrImage.Width(), ldrImage.Height(), QImage::Format_RGB32);
+        // Updates the size of the LDR image to that of the level of the
+        // pyramid for the current scale, also a tone map will be needed.
+        pyramid.reset();
+        displayLevel = pyramid.levelForScale(scaleFactor);
+        const RGBAImageSoA &level = pyramid.level(displayLevel);
+        ldrImage.Alloc(level.Width(), level.Height());
+        updateQImage();
         
-        resize(ldrImage.Width(), ldrImage.Height());
+        resize(hdrImage.Width(), hdrImage.Height());
         dataProvider.update();
         // Keep the white point and key specified by the GUI (signal-updated)
         reinhard02Params.l_w = 
             static_cast<float>(dataProvider.avgLogLuminance());
         toneMapper.SetParams(reinhard02Params);
 
-        needsToneMap = true;
+        // There is nothing to display yet: show black until the worker
+        // delivers the tiles, the visible ones first
+        memset(ldrImage.GetDataPointer(), 0, ldrImage.Size() * sizeof(Bgra8));
+        invalidateToneMap();
         update();
 
         if (result != NULL) { *result = NoError; }
@@ -96,7 +119,7 @@ bool HDRImageDisplay::open(const QString &fileName, HdrResult * result)
     }
 }
 
-bool HDRImageDisplay::compareTo(const QString &fileName, ImageComparator::Type compareMethod,
+bool HDRImageDisplay::compareTo(const QString &fileName, ImageComparator::Type method,
                                 HdrResult *result)
 {
     // If nothing has been loaded, that's an illegal state
@@ -105,41 +128,73 @@ bool HDRImageDisplay::compareTo(const QString &fileName, ImageComparator::Type c
         return false;
     }
 
-    RGBAImageSoA other;
-
     try {
 
+        // The worker must be done with the current comparison before
+        // replacing it. The loaded image itself is never modified.
+        toneMapWorker->cancel();
+        clearComparison();
+
         // If there is actually a file, we try to load it
-        if (!loadHdr(fileName, other)) {
+        if (!loadHdr(fileName, otherImage)) {
             // Terrible case: we don't know what kind of file is this one!
+            otherImage.Clear();
+            invalidateToneMap();
             if (result != NULL) { *result = UnknownType; }
             return false;
         }
 
         // The sizes must be the same
-        if (hdrImage.Width() != other.Width() || hdrImage.Height() != other.Height()) {
+        if (hdrImage.Width() != otherImage.Width() ||
+            hdrImage.Height() != otherImage.Height()) {
+            otherImage.Clear();
+            invalidateToneMap();
             if (result != NULL) { *result = SizeMissmatch; }
             return false;
         }
 
-        // Now we perform the comparison operation in place
-        ImageComparator::Compare(compareMethod, hdrImage, hdrImage, other);
+        comparing = true;
+        compareMethod = method;
+        dataProvider.setComparison(&otherImage, compareMethod);
 
         // The sizes have not changed, thus the only thing required is a tone map
         // and an update
-        needsToneMap = true;
-        update();
+        invalidateToneMap();
 
         if (result != NULL) { *result = NoError; }
         return true;
     }
     catch(...) {
+        otherImage.Clear();
+        invalidateToneMap();
         if (result != NULL) { *result = ExceptionError; }
         return false;
     }
 }
 
 
+
+void HDRImageDisplay::setCompareMethod(ImageComparator::Type method)
+{
+    if (comparing && method != compareMethod) {
+        compareMethod = method;
+        dataProvider.setComparison(&otherImage, compareMethod);
+        invalidateToneMap();
+    }
+}
+
+
+
+void HDRImageDisplay::clearComparison()
+{
+    // Only valid while the worker does not use the images
+    comparing = false;
+    dataProvider.setComparison(NULL, compareMethod);
+    otherPyramid.reset();
+    otherImage.Clear();
+}
+
+
 bool HDRImageDisplay::loadHdr(const QString & fileName, RGBAImageSoA &hdr) 
 {
     QFileInfo fileInfo(fileName);
@@ -213,20 +268,28 @@ bool HDRImageDisplay::save(const QString & fileName)
                 return false;
         }
 
+        // The comparison only exists on the fly, compute it for the file
+        RGBAImageSoA diff;
+        if (comparing && type != NO_HDR) {
+            diff.Alloc(hdrImage.Width(), hdrImage.Height());
+            ImageComparator::Compare(compareMethod, diff, hdrImage, otherImage);
+        }
+        const RGBAImageSoA &img = comparing ? diff : hdrImage;
+
         switch(type) {
         case HDR_RGBE:
-            RgbeIO::Save(hdrImage, os);
+            RgbeIO::Save(img, os);
             return true;
         case HDR_EXR:
-            OpenEXRIO::Save(hdrImage, os);
+            OpenEXRIO::Save(img, os);
             return true;
         case HDR_PFM:
-            PfmIO::Save(hdrImage, os);
+            PfmIO::Save(img, os);
             return true;
         default:
-            // We just save the currently displayed image, that's it!
+            // We just save the tone mapped image, that's it!
             Q_ASSERT( ldrImage.Width() > 0 && ldrImage.Height() > 0 );
-            return qImage.save(fileName);
+            return fullToneMappedImage().save(fileName);
         }
     }
     catch(...) {
@@ -234,20 +297,113 @@ bool HDRImageDisplay::save(const QString & fileName)
     }
 }
 
+void HDRImageDisplay::invalidateToneMap()
+{
+    const unsigned int generation = nextGeneration();
+    if (comparing) {
+        toneMapWorker->request(pyramid, otherPyramid, compareMethod,
+            displayLevel, toneMapper, technique, generation);
+    } else if (!isEmpty()) {
+        toneMapWorker->request(pyramid, displayLevel, toneMapper, technique,
+            generation);
+    }
+}
+
+
+
+void HDRImageDisplay::setDisplayLevel(int level)
+{
+    if (level != displayLevel) {
+        displayLevel = level;
+        invalidateToneMap();
+    }
+}
+
+
+
+void HDRImageDisplay::updateQImage()
+{
+    qImage = QImage(reinterpret_cast<uchar *>(ldrImage.GetDataPointer()), 
+        ldrImage.Width(), ldrImage.Height(), QImage::Format_RGB32);
+}
+
+
+
+QImage HDRImageDisplay::fullToneMappedImage()
+{
+    if (displayedGeneration == toneMapGeneration &&
+        ldrImage.Width()  == hdrImage.Width() &&
+        ldrImage.Height() == hdrImage.Height()) {
+        return qImage;
+    }
+
+    // The worker only reads the HDR images as well, thus it may continue
+    Image<Bgra8> ldr(hdrImage.Width(), hdrImage.Height());
+    if (comparing) {
+        toneMapper.ToneMap(ldr, hdrImage, otherImage, compareMethod,
+            technique);
+    } else {
+        toneMapper.ToneMap(ldr, hdrImage, technique);
+    }
+    return QImage(reinterpret_cast<uchar *>(ldr.GetDataPointer()), 
+        ldr.Width(), ldr.Height(), QImage::Format_RGB32).copy();
+}
+
+
+
+void HDRImageDisplay::updateToneMap()
+{
+    const QSize size(ldrImage.Width(), ldrImage.Height());
+    bool complete = false;
+    const unsigned int generation =
+        toneMapWorker->takeResult(ldrImage, complete);
+    if (generation != 0) {
+        if (size != QSize(ldrImage.Width(), ldrImage.Height())) {
+            updateQImage();
+        }
+        if (complete) {
+            displayedGeneration = generation;
+        }
+        update();
+    }
+}
+
+
+
 void HDRImageDisplay::paintEvent(QPaintEvent *event) 
 {
-    if (needsToneMap && hdrImage.Width() > 0 && hdrImage.Height() > 0) {
-        toneMapper.ToneMap(ldrImage, hdrImage, technique);
-        needsToneMap = false;
+    if (isEmpty()) {
+        return;
     }
 
+    // The LDR image may be a reduced level of the pyramid, which covers the
+    // whole image as well
+    const qreal sx = scaleFactor * hdrImage.Width()  / ldrImage.Width();
+    const qreal sy = scaleFactor * hdrImage.Height() / ldrImage.Height();
+
+    // The worker tone maps the tiles on display before the rest
+    const QRect visible = visibleRegion().boundingRect();
+    const qreal invScale = static_cast<qreal>(1) / scaleFactor;
+    toneMapWorker->setVisibleArea(QRectF(visible.x() * invScale,
+        visible.y() * invScale, visible.width() * invScale,
+        visible.height() * invScale).toAlignedRect());
+
+    // Exposed area in LDR image coordinates, rounded outwards so that the
+    // smooth transform has all the pixels it needs at the edges. The LDR
+    // image is never tone mapped here, it is up to the worker.
+    const QRect &rect = event->rect();
+    const QRectF exposedF(rect.x() / sx, rect.y() / sy,
+        rect.width() / sx, rect.height() / sy);
+    const QRect exposed = exposedF.toAlignedRect().adjusted(-1, -1, 1, 1) &
+        QRect(0, 0, ldrImage.Width(), ldrImage.Height());
+
     QPainter painter(this);
 
-    painter.scale(scaleFactor,scaleFactor);
-    if (scaleFactor < static_cast<qreal>(1)) {
+    painter.scale(sx, sy);
+    if (sx < static_cast<qreal>(1) || sy < static_cast<qreal>(1)) {
         painter.setRenderHint(QPainter::SmoothPixmapTransform);
     }
-    painter.drawImage(/*x*/ 0, /*y*/ 0, qImage);
+    painter.drawImage(exposed.topLeft(), qImage, exposed);
 }
 
 
@@ -256,8 +412,7 @@ void HDRImageDisplay::setGamma(float gamma)
 {
     if (gamma != toneMapper.Gamma()) {
         toneMapper.SetGamma(gamma);
-        needsToneMap = true;
-        update();
+        invalidateToneMap();
     }
 }
 
@@ -265,8 +420,7 @@ void HDRImageDisplay::setExposure(float exposure)
 {
     if (exposure != toneMapper.Exposure()) {
         toneMapper.SetExposure(exposure);
-        needsToneMap = true;
-        update();
+        invalidateToneMap();
     }
 }
 
@@ -274,8 +428,7 @@ void HDRImageDisplay::setSRGB(bool enable)
 {
     if (enable != toneMapper.isSRGB()) {
         toneMapper.SetSRGB(enable);
-        needsToneMap = true;
-        update();
+        invalidateToneMap();
     }
 }
 
@@ -292,8 +445,7 @@ void HDRImageDisplay::setWhitePoint(double value)
         reinhard02Params.l_white = l_white;
         toneMapper.SetParams(reinhard02Params);
         if (technique == REINHARD02) {
-            needsToneMap = true;
-            update();
+            invalidateToneMap();
         }
     }
 }
@@ -306,8 +458,7 @@ void HDRImageDisplay::setKey(double value)
         reinhard02Params.key = key;
         toneMapper.SetParams(reinhard02Params);
         if (technique == REINHARD02) {
-            needsToneMap = true;
-            update();
+            invalidateToneMap();
         }
     }
 }
@@ -319,8 +470,7 @@ void HDRImageDisplay::setReinhard02(bool enabled)
     if (newTechnique != technique) {
         technique = newTechnique;
         toneMapper.SetParams(reinhard02Params);
-        needsToneMap = true;
-        update();
+        invalidateToneMap();
     }
 }
 
@@ -349,5 +499,5 @@ void HDRImageDisplay::copyToClipboard()
     Q_ASSERT( hdrImage.Width() > 0 && hdrImage.Height() > 0 );
 
     QClipboard *clipboard = QApplication::clipboard();
-    clipboard->setImage(qImage);    
+    clipboard->setImage(fullToneMappedImage());
 }
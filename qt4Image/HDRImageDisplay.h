@@ -30,9 +30,12 @@
 #include <ToneMapperSoA.h>
 
 #include "ImageDataProvider.h"
+#include "ImagePyramid.h"
 
 using namespace pcg;
 
+class ToneMapWorker;
+
 // Widget to encapsulate the loading and display of the tone mapped images
 class HDRImageDisplay : public QWidget {
 
@@ -43,7 +46,21 @@ private:
     // The internal representation of the HDR Image
     RGBAImageSoA hdrImage;
 
-    // The tone mapped version of the Image
+    // Reduced versions of the HDR image for zoomed out display
+    ImagePyramid pyramid;
+
+    // Image compared with the HDR one, with its own pyramid. Both images
+    // stay intact: the comparison is evaluated only for the displayed pixels
+    // while tone mapping, so that changing the method is instant.
+    RGBAImageSoA otherImage;
+    ImagePyramid otherPyramid;
+    bool comparing;
+    ImageComparator::Type compareMethod;
+
+    // The tone mapped version of the Image. It has the latest tiles from the
+    // tone mapping worker, which might be a bit behind the settings away from
+    // the visible area; it is a level of the pyramid, thus it might be
+    // smaller than the image.
     Image<Bgra8> ldrImage;
 
     // The abstraction to communicate information about the images
@@ -60,10 +77,21 @@ private:
 
     // Internal state variables
     qreal scaleFactor;
-    bool needsToneMap;
     TmoTechnique technique;
     Reinhard02::Params reinhard02Params;
 
+    // Background thread which tone maps the image with the latest settings
+    ToneMapWorker *toneMapWorker;
+
+    // Generation of the tone mapping settings, increased whenever they
+    // change, and the generation of the displayed LDR image once all of its
+    // tiles are up to date
+    unsigned int toneMapGeneration;
+    unsigned int displayedGeneration;
+
+    // Level of the pyramid to tone map for the current scale
+    int displayLevel;
+
 
 public:
 
@@ -80,7 +108,7 @@ public:
 
     virtual QSize sizeHint() const {
 
-        return scaleFactor*QSize(ldrImage.Width(), ldrImage.Height());
+        return scaleFactor*sizeOrig();
     }
 
     QSizePolicy sizePolicy () const {
@@ -90,9 +118,19 @@ public:
 
     bool open(const QString &fileName, HdrResult * result = 0);
 
+    // Displays the comparison of the loaded image with the given file, which
+    // replaces any previous comparison
     bool compareTo(const QString &fileName, ImageComparator::Type compareMethod,
         HdrResult * result = 0);
 
+    // Returns true while displaying a comparison
+    inline bool isComparing() const {
+        return comparing;
+    }
+
+    // Changes the method of the current comparison, if any
+    void setCompareMethod(ImageComparator::Type method);
+
 
     bool save(const QString & fileName);
 
@@ -109,13 +147,13 @@ public:
         scaleFactor = scale;
         QSize sizeAux = scale * sizeOrig();
         resize(sizeAux);
-        needsToneMap = true;
+        setDisplayLevel(pyramid.levelForScale(scale));
         update();
     }
 
     QSize sizeOrig() const 
     {
-        return QSize(ldrImage.Width(), ldrImage.Height());
+        return QSize(hdrImage.Width(), hdrImage.Height());
     }
 
     float scale() const
@@ -145,16 +183,49 @@ public slots:
 protected:
     virtual void paintEvent(QPaintEvent *event);
 
+private slots:
+    // Displays the result of the tone mapping worker, if any
+    void updateToneMap();
+
 signals:
 
     // This signal is like a "mouseOver" event, sending the 
     // absolute TopDown position, taking into account any resizing
     void mouseOverPixel( QPoint pos );
 
+    // Emitted when the background tone mapping fails, with the reason
+    void toneMapFailed(const QString &message);
+
 private:
 
     static bool loadHdr(const QString & fileName, RGBAImageSoA &hdr);
 
+    // Starts a new generation of the tone mapping settings, never zero
+    inline unsigned int nextGeneration() {
+        if (++toneMapGeneration == 0) {
+            ++toneMapGeneration;
+        }
+        return toneMapGeneration;
+    }
+
+    // Requests a new tone mapped image in the background, meanwhile the
+    // current one remains on display
+    void invalidateToneMap();
+
+    // Requests the given level of the pyramid if it is a different one
+    void setDisplayLevel(int level);
+
+    // Wraps the LDR image into the QImage, after its size changes
+    void updateQImage();
+
+    // Returns the full resolution LDR image with the current settings. It
+    // is tone mapped right away, in the GUI thread, unless that is the one
+    // already on display.
+    QImage fullToneMappedImage();
+
+    // Discards the image compared with the HDR one, if any
+    void clearComparison();
+
 };
 
 #endif /* HDRIMAGEDISPLAY_H */
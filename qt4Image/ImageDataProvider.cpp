@@ -39,17 +39,34 @@ void ImageDataProvider::setWhitePointRange( const range_t &otherRange, double ot
 
 // ----------------------------------------------------------------------------
 
+namespace
+{
+
+// Gathers the pixel (x,y) of a SoA image
+inline Rgba32F pixelAt(const RGBAImageSoA &img, int x, int y)
+{
+    return Rgba32F(img.ElementAt<RGBAImageSoA::R>(x, y),
+                   img.ElementAt<RGBAImageSoA::G>(x, y),
+                   img.ElementAt<RGBAImageSoA::B>(x, y),
+                   img.ElementAt<RGBAImageSoA::A>(x, y));
+}
+
+} // namespace
+
 ImageIODataProvider::ImageIODataProvider(const RGBAImageSoA &hdrImage,
                                          const Image<Bgra8> &ldrImage)
-: hdr(hdrImage), ldr(ldrImage), whitePoint(0.0), key(0.0), lw(0.0)
+: hdr(hdrImage), ldr(ldrImage), other(NULL),
+  compareMethod(ImageComparator::AbsoluteDifference),
+  whitePoint(0.0), key(0.0), lw(0.0)
 {
     update();
 }
 
 void ImageIODataProvider::update()
 {
-    // Validates that they are the same size
-    if (hdr.Width() != ldr.Width() || hdr.Height() != ldr.Height()) {
+    // Validates the sizes: the ldr image may be a reduced version
+    if (hdr.Width() < ldr.Width() || hdr.Height() < ldr.Height() ||
+        (hdr.Size() == 0) != (ldr.Size() == 0)) {
         throw IllegalArgumentException("Incongruent sizes!");
     }
 
@@ -72,7 +89,10 @@ void ImageIODataProvider::update()
 void ImageIODataProvider::getLdrPixel(int x, int y, 
     unsigned char &rOut, unsigned char &gOut, unsigned char &bOut) const 
 {
-    const Bgra8 &pix = ldr.ElementAt(x,y);
+    // Map the coordinates in case the ldr image is a reduced version
+    const int ldrX = static_cast<int>(static_cast<qint64>(x) * ldr.Width()  / hdr.Width());
+    const int ldrY = static_cast<int>(static_cast<qint64>(y) * ldr.Height() / hdr.Height());
+    const Bgra8 &pix = ldr.ElementAt(ldrX, ldrY);
     rOut = pix.r;
     gOut = pix.g;
     bOut = pix.b;
@@ -82,9 +102,29 @@ void ImageIODataProvider::getLdrPixel(int x, int y,
 void ImageIODataProvider::getHdrPixel(int x, int y, 
     float &rOut, float &gOut, float &bOut) const
 {
-    rOut = hdr.ElementAt<RGBAImageSoA::R>(x, y);
-    gOut = hdr.ElementAt<RGBAImageSoA::G>(x, y);
-    bOut = hdr.ElementAt<RGBAImageSoA::B>(x, y);
+    if (other == NULL) {
+        rOut = hdr.ElementAt<RGBAImageSoA::R>(x, y);
+        gOut = hdr.ElementAt<RGBAImageSoA::G>(x, y);
+        bOut = hdr.ElementAt<RGBAImageSoA::B>(x, y);
+        return;
+    }
+
+    // Compare just this pixel, with the method of the displayed image
+    const Rgba32F diff = ImageComparator::Compare(compareMethod,
+        pixelAt(hdr, x, y), pixelAt(*other, x, y));
+    rOut = diff.r();
+    gOut = diff.g();
+    bOut = diff.b();
+}
+
+
+void ImageIODataProvider::setComparison(const RGBAImageSoA *otherImage,
+                                        ImageComparator::Type method)
+{
+    Q_ASSERT(otherImage == NULL || (otherImage->Width() == hdr.Width() &&
+        otherImage->Height() == hdr.Height()));
+    other = otherImage;
+    compareMethod = method;
 }
 
 
@@ -26,6 +26,7 @@
 #include <QPair>
 
 #include "ImageSoA.h"
+#include "ImageComparator.h"
 #include "Rgba32F.h"
 #include "LDRPixels.h"
 
@@ -102,6 +103,10 @@ protected:
     // Reference to the backing ldr image
     const Image<Bgra8>   &ldr;
 
+    // Image compared with the hdr one, if not NULL
+    const RGBAImageSoA *other;
+    ImageComparator::Type compareMethod;
+
     // Good tone mapping defaults
     double whitePoint;
     double key;
@@ -111,12 +116,19 @@ public:
     // The constructor just stores the references to the images
     ImageIODataProvider(const RGBAImageSoA &hdrImage, const Image<Bgra8> &ldrImage);
 
-    // Gets the given pixel from the ldr image
+    // Gets the given pixel from the ldr image, which may be a reduced version
+    // of the hdr one
     virtual void getLdrPixel(int x, int y, unsigned char &rOut, unsigned char &gOut, unsigned char &bOut) const;
 
-    // Gets the given pixel from the hdr image
+    // Gets the given pixel from the hdr image, or from its comparison
     virtual void getHdrPixel(int x, int y, float &rOut, float &gOut, float &bOut) const;
 
+    // Makes the hdr pixels those of the comparison of the hdr image with
+    // another one of the same size, which is not copied. A NULL image
+    // disables the comparison.
+    void setComparison(const RGBAImageSoA *otherImage,
+        ImageComparator::Type method);
+
     // Gets sane tone mapping defaults
     virtual void getToneMapDefaults(double &whitePointOut, double &keyOut) const;
 
@@ -0,0 +1,86 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include "ImagePyramid.h"
+
+#include <Downsampler.h>
+
+#include <QtAlgorithms>
+
+
+ImagePyramid::ImagePyramid(const RGBAImageSoA &img) : image(img)
+{
+}
+
+
+
+ImagePyramid::~ImagePyramid()
+{
+    reset();
+}
+
+
+
+void ImagePyramid::reset()
+{
+    qDeleteAll(levels);
+    levels.clear();
+}
+
+
+
+int ImagePyramid::numLevels() const
+{
+    int n = 1;
+    for (int size = qMin(image.Width(), image.Height()); size > 1; size /= 2) {
+        ++n;
+    }
+    return n;
+}
+
+
+
+int ImagePyramid::levelForScale(double scale) const
+{
+    Q_ASSERT(scale > 0);
+    const int n = numLevels();
+    int l = 0;
+    for (double factor = 2.0; l + 1 < n && scale * factor <= 1.0;
+         factor *= 2.0) {
+        ++l;
+    }
+    return l;
+}
+
+
+
+const RGBAImageSoA & ImagePyramid::level(int l)
+{
+    Q_ASSERT(l >= 0 && l < numLevels());
+    while (levels.size() < l) {
+        const RGBAImageSoA &prev = levels.isEmpty() ? image : *levels.last();
+        RGBAImageSoA *next = new RGBAImageSoA(qMax(1, prev.Width()  / 2),
+                                              qMax(1, prev.Height() / 2));
+        try {
+            Downsampler::Downsample(prev, *next, Downsampler::BOX);
+        }
+        catch (...) {
+            delete next;
+            throw;
+        }
+        levels.append(next);
+    }
+    return l == 0 ? image : *levels[l - 1];
+}
@@ -0,0 +1,71 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+#if !defined(PCG_IMAGEPYRAMID_H)
+#define PCG_IMAGEPYRAMID_H
+
+#include <QList>
+
+// ImageIO includes
+#include <ImageSoA.h>
+
+using namespace pcg;
+
+
+// Multi-resolution version of an HDR image, to display it zoomed out without
+// processing all of its pixels. Level 0 is the image itself and each of the
+// following levels halves the previous one, rounding down, until the last
+// one is a single pixel wide or tall. The levels are generated lazily from
+// the previous level, with a parallel box filter.
+//
+// The pyramid is not thread safe: it may be used from another thread as long
+// as the image and the pyramid do not change meanwhile.
+class ImagePyramid {
+
+public:
+    // The pyramid keeps a reference to the image
+    ImagePyramid(const RGBAImageSoA &img);
+    ~ImagePyramid();
+
+    // Discards the generated levels. It must be called whenever the image
+    // changes.
+    void reset();
+
+    // Number of levels for the current size of the image
+    int numLevels() const;
+
+    // Returns the smallest level which is displayed at a scale of at least
+    // one when the image is displayed at the given scale, so that the level
+    // itself is never magnified
+    int levelForScale(double scale) const;
+
+    // Returns the requested level, generating it if needed
+    const RGBAImageSoA & level(int l);
+
+private:
+    // Non-copyable
+    ImagePyramid(const ImagePyramid&);
+    ImagePyramid& operator=(const ImagePyramid&);
+
+    const RGBAImageSoA &image;
+
+    // Levels from 1 onwards generated so far
+    QList<RGBAImageSoA*> levels;
+};
+
+#endif /* PCG_IMAGEPYRAMID_H */
@@ -121,6 +121,8 @@ MainWindow::MainWindow(const QApplication *application, QMainWindow *parent) :
     connect( toneMapDialog, SIGNAL(rejected()), this, SLOT(toneMapClosed()) );
     connect( hdrDisplay, 
         SIGNAL(mouseOverPixel(QPoint)), this, SLOT(mouseOverImage(QPoint)) );
+    connect( hdrDisplay,
+        SIGNAL(toneMapFailed(QString)), this, SLOT(toneMapFailed(QString)) );
     connect( this, SIGNAL(requestPixelInfo(QPoint)), 
         pixInfoDialog, SLOT(showInfo(QPoint)) );
 
@@ -233,6 +235,14 @@ void MainWindow::open()
 void MainWindow::compareWith(ImageComparator::Type type, 
                              const QString & description)
 {
+    // Both images remain loaded, thus switching the method is instant. To
+    // compare against a different file the original must be opened again.
+    if (hdrDisplay->isComparing()) {
+        hdrDisplay->setCompareMethod(type);
+        updateForLoadedImage(tr("[%1]").arg(description));
+        return;
+    }
+
     QString fileName = chooseHDRFile(tr("Open file for comparison"));
     if (fileName.isEmpty()) {
         return;
@@ -630,3 +640,10 @@ void MainWindow::toneMapClosed()
 {
     action_Tone_mapping->setChecked(false);
 }
+
+
+void MainWindow::toneMapFailed(const QString &message)
+{
+    QMessageBox::warning(this, appTitle,
+        tr("An error occurred while tone mapping the image: %1").arg(message));
+}
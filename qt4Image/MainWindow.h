@@ -143,6 +143,8 @@ protected slots:
     void toneMap();
     // To be used when the tone mapping dialog is closed, to update the GUI
     void toneMapClosed();
+    // Report that the displayed image could not be tone mapped
+    void toneMapFailed(const QString &message);
 
     // Launch the file associations
     void fileAssociations();
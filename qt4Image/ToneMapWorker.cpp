@@ -0,0 +1,417 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+// TBB goes first: its headers use "emit" as an identifier, which becomes a
+// macro after including Qt
+#include <tbb/task_group.h>
+
+#include "ToneMapWorker.h"
+#include "ImagePyramid.h"
+
+#include <QMutexLocker>
+#include <QRectF>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <utility>
+#include <vector>
+
+
+namespace
+{
+
+// Function object to tone map some rectangles of the source within a task
+// group. If there is another source it tone maps their comparison instead.
+class ToneMapTask
+{
+public:
+    ToneMapTask(const ToneMapperSoA &tm, TmoTechnique tmo,
+        const RGBAImageSoA &srcImage, const RGBAImageSoA *otherImage,
+        ImageComparator::Type method, const QVector<QRect> &areas,
+        Image<Bgra8> &destImage) :
+    toneMapper(tm), technique(tmo), src(srcImage), other(otherImage),
+    compareMethod(method), rects(areas), dest(destImage) {}
+
+    void operator()() const {
+        for (int i = 0; i < rects.size(); ++i) {
+            const QRect &r = rects[i];
+            if (other == NULL) {
+                toneMapper.ToneMap(dest, src, r.x(), r.y(),
+                    r.width(), r.height(), technique);
+            } else {
+                toneMapper.ToneMap(dest, src, *other, compareMethod, r.x(),
+                    r.y(), r.width(), r.height(), technique);
+            }
+        }
+    }
+
+private:
+    const ToneMapperSoA &toneMapper;
+    const TmoTechnique technique;
+    const RGBAImageSoA &src;
+    const RGBAImageSoA *other;
+    const ImageComparator::Type compareMethod;
+    const QVector<QRect> &rects;
+    Image<Bgra8> &dest;
+};
+
+
+
+// Copies the pixels within the rectangle between images of the same size
+void copyRect(Image<Bgra8> &dest, const Image<Bgra8> &src, const QRect &r)
+{
+    Q_ASSERT(dest.Width() == src.Width() && dest.Height() == src.Height());
+    for (int y = r.top(); y <= r.bottom(); ++y) {
+        const ptrdiff_t offset = static_cast<ptrdiff_t>(y) * src.Width() +
+            r.x();
+        memcpy(dest.GetDataPointer() + offset, src.GetDataPointer() + offset,
+            r.width() * sizeof(Bgra8));
+    }
+}
+
+
+
+// Distance in tiles between the tile (tx,ty) and the range of tiles
+inline int tileDistance(int tx, int ty, const QRect &tiles)
+{
+    const int dx = qMax(0, qMax(tiles.left() - tx, tx - tiles.right()));
+    const int dy = qMax(0, qMax(tiles.top()  - ty, ty - tiles.bottom()));
+    return qMax(dx, dy);
+}
+
+} // namespace
+
+
+
+struct ToneMapWorker::TaskGroup : public tbb::task_group
+{
+};
+
+
+
+ToneMapWorker::ToneMapWorker(QObject *parent) : QThread(parent),
+    hasPending(false), busy(false), quit(false), group(NULL),
+    numTilesX(0), numTilesY(0), resultResized(false),
+    resultGeneration(0), hasResult(false)
+{
+    pending.pyramid = NULL;
+    pending.otherPyramid = NULL;
+    pending.compareMethod = ImageComparator::AbsoluteDifference;
+    pending.level = 0;
+    pending.technique = EXPOSURE;
+    pending.generation = 0;
+}
+
+
+
+ToneMapWorker::~ToneMapWorker()
+{
+    stop();
+}
+
+
+
+void ToneMapWorker::request(ImagePyramid &pyramid, int level,
+                            const ToneMapperSoA &toneMapper,
+                            TmoTechnique technique, unsigned int generation)
+{
+    Job job;
+    job.pyramid = &pyramid;
+    job.otherPyramid = NULL;
+    job.compareMethod = ImageComparator::AbsoluteDifference;
+    job.level = level;
+    job.toneMapper = toneMapper;
+    job.technique = technique;
+    job.generation = generation;
+    submit(job);
+}
+
+
+
+void ToneMapWorker::request(ImagePyramid &pyramid, ImagePyramid &otherPyramid,
+                            ImageComparator::Type compareMethod, int level,
+                            const ToneMapperSoA &toneMapper,
+                            TmoTechnique technique, unsigned int generation)
+{
+    Job job;
+    job.pyramid = &pyramid;
+    job.otherPyramid = &otherPyramid;
+    job.compareMethod = compareMethod;
+    job.level = level;
+    job.toneMapper = toneMapper;
+    job.technique = technique;
+    job.generation = generation;
+    submit(job);
+}
+
+
+
+void ToneMapWorker::submit(const Job &job)
+{
+    QMutexLocker lock(&mutex);
+    pending = job;
+    hasPending = true;
+    if (group != NULL) {
+        group->cancel();
+    }
+    condition.wakeAll();
+}
+
+
+
+void ToneMapWorker::setVisibleArea(const QRect &area)
+{
+    QMutexLocker lock(&mutex);
+    visibleArea = area;
+}
+
+
+
+void ToneMapWorker::cancel()
+{
+    QMutexLocker lock(&mutex);
+    hasPending = false;
+    if (group != NULL) {
+        group->cancel();
+    }
+    while (busy) {
+        condition.wait(&mutex);
+    }
+    tileGeneration.fill(0);
+    hasResult = false;
+}
+
+
+
+unsigned int ToneMapWorker::takeResult(Image<Bgra8> &dest, bool &complete)
+{
+    QMutexLocker lock(&mutex);
+    if (!hasResult) {
+        return 0;
+    }
+    if (dest.Width() != result.Width() || dest.Height() != result.Height()) {
+        dest.Alloc(result.Width(), result.Height());
+        resultResized = true;
+    }
+    if (resultResized) {
+        memcpy(dest.GetDataPointer(), result.GetDataPointer(),
+            result.Size() * sizeof(Bgra8));
+        tileNew.fill(false);
+        resultResized = false;
+    } else {
+        for (int i = 0; i < tileNew.size(); ++i) {
+            if (tileNew[i]) {
+                copyRect(dest, result, tileRect(i));
+                tileNew[i] = false;
+            }
+        }
+    }
+
+    complete = tileGeneration.count(resultGeneration) == tileGeneration.size();
+    hasResult = false;
+    return resultGeneration;
+}
+
+
+
+void ToneMapWorker::stop()
+{
+    {
+        QMutexLocker lock(&mutex);
+        quit = true;
+        hasPending = false;
+        if (group != NULL) {
+            group->cancel();
+        }
+        condition.wakeAll();
+    }
+    wait();
+}
+
+
+
+QRect ToneMapWorker::tileRect(int tile) const
+{
+    return QRect((tile % numTilesX) * TILE_SIZE, (tile / numTilesX) * TILE_SIZE,
+        TILE_SIZE, TILE_SIZE) & QRect(0, 0, result.Width(), result.Height());
+}
+
+
+
+void ToneMapWorker::setupTiles(const QSize &size, const QSize &full)
+{
+    fullSize = full;
+    if (size == QSize(result.Width(), result.Height())) {
+        return;
+    }
+
+    // The tiles not tone mapped yet are black
+    result.Alloc(size.width(), size.height());
+    memset(result.GetDataPointer(), 0, result.Size() * sizeof(Bgra8));
+    numTilesX = (size.width()  + TILE_SIZE - 1) / TILE_SIZE;
+    numTilesY = (size.height() + TILE_SIZE - 1) / TILE_SIZE;
+    tileGeneration.fill(0, numTilesX * numTilesY);
+    tileNew.fill(false, numTilesX * numTilesY);
+    resultResized = true;
+    hasResult = false;
+}
+
+
+
+void ToneMapWorker::nextTiles(unsigned int generation,
+                              QVector<int> &tiles) const
+{
+    tiles.clear();
+
+    // Tiles which overlap the visible area scaled to the result, plus the
+    // margin. If nothing is visible all tiles are equally near.
+    QRect nearTiles;
+    if (!visibleArea.isEmpty() && !fullSize.isEmpty()) {
+        const qreal sx = static_cast<qreal>(result.Width())  /fullSize.width();
+        const qreal sy = static_cast<qreal>(result.Height())/fullSize.height();
+        const QRect area = QRectF(visibleArea.x() * sx, visibleArea.y() * sy,
+            visibleArea.width() * sx, visibleArea.height() * sy).
+            toAlignedRect() & QRect(0, 0, result.Width(), result.Height());
+        if (!area.isEmpty()) {
+            nearTiles = QRect(
+                QPoint(area.left()/TILE_SIZE - 1, area.top()/TILE_SIZE - 1),
+                QPoint(area.right()/TILE_SIZE + 1, area.bottom()/TILE_SIZE+1));
+        }
+    }
+
+    std::vector<std::pair<int, int> > farTiles;
+    for (int ty = 0; ty < numTilesY; ++ty) {
+        for (int tx = 0; tx < numTilesX; ++tx) {
+            const int tile = ty*numTilesX + tx;
+            if (tileGeneration[tile] == generation) {
+                continue;
+            }
+            const int distance = nearTiles.isNull() ? 0 :
+                tileDistance(tx, ty, nearTiles);
+            if (distance == 0 && !nearTiles.isNull()) {
+                tiles.push_back(tile);
+            } else {
+                farTiles.push_back(std::make_pair(distance, tile));
+            }
+        }
+    }
+    if (!tiles.isEmpty() || farTiles.empty()) {
+        return;
+    }
+
+    const size_t batch =
+        qMin(farTiles.size(), static_cast<size_t>(REFINE_BATCH));
+    std::partial_sort(farTiles.begin(), farTiles.begin() + batch,
+        farTiles.end());
+    for (size_t i = 0; i != batch; ++i) {
+        tiles.push_back(farTiles[i].second);
+    }
+}
+
+
+
+void ToneMapWorker::process(const Job &job, QMutexLocker &lock)
+{
+    // Generating the levels is not cancellable
+    const RGBAImageSoA &src = job.pyramid->level(job.level);
+    const RGBAImageSoA *other = job.otherPyramid != NULL ?
+        &job.otherPyramid->level(job.level) : NULL;
+    const RGBAImageSoA &full = job.pyramid->level(0);
+    if (work.Width() != src.Width() || work.Height() != src.Height()) {
+        work.Alloc(src.Width(), src.Height());
+    }
+
+    lock.relock();
+    setupTiles(QSize(src.Width(), src.Height()),
+        QSize(full.Width(), full.Height()));
+
+    QVector<int> tiles;
+    QVector<QRect> rects;
+    nextTiles(job.generation, tiles);
+    while (!tiles.isEmpty() && !hasPending && !quit) {
+        rects.clear();
+        for (int i = 0; i < tiles.size(); ++i) {
+            rects.push_back(tileRect(tiles[i]));
+        }
+
+        TaskGroup taskGroup;
+        group = &taskGroup;
+        lock.unlock();
+
+        const ToneMapTask task(job.toneMapper, job.technique, src, other,
+            job.compareMethod, rects, work);
+        const bool completed = taskGroup.run_and_wait(task) == tbb::complete;
+
+        lock.relock();
+        group = NULL;
+        if (!completed || hasPending || quit) {
+            break;
+        }
+
+        for (int i = 0; i < tiles.size(); ++i) {
+            copyRect(result, work, rects[i]);
+            tileGeneration[tiles[i]] = job.generation;
+            tileNew[tiles[i]] = true;
+        }
+        resultGeneration = job.generation;
+        hasResult = true;
+        emit toneMapDone();
+
+        // The visible area might have changed meanwhile
+        nextTiles(job.generation, tiles);
+    }
+}
+
+
+
+void ToneMapWorker::run()
+{
+    QMutexLocker lock(&mutex);
+    for (;;) {
+        while (!hasPending && !quit) {
+            condition.wait(&mutex);
+        }
+        if (quit) {
+            break;
+        }
+
+        const Job job = pending;
+        hasPending = false;
+        busy = true;
+        lock.unlock();
+
+        QString error;
+        try {
+            process(job, lock);
+        }
+        catch (const std::exception &e) {
+            error = QString::fromLocal8Bit(e.what());
+        }
+        catch (...) {
+            error = tr("Unknown error");
+        }
+
+        // The failed tiles remain out of date and the GUI keeps the ones it
+        // has, the user is told why the image stopped updating
+        lock.relock();
+        group = NULL;
+        busy = false;
+        if (!error.isEmpty() && !quit) {
+            emit toneMapFailed(error);
+        }
+        condition.wakeAll();
+    }
+}
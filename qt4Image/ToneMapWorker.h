@@ -0,0 +1,184 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Distributed under the OSI-approved MIT License (the "License");
+  see accompanying file LICENSE for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+#if !defined(PCG_TONEMAPWORKER_H)
+#define PCG_TONEMAPWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+
+// ImageIO includes
+#include <Image.h>
+#include <ImageComparator.h>
+#include <ImageSoA.h>
+#include <LDRPixels.h>
+#include <ToneMapperSoA.h>
+
+using namespace pcg;
+
+class ImagePyramid;
+
+
+// Thread which tone maps images in the background, so that the GUI never
+// waits for it. Only the latest request matters: a new request cancels the
+// one in progress. The tone mapping itself runs within a TBB task group, thus
+// cancelling it also cancels the parallel loops of the tone mapper.
+//
+// The result is split into square tiles tagged with the generation of the
+// settings they were tone mapped with. Each request first tone maps the out
+// of date tiles around the visible area and then, in small batches, the rest
+// of them from the nearest to the farthest; the finished tiles are handed to
+// the GUI after each step. Thus the tiles already up to date with the same
+// generation are kept when only the visible area changes.
+class ToneMapWorker : public QThread {
+
+    Q_OBJECT
+
+public:
+    // Size of the tiles of the result
+    static const int TILE_SIZE = 256;
+
+    // Number of tiles tone mapped by each step of the background refinement
+    static const int REFINE_BATCH = 8;
+
+    ToneMapWorker(QObject *parent = 0);
+    virtual ~ToneMapWorker();
+
+    // Requests a tone mapped version of a level of the pyramid with a copy
+    // of the given settings, superseding any previous request. The level is
+    // generated first if needed, which is not cancellable. Neither the image
+    // nor the pyramid may change until the request completes or it is
+    // cancelled.
+    void request(ImagePyramid &pyramid, int level,
+        const ToneMapperSoA &toneMapper, TmoTechnique technique,
+        unsigned int generation);
+
+    // Same as above for the comparison of the images of two pyramids with
+    // the same size, which is evaluated only while tone mapping the level
+    void request(ImagePyramid &pyramid, ImagePyramid &otherPyramid,
+        ImageComparator::Type compareMethod, int level,
+        const ToneMapperSoA &toneMapper, TmoTechnique technique,
+        unsigned int generation);
+
+    // Sets the area on display, in pixels of the full resolution image. The
+    // out of date tiles within it, plus a margin of one tile, are tone mapped
+    // before any other.
+    void setVisibleArea(const QRect &area);
+
+    // Cancels the pending request and the one in progress, if any, and marks
+    // all the tiles as out of date. When this method returns the worker no
+    // longer touches the pyramids.
+    void cancel();
+
+    // Copies into dest the tiles tone mapped since the last call. If the size
+    // of dest is different it is reallocated and it gets the whole result,
+    // where the tiles not tone mapped yet are black. Returns the generation
+    // of the new tiles or zero if there was nothing new to copy; complete is
+    // set if all the tiles are up to date with that generation.
+    unsigned int takeResult(Image<Bgra8> &dest, bool &complete);
+
+    // Cancels everything and waits for the thread to finish
+    void stop();
+
+signals:
+    // Emitted from the worker thread whenever new tiles are ready to be taken
+    void toneMapDone();
+
+    // Emitted from the worker thread when a request fails, with the reason.
+    // The request is abandoned, the next one starts over.
+    void toneMapFailed(const QString &message);
+
+protected:
+    virtual void run();
+
+private:
+    struct Job {
+        ImagePyramid *pyramid;
+        ImagePyramid *otherPyramid;     // NULL unless comparing
+        ImageComparator::Type compareMethod;
+        int level;
+        ToneMapperSoA toneMapper;
+        TmoTechnique technique;
+        unsigned int generation;
+    };
+
+    // Replaces the pending request, cancelling the one in progress
+    void submit(const Job &job);
+
+    // Tone maps the tiles for the job until all of them are up to date or
+    // the job is superseded. It is called without the lock and it returns
+    // holding it, unless it throws.
+    void process(const Job &job, QMutexLocker &lock);
+
+    // Prepares the tiles for an image of the given size, the level of the
+    // full resolution image of size fullSize. If the size of the result
+    // changes all the tiles become out of date. Requires the lock.
+    void setupTiles(const QSize &size, const QSize &fullSize);
+
+    // Fills tiles with the next out of date tiles for the generation: all
+    // those around the visible area if any, otherwise the REFINE_BATCH ones
+    // nearest to it. Requires the lock.
+    void nextTiles(unsigned int generation, QVector<int> &tiles) const;
+
+    // Pixels of the result covered by the tile
+    QRect tileRect(int tile) const;
+
+    // Guards all the state below, the condition signals both new requests
+    // and the worker becoming idle
+    QMutex mutex;
+    QWaitCondition condition;
+
+    Job pending;
+    bool hasPending;
+    bool busy;
+    bool quit;
+
+    // TBB task group of the request in progress, to cancel it. It is opaque
+    // here since the TBB headers do not get along with the Qt keywords.
+    struct TaskGroup;
+    TaskGroup *group;
+
+    // Area on display, in pixels of the full resolution image
+    QRect visibleArea;
+
+    // The tiles are tone mapped into work, which only the worker thread
+    // touches since the tone mapper may write a few pixels past each tile.
+    // The finished tiles are then copied into result, with the lock.
+    Image<Bgra8> work;
+    Image<Bgra8> result;
+    QSize fullSize;
+    int numTilesX;
+    int numTilesY;
+
+    // Generation of each tile of the result, zero if it is out of date, and
+    // whether the GUI has yet to take it
+    QVector<unsigned int> tileGeneration;
+    QVector<bool> tileNew;
+    bool resultResized;
+
+    // Generation of the latest tiles, valid only if hasResult is set
+    unsigned int resultGeneration;
+    bool hasResult;
+};
+
+#endif /* PCG_TONEMAPWORKER_H */
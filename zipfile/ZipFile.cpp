@@ -29,7 +29,8 @@ using std::endl;
 
 
 ZipFile::ZipFile(const char *name) :
-	m_uzFile(NULL), isOpen(false), currIndex(0),
+	filename(name != NULL ? name : ""), m_uzFile(NULL), isOpen(false),
+	currIndex(0),
 	zipstream(NULL), zstreambuf(NULL)
 {
 
@@ -191,6 +192,7 @@ ZipEntry* ZipFile::GetNextEntry()
 	entry->time = uzfi.dosDate;
 	entry->isDirectory = (uzfi.external_fa & (uLong)FILE_ATTRIBUTE_DIRECTORY) == 
 		                 (uLong)FILE_ATTRIBUTE_DIRECTORY;
+	entry->offset = unzGetOffset64(m_uzFile);
 
 	return entry;
 }
@@ -211,7 +213,7 @@ istream& ZipFile::GetInputStream(const ZipEntry *entry) {
 	if ( !GotoFile(e->GetIndex()) ) {
 		throw ZipException("Unexpeced error when moving to the specified file index");
 	}
-	zipstream_buf *zipbuffer = new zipstream_buf(m_uzFile, e->GetSize());
+	zipstream_buf *zipbuffer = new zipstream_buf(m_uzFile, filename.c_str(), *e);
 
 	// With the corresponding buffer created we just adjust the state variables and return
 	if (zipstream == NULL) {
@@ -228,3 +230,43 @@ istream& ZipFile::GetInputStream(const ZipEntry *entry) {
 	return *zipstream;
 
 }
+
+
+
+ZipEntryReader::ZipEntryReader(const ZipFile &zip, const ZipEntry *entry) :
+	zstreambuf(NULL), zipstream(NULL)
+{
+	if (!zip.isOpen) {
+		throw ZipFile::ZipException("Invalid state: the file is not open");
+	}
+
+	// We validate that the entry matches what we have
+	const ZipEntry *e = zip.entries.at(entry->GetIndex());
+	if (e->GetCrc() != entry->GetCrc()) {
+		throw ZipFile::ZipException("Entries missmatch, are you sure this is an entry from this zip?");
+	}
+
+	// The unzip handle is only needed to locate the data of the entry,
+	// jumping to it without walking the central directory
+	void *uzFile = unzOpen(zip.filename.c_str());
+	if (uzFile == NULL) {
+		throw ZipFile::ZipException("Error openning zipfile");
+	}
+	try {
+		if (unzSetOffset64(uzFile, e->offset) != UNZ_OK) {
+			throw ZipFile::ZipException("Unexpeced error when moving to the entry");
+		}
+		zstreambuf = new zipstream_buf(uzFile, zip.filename.c_str(), *e);
+	}
+	catch (...) {
+		unzClose(uzFile);
+		throw;
+	}
+	unzClose(uzFile);
+	zipstream = new istream(zstreambuf);
+}
+
+ZipEntryReader::~ZipEntryReader() {
+	delete zipstream;
+	delete zstreambuf;
+}
@@ -47,12 +47,15 @@ namespace pcg {
 		unsigned long time;
 		bool isDirectory;
 
+		// Position of the entry within the central directory
+		unsigned long long offset;
+
 
 		// The one constructor
 		ZipEntry(unsigned int index = 0) : 
 		  compressedSize(0), crc(0),
 		  method(0), size(0), time(0), 
-		  isDirectory(false)
+		  isDirectory(false), offset(0)
 		{
 			this->index = index;
 		}
@@ -69,6 +72,7 @@ namespace pcg {
 			size = entry.size;
 			time = entry.time;
 			isDirectory = entry.isDirectory;
+			offset = entry.offset;
 		}
 
 		// Returns the index of this entry in the zipfile
@@ -79,6 +83,7 @@ namespace pcg {
 	public:
 
 		friend class ZipFile;
+		friend class ZipEntryReader;
 
 		// Returns the comment string for the entry, or null if none
 		inline const char* GetComment() const {
@@ -132,8 +137,13 @@ namespace pcg {
 	 */
 	class ZipFile {
 
+		friend class ZipEntryReader;
+
 	protected:
 
+		// Name of the file, to open other handles to it
+		string filename;
+
 		// The internal unzip handle
 		void *m_uzFile;
 
@@ -202,7 +212,9 @@ namespace pcg {
 
 		// Returns an input stream for reading the contents of the specified zip file
 		// entry. This method is totally thread UNSAFE, as only one of this streams
-		// can be active per file at the same time. So use with care!
+		// can be active per file at the same time. So use with care! The stream
+		// is seekable, although seeking backwards within deflated entries needs
+		// to inflate again from the closest point already indexed.
 		istream& GetInputStream(const ZipEntry *entry);
 
 
@@ -226,6 +238,37 @@ namespace pcg {
 	};
 
 
+	/**
+	 * Reader of a single entry with its own handle to the zip file, which goes
+	 * straight to the entry through its position in the central directory.
+	 * Its stream is seekable as well.
+	 * Unlike ZipFile::GetInputStream, any number of readers may be used at the
+	 * same time, each one from a different thread, and they remain valid after
+	 * the ZipFile is closed.
+	 */
+	class ZipEntryReader {
+
+	public:
+		// Opens the entry, which must belong to the given zip file
+		ZipEntryReader(const ZipFile &zip, const ZipEntry *entry);
+
+		~ZipEntryReader();
+
+		// Stream with the uncompressed contents of the entry
+		inline istream& GetInputStream() {
+			return *zipstream;
+		}
+
+	private:
+		// Non-copyable
+		ZipEntryReader(const ZipEntryReader&);
+		ZipEntryReader& operator=(const ZipEntryReader&);
+
+		zipstream_buf *zstreambuf;
+		istream *zipstream;
+	};
+
+
 }
 
 
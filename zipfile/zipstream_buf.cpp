@@ -14,101 +14,300 @@
 ============================================================================*/
 
 #include "zipstream_buf.h"
+#include "ZipFile.h"
 #include "unzip.h"
 
 #include <cassert>
-#include <iostream>
+#include <cstring>
 #include <algorithm>
 
 using namespace pcg;
 using std::min;
-using std::cerr;
-using std::endl;
 
 
 const zipstream_buf::pos_type zipstream_buf::BAD_POSITION = 
 	zipstream_buf::pos_type(zipstream_buf::off_type(-1));
 
-zipstream_buf::zipstream_buf(const void* _m_uzFile, const unsigned long _size) :
-	m_uzFile(_m_uzFile), size(_size), readBytes(0), endOfEntry(false)
+zipstream_buf::zipstream_buf(const void* _m_uzFile, const char *filename,
+	const ZipEntry &entry) :
+	dataStart(0), compressedSize(entry.GetCompressedSize()),
+	size(entry.GetSize()), expectedCrc(entry.GetCrc()), crc(crc32(0L, Z_NULL, 0)),
+	crcPos(0), isDeflated(entry.GetMethod() == Z_DEFLATED), outPos(0),
+	seekTarget(0), seekPending(false), inPos(0), windowPos(0),
+	endOfStream(false)
 {
-	if (m_uzFile == NULL) {
+	if (_m_uzFile == NULL) {
 		throw ZipException("Null unzip archive");
 	}
+	if (entry.GetMethod() != 0 && !isDeflated) {
+		throw ZipException("Unsupported compression method");
+	}
 
-	if (unzOpenCurrentFile(const_cast<void*>(m_uzFile)) != UNZ_OK) {
+	// Opening the entry validates its local header and locates the data
+	void *uzFile = const_cast<void*>(_m_uzFile);
+	if (unzOpenCurrentFile(uzFile) != UNZ_OK) {
 		throw ZipException("Error when opening the current zip file");
 	}
+	dataStart = unzGetCurrentFileZStreamPos64(uzFile);
+	unzCloseCurrentFile(uzFile);
+
+	file.open(filename, ios_base::binary);
+	if (!file) {
+		throw ZipException("Error openning zipfile");
+	}
+
+	memset(&strm, 0, sizeof(strm));
+	memset(window, 0, sizeof(window));
+	if (isDeflated && inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+		throw ZipException("Couldn't initialize the inflater");
+	}
 
-	// Set the pointers to the beginning  of the stuff,
-	// the get next and the end pointer
-	// Initially the get pointer is at the end so that
-	// it fills the buffer upon the first request for data
-	setg(&buffer[0], &buffer[BUF_SIZE], &buffer[BUF_SIZE]);
+	// Initially the get area is empty so that it fills the buffer upon the
+	// first request for data
+	setg(&window[0], &window[0], &window[0]);
 }
 
-zipstream_buf::int_type	zipstream_buf::underflow() 
+zipstream_buf::~zipstream_buf()
 {
-	// You've read everything: don't even think about reading more!
-	if (endOfEntry) {
-		return traits_type::eof();
+	if (isDeflated) {
+		inflateEnd(&strm);
+	}
+	for (size_t i = 0; i < points.size(); ++i) {
+		delete points[i];
+	}
+}
+
+unsigned int zipstream_buf::readRaw(unsigned long long offset, char *dest,
+	unsigned int count)
+{
+	count = static_cast<unsigned int>(min(static_cast<unsigned long long>(count),
+		compressedSize - min(offset, compressedSize)));
+	if (count == 0) {
+		return 0;
+	}
+	file.clear();
+	file.seekg(static_cast<std::streamoff>(dataStart + offset));
+	file.read(dest, count);
+	if (file.gcount() != static_cast<streamsize>(count)) {
+		throw ZipException("Unexpected end of zip entry");
+	}
+	return count;
+}
+
+void zipstream_buf::updateCrc(unsigned long long start, const char *data)
+{
+	// Data beyond a forward seek within a stored entry never gets checked
+	if (start <= crcPos && crcPos < outPos) {
+		crc = crc32(crc, reinterpret_cast<const Bytef*>(data + (crcPos - start)),
+			static_cast<uInt>(outPos - crcPos));
+		crcPos = outPos;
+		if (crcPos == size && crc != expectedCrc) {
+			throw ZipException("Read all the file but the CRC is not good");
+		}
+	}
+}
+
+void zipstream_buf::reposition(unsigned long long position)
+{
+	if (!isDeflated) {
+		outPos = position;
+		return;
+	}
+
+	// Closest access point before the position, if any
+	const AccessPoint *point = NULL;
+	for (size_t i = points.size(); i > 0; --i) {
+		if (points[i-1]->out <= position) {
+			point = points[i-1];
+			break;
+		}
+	}
+
+	// Going forward just inflates up to the position unless there is an
+	// access point on the way
+	if (position >= outPos && (point == NULL || point->out <= outPos)) {
+		return;
+	}
+
+	inflateReset(&strm);
+	strm.avail_in = 0;
+	endOfStream = false;
+	windowPos = 0;
+	if (point == NULL) {
+		inPos  = 0;
+		outPos = 0;
+		return;
+	}
+
+	inPos = point->in;
+	if (point->bits != 0) {
+		char c;
+		readRaw(point->in - 1, &c, 1);
+		const int value = static_cast<unsigned char>(c) >> (8 - point->bits);
+		inflatePrime(&strm, point->bits, value);
+	}
+	inflateSetDictionary(&strm, point->window, WINDOW_SIZE);
+	memcpy(window, point->window, WINDOW_SIZE);
+	outPos = point->out;
+}
+
+unsigned int zipstream_buf::produceStored()
+{
+	const unsigned int count = static_cast<unsigned int>(
+		min(static_cast<unsigned long long>(WINDOW_SIZE), size - outPos));
+	readRaw(outPos, window, count);
+	outPos += count;
+	return 0;
+}
+
+unsigned int zipstream_buf::produceDeflated()
+{
+	if (windowPos == WINDOW_SIZE) {
+		windowPos = 0;
+	}
+	const unsigned int start = windowPos;
+	if (endOfStream) {
+		return start;
 	}
 
+	strm.next_out  = reinterpret_cast<Bytef*>(&window[windowPos]);
+	strm.avail_out = WINDOW_SIZE - windowPos;
+	do {
+		if (strm.avail_in == 0) {
+			strm.avail_in = readRaw(inPos, input, BUF_SIZE);
+			strm.next_in  = reinterpret_cast<Bytef*>(input);
+			inPos += strm.avail_in;
+		}
+
+		// The end of the last block may be reached after all the input has
+		// been consumed, hence the inflater gets called even without input
+		const int ret = inflate(&strm, Z_BLOCK);
+		if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+			throw ZipException("Corrupt deflated data in zip entry");
+		}
+		if (ret == Z_BUF_ERROR && strm.avail_in == 0) {
+			throw ZipException("Unexpected end of zip entry");
+		}
+		const unsigned int end = WINDOW_SIZE - strm.avail_out;
+		if (ret == Z_STREAM_END) {
+			endOfStream = true;
+			windowPos = end;
+			break;
+		}
+
+		// At the end of a block which is not the last one, remember the
+		// state if it is far enough from the last access point
+		const unsigned long long out = outPos + (end - start);
+		if ((strm.data_type & 128) && !(strm.data_type & 64) &&
+			(points.empty() ? out >= SPAN : out >= points.back()->out + SPAN)) {
+			AccessPoint *point = new AccessPoint;
+			point->out  = out;
+			point->in   = inPos - strm.avail_in;
+			point->bits = strm.data_type & 7;
+			memcpy(point->window, &window[end], WINDOW_SIZE - end);
+			memcpy(point->window + (WINDOW_SIZE - end), window, end);
+			points.push_back(point);
+		}
+	} while (strm.avail_out != 0);
+
+	windowPos = WINDOW_SIZE - strm.avail_out;
+	outPos += windowPos - start;
+	if (endOfStream && outPos != size) {
+		throw ZipException("Unexpected end of zip entry");
+	}
+	return start;
+}
+
+unsigned int zipstream_buf::produce()
+{
+	const unsigned long long start = outPos;
+	const unsigned int offset = isDeflated ? produceDeflated() : produceStored();
+	updateCrc(start, &window[offset]);
+	return offset;
+}
+
+zipstream_buf::int_type	zipstream_buf::underflow() 
+{
 	// Ok, perhaps we can just happily return whatever is in the buffer
 	if (gptr() != egptr()) {
-		// Check for evil modifications in debug mode
-		assert(gptr() >= &buffer[0] && gptr() < &buffer[BUF_SIZE]);
-		return traits_type::not_eof( *gptr() );
+		return traits_type::to_int_type( *gptr() );
+	}
+
+	// You've read everything: don't even think about reading more!
+	const unsigned long long position = seekPending ? seekTarget : outPos;
+	if (position >= size) {
+		return traits_type::eof();
 	}
 
 	// This case means that we have to fill the buffer with more data,
-	// update the pointers and updates the readBytes variable
-	int nRet = unzReadCurrentFile(const_cast<void*>(m_uzFile), buffer, BUF_SIZE);
-	if (nRet > 0) {
-		assert(nRet <= BUF_SIZE);
-		setg(&buffer[0], &buffer[0], &buffer[nRet]);
-		readBytes += nRet;
-		return traits_type::not_eof( *gptr() );
-	}
-	else {
-		// That's it, whe read everything, did we?
-		endOfEntry = true;
-		if (readBytes != size) {
+	// skipping anything before the position, and update the pointers
+	reposition(position);
+	for (;;) {
+		const unsigned long long start = outPos;
+		const unsigned int offset = produce();
+		if (outPos == start) {
 			throw ZipException("Unexpected end of zip entry");
 		}
-		if (unzCloseCurrentFile(const_cast<void*>(m_uzFile)) == UNZ_CRCERROR) {
-			throw ZipException("Read all the file but the CRC is not good");
+		if (outPos > position) {
+			char *base = &window[offset];
+			setg(base, base + (position - start), base + (outPos - start));
+			break;
 		}
-		return traits_type::eof();
 	}
+	seekPending = false;
+	return traits_type::to_int_type( *gptr() );
 }
 
 streamsize zipstream_buf::showmanyc() {
 
-	if (endOfEntry) {
-		return 0;
+	const unsigned long long position = seekPending ? seekTarget :
+		outPos - (egptr() - gptr());
+	if (position >= size) {
+		return -1;
 	}
-	else {
-		return min(BUF_SIZE, static_cast<int>(size-readBytes));
+	return static_cast<streamsize>(
+		min(static_cast<unsigned long long>(WINDOW_SIZE), size - position));
+}
+
+zipstream_buf::pos_type zipstream_buf::seekoff(off_type off,
+	ios_base::seekdir way, ios_base::openmode which)
+{
+	if ((which & ios_base::in) == 0) {
+		return BAD_POSITION;
 	}
+	const off_type current = static_cast<off_type>(seekPending ? seekTarget :
+		outPos - (egptr() - gptr()));
+	off_type base;
+	if (way == ios_base::beg) {
+		base = 0;
+	} else if (way == ios_base::cur) {
+		base = current;
+	} else {
+		base = static_cast<off_type>(size);
+	}
+	return seekpos(pos_type(base + off), which);
 }
 
-// WARNING: This hasn't been tested throughly! there might be horrible bugs!
 zipstream_buf::pos_type zipstream_buf::seekpos(pos_type sp, ios_base::openmode which)
 {
-	// If it's utterly invalud just return
-	const int buffBase = ((readBytes - 
-		min(BUF_SIZE, static_cast<int>(size-readBytes)))/BUF_SIZE)*BUF_SIZE;
-	if (sp < 0 || sp > size || sp < buffBase || sp > (buffBase+BUF_SIZE)) {
+	// If it's utterly invalid just return
+	if ((which & ios_base::in) == 0 || off_type(sp) < 0 ||
+		static_cast<unsigned long long>(off_type(sp)) > size) {
 		return BAD_POSITION;
 	}
+	const unsigned long long position =
+		static_cast<unsigned long long>(off_type(sp));
 
-	// Lets limit the seek to within the buffer
-	const int relativePos = static_cast<int>(sp < BUF_SIZE ? (int)sp : (int)(sp % BUF_SIZE));
-	assert(relativePos >= 0 && relativePos < BUF_SIZE);
-
-	setg(&buffer[0], &buffer[relativePos], egptr());
+	// Seeks within the buffer just move the pointer
+	const unsigned long long bufferStart = outPos - (egptr() - eback());
+	if (!seekPending && position >= bufferStart && position < outPos) {
+		setg(eback(), eback() + (position - bufferStart), egptr());
+		return sp;
+	}
 
+	// Otherwise the buffer gets discarded, the next read does the rest
+	setg(&window[0], &window[0], &window[0]);
+	seekTarget  = position;
+	seekPending = true;
 	return sp;
 }
-
@@ -16,12 +16,23 @@
 // This is the class that will do the actual magic behind scenes.
 // This guy then be encapsulated into a generic istream: we don't
 // want to expose this to the public... should we though?
+//
+// The entry data is read straight from the zip file through a separate
+// handle, so that the stream is fully seekable: stored entries simply map
+// to their byte range, while deflated ones build an index of access points
+// as they get inflated, in the spirit of zlib's zran example. Each access
+// point keeps the last 32 KB of uncompressed data before a deflate block
+// boundary, thus seeking backwards only inflates again from the closest
+// access point instead of the beginning of the entry.
 
 #ifndef PCG_ZIPSTREAM_BUF_H
 #define PCG_ZIPSTREAM_BUF_H
 
 #include "unzip.h"
 #include <streambuf>
+#include <fstream>
+#include <string>
+#include <vector>
 
 using std::streamsize;
 using std::streambuf;
@@ -31,12 +42,18 @@ using std::ios_base;
 
 namespace pcg {
 
-	// Forward declaration
+	// Forward declarations
 	class ZipFile;
+	class ZipEntry;
+	class ZipEntryReader;
 
 	class zipstream_buf : public streambuf {
 
 		friend class ZipFile;
+		friend class ZipEntryReader;
+
+	public:
+		virtual ~zipstream_buf();
 
 	private:
 		// Basic exception type
@@ -56,26 +73,94 @@ namespace pcg {
 			std::string message;
 		};
 
-	protected:
-		char buffer[BUF_SIZE];
+		// Size of the deflate window, which is also the size of the buffer
+		// with the uncompressed data
+		static const unsigned int WINDOW_SIZE = 32768;
+
+		// Minimum distance in uncompressed bytes between access points
+		static const unsigned long long SPAN = 1048576;
+
+		// State of the inflater at a deflate block boundary
+		struct AccessPoint {
+			// Offsets in the uncompressed and compressed data
+			unsigned long long out;
+			unsigned long long in;
+			// Number of bits of the byte before "in" which belong to the block
+			int bits;
+			// Uncompressed data right before "out"
+			unsigned char window[WINDOW_SIZE];
+		};
+
+		// Non-copyable
+		zipstream_buf(const zipstream_buf&);
+		zipstream_buf& operator=(const zipstream_buf&);
+
+		// Moves the producer back to position or, for deflated entries, to the
+		// closest access point before it if that saves inflating
+		void reposition(unsigned long long position);
+
+		// Produces the next piece of uncompressed data into the window and
+		// returns its offset within the window. Returns zero bytes at the end.
+		unsigned int produce();
+		unsigned int produceStored();
+		unsigned int produceDeflated();
+
+		// Reads compressed data at the given offset within the entry
+		unsigned int readRaw(unsigned long long offset, char *dest,
+			unsigned int count);
+
+		// Checks the CRC of the data which has not been checked yet
+		void updateCrc(unsigned long long start, const char *data);
 
+	protected:
 		const static pos_type BAD_POSITION;
 
-		// Pointer to the underlying zip file from the original zip library
-		const void* m_uzFile;
+		// Separate handle to the zip file
+		std::ifstream file;
+
+		// Position of the entry data within the zip file
+		unsigned long long dataStart;
+
+		// The compressed and uncompressed sizes of the entry
+		const unsigned long long compressedSize;
+		const unsigned long long size;
+
+		// The expected CRC and the one of the data read so far, in order
+		const unsigned long expectedCrc;
+		unsigned long crc;
+		unsigned long long crcPos;
+
+		// Whether the data is deflated, otherwise it is just stored
+		const bool isDeflated;
+
+		// Uncompressed data, which for deflated entries is also the circular
+		// window of the inflater. The get area is always a piece of it.
+		char window[WINDOW_SIZE];
+
+		// Offset of the next uncompressed byte to produce, which is right
+		// after the end of the get area
+		unsigned long long outPos;
 
-		// The uncompressed size of the file
-		const unsigned int size;
+		// Position to read from once the get area gets discarded by a seek
+		unsigned long long seekTarget;
+		bool seekPending;
 
-		// Count of the bytes read so far from the file
-		unsigned int readBytes;
+		// Inflater state: the compressed data, its position and the next
+		// position within the window
+		z_stream strm;
+		char input[BUF_SIZE];
+		unsigned long long inPos;
+		unsigned int windowPos;
+		bool endOfStream;
 
-		// A flag to remember when we reach the end of the entry
-		bool endOfEntry;
+		// Access points in order, the last one is the farthest indexed
+		std::vector<AccessPoint*> points;
 
 		// Yes, the constructor is protected: this class depends completely in the ZipFile
-		// for a proper behavior
-		zipstream_buf(const void* _uzFile, const unsigned long _size);
+		// for a proper behavior. The unzip handle must be at the entry to read, and
+		// filename is the name of the zip file.
+		zipstream_buf(const void* _uzFile, const char *filename,
+			const ZipEntry &entry);
 
 		// This is the trully magic function which fills the buffer
 		// and manipulates the current character pointer
@@ -89,7 +174,9 @@ namespace pcg {
 			return streambuf::overflow(c);
 		}
 
-		// Tries to alter the current positions for the controlled streams
+		// Moves the read position anywhere within the entry
+		virtual pos_type seekoff(off_type off, ios_base::seekdir way,
+			ios_base::openmode which = ios_base::in | ios_base::out);
 		virtual pos_type seekpos(pos_type _Sp,
 			ios_base::openmode _Which = ios_base::in | ios_base::out);
 